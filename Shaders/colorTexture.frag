@@ -7,29 +7,199 @@ uniform sampler2D uTexture;
 
 varying vec2 vary_uv;
 
+#ifdef UNIFORM_BUFFERS
+//Shared std140 blocks. Must match FrameUniforms, MaterialUniforms and ObjectUniforms (UniformBuffers.h) and colorTexture.vert
+struct MaterialData
+{
+	vec4 color;
+	vec4 cts;
+};
+
+layout(std140) uniform FrameBlock
+{
+	mat4 uView;
+	mat4 uProjection;
+	mat4 uViewProjection;
+	vec4 uCameraPosition4;
+	vec4 uLightPosition4;
+	vec4 uLightColor4;
+	vec4 uDepthParams;
+};
+
+layout(std140) uniform MaterialBlock
+{
+	MaterialData uMaterials[MAX_MATERIALS];
+};
+
+layout(std140) uniform ObjectBlock
+{
+	mat4  uMVP;
+	mat4  uModel;
+	mat3  uInvModel3x3;
+	ivec4 uObjectMaterial;
+	vec4  uOccluders[MAX_OCCLUDERS];
+};
+
+#define uMtlColor       uMaterials[uObjectMaterial.x].color.rgb
+#define uMtlCts         uMaterials[uObjectMaterial.x].cts
+#define uLightPos       uLightPosition4.xyz
+#define uLightColor     uLightColor4.rgb
+#define uCameraPosition uCameraPosition4.xyz
+#define uLightRadius    uLightPosition4.w
+#define uNbOccluders    uObjectMaterial.y
+#else
 uniform vec3 uMtlColor;
 uniform vec4 uMtlCts;
 uniform vec3 uLightPos;
 uniform vec3 uLightColor;
 uniform vec3 uCameraPosition;
+#if defined(LOG_DEPTH) || defined(IMPOSTORS)
+uniform vec4 uDepthParams;
+#endif
+#ifdef IMPOSTORS
+uniform mat4 uViewProjection;
+#endif
+#ifdef ECLIPSES
+uniform float uLightRadius;
+uniform int   uNbOccluders;
+uniform vec4  uOccluders[MAX_OCCLUDERS];
+#endif
+#endif
 
 varying vec3 vary_normal;
 varying vec4 vary_world_position;
+#ifdef LOG_DEPTH
+varying float vary_log_depth;
+#endif
+#ifdef IMPOSTORS
+varying vec4 vary_impostor;
+varying mat3 vary_impostor_axes;
+#endif
 
 //We still use varying because OpenGLES 2.0 (OpenGL Embedded System, for example for smartphones) does not accept "in" and "out"
 
+#ifdef ECLIPSES
+const float PI = 3.14159265;
+
+//Area of the intersection of two discs of radii a and b whose centers are c apart (the lens between two circles)
+float discOverlap(float a, float b, float c)
+{
+	if(c >= a + b)
+		return 0.0;
+	if(c <= abs(a - b))
+		return PI * min(a, b) * min(a, b);
+	float alpha = acos(clamp((c * c + a * a - b * b) / (2.0 * c * a), -1.0, 1.0)); //Half angles of the chord seen from each center
+	float beta  = acos(clamp((c * c + b * b - a * a) / (2.0 * c * b), -1.0, 1.0));
+	return a * a * (alpha - 0.5 * sin(2.0 * alpha)) + b * b * (beta - 0.5 * sin(2.0 * beta));
+}
+
+//Part of the light disc seen from p which no occluder hides : 1 in the light, between 0 and 1 in the penumbra, 0 in the umbra
+//The discs are the angular radii of the spheres seen from p, their distance the angle between their directions
+float lightVisibility(vec3 p)
+{
+	vec3  toLight       = uLightPos - p;
+	float lightDistance = length(toLight);
+	float a = max(asin(min(1.0, uLightRadius / lightDistance)), 1e-5); //A point light gives hard shadows
+	float visibility = 1.0;
+	for(int i = 0; i < uNbOccluders; i++)
+	{
+		vec3  toOccluder       = uOccluders[i].xyz - p;
+		float occluderDistance = length(toOccluder);
+		if(occluderDistance >= lightDistance)
+			continue;
+		float b = asin(min(1.0, uOccluders[i].w / occluderDistance));
+		float c = atan(length(cross(toLight, toOccluder)), dot(toLight, toOccluder)); //More precise than acos for the small angles
+		visibility *= 1.0 - min(1.0, discOverlap(a, b, c) / (PI * a * a));
+	}
+	return visibility;
+}
+#endif
+
+#ifdef IMPOSTORS
+//The UVs of StaticSphere<32, 32> : the angles are divided by 31 quads, the UVs by 32. Kept so that a body does not change when it becomes an impostor
+const float SPHERE_UV_SCALE = 31.0 / 32.0;
+const float TWO_PI          = 6.28318531;
+#endif
+
 void main()
 {
+	vec2 uv = vary_uv;
+#ifdef IMPOSTORS
+	//The nearest intersection of the ray from the camera (at the origin) through the quad with the sphere
+	vec3  rayDir  = normalize(vary_world_position.xyz);
+	vec3  center  = vary_impostor.xyz;
+	float radius  = vary_impostor.w;
+	float along   = dot(rayDir, center);
+	vec3  closest = center - along * rayDir;
+	float h       = radius * radius - dot(closest, closest); //Precise for the small spheres far away, unlike along² - |center|² + radius²
+	if(h < 0.0)
+		discard;
+	vec3 position = (along - sqrt(h)) * rayDir;
+	vec3 normal   = (position - center) / radius;
+
+	//Longitude from +z towards +x and colatitude from +y in the frame of the body (transpose : the inverse rotation)
+	vec3  local = normal * vary_impostor_axes;
+	float theta = atan(local.x, local.z);
+	if(theta < 0.0)
+		theta += TWO_PI;
+	uv = vec2(theta / TWO_PI, acos(clamp(local.y, -1.0, 1.0)) / (0.5 * TWO_PI)) * SPHERE_UV_SCALE;
+
+	vec4 clip = uViewProjection * vec4(position, 1.0);
+#ifdef LOG_DEPTH
+	float depth = log2(1.0 + clip.w) * uDepthParams.x * 0.5;
+#else
+	float depth = uDepthParams.y > 0.5 ? clip.z / clip.w : clip.z / clip.w * 0.5 + 0.5; //[0, 1] clip space of the reversed depth, [-1, 1] otherwise
+#endif
+#elif !defined(PARTICLES) && !defined(UNLIT)
+	vec3 position = vary_world_position.xyz;
 	vec3 normal   = normalize(vary_normal);
-	vec3 lightDir = normalize(uLightPos - vary_world_position.xyz);
-	vec3 V        = normalize(uCameraPosition - vary_world_position.xyz);
-	vec3 R        = reflect(-lightDir, normal);
+#endif
+
+#ifdef PARTICLES
+	//Soft disc, no texture
+	float d = length(vary_uv * 2.0 - 1.0);
+	vec4 color = varyColor * vec4(1.0, 1.0, 1.0, 1.0 - smoothstep(0.3, 1.0, d));
+#elif defined(UNLIT)
+	//Only the ambient term (no diffuse nor specular, or forced by the material) : a single texture fetch, no lighting
+	vec4 color = vec4(uMtlCts.x * uMtlColor * uLightColor, 1.0) * texture2D(uTexture, uv);
+#else
+	vec3 lightDir = normalize(uLightPos - position);
 	
 	vec3 ambient  = uMtlCts.x * uMtlColor * uLightColor;
 	vec3 diffuse  = uMtlCts.y * max(0.0, dot(normal, lightDir)) * uMtlColor * uLightColor;
+#ifdef NO_SPECULAR
+	vec3 specular = vec3(0.0);
+#else
+	vec3 V        = normalize(uCameraPosition - position);
+	vec3 R        = reflect(-lightDir, normal);
 	vec3 specular = uMtlCts.z * pow(max(0.0, dot(R, V)), uMtlCts.w) * uLightColor;
+#endif
+#ifdef ECLIPSES
+	//The ambient term stays : it stands for the light scattered by everything else
+	float visibility = lightVisibility(position);
+	diffuse  *= visibility;
+	specular *= visibility;
+#endif
     
-	vec4 color =  vec4(ambient + diffuse + specular, 1.0) * texture2D(uTexture, vary_uv) ;
-      gl_FragColor = color;
+	vec4 color =  vec4(ambient + diffuse + specular, 1.0) * texture2D(uTexture, uv) ;
       //gl_FragColor = texture2D(uTexture, vary_uv);
+#endif
+
+#ifdef WEIGHTED_BLENDED
+	//Order-independent transparency (see WeightedBlending) : the premultiplied color and the alpha, weighted by the distance to the camera
+	//(McGuire and Bavoil, equation 7). The world positions are camera-relative
+	float z = length(vary_world_position.xyz);
+	float w = color.a * clamp(10.0 / (1e-5 + pow(z / 5.0, 2.0) + pow(z / 200.0, 6.0)), 1e-2, 3e3);
+	gl_FragData[0] = vec4(color.rgb * color.a * w, color.a);
+	gl_FragData[1] = vec4(color.a * w);
+#else
+	gl_FragColor = color;
+#endif
+
+#ifdef IMPOSTORS
+	gl_FragDepth = depth;
+#elif defined(LOG_DEPTH)
+	//Per fragment : the logarithm is not linear across the big triangles next to the camera
+	gl_FragDepth = log2(vary_log_depth) * uDepthParams.x * 0.5;
+#endif
 }
@@ -8,26 +8,117 @@ attribute vec3 vNormal;
 
 
 //uniform float uScale;
+#ifdef UNIFORM_BUFFERS
+//Shared std140 blocks. Must match FrameUniforms and ObjectUniforms (UniformBuffers.h) and colorTexture.frag
+layout(std140) uniform FrameBlock
+{
+	mat4 uView;
+	mat4 uProjection;
+	mat4 uViewProjection;
+	vec4 uCameraPosition4;
+	vec4 uLightPosition4;
+	vec4 uLightColor4;
+	vec4 uDepthParams;
+};
+
+layout(std140) uniform ObjectBlock
+{
+	mat4  uMVP;
+	mat4  uModel;
+	mat3  uInvModel3x3;
+	ivec4 uObjectMaterial;
+	vec4  uOccluders[MAX_OCCLUDERS];
+};
+#else
 uniform mat4 uMVP;
 uniform mat4 uModel;
 uniform mat3 uInvModel3x3;
+#ifdef LOG_DEPTH
+uniform vec4 uDepthParams; //x : 2 / log2(zFar + 1)
+#endif
+#endif
+
+#ifdef PARTICLES
+attribute vec4 vInstancePositionSize; //Per-instance center (xyz) and width (w) of the billboard
+attribute vec4 vInstanceColor;
+#ifndef UNIFORM_BUFFERS
+uniform mat4 uView;
+uniform mat4 uProjection;
+#endif
+#endif
+
+#ifdef INSTANCED
+attribute mat4 vInstanceModel; //Per-instance model matrix (uses 4 attribute locations)
+#ifndef UNIFORM_BUFFERS
+uniform mat4 uViewProjection;
+#endif
+#endif
 
 varying vec4 varyColor; //Depending who compiles, these variables are not "varying" but "out". In this version (130) both are accepted. out should be used later
 varying vec2 vary_uv;
 varying vec3 vary_normal;
 varying vec4 vary_world_position;
+#ifdef LOG_DEPTH
+varying float vary_log_depth;
+#endif
+#ifdef IMPOSTORS
+varying vec4 vary_impostor;      //Center (camera-relative) and radius of the sphere
+varying mat3 vary_impostor_axes; //Rotation of the sphere, without its scale
+#endif
 
 //We still use varying because OpenGLES 2.0 (OpenGL Embedded System, for example for smartphones) does not accept "in" and "out"
 
 void main()
 {
+#ifdef PARTICLES
+      //The corner is added in view space : the quad always faces the camera
+      vec4 center = uView * vec4(vInstancePositionSize.xyz, 1.0);
+      gl_Position = uProjection * (center + vec4(vPosition.xy * vInstancePositionSize.w, 0.0, 0.0));
+      vary_uv = vPosition.xy + 0.5;
+      varyColor = vInstanceColor;
+#elif defined(IMPOSTORS)
+      //A square in the plane of the center facing the camera (at the origin), just large enough to hold the silhouette of the sphere
+      vec3  center   = vInstanceModel[3].xyz;
+      float radius   = 0.5 * length(vInstanceModel[0].xyz); //The instances are uniformly scaled
+      float distance = length(center);
+      vec3  forward  = center / distance;
+      vec3  right    = normalize(cross(forward, abs(forward.y) < 0.99 ? vec3(0.0, 1.0, 0.0) : vec3(1.0, 0.0, 0.0)));
+      vec3  up       = cross(right, forward);
+      float halfSize = radius * distance / sqrt(max(distance * distance - radius * radius, 1e-12));
+      vec2  corner   = vec2(gl_VertexID & 1, (gl_VertexID >> 1) & 1) * 2.0 - 1.0; //Triangle strip
+      vary_world_position = vec4(center + (right * corner.x + up * corner.y) * halfSize, 1.0);
+      gl_Position = uViewProjection * vary_world_position;
+      vary_impostor = vec4(center, radius);
+      vary_impostor_axes = mat3(normalize(vInstanceModel[0].xyz), normalize(vInstanceModel[1].xyz), normalize(vInstanceModel[2].xyz));
+#elif defined(INSTANCED)
+      gl_Position = uViewProjection*vInstanceModel*vec4(vPosition, 1.0);
+      vary_uv = vUV;
+#ifndef UNLIT
+	vary_normal = mat3(vInstanceModel) * vNormal; //Instances are uniformly scaled
+#endif
+#if !defined(UNLIT) || defined(WEIGHTED_BLENDED)
+	vary_world_position = vInstanceModel * vec4(vPosition, 1.0); //Lighting, or the weight of the order-independent transparency
+#endif
+#else
       //gl_Position = vec4(uScale*vPosition, 1.0); We need to put vPosition as a vec4. Because vPosition is a vec3, we need one more value (w) which is here 1.0. Hence x and y go from -w to w hence -1 to +1. Premultiply this variable if you want to transform the position.
       gl_Position = uMVP*vec4(vPosition, 1.0);
       //gl_Position = varyColor;
       //varyColor = (vec4(vColor, 1.0) + 1)/2;
       vary_uv= vUV; //permet UV et détails
+#ifndef UNLIT
 	vary_normal = transpose(uInvModel3x3) * vNormal;
+#endif
 
+#if !defined(UNLIT) || defined(WEIGHTED_BLENDED)
+	//Lighting, or the weight of the order-independent transparency
 	vary_world_position = uModel * vec4(vPosition, 1.0);
 	vary_world_position = vary_world_position / vary_world_position.w; //Normalization from w
-}
\ No newline at end of file
+#endif
+#endif
+
+#ifdef LOG_DEPTH
+      //Depth proportional to log2(1 + distance) : the same relative precision from the near planets to the far ones
+      vary_log_depth = 1.0 + gl_Position.w;
+      gl_Position.z = (log2(max(1e-6, vary_log_depth)) * uDepthParams.x - 1.0) * gl_Position.w;
+#endif
+}
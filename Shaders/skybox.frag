@@ -0,0 +1,12 @@
+#version 130
+precision mediump float;
+
+uniform samplerCube uSky;
+uniform vec3 uSkyColor; //The ambient color of the material of the sky and the color of the light
+
+varying vec3 vary_direction;
+
+void main()
+{
+	gl_FragColor = vec4(uSkyColor, 1.0) * textureCube(uSky, vary_direction);
+}
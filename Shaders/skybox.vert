@@ -0,0 +1,16 @@
+#version 130
+precision mediump float;
+
+uniform mat4  uClipToSky; //From clip space to a direction in the frame of the cube map (see Skybox::setView)
+uniform float uFarDepth;  //Normalized device depth where the depth buffer is cleared
+
+varying vec3 vary_direction;
+
+//Full screen triangle, without any vertex buffer : (-1,-1) (3,-1) (-1,3), on the far plane
+void main()
+{
+	vec2 corner = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2) * 2.0 - 1.0;
+	//Linear on the screen : w is the same for every point of the far plane, the direction needs no division
+	vary_direction = (uClipToSky * vec4(corner, 1.0, 1.0)).xyz;
+	gl_Position = vec4(corner, uFarDepth, 1.0);
+}
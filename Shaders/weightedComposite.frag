@@ -0,0 +1,18 @@
+#version 130
+precision mediump float;
+
+//Resolve of the weighted blended order-independent transparency (see WeightedBlending)
+uniform sampler2D uAccumulation; //rgb : sum of the weighted premultiplied colors, a : product of the transparencies (revealage)
+uniform sampler2D uWeights;      //r : sum of the weighted alphas
+
+void main()
+{
+	ivec2 texel = ivec2(gl_FragCoord.xy);
+	vec4 accumulation = texelFetch(uAccumulation, texel, 0);
+	if(accumulation.a >= 1.0)
+		discard; //Nothing translucent in this pixel
+
+	//The weighted average color, blended over the opaque image with the coverage of all the translucent layers
+	float weights = texelFetch(uWeights, texel, 0).r;
+	gl_FragColor = vec4(accumulation.rgb / max(weights, 1e-5), 1.0 - accumulation.a);
+}
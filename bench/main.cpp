@@ -0,0 +1,703 @@
+/*
+* Benchmarks of the simulation : tessellation of the primitives, copies of geometries, world transforms and culling
+* of large scene graphs, keyframe timelines, sorting and submission of the draws in an offscreen context.
+*
+* Every benchmark is run in samples of enough iterations to last BENCH_MIN_SAMPLE_NS. The times per iteration are written
+* in JSON (--output) and the fastest sample is compared to a previous run (--baseline) : the program fails if a benchmark
+* got slower than the threshold. The fastest sample is the least disturbed by the rest of the system. The baseline is only meaningful on the machine and with the build type it was recorded with.
+*
+* Run from the directory containing Shaders/ (the build copies it next to the executable).
+*/
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Annulus.h"
+#include "Circle.h"
+#include "Cone.h"
+#include "Cube.h"
+#include "Cylinder.h"
+#include "Eclipses.h"
+#include "Framebuffer.h"
+#include "GameObject.h"
+#include "HeadlessContext.h"
+#include "RayTracer.h"
+#include "RenderQueue.h"
+#include "SceneCuller.h"
+#include "ShaderLibrary.h"
+#include "Sphere.h"
+#include "Scene.h"
+#include "StaticGeometry.h"
+#include "Timeline.h"
+#include "UniformBuffers.h"
+#include "WorldTransforms.h"
+#include "logger.h"
+
+#define BENCH_FORMAT_VERSION 1
+#define BENCH_MIN_SAMPLE_NS  50000000ull /*!< 50 ms : the iterations of a sample are increased until it lasts this long*/
+#define BENCH_CHILDREN       8           /*!< Children per node of the synthetic scene graphs*/
+#define BENCH_TIMELINE_KEYS  64          /*!< Keys per track of the synthetic timelines*/
+
+#ifdef NDEBUG
+#define BENCH_BUILD "release"
+#else
+#define BENCH_BUILD "debug"
+#endif
+
+/* \brief The measures of one benchmark */
+struct BenchResult
+{
+    std::string name;
+    uint64_t    iterations = 0; /*!< Per sample*/
+    uint32_t    samples    = 0;
+    uint64_t    items      = 0; /*!< Work done by one iteration (vertices, nodes, draws), to report a throughput*/
+    double      minNs      = 0.0;
+    double      medianNs   = 0.0;
+    double      meanNs     = 0.0;
+};
+
+/* \brief A benchmark : run performs one iteration. Its setup is done before, out of the measures */
+struct Benchmark
+{
+    std::string           name;
+    uint64_t              items;
+    std::function<void()> run;
+};
+
+static uint64_t clockNs()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/* \brief Keep the optimizer from removing a computation whose result is unused */
+static volatile uint64_t g_sink = 0;
+
+static BenchResult measure(const Benchmark& bench, uint32_t nbSamples)
+{
+    BenchResult result;
+    result.name    = bench.name;
+    result.items   = bench.items;
+    result.samples = nbSamples;
+
+    /* Warm up (caches, lazy allocations, shader compilation), then double the iterations until a sample is long enough */
+    bench.run();
+    uint64_t iterations = 1;
+    while(true)
+    {
+        uint64_t begin = clockNs();
+        for(uint64_t i = 0; i < iterations; i++)
+            bench.run();
+        uint64_t elapsed = clockNs() - begin;
+        if(elapsed >= BENCH_MIN_SAMPLE_NS || iterations >= (1ull << 30))
+            break;
+        iterations = elapsed > 0 ? std::max(iterations * 2, (uint64_t)(iterations * 1.2 * BENCH_MIN_SAMPLE_NS / elapsed)) : iterations * 2;
+    }
+    result.iterations = iterations;
+
+    std::vector<double> times(nbSamples);
+    for(uint32_t s = 0; s < nbSamples; s++)
+    {
+        uint64_t begin = clockNs();
+        for(uint64_t i = 0; i < iterations; i++)
+            bench.run();
+        times[s] = (clockNs() - begin) / (double)iterations;
+    }
+
+    std::sort(times.begin(), times.end());
+    result.minNs    = times[0];
+    result.medianNs = nbSamples % 2 ? times[nbSamples / 2] : 0.5 * (times[nbSamples / 2 - 1] + times[nbSamples / 2]);
+    for(uint32_t s = 0; s < nbSamples; s++)
+        result.meanNs += times[s] / nbSamples;
+    return result;
+}
+
+/* \brief Write the results, one benchmark per line so that readBaseline does not need a full JSON parser */
+static bool writeResults(const char* path, const std::vector<BenchResult>& results, const char* renderer)
+{
+    FILE* file = fopen(path, "w");
+    if(!file)
+    {
+        ERROR("Could not write the results %s\n", path);
+        return false;
+    }
+
+    fprintf(file, "{\"version\":%d,\"build\":\"%s\",\"threads\":%u,\"renderer\":\"%s\",\"results\":[\n",
+            BENCH_FORMAT_VERSION, BENCH_BUILD, std::thread::hardware_concurrency(), renderer);
+    for(size_t i = 0; i < results.size(); i++)
+    {
+        const BenchResult& r = results[i];
+        fprintf(file, "{\"name\":\"%s\",\"iterations\":%llu,\"samples\":%u,\"items\":%llu,\"min_ns\":%.1f,\"median_ns\":%.1f,\"mean_ns\":%.1f}%s\n",
+                r.name.c_str(), (unsigned long long)r.iterations, r.samples, (unsigned long long)r.items,
+                r.minNs, r.medianNs, r.meanNs, i + 1 < results.size() ? "," : "");
+    }
+    fprintf(file, "]}\n");
+
+    bool written = !ferror(file);
+    fclose(file);
+    return written;
+}
+
+/* \brief Read the name and the fastest sample of every result of a file written by writeResults */
+static bool readBaseline(const char* path, std::vector<BenchResult>& baseline, std::string& build)
+{
+    FILE* file = fopen(path, "r");
+    if(!file)
+    {
+        ERROR("Could not open the baseline %s\n", path);
+        return false;
+    }
+
+    char line[1024];
+    while(fgets(line, sizeof(line), file))
+    {
+        const char* buildField = strstr(line, "\"build\":\"");
+        if(buildField)
+        {
+            char value[32] = {0};
+            if(sscanf(buildField, "\"build\":\"%31[^\"]", value) == 1)
+                build = value;
+        }
+
+        const char* nameField = strstr(line, "\"name\":\"");
+        const char* minField  = strstr(line, "\"min_ns\":");
+        if(!nameField || !minField)
+            continue;
+        char name[256] = {0};
+        BenchResult result;
+        if(sscanf(nameField, "\"name\":\"%255[^\"]", name) != 1 || sscanf(minField, "\"min_ns\":%lf", &result.minNs) != 1)
+            continue;
+        result.name = name;
+        baseline.push_back(result);
+    }
+    fclose(file);
+    return true;
+}
+
+/* \brief A complete tree of GameObjects, BENCH_CHILDREN children per node, with bounding spheres and spins */
+struct SyntheticScene
+{
+    std::vector<GameObject>  objects;
+    std::vector<GameObject*> roots;
+};
+
+static void buildScene(SyntheticScene& scene, uint32_t nbNodes, Geometry* geometry)
+{
+    scene.objects.resize(nbNodes);
+    for(uint32_t i = 0; i < nbNodes; i++)
+    {
+        GameObject& go = scene.objects[i];
+        go.geometry    = geometry;
+        go.occluder    = i % 64 == 1;
+        /* Each level is smaller and closer to its parent, like the moons of a planet */
+        float angle = i * 2.39996f;
+        go.position = glm::dvec3(cos(angle), 0.1 * sin(3.0 * angle), sin(angle)) * (i == 0 ? 0.0 : 4.0);
+        go.propagatedMatrix = glm::scale(glm::rotate(glm::mat4(1.0f), angle, glm::vec3(0.0f, 1.0f, 0.0f)), glm::vec3(0.3f));
+        go.localMatrix      = glm::scale(glm::mat4(1.0f), glm::vec3(0.5f));
+        if(i > 0)
+            scene.objects[(i - 1) / BENCH_CHILDREN].children.push_back(&go);
+    }
+    scene.roots.assign(1, &scene.objects[0]);
+}
+
+static void addGeometryBenchmarks(std::vector<Benchmark>& benchmarks)
+{
+    /* The items are the vertices generated */
+    static const uint32_t resolutions[] = {8, 32, 128, 512};
+    for(uint32_t r : resolutions)
+    {
+        benchmarks.push_back({"geometry/sphere/" + std::to_string(r), Sphere(r, r).getNbVertices(), [r]()
+        {
+            Sphere sphere(r, r);
+            g_sink += sphere.getNbVertices();
+        }});
+        benchmarks.push_back({"geometry/cylinder/" + std::to_string(r), Cylinder(r).getNbVertices(), [r]()
+        {
+            Cylinder cylinder(r);
+            g_sink += cylinder.getNbVertices();
+        }});
+        benchmarks.push_back({"geometry/cone/" + std::to_string(r), Cone(r, 0.5f).getNbVertices(), [r]()
+        {
+            Cone cone(r, 0.5f);
+            g_sink += cone.getNbVertices();
+        }});
+        benchmarks.push_back({"geometry/circle/" + std::to_string(r), Circle(r).getNbVertices(), [r]()
+        {
+            Circle circle(r);
+            g_sink += circle.getNbVertices();
+        }});
+        benchmarks.push_back({"geometry/annulus/" + std::to_string(r), Annulus(r, 0.25f).getNbVertices(), [r]()
+        {
+            Annulus annulus(r, 0.25f);
+            g_sink += annulus.getNbVertices();
+        }});
+    }
+    benchmarks.push_back({"geometry/cube", Cube().getNbVertices(), []()
+    {
+        Cube cube;
+        g_sink += cube.getNbVertices();
+    }});
+
+    /* The tessellations of main, generated at compile time : nothing left to do at runtime */
+    benchmarks.push_back({"geometry/static_sphere/6", StaticSphere<6, 6>::NB_VERTICES, []()
+    {
+        StaticSphere<6, 6> sphere;
+        g_sink += sphere.getNbVertices();
+    }});
+    benchmarks.push_back({"geometry/static_sphere/32", StaticSphere<32, 32>::NB_VERTICES, []()
+    {
+        StaticSphere<32, 32> sphere;
+        g_sink += sphere.getNbVertices();
+    }});
+
+    /* Copies of a geometry the size of the one of the planets, and of a detailed one */
+    static const uint32_t copied[] = {32, 256};
+    for(uint32_t r : copied)
+    {
+        std::shared_ptr<Sphere> sphere = std::make_shared<Sphere>(r, r);
+        benchmarks.push_back({"geometry/copy/sphere" + std::to_string(r), sphere->getNbVertices(), [sphere]()
+        {
+            Geometry copy(*sphere);
+            g_sink += copy.getNbVertices();
+        }});
+    }
+}
+
+static void addSceneBenchmarks(std::vector<Benchmark>& benchmarks, std::vector<std::shared_ptr<SyntheticScene>>& scenes, Geometry* geometry)
+{
+    static const uint32_t sizes[] = {1000, 100000, 1000000};
+    glm::dvec3 cameraPosition(0.0, 20.0, 40.0);
+    glm::mat4  view       = glm::lookAt(glm::vec3(0.0f), glm::vec3(-cameraPosition), glm::vec3(0.0f, 1.0f, 0.0f));
+    glm::mat4  projection = glm::perspective(45.0f, 1.0f, 0.1f, 1000.0f);
+
+    for(uint32_t n : sizes)
+    {
+        std::shared_ptr<SyntheticScene> scene = std::make_shared<SyntheticScene>();
+        buildScene(*scene, n, geometry);
+        scenes.push_back(scene);
+
+        /* The work done by WorldTransforms each frame : compose the hierarchy in double, then rebase on the camera */
+        std::shared_ptr<WorldTransforms> transforms = std::make_shared<WorldTransforms>();
+        benchmarks.push_back({"scene/transforms/" + std::to_string(n), n, [scene, transforms, cameraPosition]()
+        {
+            transforms->update(scene->roots);
+            transforms->rebase(cameraPosition);
+            g_sink += transforms->getNbObjects();
+        }});
+
+        /* Culling of the transformed scene, with and without the occlusion pass */
+        for(int occlusion = 0; occlusion < 2; occlusion++)
+        {
+            std::shared_ptr<SceneCuller> culler = std::make_shared<SceneCuller>(800);
+            culler->setOcclusionEnabled(occlusion);
+            benchmarks.push_back({std::string(occlusion ? "scene/cull_occlusion/" : "scene/cull/") + std::to_string(n), n,
+                                  [scene, transforms, culler, view, projection, cameraPosition]()
+            {
+                if(transforms->getNbObjects() == 0)
+                {
+                    transforms->update(scene->roots);
+                    transforms->rebase(cameraPosition);
+                }
+                culler->cull(scene->roots, view, projection, cameraPosition);
+                g_sink += culler->getStats().getNbVisible();
+            }});
+        }
+
+        /* The occluders of every body for the analytic shadows, lit from the root. Quadratic : one occluder every 64 nodes */
+        if(n > 100000)
+            continue;
+        std::shared_ptr<std::vector<GameObject*>> occluders = std::make_shared<std::vector<GameObject*>>();
+        for(uint32_t i = 0; i < n; i++)
+            if(scene->objects[i].occluder)
+                occluders->push_back(&scene->objects[i]);
+        std::shared_ptr<Eclipses> eclipses = std::make_shared<Eclipses>();
+        benchmarks.push_back({"scene/eclipses/" + std::to_string(n), n, [scene, transforms, occluders, eclipses, view, projection, cameraPosition]()
+        {
+            /* The world spheres come from the culling */
+            if(transforms->getNbObjects() == 0)
+            {
+                transforms->update(scene->roots);
+                transforms->rebase(cameraPosition);
+                SceneCuller(800).cull(scene->roots, view, projection, cameraPosition);
+            }
+            eclipses->update(glm::vec3(0.0f), *occluders, cameraPosition);
+            glm::vec4 spheres[SHADER_MAX_OCCLUDERS];
+            for(size_t i = 0; i < scene->objects.size(); i++)
+                g_sink += eclipses->findOccluders(scene->objects[i], spheres);
+        }});
+    }
+}
+
+/* \brief A flat scene of animated nodes and its timeline : a position spline, a rotation and a scale per node */
+struct SyntheticTimeline
+{
+    Scene*                  scene    = NULL;
+    Timeline*               timeline = NULL;
+    std::vector<GameObject> objects;
+    double                  time     = 0.0;
+
+    ~SyntheticTimeline() {delete timeline; delete scene;}
+};
+
+static bool buildTimeline(SyntheticTimeline& synthetic, uint32_t nbNodes)
+{
+    /* Both are loaded from files like the ones of the application */
+    std::string base       = (std::filesystem::temp_directory_path() / ("bench_timeline_" + std::to_string(nbNodes))).string();
+    std::string scenePath  = base + ".scene";
+    std::string scriptPath = base + ".timeline";
+
+    FILE* file = fopen(scenePath.c_str(), "w");
+    if(!file)
+        return false;
+    for(uint32_t i = 0; i < nbNodes; i++)
+        fprintf(file, "node n%u -\n", i);
+    fclose(file);
+
+    file = fopen(scriptPath.c_str(), "w");
+    if(!file)
+        return false;
+    for(uint32_t i = 0; i < nbNodes; i++)
+    {
+        fprintf(file, "track n%u position spline\n", i);
+        for(uint32_t k = 0; k < BENCH_TIMELINE_KEYS; k++)
+            fprintf(file, "key %u %g,%g,%g\n", 16*k + i%16, cos(0.1*(i+k)), sin(0.3*k), 0.01*i);
+        fprintf(file, "track n%u rotation linear\n", i);
+        for(uint32_t k = 0; k < BENCH_TIMELINE_KEYS; k++)
+            fprintf(file, "key %u 0,1,0 %g\n", 16*k, 0.05*k*(1 + i%3));
+        fprintf(file, "track n%u scale step\n", i);
+        for(uint32_t k = 0; k < BENCH_TIMELINE_KEYS; k++)
+            fprintf(file, "key %u %g\n", 16*k + 8, 0.5 + 0.01*k);
+    }
+    fclose(file);
+
+    synthetic.scene = Scene::load(scenePath);
+    if(synthetic.scene)
+        synthetic.timeline = Timeline::load(scriptPath, *synthetic.scene);
+    remove(scenePath.c_str());
+    remove(scriptPath.c_str());
+    if(!synthetic.timeline)
+        return false;
+    synthetic.objects.resize(nbNodes);
+    return true;
+}
+
+static void addTimelineBenchmarks(std::vector<Benchmark>& benchmarks)
+{
+    static const uint32_t sizes[] = {1000, 10000};
+    for(uint32_t n : sizes)
+    {
+        std::shared_ptr<SyntheticTimeline> synthetic = std::make_shared<SyntheticTimeline>();
+        if(!buildTimeline(*synthetic, n))
+        {
+            WARNING("Could not build the timeline of %u nodes : its benchmarks are skipped\n", n);
+            continue;
+        }
+        uint64_t nbTracks = synthetic->timeline->getNbTracks();
+
+        /* Played step by step like the application, looping : the items are the tracks evaluated */
+        benchmarks.push_back({"timeline/evaluate/" + std::to_string(n), nbTracks, [synthetic]()
+        {
+            synthetic->timeline->evaluate(synthetic->time, synthetic->objects);
+            synthetic->time += 1.0;
+            if(synthetic->time > synthetic->timeline->getDuration())
+                synthetic->time = 0.0;
+            g_sink += (uint64_t)synthetic->objects[0].position.x;
+        }});
+
+        /* Random access : a binary search per track */
+        benchmarks.push_back({"timeline/seek/" + std::to_string(n), nbTracks, [synthetic]()
+        {
+            synthetic->time = fmod(synthetic->time + 377.0, synthetic->timeline->getDuration());
+            synthetic->timeline->seek(synthetic->time);
+            synthetic->timeline->evaluate(synthetic->time, synthetic->objects);
+            g_sink += (uint64_t)synthetic->objects[0].position.x;
+        }});
+    }
+}
+
+/* \brief A field of spheres in front of the camera, each one an occluder, lit by a disc light behind the camera.
+ * The items are the rays of a frame : the benchmarks report rays per second */
+static void addRayTraceBenchmarks(std::vector<Benchmark>& benchmarks)
+{
+    static const uint32_t sizes[]  = {100, 10000};
+    const uint32_t        width    = 128, height = 128;
+    glm::mat4             view       = glm::mat4(1.0f);
+    glm::mat4             projection = glm::perspective(45.0f, 1.0f, 0.1f, 1000.0f);
+    uint32_t              nbCores    = std::max(1u, std::thread::hardware_concurrency());
+
+    for(uint32_t n : sizes)
+    {
+        /* 1 thread, then one per core but at least 4 : the tiles are stolen even on a single core */
+        for(uint32_t nbThreads : {1u, std::max(4u, nbCores)})
+        {
+            std::shared_ptr<RayTracer> tracer = std::make_shared<RayTracer>(1, nbThreads);
+            uint32_t side = (uint32_t)ceil(sqrt((double)n));
+            for(uint32_t i = 0; i < n; i++)
+            {
+                float     scale = 20.0f / side;
+                glm::vec3 center((i % side + 0.5f) * scale - 10.0f, (i / side + 0.5f) * scale - 10.0f, -20.0f - 2.0f * (i % 7));
+                RayPrimitive primitive = {RAY_SPHERE, glm::scale(glm::translate(glm::mat4(1.0f), center), glm::vec3(0.8f * scale)),
+                                          Material{{1.0f, 1.0f, 1.0f}, 0.1f, 0.9f, 0.5f, 20, 0}, 0, false, 0.0f, glm::vec2(1.0f)};
+                tracer->addPrimitive(primitive);
+                tracer->addOccluder(glm::vec4(center, 0.4f * scale));
+            }
+            tracer->setLight(glm::vec3(5.0f, 5.0f, 10.0f), 1.0f, glm::vec3(1.0f));
+            std::shared_ptr<std::vector<uint8_t>> pixels = std::make_shared<std::vector<uint8_t>>(width * height * 4);
+            tracer->render(view, projection, width, height, pixels->data());
+
+            benchmarks.push_back({"raytrace/" + std::to_string(n) + "/threads_" + std::to_string(nbThreads), tracer->getStats().nbRays,
+                                  [tracer, pixels, view, projection, width, height]()
+            {
+                tracer->render(view, projection, width, height, pixels->data());
+                g_sink += (*pixels)[(width * height / 2) * 4];
+            }});
+        }
+    }
+}
+
+/* \brief The GL objects of the submission benchmarks. Destroyed with the context */
+struct SubmitResources
+{
+    Framebuffer*    framebuffer    = NULL;
+    ShaderLibrary*  shaders        = NULL;
+    UniformBuffers* uniformBuffers = NULL;
+    RenderQueue     queue;
+    std::vector<DrawPacket> packets; /*!< The draws of a frame, pushed again each iteration*/
+    GLuint vbo = 0;
+    GLuint vao = 0;
+};
+
+static bool addSubmitBenchmarks(std::vector<Benchmark>& benchmarks, std::shared_ptr<SubmitResources>& res, Geometry& sphere, uint32_t width, uint32_t height)
+{
+    static const uint32_t sizes[] = {10, 100, 1000};
+    res = std::make_shared<SubmitResources>();
+
+    res->framebuffer = new Framebuffer(width, height);
+    if(!res->framebuffer->isComplete())
+        return false;
+    res->framebuffer->bind();
+    glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+    glEnable(GL_DEPTH_TEST);
+
+    res->shaders = ShaderLibrary::loadFromPaths("Shaders/colorTexture.vert", "Shaders/colorTexture.frag");
+    if(!res->shaders)
+        return false;
+    if(UniformBuffers::isSupported())
+        res->uniformBuffers = new UniformBuffers(sizes[2]);
+    uint32_t baseFeatures = res->uniformBuffers ? SHADER_UNIFORM_BUFFERS : 0;
+    if(!res->shaders->get(baseFeatures))
+        return false;
+
+    /* The layout of main : positions, normals then UVs */
+    uint32_t nbVertices = sphere.getNbVertices();
+    glGenBuffers(1, &res->vbo);
+    glBindBuffer(GL_ARRAY_BUFFER, res->vbo);
+    glBufferData(GL_ARRAY_BUFFER, nbVertices * (3 + 3 + 2) * sizeof(float), nullptr, GL_STATIC_DRAW);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, nbVertices * 3 * sizeof(float), sphere.getVertices());
+    glBufferSubData(GL_ARRAY_BUFFER, nbVertices * 3 * sizeof(float), nbVertices * 3 * sizeof(float), sphere.getNormals());
+    glBufferSubData(GL_ARRAY_BUFFER, nbVertices * 6 * sizeof(float), nbVertices * 2 * sizeof(float), sphere.getUVs());
+    glGenVertexArrays(1, &res->vao);
+    glBindVertexArray(res->vao);
+    glVertexAttribPointer(ATTRIB_POSITION, 3, GL_FLOAT, GL_FALSE, 0, 0);
+    glEnableVertexAttribArray(ATTRIB_POSITION);
+    glVertexAttribPointer(ATTRIB_NORMAL, 3, GL_FLOAT, GL_FALSE, 0, (void*)(nbVertices * 3 * sizeof(float)));
+    glEnableVertexAttribArray(ATTRIB_NORMAL);
+    glVertexAttribPointer(ATTRIB_UV, 2, GL_FLOAT, GL_FALSE, 0, (void*)(nbVertices * 6 * sizeof(float)));
+    glEnableVertexAttribArray(ATTRIB_UV);
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    FrameUniforms frame;
+    frame.view           = glm::lookAt(glm::vec3(0.0f), glm::vec3(0.0f, -0.4f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    frame.projection     = glm::perspective(45.0f, width / (float)height, 0.1f, 1000.0f);
+    frame.viewProjection = frame.projection * frame.view;
+    frame.cameraPosition = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+    frame.lightPosition  = glm::vec4(0.0f, 0.0f, -20.0f, 1.0f);
+    frame.lightColor     = glm::vec4(1.0f);
+    frame.depthParams    = glm::vec4(0.0f);
+
+    /* A grid of spheres in front of the camera, with the material and shader variety of the solar system */
+    const Material materials[] = {{{1.0f, 0.8f, 0.3f}, 1.0f, 0.0f, 0.0f, 1, 0},
+                                  {{0.3f, 0.5f, 1.0f}, 0.2f, 0.8f, 0.0f, 1, 0},
+                                  {{0.8f, 0.8f, 0.8f}, 0.3f, 0.9f, 0.8f, 100, 0},
+                                  {{0.6f, 0.3f, 0.2f}, 0.2f, 0.7f, 0.3f, 20, 0}};
+    const uint32_t features[] = {SHADER_UNLIT, SHADER_NO_SPECULAR, 0, 0};
+    for(uint32_t n : sizes)
+    {
+        std::shared_ptr<std::vector<DrawPacket>> packets = std::make_shared<std::vector<DrawPacket>>(n);
+        uint32_t side = (uint32_t)ceil(sqrt((double)n));
+        for(uint32_t i = 0; i < n; i++)
+        {
+            glm::vec3 center((i % side + 0.5f) / side * 2.0f - 1.0f, (i / side + 0.5f) / side * 2.0f - 1.0f, 0.0f);
+            center = center * 20.0f + glm::vec3(0.0f, -8.0f, -30.0f);
+            glm::mat4 model = glm::scale(glm::translate(glm::mat4(1.0f), center), glm::vec3(10.0f / side));
+
+            DrawPacket& packet = (*packets)[i];
+            packet.shader     = res->shaders->get(features[i % 4] | baseFeatures);
+            packet.vao        = res->vao;
+            packet.texture    = 0;
+            packet.first      = 0;
+            packet.nbVertices = nbVertices;
+            packet.material   = materials[i % 4];
+            packet.object.mvp   = frame.viewProjection * model;
+            packet.object.model = model;
+            glm::mat3 invModel3x3 = glm::inverse(glm::mat3(model));
+            for(int c = 0; c < 3; c++)
+                packet.object.invModel3x3[c] = glm::vec4(invModel3x3[c], 0.0f);
+            packet.object.material[0] = packet.object.material[1] = packet.object.material[2] = packet.object.material[3] = 0;
+            packet.key = RenderQueue::makeKey(LAYER_OPAQUE, packet.shader ? packet.shader->getProgramID() : 0, 0, res->vao, glm::length(center) / 1000.0f);
+            if(!packet.shader)
+                return false;
+        }
+
+        /* What main does each frame after the culling : queue, sort, submit. glFinish waits for the rasterization (llvmpipe) */
+        SubmitResources* r = res.get();
+        benchmarks.push_back({"submit/spheres/" + std::to_string(n), n, [r, packets, frame]()
+        {
+            glClear(GL_DEPTH_BUFFER_BIT | GL_COLOR_BUFFER_BIT);
+            r->queue.clear();
+            for(size_t i = 0; i < packets->size(); i++)
+                r->queue.push((*packets)[i]);
+            r->queue.sort();
+            r->queue.submit(r->uniformBuffers, frame);
+            glFinish();
+            g_sink += r->queue.getStats().nbDraws;
+        }});
+    }
+    return true;
+}
+
+static void destroySubmitResources(SubmitResources& res)
+{
+    glDeleteVertexArrays(1, &res.vao);
+    glDeleteBuffers(1, &res.vbo);
+    delete res.uniformBuffers;
+    delete res.shaders;
+    delete res.framebuffer;
+}
+
+int main(int argc, char* argv[])
+{
+    const char* outputPath   = NULL;  //Write the results in JSON
+    const char* baselinePath = NULL;  //Compare to a previous output
+    const char* filter       = NULL;  //Only the benchmarks whose name contains this string
+    double   threshold = 0.10;        //Relative slowdown of the fastest sample reported as a regression
+    uint32_t nbSamples = 5;
+    uint32_t width = 256, height = 256; //Small : the rasterization on llvmpipe would hide the cost of the submission
+    bool     gpu = true;              //The submission benchmarks need an EGL context
+    for(int i = 1; i < argc; i++)
+    {
+        if(strcmp(argv[i], "--output") == 0 && i + 1 < argc)
+            outputPath = argv[++i];
+        else if(strcmp(argv[i], "--baseline") == 0 && i + 1 < argc)
+            baselinePath = argv[++i];
+        else if(strcmp(argv[i], "--filter") == 0 && i + 1 < argc)
+            filter = argv[++i];
+        else if(strcmp(argv[i], "--threshold") == 0 && i + 1 < argc)
+            threshold = atof(argv[++i]);
+        else if(strcmp(argv[i], "--samples") == 0 && i + 1 < argc)
+            nbSamples = std::max(1, atoi(argv[++i]));
+        else if(strcmp(argv[i], "--width") == 0 && i + 1 < argc)
+            width = std::max(1, atoi(argv[++i]));
+        else if(strcmp(argv[i], "--height") == 0 && i + 1 < argc)
+            height = std::max(1, atoi(argv[++i]));
+        else if(strcmp(argv[i], "--no-gpu") == 0)
+            gpu = false;
+        else
+            WARNING("Unknown option %s\n", argv[i]);
+    }
+
+    std::vector<Benchmark> benchmarks;
+    addGeometryBenchmarks(benchmarks);
+
+    Sphere sphere(32, 32);
+    std::vector<std::shared_ptr<SyntheticScene>> scenes;
+    addSceneBenchmarks(benchmarks, scenes, &sphere);
+    addTimelineBenchmarks(benchmarks);
+    addRayTraceBenchmarks(benchmarks);
+
+    HeadlessContext* context = NULL;
+    std::shared_ptr<SubmitResources> submitResources;
+    std::string renderer = "none";
+    if(gpu)
+    {
+        context = HeadlessContext::create(3, 0);
+        if(context)
+        {
+            glewExperimental = GL_TRUE;
+            glewContextInit();
+            renderer = (const char*)glGetString(GL_RENDERER);
+            if(!addSubmitBenchmarks(benchmarks, submitResources, sphere, width, height))
+            {
+                ERROR("Could not set up the submission benchmarks (run from the directory containing Shaders/)\n");
+                return EXIT_FAILURE;
+            }
+        }
+        else
+            WARNING("No OpenGL context : the submission benchmarks are skipped\n");
+    }
+
+    std::vector<BenchResult> results;
+    for(size_t i = 0; i < benchmarks.size(); i++)
+    {
+        if(filter && benchmarks[i].name.find(filter) == std::string::npos)
+            continue;
+        results.push_back(measure(benchmarks[i], nbSamples));
+        const BenchResult& r = results.back();
+        printf("%-32s %14.1f ns  (min %14.1f, %10.4g items/s)\n", r.name.c_str(), r.medianNs, r.minNs, r.items / r.medianNs * 1e9);
+        fflush(stdout);
+    }
+
+    if(submitResources)
+        destroySubmitResources(*submitResources);
+    delete context;
+
+    if(outputPath && !writeResults(outputPath, results, renderer.c_str()))
+        return EXIT_FAILURE;
+
+    /* The fastest samples against the baseline : the benchmarks missing from one side are ignored */
+    bool regression = false;
+    if(baselinePath)
+    {
+        std::vector<BenchResult> baseline;
+        std::string baselineBuild;
+        if(!readBaseline(baselinePath, baseline, baselineBuild))
+            return EXIT_FAILURE;
+        if(baselineBuild != BENCH_BUILD)
+            WARNING("The baseline %s was recorded with a %s build, this one is %s\n", baselinePath, baselineBuild.c_str(), BENCH_BUILD);
+
+        uint32_t nbCompared = 0;
+        for(size_t i = 0; i < results.size(); i++)
+        {
+            for(size_t j = 0; j < baseline.size(); j++)
+            {
+                if(baseline[j].name != results[i].name || baseline[j].minNs <= 0.0)
+                    continue;
+                double ratio = results[i].minNs / baseline[j].minNs;
+                nbCompared++;
+                if(ratio > 1.0 + threshold)
+                {
+                    regression = true;
+                    printf(RED "REGRESSION" RESET " %-32s %+.1f%%\n", results[i].name.c_str(), (ratio - 1.0) * 100.0);
+                }
+                else if(ratio < 1.0 - threshold)
+                    printf(GRN "IMPROVED  " RESET " %-32s %+.1f%%\n", results[i].name.c_str(), (ratio - 1.0) * 100.0);
+                break;
+            }
+        }
+        printf("%u benchmarks compared to %s (threshold %.0f%%) : %s\n", nbCompared, baselinePath, threshold * 100.0, regression ? "regression" : "ok");
+    }
+
+    return regression ? EXIT_FAILURE : EXIT_SUCCESS;
+}
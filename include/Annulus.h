@@ -0,0 +1,18 @@
+#ifndef  ANNULUS_INC
+#define  ANNULUS_INC
+
+#include "Geometry.h"
+#include <cmath>
+
+/* \brief Represents a flat ring (the rings of a planet) in the plane y = 0, facing +y, between an inner radius and the outer radius 0.5.
+ * The UVs are radial : v goes from 0 on the inner edge to 1 on the outer one and u around the ring, for the ring textures whose rows are the radii */
+class Annulus : public Geometry
+{
+    public:
+        /* \brief Create an annulus
+         * \param nbEdges the number of edges of each of the two circles. Minimum : 3
+         * \param innerRadius the radius of the hole, between 0 and 0.5 */
+        Annulus(uint32_t nbEdges, float innerRadius);
+};
+
+#endif
@@ -0,0 +1,107 @@
+#ifndef  COLLISIONWORLD_INC
+#define  COLLISIONWORLD_INC
+
+#include <glm/glm.hpp>
+#include <stdint.h>
+#include <vector>
+
+class WorkerPool;
+
+#define COLLISION_CELL_FACTOR 2.0f /*!< Cell size of the grid, in average swept diameters*/
+#define COLLISION_MAX_CELLS   8    /*!< Bodies whose swept box covers more cells are tested against every body instead*/
+#define COLLISION_ALL         0xFFFFFFFF
+
+/* \brief Two bodies which touched during the last step */
+struct CollisionEvent
+{
+    uint32_t  a;     /*!< Index of the first body (the smallest)*/
+    uint32_t  b;     /*!< Index of the second body*/
+    float     time;  /*!< When they touched, in [0, 1] from the start to the end of the step. 0 if they already overlapped*/
+    glm::vec3 point; /*!< Contact point at that time*/
+};
+
+/* \brief Counters of the last step */
+struct CollisionStats
+{
+    uint32_t nbBodies      = 0;
+    uint32_t nbLargeBodies = 0; /*!< Bodies too big for the grid*/
+    uint32_t nbCells       = 0; /*!< Grid entries (a body is in every cell its swept box overlaps)*/
+    uint64_t nbCandidates  = 0; /*!< Pairs whose swept boxes overlap : given to the narrow phase*/
+    uint32_t nbEvents      = 0;
+};
+
+/** \brief Continuous collision detection between moving spheres.
+ * Each step, every body sweeps from its previous to its current position.
+ * The broad phase hashes the swept boxes in a uniform grid (counting sort by cell, so linear in the number of bodies)
+ * and the pairs sharing a cell are tested in parallel. The narrow phase solves the time of impact of the two spheres.
+ * The events are queued by time, to be polled like the SDL events.*/
+class CollisionWorld
+{
+    public:
+        /** \brief Constructor
+         * \param workers the threads of the passes over the bodies and of the pair tests */
+        CollisionWorld(WorkerPool& workers);
+
+        /** \brief set the number of bodies. The new bodies are empty spheres at the origin which collide with nothing
+         * \param nbBodies the number of bodies */
+        void resize(uint32_t nbBodies);
+
+        /** \brief set the motion of a body during the next step
+         * \param i the body
+         * \param from its center at the start of the step
+         * \param to its center at the end of the step
+         * \param radius its radius
+         * \param group the groups of the body (bits)
+         * \param mask the groups it collides with. Two bodies are tested if each one is in a group of the other's mask */
+        void setBody(uint32_t i, const glm::vec3& from, const glm::vec3& to, float radius, uint32_t group = 1, uint32_t mask = COLLISION_ALL)
+        {
+            m_x0[i] = from.x; m_y0[i] = from.y; m_z0[i] = from.z;
+            m_x1[i] = to.x;   m_y1[i] = to.y;   m_z1[i] = to.z;
+            m_radius[i] = radius;
+            m_group[i]  = group;
+            m_mask[i]   = mask;
+        }
+
+        /** \brief detect the collisions of the motions set, replacing the events not polled yet */
+        void step();
+
+        /** \brief get the next event, in time order
+         * \param event filled with the event
+         * \return false if there is no more event */
+        bool pollEvent(CollisionEvent& event);
+
+        uint32_t getNbBodies() const {return m_radius.size();}
+        const CollisionStats& getStats() const {return m_stats;}
+    private:
+        /* \brief Test the pairs of the grid entries [first, last[ (whole cells) */
+        void testCells(uint32_t first, uint32_t last, std::vector<CollisionEvent>& events, uint64_t& nbCandidates) const;
+
+        /* \brief Test a large body against every body */
+        void testLarge(uint32_t large, std::vector<CollisionEvent>& events, uint64_t& nbCandidates) const;
+
+        /* \brief Narrow phase : add an event if the two spheres touch during the step */
+        void testPair(uint32_t a, uint32_t b, std::vector<CollisionEvent>& events, uint64_t& nbCandidates) const;
+
+        /* \brief Cell coordinate of a position */
+        int32_t cell(float v) const;
+
+        WorkerPool& m_workers;
+
+        /* Bodies, structure of arrays */
+        std::vector<float>    m_x0, m_y0, m_z0, m_x1, m_y1, m_z1, m_radius;
+        std::vector<uint32_t> m_group, m_mask;
+
+        /* Grid of the last step : the entries sorted by hashed cell */
+        float                 m_cellSize = 1.0f;
+        uint32_t              m_hashMask = 0;
+        std::vector<uint32_t> m_cellCounts; /*!< Cells of each body's swept box, then the offsets of its entries*/
+        std::vector<uint32_t> m_entryKeys, m_entryBodies;
+        std::vector<uint32_t> m_sortedBodies, m_sortedKeys, m_bucketStarts;
+        std::vector<uint32_t> m_largeBodies;
+
+        std::vector<CollisionEvent> m_events;
+        size_t                      m_nextEvent = 0;
+        CollisionStats              m_stats;
+};
+
+#endif
@@ -1,12 +1,9 @@
 #ifndef  CUBE_INC
 #define  CUBE_INC
 
-#include "Geometry.h"
+#include "StaticGeometry.h"
 
-class Cube : public Geometry
-{
-    public:
-        Cube();
-};
+/* \brief The unit cube has a single tessellation : it is always generated at compile time */
+typedef StaticCube Cube;
 
 #endif
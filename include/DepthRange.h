@@ -0,0 +1,58 @@
+#ifndef  DEPTHRANGE_INC
+#define  DEPTHRANGE_INC
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+/** \brief How the depth of a fragment is computed and stored*/
+enum DepthMode
+{
+    DEPTH_STANDARD    = 0, /*!< The OpenGL default : [-1, 1] clip space, depth test LESS. Most of the precision is next to the near plane*/
+    DEPTH_REVERSED    = 1, /*!< [0, 1] clip space (GL_ARB_clip_control), 1 at the near plane and 0 at infinity, depth test GREATER.
+                                With a floating point depth buffer the precision is nearly constant relatively to the distance*/
+    DEPTH_LOGARITHMIC = 2  /*!< The depth is written by the shaders as log2(1 + distance) (SHADER_LOG_DEPTH). Works with any depth buffer*/
+};
+
+/** \brief The depth configuration of the frames : the projection matrix, the depth test and the clear value of a DepthMode.
+ * The culling keeps the standard projection, only the matrices given to the GPU change.*/
+class DepthRange
+{
+    public:
+        /** \brief Constructor
+         * \param mode the DepthMode. Must be supported (see getBestMode)
+         * \param zFar the farthest distance drawn by the logarithmic mode (the reversed mode has no far plane) */
+        DepthRange(DepthMode mode, float zFar);
+
+        /** \brief get the best mode supported by the current context
+         * \param floatDepthBuffer whether the target has a floating point depth buffer
+         * \return DEPTH_REVERSED with a float depth buffer and GL_ARB_clip_control, DEPTH_LOGARITHMIC otherwise */
+        static DepthMode getBestMode(bool floatDepthBuffer);
+
+        /** \brief tell whether a mode can be used with the current context
+         * \param mode the DepthMode
+         * \return true if supported */
+        static bool isSupported(DepthMode mode);
+
+        /** \brief set the clip space convention, the depth test and the depth clear value. Called once, the state is kept by the context */
+        void apply() const;
+
+        /** \brief get the projection to give to the GPU
+         * \param perspective the standard perspective projection (glm::perspective), used for the culling
+         * \return the projection of this mode : the reversed infinite projection for DEPTH_REVERSED, perspective otherwise */
+        glm::mat4 getProjection(const glm::mat4& perspective) const;
+
+        /** \brief get the parameters of the depth computed by the shaders (logarithmic depth, impostors), for the uDepthParams uniform
+         * \return x : 2 / log2(zFar + 1). y : 1 with the [0, 1] clip space of DEPTH_REVERSED, 0 with [-1, 1]. zw unused */
+        glm::vec4 getParams() const;
+
+        /** \brief get the normalized device depth of the farthest point, where the depth buffer is cleared
+         * \return 0 for DEPTH_REVERSED, 1 otherwise */
+        float getFarDepth() const {return m_mode == DEPTH_REVERSED ? 0.0f : 1.0f;}
+
+        DepthMode getMode() const {return m_mode;}
+    private:
+        DepthMode m_mode;
+        float     m_zFar;
+};
+
+#endif
@@ -0,0 +1,47 @@
+#ifndef  ECLIPSES_INC
+#define  ECLIPSES_INC
+
+#include <glm/glm.hpp>
+#include <stdint.h>
+#include <vector>
+#include "GameObject.h"
+#include "Shader.h"
+
+/** \brief Analytic shadows of spherical bodies, without any depth pass.
+ * For each lit body (the receiver), the CPU keeps the few occluders which may hide a part of the light from it : the ones
+ * intersecting the convex hull of the light sphere and of the receiver sphere, a truncated cone tested for 4 occluders at once with SSE.
+ * The fragment shader (SHADER_ECLIPSES) then computes, per fragment, the part of the light disc covered by the disc of each occluder :
+ * the penumbra and the umbra come from the angular overlap of the two spheres.*/
+class Eclipses
+{
+    public:
+        /** \brief set the light and the bodies which may cast shadows, for the current step.
+         * A body containing the light is its source : it casts no shadow and its radius becomes the one of the light
+         * \param light the position of the light
+         * \param occluders the bodies, with the worldCenter and worldRadius of the step
+         * \param origin the point the spheres are made relative to, in double before they become floats (the camera : they are ready for the shaders) */
+        void update(const glm::vec3& light, const std::vector<GameObject*>& occluders, const glm::dvec3& origin);
+
+        /** \brief find the occluders which may hide the light from a part of a receiver
+         * \param receiver the lit body, with the worldCenter and worldRadius of the step. It is never its own occluder
+         * \param spheres filled with the spheres (center relative to the origin, radius) of up to SHADER_MAX_OCCLUDERS occluders, the largest seen from the receiver first
+         * \return the number of spheres written */
+        uint32_t findOccluders(const GameObject& receiver, glm::vec4* spheres) const;
+
+        /** \brief get the radius of the light source
+         * \return the radius of the body containing the light, 0 for a point light */
+        float getLightRadius() const {return m_lightRadius;}
+    private:
+        glm::dvec3 m_origin      = glm::dvec3(0.0);
+        glm::vec3  m_light       = glm::vec3(0.0f); /*!< Relative to m_origin*/
+        float      m_lightRadius = 0.0f;
+
+        /* The occluders relative to m_origin as separate arrays, padded to a multiple of 4 with spheres at the light (never selected) */
+        std::vector<float> m_x;
+        std::vector<float> m_y;
+        std::vector<float> m_z;
+        std::vector<float> m_radius;
+        std::vector<const GameObject*> m_objects; /*!< NULL for the padding*/
+};
+
+#endif
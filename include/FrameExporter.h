@@ -0,0 +1,141 @@
+#ifndef  FRAMEEXPORTER_INC
+#define  FRAMEEXPORTER_INC
+
+#include <GL/glew.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <atomic>
+#include "Framebuffer.h"
+
+#define EXPORT_PBO_RING 3 /*!< Number of pixel pack buffers : a frame is mapped EXPORT_PBO_RING-1 frames after its glReadPixels*/
+
+/** \brief The output of a FrameExporter*/
+enum ExportFormat
+{
+    EXPORT_PNG,    /*!< One PNG file per frame, the path is a printf pattern (e.g. frames/frame_%05d.png)*/
+    EXPORT_Y4M,    /*!< Raw YUV 4:2:0 video in a YUV4MPEG2 stream*/
+    EXPORT_FFMPEG  /*!< Raw RGBA frames piped to the standard input of ffmpeg, which encodes the path (e.g. scene.mp4)*/
+};
+
+/** \brief Export the rendered frames without stalling the OpenGL thread.
+ * Each capture starts an asynchronous glReadPixels into a ring of pixel pack buffers.
+ * A buffer is only mapped a few frames later, once its fence is signaled, and its copy is encoded and written by worker threads.*/
+class FrameExporter
+{
+    public:
+        /** \brief create an exporter. Must be called with the OpenGL context current, unless readback is false
+         * \param format the output format
+         * \param path the output path (a printf pattern for EXPORT_PNG)
+         * \param width the width of the captured frames
+         * \param height the height of the captured frames
+         * \param framerate the framerate written in the video formats
+         * \param readback whether framebuffers are captured. false : only the frames rendered on the CPU, without any OpenGL context
+         * \return the FrameExporter created or NULL if error */
+        static FrameExporter* create(ExportFormat format, const std::string& path, uint32_t width, uint32_t height, uint32_t framerate, bool readback = true);
+
+        /** \brief guess the format from the extension of a path : .png, .y4m, anything else is given to ffmpeg
+         * \param path the output path
+         * \return the format */
+        static ExportFormat formatFromPath(const std::string& path);
+
+        /** \brief tell whether a path is a valid pattern for the PNG files : exactly one integer conversion (%d, %05u...), the other % written %%
+         * \param path the output path
+         * \return true if the frame number can be formatted in it */
+        static bool isFramePattern(const std::string& path);
+
+        /* \brief Destructor. Finish the export if needed */
+        ~FrameExporter();
+
+        /** \brief queue the readback of a frame. Never waits for the GPU unless the ring is full of unfinished frames
+         * \param framebuffer the framebuffer to read (its whole color attachment) */
+        void capture(const Framebuffer& framebuffer);
+
+        /** \brief queue a frame rendered on the CPU (RayTracer), after the readbacks in flight
+         * \param pixels width * height RGBA pixels, bottom-up like the readbacks. Copied */
+        void capture(const uint8_t* pixels);
+
+        /** \brief read back the frames in flight, wait for the workers and close the output. Reports the throughput */
+        void finish();
+
+        /** \brief get the number of frames written
+         * \return the number of frames */
+        uint32_t getNbFrames() const {return m_nbWritten;}
+    private:
+        /** \brief the constructor. Should never be called alone (use create)*/
+        FrameExporter(ExportFormat format, const std::string& path, uint32_t width, uint32_t height);
+
+        /** \brief map the oldest pixel pack buffer and hand its content to the workers
+         * \param slot the index of the buffer in the ring */
+        void retire(uint32_t slot);
+
+        /** \brief take a free copy buffer, waiting for a worker if every copy is still being encoded
+         * \return the buffer */
+        uint8_t* acquirePixels();
+
+        /** \brief hand a copy to the workers
+         * \param pixels the copy, from acquirePixels
+         * \param index the frame number */
+        void pushJob(uint8_t* pixels, uint32_t index);
+
+        /** \brief the worker threads loop : encode the queued frames until finish is called */
+        void workerLoop();
+
+        /** \brief encode and write one frame
+         * \param pixels the RGBA pixels, bottom-up as read by OpenGL
+         * \param index the frame number
+         * \param yuv scratch memory of the worker
+         * \return false on a write error */
+        bool encode(uint8_t* pixels, uint32_t index, std::vector<uint8_t>& yuv);
+
+        /** \brief write a buffer in the output stream, in the frame order
+         * \param index the frame number
+         * \param header written before the data, can be NULL
+         * \param data the data
+         * \param size the size of data in bytes
+         * \return false on a write error */
+        bool writeOrdered(uint32_t index, const char* header, const uint8_t* data, size_t size);
+
+        struct Job
+        {
+            uint8_t* pixels;
+            uint32_t index;
+        };
+
+        ExportFormat m_format;
+        std::string  m_path;
+        uint32_t     m_width;
+        uint32_t     m_height;
+        FILE*        m_output = NULL; /*!< The Y4M file or the ffmpeg pipe*/
+
+        GLuint   m_pbo[EXPORT_PBO_RING];
+        GLsync   m_fence[EXPORT_PBO_RING];
+        bool     m_pending[EXPORT_PBO_RING];
+        uint32_t m_index[EXPORT_PBO_RING];
+        uint32_t m_nbCaptured = 0;
+        uint32_t m_nbStalls   = 0; /*!< Times the GPU had not finished a readback when its buffer was needed*/
+        std::chrono::steady_clock::time_point m_timeStart; /*!< First capture*/
+        bool     m_finished   = false;
+
+        std::vector<std::thread> m_workers;
+        std::mutex               m_mutex;
+        std::condition_variable  m_jobCond;   /*!< A job was queued or the export is finishing*/
+        std::condition_variable  m_freeCond;  /*!< A pixel buffer was released*/
+        std::mutex               m_writeMutex; /*!< Held while writing in m_output, separate so that the GL thread never waits for the disk or the pipe*/
+        std::condition_variable  m_writeCond;  /*!< A frame was written in the ordered stream*/
+        std::deque<Job>          m_jobs;
+        std::vector<uint8_t*>    m_freePixels; /*!< Bounded pool of frame copies : the GL thread waits if the workers fall behind*/
+        std::vector<uint8_t*>    m_allPixels;
+        uint32_t                 m_nextWrite = 0;     /*!< Protected by m_writeMutex*/
+        std::atomic<uint32_t>    m_nbWritten;
+        std::atomic<bool>        m_failed;
+        bool                     m_stop      = false;
+};
+
+#endif
@@ -0,0 +1,55 @@
+#ifndef  FRAMEBUFFER_INC
+#define  FRAMEBUFFER_INC
+
+#include <GL/glew.h>
+#include <stdint.h>
+
+/** \brief An offscreen render target of any resolution : an RGBA8 color texture and a 24 bits or floating point depth renderbuffer*/
+class Framebuffer
+{
+    public:
+        /** \brief Constructor. Create the attachments
+         * \param width the width in pixels
+         * \param height the height in pixels
+         * \param floatDepth a 32 bits floating point depth buffer instead of 24 bits fixed point (for DEPTH_REVERSED) */
+        Framebuffer(uint32_t width, uint32_t height, bool floatDepth = false);
+
+        /* \brief Destructor. Destroy the framebuffer and its attachments */
+        ~Framebuffer();
+
+        /** \brief tell whether the framebuffer can be drawn into
+         * \return true if the framebuffer is complete */
+        bool isComplete() const {return m_complete;}
+
+        /** \brief draw into this framebuffer from now on. The viewport is set to its whole size */
+        void bind();
+
+        /** \brief draw into the default framebuffer again */
+        static void unbind();
+
+        /** \brief get the framebuffer object
+         * \return the framebuffer ID */
+        GLuint getID() const {return m_fbo;}
+
+        /** \brief get the color attachment
+         * \return the texture ID */
+        GLuint getColorTexture() const {return m_color;}
+
+        /** \brief get the depth attachment, to share it with another framebuffer
+         * \return the renderbuffer ID */
+        GLuint getDepthBuffer() const {return m_depth;}
+
+        uint32_t getWidth()  const {return m_width;}
+        uint32_t getHeight() const {return m_height;}
+        bool hasFloatDepth() const {return m_floatDepth;}
+    private:
+        GLuint   m_fbo   = 0;
+        GLuint   m_color = 0;
+        GLuint   m_depth = 0;
+        uint32_t m_width;
+        uint32_t m_height;
+        bool     m_floatDepth;
+        bool     m_complete = false;
+};
+
+#endif
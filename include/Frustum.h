@@ -0,0 +1,38 @@
+#ifndef  FRUSTUM_INC
+#define  FRUSTUM_INC
+
+#include <glm/glm.hpp>
+#include <stdint.h>
+
+/** \brief The six planes of a view-projection volume, to test bounding spheres against.*/
+class Frustum
+{
+    public:
+        /** \brief Constructor. Extract the planes (Gribb/Hartmann)
+         * \param viewProjection the projection * view matrix. The planes are thus in world space */
+        Frustum(const glm::mat4& viewProjection);
+
+        /** \brief Test one sphere
+         * \param center the center of the sphere
+         * \param radius the radius of the sphere
+         * \return false if the sphere is completely outside of the volume */
+        bool intersects(const glm::vec3& center, float radius) const;
+
+        /** \brief Test a batch of spheres stored as separate arrays (4 spheres per SSE iteration when available)
+         * \param x the x coordinates of the centers
+         * \param y the y coordinates of the centers
+         * \param z the z coordinates of the centers
+         * \param radius the radii
+         * \param nbSpheres the size of every array
+         * \param visible filled with 1 if the sphere intersects the volume, 0 otherwise */
+        void intersects(const float* x, const float* y, const float* z, const float* radius, uint32_t nbSpheres, uint8_t* visible) const;
+
+        /** \brief Get a plane. The inside is where dot(plane.xyz, p) + plane.w >= 0
+         * \param i 0 left, 1 right, 2 bottom, 3 top, 4 near, 5 far
+         * \return the normalized plane */
+        const glm::vec4& getPlane(uint32_t i) const {return m_planes[i];}
+    private:
+        glm::vec4 m_planes[6];
+};
+
+#endif
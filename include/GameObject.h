@@ -0,0 +1,51 @@
+#ifndef  GAMEOBJECT_INC
+#define  GAMEOBJECT_INC
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <stdint.h>
+#include <vector>
+#include "Geometry.h"
+
+struct Material {
+    glm::vec3 color;
+    float ka;
+    float kd;
+    float ks;
+    float alpha;
+    uint32_t shaderFeatures; //ShaderFeature flags forced for this material (e.g. SHADER_UNLIT for self-lit bodies)
+};
+
+struct Light {
+    glm::vec3 position;
+    glm::vec3 color;
+};
+
+//Objects
+struct GameObject {
+    GLuint vboID = 0;
+    GLuint vaoID = 0;
+    GLuint texture = 0;
+    Geometry* geometry = nullptr;
+    Material sphereMtl = Material(); //Zero : the pivot nodes never set it
+    Light light;
+    glm::dvec3 position = glm::dvec3(0.0);        //Translation from the parent frame, applied before propagatedMatrix. Double : exact at the scale of the solar system
+    glm::mat4 propagatedMatrix = glm::mat4(1.0f); //Rotation (and scale) propagated to the children
+    glm::mat4 localMatrix = glm::mat4(1.0f);      //Transformation of the geometry only
+
+    //World transform (see WorldTransforms)
+    glm::dvec3 worldPosition = glm::dvec3(0.0); //Origin of the geometry in world space. Updated each frame
+    glm::mat4 modelMatrix = glm::mat4(1.0f);    //World matrix of the geometry with the camera at the origin : small values, exact in float. Updated each frame
+    std::vector<GameObject*> children;
+    bool translucent = false; //Blended with what is behind : drawn back to front after the opaque objects
+    bool sky = false;         //The background : only its texture and its orientation are used, by the Skybox
+
+    //Culling (see SceneCuller)
+    bool occluder = false;                   //Opaque solid body : its inscribed sphere may hide other objects in the occlusion pass, it collides and casts eclipses (a body containing the light is its source)
+    glm::dvec3 worldCenter = glm::dvec3(0.0); //Center of the bounding sphere of the geometry in world space, in double like worldPosition. Updated each frame
+    float worldRadius = 0.0f;                 //Radius of that sphere. Updated each frame
+    bool visible = true;                     //Whether the geometry passed the culling tests this frame
+    bool subtreeVisible = true;              //Whether this object or one of its descendants is visible this frame
+};
+
+#endif
@@ -43,14 +43,38 @@ class Geometry
          * \return the number of vertices this geometry contains*/
         uint32_t getNbVertices() const {return m_nbVertices;}
 
+        /* \brief Get the center of the bounding sphere, in object space
+         * \return pointer on the 3 coordinates of the center */
+        const float* getBoundingCenter() const {return m_boundingCenter;}
+
+        /* \brief Get the radius of the bounding sphere, in object space
+         * \return the radius. 0 if the geometry is empty */
+        float getBoundingRadius() const {return m_boundingRadius;}
+
     protected: 
+        /* \brief Constructor of the geometries whose arrays are static data (see StaticGeometry.h). They are neither copied nor freed
+         * \param vertices the positions, 3*nbVertices floats
+         * \param normals the normals, 3*nbVertices floats
+         * \param uvs the UV mapping, 2*nbVertices floats
+         * \param nbVertices the number of vertices
+         * \param boundingCenter the center of the bounding sphere (3 floats)
+         * \param boundingRadius the radius of the bounding sphere*/
+        Geometry(const float* vertices, const float* normals, const float* uvs, uint32_t nbVertices, const float* boundingCenter, float boundingRadius);
+
         /* \brief Clear all the tables*/
         void clear();
 
+        /* \brief Compute the bounding sphere from m_vertices (center of the axis-aligned box, radius up to the farthest vertex).
+         * Subclasses call it once their vertices are filled*/
+        void computeBoundingSphere();
+
         uint32_t m_nbVertices = 0;
         float*   m_vertices   = NULL;
         float*   m_normals    = NULL;
         float*   m_uvs        = NULL;
+        float    m_boundingCenter[3] = {0.0f, 0.0f, 0.0f};
+        float    m_boundingRadius    = 0.0f;
+        bool     m_ownsData          = true; /*!< false : the arrays are static data, shared by the copies and never freed*/
 };
 
 #endif
@@ -0,0 +1,32 @@
+#ifndef  HEADLESSCONTEXT_INC
+#define  HEADLESSCONTEXT_INC
+
+#include <stddef.h>
+
+/** \brief An OpenGL context without any window nor display server (EGL surfaceless, e.g. Mesa llvmpipe on a server).
+ * Nothing can be presented : the frames have to be rendered into a Framebuffer.
+ * Only available when the program is compiled with USE_EGL, create returns NULL otherwise.*/
+class HeadlessContext
+{
+    public:
+        /** \brief create an OpenGL context and make it current on the calling thread
+         * \param major the requested OpenGL major version
+         * \param minor the requested OpenGL minor version
+         * \return the HeadlessContext created or NULL if error */
+        static HeadlessContext* create(int major, int minor);
+
+        /* \brief Destructor. Release the context and the display */
+        ~HeadlessContext();
+
+        /** \brief make this context current on the calling thread
+         * \return true on success */
+        bool makeCurrent();
+    private:
+        /** \brief the constructor. Should never be called alone (use create)*/
+        HeadlessContext();
+
+        void* m_display = NULL; /*!< The EGLDisplay*/
+        void* m_context = NULL; /*!< The EGLContext*/
+};
+
+#endif
@@ -0,0 +1,72 @@
+#ifndef  ORBITALCATALOG_INC
+#define  ORBITALCATALOG_INC
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+class WorkerPool;
+
+#define CATALOG_WINDOW_SIZE (64 * 1024 * 1024) /*!< Bytes of the file mapped and parsed at once : bounds the memory used by the parsing*/
+#define CATALOG_MAX_LINE    4096               /*!< Longer lines are rejected*/
+#define CATALOG_GAUSS_K     0.01720209895      /*!< Gaussian gravitational constant : mean motion in rad/day of a body at 1 AU*/
+
+/* \brief Counters of a load */
+struct CatalogStats
+{
+    uint64_t nbBytes    = 0;
+    uint64_t nbRows     = 0; /*!< Data rows read, header excluded*/
+    uint64_t nbRejected = 0; /*!< Rows with a missing or invalid element, or an unbound orbit (e >= 1)*/
+    double   seconds    = 0.0;
+};
+
+/** \brief Keplerian orbital elements of a population of small bodies (asteroids), stored as separate arrays (SoA).
+ * Loaded from a CSV catalog with a header row (JPL Small-Body Database export : a, e, i, om, w, ma, epoch, H).
+ * The file is mapped window by window and each window is parsed by every core, so the memory used does not depend on the size of the file.*/
+class OrbitalCatalog
+{
+    public:
+        /** \brief load a CSV catalog. The columns are found by their name in the header :
+         * a (AU), e, i (deg), om or node (deg), w or peri (deg), ma or M (deg), and optionally epoch (JD) and H
+         * \param path the file
+         * \param maxBodies stop reading once this count is reached. 0 : no limit
+         * \return the catalog loaded or NULL if error */
+        static OrbitalCatalog* load(const std::string& path, uint64_t maxBodies = 0);
+
+        /** \brief compute the heliocentric ecliptic positions (AU) of a range of bodies at a date. Parallel for big ranges
+         * \param days the date, in days since J2000
+         * \param x the x coordinates, indexed like the bodies
+         * \param y the y coordinates
+         * \param z the z coordinates
+         * \param first the first body
+         * \param count how many bodies
+         * \param workers the threads sharing a big range */
+        void computePositions(double days, float* x, float* y, float* z, uint32_t first, uint32_t count, WorkerPool& workers) const;
+
+        uint32_t getNbBodies() const {return m_semiMajorAxis.size();}
+        const CatalogStats& getStats() const {return m_stats;}
+
+        const float* getSemiMajorAxis()     const {return m_semiMajorAxis.data();}
+        const float* getEccentricity()      const {return m_eccentricity.data();}
+        const float* getInclination()       const {return m_inclination.data();}
+        const float* getAscendingNode()     const {return m_ascendingNode.data();}
+        const float* getArgPeriapsis()      const {return m_argPeriapsis.data();}
+        const float* getMeanAnomaly()       const {return m_meanAnomaly.data();}
+        const float* getEpoch()             const {return m_epoch.data();}
+        const float* getAbsoluteMagnitude() const {return m_absoluteMagnitude.data();}
+    private:
+        /** \brief the constructor. Should never be called alone (use load)*/
+        OrbitalCatalog() {}
+
+        std::vector<float> m_semiMajorAxis;     /*!< a, in AU*/
+        std::vector<float> m_eccentricity;      /*!< e, in [0, 1[*/
+        std::vector<float> m_inclination;       /*!< i, in rad*/
+        std::vector<float> m_ascendingNode;     /*!< Longitude of the ascending node, in rad*/
+        std::vector<float> m_argPeriapsis;      /*!< Argument of the periapsis, in rad*/
+        std::vector<float> m_meanAnomaly;       /*!< Mean anomaly at the epoch, in rad*/
+        std::vector<float> m_epoch;             /*!< Epoch of the elements, in days since J2000*/
+        std::vector<float> m_absoluteMagnitude; /*!< H, NaN if unknown*/
+        CatalogStats       m_stats;
+};
+
+#endif
@@ -0,0 +1,126 @@
+#ifndef  PARTICLESYSTEM_INC
+#define  PARTICLESYSTEM_INC
+
+#include <glm/glm.hpp>
+#include <stdint.h>
+#include <vector>
+#include "GameObject.h"
+
+class WorkerPool;
+
+#define PARTICLES_MAX_EMITTERS 65535 /*!< A particle keeps the index of its emitter on 16 bits*/
+
+/* \brief How an emitter spawns its particles. The size and the color go linearly from their start to their end value over the life of a particle */
+struct ParticleEmitter
+{
+    GameObject* node = nullptr;        /*!< Particles are spawned on the surface of its bounding sphere (worldCenter, worldRadius). NULL : only burst*/
+    float       rate = 0.0f;           /*!< Particles per step spawned by update*/
+    glm::vec3   direction = glm::vec3(0.0f); /*!< Mean direction of the velocities. Zero : every direction*/
+    float       spread = 1.0f;         /*!< Random part of the direction : 0 along the direction only, 1 up to 90 degrees around it*/
+    float       speed = 0.01f;         /*!< Mean speed, in scene units per step*/
+    float       speedSpread = 0.5f;    /*!< The speed varies by this fraction*/
+    float       lifetime = 60.0f;      /*!< Mean lifetime, in steps*/
+    float       lifetimeSpread = 0.3f; /*!< The lifetime varies by this fraction*/
+    float       startSize = 0.02f;     /*!< Width of the billboard at birth*/
+    float       endSize = 0.05f;       /*!< Width of the billboard at death*/
+    glm::vec4   startColor = glm::vec4(1.0f, 0.8f, 0.3f, 1.0f);
+    glm::vec4   endColor = glm::vec4(0.6f, 0.1f, 0.0f, 0.0f);
+    float       accumulator = 0.0f;    /*!< Fraction of particle not spawned yet*/
+};
+
+/* \brief One billboard, as read by the vertex shader (vInstancePositionSize and vInstanceColor) */
+struct ParticleInstance
+{
+    glm::vec4 positionSize; /*!< Center relative to the camera (camera-relative rendering), width*/
+    glm::vec4 color;
+};
+
+/* \brief Counters of the last step */
+struct ParticleStats
+{
+    uint32_t nbAlive   = 0;
+    uint32_t nbSpawned = 0;
+    uint32_t nbKilled  = 0;
+    uint32_t nbDropped = 0; /*!< Spawns refused because the pool was full*/
+};
+
+/** \brief A fixed-capacity pool of particles stored as separate arrays (SoA).
+ * The motion is integrated 4 particles at a time (SSE) and in parallel for big pools, the dead particles are replaced by the last one (swap-remove).
+ * The size and the color are evaluated from the age when the billboards are built, sorted back to front for alpha blending.*/
+class ParticleSystem
+{
+    public:
+        /** \brief Constructor. Allocates the whole pool
+         * \param capacity the maximum number of live particles
+         * \param workers the threads of update and buildInstances */
+        ParticleSystem(uint32_t capacity, WorkerPool& workers);
+
+        /** \brief add an emitter
+         * \param emitter its parameters
+         * \return its index, or PARTICLES_MAX_EMITTERS if there are too many */
+        uint32_t addEmitter(const ParticleEmitter& emitter);
+
+        /** \brief get an emitter, to move or tune it
+         * \param i its index
+         * \return the emitter */
+        ParticleEmitter& getEmitter(uint32_t i) {return m_emitters[i];}
+
+        /** \brief spawn particles at once with the parameters of an emitter (an impact...)
+         * \param emitter the index of the emitter
+         * \param center the center of the emission sphere
+         * \param radius its radius : the particles start on its surface
+         * \param direction the mean direction, replacing the one of the emitter. Zero : every direction
+         * \param count how many particles */
+        void burst(uint32_t emitter, const glm::vec3& center, float radius, const glm::vec3& direction, uint32_t count);
+
+        /** \brief spawn the particles of the emitters attached to a node, age and move every particle, remove the dead ones
+         * \param dt the time elapsed, in steps */
+        void update(float dt = 1.0f);
+
+        /** \brief build the billboards of every live particle, from the farthest to the nearest
+         * \param cameraPosition the camera, in world space. It is the origin of the billboard centers
+         * \param instances filled with getNbParticles() billboards */
+        void buildInstances(const glm::vec3& cameraPosition, ParticleInstance* instances);
+
+        /** \brief set the acceleration applied to every particle
+         * \param acceleration in scene units per step^2 */
+        void setAcceleration(const glm::vec3& acceleration) {m_acceleration = acceleration;}
+
+        /** \brief set the drag : the velocities are multiplied by this factor each step
+         * \param damping in ]0, 1] */
+        void setDamping(float damping) {m_damping = damping;}
+
+        uint32_t getNbParticles() const {return m_nbParticles;}
+        uint32_t getCapacity() const {return m_x.size();}
+        const ParticleStats& getStats() const {return m_stats;}
+    private:
+        /* \brief Spawn one particle. Dropped if the pool is full */
+        void spawn(uint32_t emitter, const glm::vec3& center, float radius, const glm::vec3& direction);
+
+        /* \brief Integrate the particles [first, last[ */
+        void integrate(uint32_t first, uint32_t last, float dt);
+
+        /* \brief Random float in [0, 1[ (xorshift) */
+        float random();
+
+        WorkerPool& m_workers;
+        uint32_t m_nbParticles = 0;
+        uint32_t m_random = 0x9E3779B9;
+
+        /* Particles, structure of arrays. The vectors have the capacity, only the first m_nbParticles are alive */
+        std::vector<float>    m_x, m_y, m_z, m_vx, m_vy, m_vz, m_age;
+        std::vector<float>    m_invLife; /*!< 1 / lifetime : the particle dies when age * invLife reaches 1*/
+        std::vector<uint16_t> m_emitter;
+
+        std::vector<ParticleEmitter> m_emitters;
+        glm::vec3                    m_acceleration = glm::vec3(0.0f);
+        float                        m_damping = 1.0f;
+
+        /* Depth sort */
+        std::vector<uint16_t> m_keys, m_keysTmp;
+        std::vector<uint32_t> m_order, m_orderTmp;
+
+        ParticleStats m_stats;
+};
+
+#endif
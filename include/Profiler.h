@@ -0,0 +1,141 @@
+#ifndef  PROFILER_INC
+#define  PROFILER_INC
+
+#include <GL/glew.h>
+#include <stdint.h>
+#include <string>
+
+#define PROFILER_MAX_FRAMES      512 /*!< Frames kept in the ring, the summaries and the trace cover them*/
+#define PROFILER_MAX_SCOPES      64  /*!< CPU scopes recorded per frame, the next ones are dropped*/
+#define PROFILER_MAX_GPU_SCOPES  8   /*!< GPU passes timed per frame*/
+#define PROFILER_GPU_LATENCY     3   /*!< Frames between a GPU query and the read of its result*/
+
+/* \brief A timed scope. Times are in nanoseconds since the creation of the first Profiler (all of them share this origin) */
+struct ProfileEvent
+{
+    const char* name;  /*!< Must outlive the profiler (string literal)*/
+    uint64_t    begin;
+    uint64_t    end;
+    uint32_t    depth; /*!< Nesting level, 0 for the outermost scopes*/
+};
+
+/* \brief Everything recorded during one frame */
+struct ProfileFrame
+{
+    uint64_t     index;
+    uint64_t     begin;
+    uint64_t     end;
+    ProfileEvent scopes[PROFILER_MAX_SCOPES];
+    uint32_t     nbScopes;
+    ProfileEvent gpuScopes[PROFILER_MAX_GPU_SCOPES]; /*!< begin is the CPU time of beginGpu, end = begin + the GPU duration*/
+    uint32_t     nbGpuScopes;
+    bool         gpuResolved;                        /*!< Whether the GPU durations were read back*/
+};
+
+/** \brief Frame profiler : nestable CPU scopes on a high resolution clock and GL_TIME_ELAPSED queries per render pass.
+ * The frames are kept in a ring buffer which can be summarized (min / avg / p99 per scope name) or exported as a Chrome trace (chrome://tracing).
+ * A Profiler is used by a single thread : each thread has its own, and their traces can be exported together. Only the one of the OpenGL thread can time the GPU.*/
+class Profiler
+{
+    public:
+        /** \brief Constructor. Create the GPU queries if asked and GL_ARB_timer_query is supported
+         * \param name the name of the thread in the summary and the trace (string literal)
+         * \param gpu whether the GPU passes are timed. Must be false if the OpenGL context is not current on the thread */
+        Profiler(const char* name = "CPU", bool gpu = true);
+
+        /* \brief Destructor. Destroy the queries */
+        ~Profiler();
+
+        /** \brief start a new frame. Reads the GPU results of the frame issued PROFILER_GPU_LATENCY frames ago */
+        void beginFrame();
+
+        /** \brief end the current frame */
+        void endFrame();
+
+        /** \brief open a CPU scope. Prefer ProfileScope
+         * \param name the scope name (string literal) */
+        void beginScope(const char* name);
+
+        /** \brief close the innermost CPU scope */
+        void endScope();
+
+        /** \brief start timing a render pass on the GPU. The GPU passes cannot be nested
+         * \param name the pass name (string literal) */
+        void beginGpu(const char* name);
+
+        /** \brief stop timing the current render pass */
+        void endGpu();
+
+        /** \brief print, for every scope name, the min / avg / p99 duration over the recorded frames */
+        void printSummary() const;
+
+        /** \brief write the recorded frames in the Chrome trace event format
+         * \param path the JSON file to write
+         * \return false if the file could not be written */
+        bool exportChromeTrace(const std::string& path) const;
+
+        /** \brief write the recorded frames of several profilers (one per thread) in a single Chrome trace
+         * \param path the JSON file to write
+         * \param profilers the profilers
+         * \param nbProfilers the number of profilers
+         * \return false if the file could not be written */
+        static bool exportChromeTrace(const std::string& path, const Profiler* const* profilers, uint32_t nbProfilers);
+
+        /** \brief get the time elapsed since the creation of the profiler
+         * \return the time in nanoseconds */
+        uint64_t now() const;
+    private:
+        ProfileFrame* m_frames;           /*!< The ring, PROFILER_MAX_FRAMES frames*/
+        uint64_t      m_nbFrames = 0;     /*!< Frames started so far*/
+        ProfileFrame* m_current  = NULL;  /*!< The frame being recorded*/
+        uint32_t      m_stack[PROFILER_MAX_SCOPES]; /*!< Indices of the open scopes in m_current*/
+        uint32_t      m_depth    = 0;
+        uint64_t      m_origin;           /*!< Clock value at the creation of the first Profiler, in nanoseconds*/
+        const char*   m_name;
+
+        bool     m_gpuSupported = false;
+        GLuint   m_queries[PROFILER_GPU_LATENCY][PROFILER_MAX_GPU_SCOPES];
+        uint64_t m_queryFrame[PROFILER_GPU_LATENCY]; /*!< Frame index whose passes use this set of queries*/
+        bool     m_gpuOpen = false;
+        uint32_t m_nbUnresolved = 0; /*!< Frames whose queries were not available when their set was reused*/
+};
+
+/** \brief RAII CPU scope : times the block it is declared in. Does nothing if the profiler is NULL*/
+class ProfileScope
+{
+    public:
+        ProfileScope(Profiler* profiler, const char* name) : m_profiler(profiler)
+        {
+            if(m_profiler)
+                m_profiler->beginScope(name);
+        }
+
+        ~ProfileScope()
+        {
+            if(m_profiler)
+                m_profiler->endScope();
+        }
+    private:
+        Profiler* m_profiler;
+};
+
+/** \brief RAII GPU pass : times the GL commands issued in the block. Does nothing if the profiler is NULL*/
+class ProfileGpuScope
+{
+    public:
+        ProfileGpuScope(Profiler* profiler, const char* name) : m_profiler(profiler)
+        {
+            if(m_profiler)
+                m_profiler->beginGpu(name);
+        }
+
+        ~ProfileGpuScope()
+        {
+            if(m_profiler)
+                m_profiler->endGpu();
+        }
+    private:
+        Profiler* m_profiler;
+};
+
+#endif
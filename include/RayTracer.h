@@ -0,0 +1,209 @@
+#ifndef  RAYTRACER_INC
+#define  RAYTRACER_INC
+
+#include <glm/glm.hpp>
+#include <stdint.h>
+#include <unordered_map>
+#include <vector>
+#include "GameObject.h"
+#include "ParticleSystem.h"
+
+#define RAYTRACE_TILE_SIZE  16 /*!< Side in pixels of the tiles taken by the threads (a multiple of the 2x2 packets)*/
+#define RAYTRACE_LEAF_SIZE  4  /*!< Bounding spheres per leaf of the hierarchies*/
+#define RAYTRACE_MAX_LAYERS 8  /*!< Translucent surfaces a view ray goes through before it only sees the background*/
+
+/** \brief The shape of a RayPrimitive in its local frame : the meshes of the rasterizer, without their tessellation*/
+enum RayShape
+{
+    RAY_SPHERE,  /*!< The sphere of radius 0.5 centered on the origin (Sphere, StaticSphere)*/
+    RAY_ANNULUS  /*!< The flat ring of outer radius 0.5 in the plane y = 0, its normal +y (Annulus)*/
+};
+
+/** \brief A body to render, camera-relative like the draws of the rasterizer*/
+struct RayPrimitive
+{
+    RayShape  shape;
+    glm::mat4 model;
+    Material  material;
+    uint32_t  texture;     /*!< An id given to RayTracer::addTexture. An unknown id is white*/
+    bool      translucent; /*!< Blended with the alpha of its texture over what is behind it*/
+    float     innerRadius; /*!< RAY_ANNULUS : the radius of the hole*/
+    glm::vec2 uvScale;     /*!< RAY_SPHERE : the UVs of the seam and of the south pole (StaticSphere::U_SCALE and V_SCALE)*/
+};
+
+/* \brief Counters of the last RayTracer::render */
+struct RayStats
+{
+    uint64_t nbRays       = 0; /*!< View rays (one per translucent layer crossed) and shadow rays*/
+    uint64_t nbShadowRays = 0;
+    uint32_t nbTiles      = 0;
+    uint32_t nbSteals     = 0; /*!< Ranges of tiles a thread took from another one*/
+    uint32_t nbThreads    = 0;
+    double   seconds      = 0.0;
+};
+
+/** \brief Offline renderer on the CPU, for the stills and videos where the Phong shading of the rasterizer is not enough.
+ * Each pixel averages jittered samples. The view rays are traced by packets of 2x2 pixels, the 4 lanes of an SSE register, through a
+ * bounding volume hierarchy over the bounding spheres of the primitives, and intersected analytically with the sphere or the annulus.
+ * The lighting is the one of colorTexture.frag, the shadows come from rays towards a random point of the light disc through a second
+ * hierarchy over the occluders : the penumbrae converge with the samples. The particles are splatted over the result, behind the first
+ * opaque surface like the depth test of their billboards.
+ * The image is cut into tiles : each thread renders the tiles of its own range, then steals the second half of the largest remaining range.*/
+class RayTracer
+{
+    public:
+        /** \brief Constructor
+         * \param nbSamples the samples per pixel (antialiasing and penumbrae). 1 : the center of the pixel and of the light, hard shadows
+         * \param nbThreads the threads rendering the tiles, 0 for one per core */
+        RayTracer(uint32_t nbSamples = 4, uint32_t nbThreads = 0);
+
+        /** \brief keep a copy of a texture, sampled with bilinear filtering and repeated like the textures of the rasterizer
+         * \param id the id the primitives refer to it by
+         * \param rgba the pixels, 4 bytes per pixel, the first row at v = 0
+         * \param width the width of the texture
+         * \param height the height of the texture */
+        void addTexture(uint32_t id, const uint8_t* rgba, uint32_t width, uint32_t height);
+
+        /** \brief set the background at infinity, mapped like the Skybox
+         * \param rgba the pixels of the equirectangular image, 4 bytes per pixel, the first row at the north pole
+         * \param width the width of the image
+         * \param height the height of the image */
+        void setSky(const uint8_t* rgba, uint32_t width, uint32_t height);
+
+        /** \brief remove the primitives, occluders and particles of the previous frame */
+        void clear();
+
+        /** \brief add a primitive to the next render
+         * \param primitive the primitive, copied */
+        void addPrimitive(const RayPrimitive& primitive);
+
+        /** \brief add a sphere which casts a shadow (see Eclipses). A sphere containing the light is its source and casts none
+         * \param sphere the camera-relative center and the radius */
+        void addOccluder(const glm::vec4& sphere);
+
+        /** \brief set the particles of the next render
+         * \param particles the billboards, sorted from the farthest to the nearest (ParticleSystem::buildInstances). Copied
+         * \param nbParticles the number of particles */
+        void setParticles(const ParticleInstance* particles, uint32_t nbParticles);
+
+        /** \brief set the light of the next render
+         * \param position the camera-relative position
+         * \param radius the radius of the light disc, 0 for a point light
+         * \param color the color of the light */
+        void setLight(const glm::vec3& position, float radius, const glm::vec3& color);
+
+        /** \brief set the background of the next render
+         * \param visible false for a black background
+         * \param rotation the orientation of the sky in the world
+         * \param color the color the sky is multiplied by */
+        void setSkyView(bool visible, const glm::mat3& rotation, const glm::vec3& color);
+
+        /** \brief render a frame with every thread. The camera is at the origin (camera-relative rendering)
+         * \param view the rotation of the camera
+         * \param projection the projection of the camera
+         * \param width the width of the image
+         * \param height the height of the image
+         * \param rgba filled with width * height * 4 bytes, the first row at the bottom like glReadPixels */
+        void render(const glm::mat4& view, const glm::mat4& projection, uint32_t width, uint32_t height, uint8_t* rgba);
+
+        /** \brief get the counters of the last render
+         * \return the statistics */
+        const RayStats& getStats() const {return m_stats;}
+
+        /** \brief get the samples per pixel
+         * \return the number of samples */
+        uint32_t getNbSamples() const {return m_nbSamples;}
+    private:
+        struct Texture
+        {
+            uint32_t width  = 0;
+            uint32_t height = 0;
+            std::vector<uint8_t> rgba;
+        };
+
+        /* A node of a hierarchy : an inner node is followed by its first child, a leaf holds count indices from first */
+        struct Node
+        {
+            glm::vec3 min;
+            uint32_t  first;  /*!< Inner node : index of the second child. Leaf : first index*/
+            glm::vec3 max;
+            uint16_t  count;  /*!< 0 for an inner node*/
+            uint16_t  axis;   /*!< Inner node : the axis the children are split along*/
+        };
+
+        /* A primitive with what its intersections and shading need */
+        struct Item
+        {
+            RayPrimitive   primitive;
+            glm::mat4      invModel;     /*!< Rays into the local frame*/
+            glm::mat3      normalMatrix; /*!< Local normals into the world*/
+            const Texture* texture;      /*!< NULL : white*/
+            bool           unlit;        /*!< Self-lit : the ambient term only, like SHADER_UNLIT*/
+        };
+
+        struct Counters;
+        struct Packet;
+        struct Surface;
+
+        /* \brief Build a hierarchy over spheres (center, radius), median split along the largest axis of the centers */
+        static void buildHierarchy(const std::vector<glm::vec4>& spheres, std::vector<Node>& nodes, std::vector<uint32_t>& indices);
+
+        /* \brief Build the node of the spheres indices[first, first + count[ and its subtree, depth first. Returns its index */
+        static uint32_t buildNode(const std::vector<glm::vec4>& spheres, std::vector<Node>& nodes, std::vector<uint32_t>& indices, uint32_t first, uint32_t count);
+
+        /* \brief Bilinear fetch with the texture repeated */
+        static glm::vec4 sample(const Texture& texture, float u, float v);
+
+        /* \brief Find the nearest item hit by the active lanes of a packet, beyond their tMin */
+        void intersect(Packet& packet, int mask) const;
+
+        /* \brief Tell which active lanes of a packet of shadow rays an occluder stops before their tMax */
+        int occluded(const Packet& packet, int mask) const;
+
+        /* \brief Shade the view rays of a packet, through the translucent surfaces. depths : the distance of the first opaque surface */
+        void trace(Packet& packet, int mask, const glm::vec2* lightSamples, glm::vec3* colors, float* depths, Counters& counters) const;
+
+        /* \brief The background seen in a direction */
+        glm::vec3 background(const glm::vec3& direction) const;
+
+        /* \brief The direction of the view ray through a point of the image (in pixels, from the bottom left corner) */
+        glm::vec3 viewRay(float x, float y) const;
+
+        /* \brief Render every pixel of a tile, then splat its particles */
+        void renderTile(uint32_t tile, uint8_t* rgba, Counters& counters) const;
+
+        uint32_t m_nbSamples;
+        uint32_t m_nbThreads;
+
+        std::unordered_map<uint32_t, Texture> m_textures;
+        Texture   m_sky;
+        bool      m_skyVisible  = false;
+        glm::mat3 m_skyRotation = glm::mat3(1.0f);
+        glm::vec3 m_skyColor    = glm::vec3(1.0f);
+
+        glm::vec3 m_lightPosition = glm::vec3(0.0f);
+        float     m_lightRadius   = 0.0f;
+        glm::vec3 m_lightColor    = glm::vec3(1.0f);
+
+        std::vector<Item>      m_items;
+        std::vector<glm::vec4> m_occluders;
+        std::vector<ParticleInstance> m_particles;
+
+        /* The state of the frame being rendered, read by every thread */
+        std::vector<Node>     m_nodes;           /*!< Over the bounding spheres of m_items*/
+        std::vector<uint32_t> m_indices;
+        std::vector<Node>     m_occluderNodes;   /*!< Over m_occluders*/
+        std::vector<uint32_t> m_occluderIndices;
+        std::vector<glm::vec4> m_particleCenters;            /*!< In view space, and the width*/
+        std::vector<std::vector<uint32_t> > m_tileParticles; /*!< The particles overlapping each tile, in their order*/
+        glm::mat4 m_invViewProjection = glm::mat4(1.0f);
+        glm::mat4 m_view       = glm::mat4(1.0f);
+        glm::mat4 m_projection = glm::mat4(1.0f);
+        uint32_t  m_width   = 0;
+        uint32_t  m_height  = 0;
+        uint32_t  m_nbTilesX = 0;
+
+        RayStats m_stats;
+};
+
+#endif
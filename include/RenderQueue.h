@@ -0,0 +1,92 @@
+#ifndef  RENDERQUEUE_INC
+#define  RENDERQUEUE_INC
+
+#include <GL/glew.h>
+#include <stdint.h>
+#include <vector>
+#include "GameObject.h"
+#include "Shader.h"
+#include "Skybox.h"
+#include "UniformBuffers.h"
+#include "WeightedBlending.h"
+
+/** \brief The coarsest sort criterion : layers are drawn in this order*/
+enum RenderLayer
+{
+    LAYER_OPAQUE      = 0, /*!< Front to back, grouped by shader*/
+    LAYER_BACKGROUND  = 1, /*!< Opaque objects surrounding the camera : drawn after every other opaque object, before the Skybox*/
+    LAYER_WEIGHTED    = 2, /*!< Translucent, in any order : accumulated then composited by WeightedBlending. Like LAYER_TRANSLUCENT without it*/
+    LAYER_TRANSLUCENT = 3  /*!< Back to front, blended, without depth writes*/
+};
+
+/* \brief Everything needed to issue one draw call */
+struct DrawPacket
+{
+    uint64_t       key;        /*!< See RenderQueue::makeKey*/
+    Shader*        shader;
+    GLuint         vao;
+    GLuint         texture;
+    GLint          first;
+    GLsizei        nbVertices;
+    GLsizei        nbInstances = 0; /*!< 0 : a single draw. Otherwise the VAO provides the per-instance attributes of a SHADER_INSTANCED or SHADER_PARTICLES variant*/
+    GLenum         primitive   = GL_TRIANGLES;
+    Material       material;
+    ObjectUniforms object;     /*!< The material index is filled at submission*/
+};
+
+/* \brief State changes of the last submission */
+struct RenderStats
+{
+    uint32_t nbDraws      = 0;
+    uint32_t programBinds = 0;
+    uint32_t textureBinds = 0;
+    uint32_t bufferBinds  = 0; /*!< Vertex arrays and uniform ranges*/
+};
+
+/** \brief Collect the draws of a frame, sort them by a 64-bit key and submit them while skipping the redundant state changes.*/
+class RenderQueue
+{
+    public:
+        /** \brief Build a sort key.
+         * Opaque : layer(2) | shader(8) | depth(16, front to back) | texture(16) | mesh(16) | unused(6)
+         * Weighted and translucent : layer(2) | inverted depth(16, back to front) | shader(8) | texture(16) | mesh(16) | unused(6)
+         * \param layer the RenderLayer
+         * \param program the program ID (only its 8 lowest bits are used)
+         * \param texture the texture ID (only its 16 lowest bits are used)
+         * \param mesh the vertex array ID (only its 16 lowest bits are used)
+         * \param depth the distance to the camera divided by the far plane distance. Clamped in [0, 1]
+         * \return the key */
+        static uint64_t makeKey(RenderLayer layer, GLuint program, GLuint texture, GLuint mesh, float depth);
+
+        /** \brief Remove every packet */
+        void clear();
+
+        /** \brief Add a draw
+         * \param packet the draw to add */
+        void push(const DrawPacket& packet) {m_packets.push_back(packet);}
+
+        /** \brief Sort the packets by key (LSD radix sort, 8 bits per pass, passes where every key has the same byte are skipped) */
+        void sort();
+
+        /** \brief Issue the draw calls, in the sorted order
+         * \param uniformBuffers the shared uniform blocks, whose frame is begun here. NULL to set the classic uniforms instead
+         * \param frame the per-frame data
+         * \param weighted the order-independent transparency of LAYER_WEIGHTED. NULL to blend it back to front instead
+         * \param sky the background, drawn after the opaque layers and before the translucent ones. NULL for none */
+        void submit(UniformBuffers* uniformBuffers, const FrameUniforms& frame, WeightedBlending* weighted = NULL, const Skybox* sky = NULL);
+
+        /** \brief Get how many packets are queued
+         * \return the number of packets */
+        size_t getNbPackets() const {return m_packets.size();}
+
+        /** \brief Get the state changes of the last submission
+         * \return the statistics */
+        const RenderStats& getStats() const {return m_stats;}
+    private:
+        std::vector<DrawPacket> m_packets;
+        std::vector<uint64_t>   m_keys, m_keysTmp;
+        std::vector<uint32_t>   m_order, m_orderTmp;
+        RenderStats             m_stats;
+};
+
+#endif
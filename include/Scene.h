@@ -0,0 +1,170 @@
+#ifndef  SCENE_INC
+#define  SCENE_INC
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include "GameObject.h"
+
+#define SCENE_MAGIC    "SSCN"     /*!< First bytes of a compiled scene*/
+#define SCENE_VERSION  2          /*!< Increased at each change of the binary layout*/
+#define SCENE_NONE     0xFFFFFFFF /*!< No parent / texture / material*/
+
+/** \brief The geometry of a node*/
+enum SceneMesh
+{
+    SCENE_MESH_SPHERE  = 0,
+    SCENE_MESH_ANNULUS = 1, /*!< Flat ring in the equatorial plane (the rings of a planet, see Annulus)*/
+    SCENE_NB_MESHES    = 2
+};
+
+/** \brief Flags of a node, copied to the GameObject*/
+enum SceneNodeFlag
+{
+    SCENE_NODE_OCCLUDER    = 1 << 0,
+    SCENE_NODE_TRANSLUCENT = 1 << 1,
+    SCENE_NODE_SKY         = 1 << 2  /*!< The background : its texture (equirectangular) is drawn at infinity by a Skybox, turned like the node*/
+};
+
+/* \brief A material of the binary form. Same fields as Material */
+struct SceneMaterial
+{
+    float    color[3];
+    float    ka, kd, ks, alpha;
+    uint32_t shaderFeatures;
+    uint32_t name;           /*!< Offset in the string table*/
+    uint32_t padding;
+};
+
+/* \brief A texture of the binary form */
+struct SceneTexture
+{
+    uint32_t path;           /*!< Offset in the string table, relative to the working directory*/
+    uint32_t name;           /*!< Offset in the string table*/
+};
+
+/* \brief A node of the binary form. Each frame : position = position, propagatedMatrix = rotate(phase + speed * step, axis), localMatrix = scale(scale) */
+struct SceneNode
+{
+    uint32_t parent;         /*!< Index of the parent, always smaller than the index of the node. SCENE_NONE for the roots*/
+    uint32_t name;           /*!< Offset in the string table*/
+    uint32_t texture;        /*!< Index in the textures or SCENE_NONE*/
+    uint32_t material;       /*!< Index in the materials or SCENE_NONE (all zero)*/
+    uint32_t mesh;           /*!< SceneMesh*/
+    uint32_t flags;          /*!< SceneNodeFlag*/
+    double   position[3];    /*!< Relative to the parent. Double : exact at the scale of the solar system*/
+    float    axis[3];        /*!< Rotation axis, in the parent frame*/
+    float    speed;          /*!< Radians per simulation step*/
+    float    phase;          /*!< Angle at the step 0*/
+    float    scale[3];       /*!< Scale of the geometry, not propagated to the children*/
+};
+
+/* \brief The light of the binary form */
+struct SceneLight
+{
+    float position[3];
+    float color[3];
+};
+
+/* \brief Header of the binary form. The sections follow, 8 bytes aligned, little endian */
+struct SceneFileHeader
+{
+    char       magic[4];
+    uint32_t   version;
+    uint32_t   byteOrder;    /*!< 0x01020304 written natively : another value means the file comes from a machine of another endianness*/
+    uint32_t   nbMaterials;
+    uint32_t   nbTextures;
+    uint32_t   nbNodes;
+    uint32_t   stringsSize;
+    uint32_t   padding;
+    uint64_t   materialsOffset;
+    uint64_t   texturesOffset;
+    uint64_t   nodesOffset;
+    uint64_t   stringsOffset;
+    SceneLight light;
+};
+
+/** \brief A scene description : materials, textures, a light and a hierarchy of animated nodes stored in flat arrays.
+ * It is written by hand in a text form (see Scenes/solar_system.scene) and can be compiled to a binary form
+ * which is mapped in memory and used in place, without any parsing.*/
+class Scene
+{
+    public:
+        /* \brief Destructor. Unmap the binary form */
+        ~Scene();
+
+        /** \brief load a scene, text or binary (recognized by its first bytes)
+         * \param path the file
+         * \return the Scene loaded or NULL if error */
+        static Scene* load(const std::string& path);
+
+        /** \brief parse the text form
+         * \param path the file
+         * \return the Scene loaded or NULL if error */
+        static Scene* loadText(const std::string& path);
+
+        /** \brief map the binary form in memory. Only the indices are checked
+         * \param path the file
+         * \return the Scene loaded or NULL if error */
+        static Scene* loadBinary(const std::string& path);
+
+        /** \brief write the binary form
+         * \param path the file
+         * \return false if the file could not be written */
+        bool saveBinary(const std::string& path) const;
+
+        uint32_t getNbMaterials() const {return m_header.nbMaterials;}
+        uint32_t getNbTextures()  const {return m_header.nbTextures;}
+        uint32_t getNbNodes()     const {return m_header.nbNodes;}
+        const SceneMaterial* getMaterials() const {return m_materials;}
+        const SceneTexture*  getTextures()  const {return m_textures;}
+        const SceneNode*     getNodes()     const {return m_nodes;}
+        const SceneLight&    getLight()     const {return m_header.light;}
+
+        /** \brief get a string of the string table
+         * \param offset the offset stored in a node, texture or material
+         * \return the string */
+        const char* getString(uint32_t offset) const {return m_strings + offset;}
+
+        /** \brief find a node by name
+         * \param name the name of the node
+         * \return its index, or SCENE_NONE */
+        uint32_t findNode(const std::string& name) const;
+
+        /** \brief create the GameObjects of the nodes : hierarchy, materials, light and flags
+         * \param objects resized to getNbNodes() and filled, in the node order
+         * \param textures the OpenGL texture of each scene texture
+         * \param geometries the geometry of each SceneMesh, with its VBO and VAO */
+        void instantiate(std::vector<GameObject>& objects, const std::vector<GLuint>& textures,
+                         Geometry* const* geometries, const GLuint* vbos, const GLuint* vaos) const;
+
+        /** \brief set the positions and the matrices of the GameObjects for a simulation step
+         * \param objects the objects created by instantiate
+         * \param step the simulation step */
+        void animate(std::vector<GameObject>& objects, uint64_t step) const;
+    private:
+        /** \brief the constructor. Should never be called alone (use the load functions)*/
+        Scene();
+
+        /** \brief check the header and the indices of the arrays
+         * \param fileSize the size of the binary form
+         * \return false if the scene is not valid */
+        bool validate(uint64_t fileSize) const;
+
+        SceneFileHeader      m_header;
+        const SceneMaterial* m_materials = NULL;
+        const SceneTexture*  m_textures  = NULL;
+        const SceneNode*     m_nodes     = NULL;
+        const char*          m_strings   = NULL;
+
+        /* Storage of the text form. The binary form points into m_mapping instead */
+        std::vector<SceneMaterial> m_ownMaterials;
+        std::vector<SceneTexture>  m_ownTextures;
+        std::vector<SceneNode>     m_ownNodes;
+        std::vector<char>          m_ownStrings;
+
+        void*    m_mapping     = NULL;
+        uint64_t m_mappingSize = 0;
+};
+
+#endif
@@ -0,0 +1,81 @@
+#ifndef  SCENECULLER_INC
+#define  SCENECULLER_INC
+
+#include <glm/glm.hpp>
+#include <stdint.h>
+#include <vector>
+#include "GameObject.h"
+
+#define HIZ_SIZE   64 /*!< Resolution of the CPU occlusion depth buffer (power of two)*/
+#define HIZ_LEVELS 7  /*!< log2(HIZ_SIZE)+1 levels in the max-depth pyramid*/
+#define CULLER_MAX_OCCLUDERS 8 /*!< Largest visible occluders on screen rasterized in the depth buffer each frame*/
+
+/* \brief What the last SceneCuller::cull call removed */
+struct CullingStats
+{
+    uint32_t nbObjects       = 0; /*!< Objects traversed*/
+    uint32_t frustumCulled   = 0; /*!< Outside of the view frustum*/
+    uint32_t smallCulled     = 0; /*!< Projected smaller than the minimum pixel radius*/
+    uint32_t occlusionCulled = 0; /*!< Hidden behind an occluder*/
+    uint32_t nbOccluders     = 0; /*!< Occluders rasterized in the depth buffer*/
+
+    uint32_t getNbVisible() const {return nbObjects - frustumCulled - smallCulled - occlusionCulled;}
+};
+
+/** \brief Per-frame visibility of a scene graph.
+ * The world bounding spheres are propagated along the hierarchy, tested in batch against the frustum,
+ * then optionally against a small hierarchical depth buffer where the largest occluders are ray-cast on the CPU.
+ * The result is written in GameObject::visible and GameObject::subtreeVisible.*/
+class SceneCuller
+{
+    public:
+        /** \brief Constructor
+         * \param viewportHeight the height of the viewport, in pixels, to estimate the projected sizes */
+        SceneCuller(uint32_t viewportHeight);
+
+        /** \brief Enable or disable the CPU occlusion pass (disabled by default)
+         * \param enabled true to enable it */
+        void setOcclusionEnabled(bool enabled) {m_occlusion = enabled;}
+
+        /** \brief Set the projected radius under which an object is culled (0.5 pixel by default)
+         * \param minPixelRadius the radius, in pixels. 0 disables the small object culling */
+        void setMinPixelRadius(float minPixelRadius) {m_minPixelRadius = minPixelRadius;}
+
+        /** \brief Compute the visibility of every object reachable from the roots
+         * \param roots the root objects, drawn with their modelMatrix (camera-relative, see WorldTransforms) on top of projection * view
+         * \param view the view matrix, with the camera at the origin
+         * \param projection the (symmetric perspective) projection matrix
+         * \param cameraPosition the camera in world space, to set the world bounding spheres */
+        void cull(const std::vector<GameObject*>& roots, const glm::mat4& view, const glm::mat4& projection, const glm::dvec3& cameraPosition);
+
+        /** \brief Get the statistics of the last cull
+         * \return the statistics */
+        const CullingStats& getStats() const {return m_stats;}
+    private:
+        /* \brief Flatten the hierarchy in depth-first order and compute the bounding spheres, camera-relative and in world space */
+        void gather(GameObject& go, const glm::dvec3& cameraPosition, int32_t parent);
+
+        /* \brief Ray-cast the occluders in the depth buffer and build the max-depth pyramid */
+        void rasterizeOccluders(const glm::mat4& projection, float zNear);
+
+        /* \brief Test a view-space sphere against the depth pyramid
+         * \return true if the sphere is hidden */
+        bool isOccluded(const glm::vec3& center, float radius, const glm::mat4& projection, float zNear) const;
+
+        uint32_t m_viewportHeight;
+        bool     m_occlusion      = false;
+        float    m_minPixelRadius = 0.5f;
+        CullingStats m_stats;
+
+        /* Flattened hierarchy, structure of arrays for the batch frustum test */
+        std::vector<GameObject*> m_nodes;
+        std::vector<int32_t>     m_parents;
+        std::vector<float>       m_x, m_y, m_z, m_radius;
+        std::vector<float>       m_innerRadius; /*!< World radius of the sphere inscribed in the geometry, for the occluders*/
+        std::vector<uint8_t>     m_visible;
+
+        std::vector<glm::vec3>   m_viewCenters; /*!< The centers in view space*/
+        std::vector<float> m_hiz[HIZ_LEVELS]; /*!< Max-distance pyramid, level l is (HIZ_SIZE>>l)^2. Distances from the camera*/
+};
+
+#endif
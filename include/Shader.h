@@ -2,13 +2,50 @@
 #define SHADER_INCLUDE
 
 #define ERROR_MAX_LENGTH 500
+#define SHADER_MAX_MATERIALS 64 /*!< Size of the MaterialBlock array of the UNIFORM_BUFFERS variants*/
+#define SHADER_MAX_OCCLUDERS 4  /*!< Spheres which can shadow one object in the ECLIPSES variants*/
 
 #include <GL/glew.h>
 #include <GL/gl.h>
 #include <iostream>
 #include <cstdlib>
+#include <string>
 #include "logger.h"
 
+/** \brief Feature flags used to specialize a shader source at compile time. Each flag is turned into a #define (see Shader::featureDefines)*/
+enum ShaderFeature
+{
+    SHADER_UNLIT       = 1 << 0, /*!< No lighting at all : only the texture modulated by the ambient term (self-lit bodies, sky)*/
+    SHADER_NO_SPECULAR = 1 << 1, /*!< Ambient + diffuse only, the Phong pow() is skipped*/
+    SHADER_INSTANCED   = 1 << 2, /*!< The model matrix comes from the per-instance attribute vInstanceModel instead of uniforms*/
+    SHADER_UNIFORM_BUFFERS = 1 << 3, /*!< The frame, material and object data come from std140 uniform blocks (GL_ARB_uniform_buffer_object)*/
+    SHADER_PARTICLES   = 1 << 4, /*!< Camera-facing quads : vPosition is a corner, the center, width and color come from vInstancePositionSize and vInstanceColor*/
+    SHADER_LOG_DEPTH   = 1 << 5, /*!< The depth is log2(1 + distance) (DEPTH_LOGARITHMIC, see DepthRange)*/
+    SHADER_ECLIPSES    = 1 << 6, /*!< The light is dimmed by the part of its disc hidden by the occluders of the object (see Eclipses)*/
+    SHADER_WEIGHTED_BLENDED = 1 << 7, /*!< Writes the weighted color and alpha into the two targets of WeightedBlending instead of gl_FragColor*/
+    SHADER_IMPOSTORS   = 1 << 8  /*!< With SHADER_INSTANCED : each instance is a sphere ray cast on a camera-facing quad of 4 vertices (from gl_VertexID, GL_TRIANGLE_STRIP).
+                                      The sphere of radius 0.5 transformed by vInstanceModel, with the UVs of StaticSphere<32, 32> and the exact depth*/
+};
+
+/** \brief The fixed attribute locations, bound before linking. A vertex array object is thus valid for every program*/
+enum VertexAttribute
+{
+    ATTRIB_POSITION       = 0, /*!< vPosition*/
+    ATTRIB_NORMAL         = 1, /*!< vNormal*/
+    ATTRIB_UV             = 2, /*!< vUV*/
+    ATTRIB_INSTANCE_MODEL = 3, /*!< vInstanceModel, a mat4 : uses the locations 3 to 6*/
+    ATTRIB_INSTANCE_PARTICLE = 7, /*!< vInstancePositionSize*/
+    ATTRIB_INSTANCE_COLOR = 8  /*!< vInstanceColor*/
+};
+
+/** \brief The fixed binding points of the uniform blocks*/
+enum UniformBlockBinding
+{
+    BLOCK_FRAME    = 0, /*!< FrameBlock : view, projection, camera and light. Written once per frame*/
+    BLOCK_MATERIAL = 1, /*!< MaterialBlock : the array of every material*/
+    BLOCK_OBJECT   = 2  /*!< ObjectBlock : matrices and material index of one draw*/
+};
+
 /** \brief A graphic program.*/
 class Shader
 {
@@ -31,6 +68,10 @@ class Shader
          * \return the fragment ID */
         int getFragID() const;
 
+        /** \brief exchange the graphic objects of two shaders. Used to replace a program in place without invalidating the Shader pointers.
+         * \param other the shader to exchange with */
+        void swap(Shader& other);
+
         /** \brief create a shader from a vertex and a fragment file.
          * \param vertexFile the vertex file.
          * \param fragmentFile the fragment file.
@@ -45,6 +86,25 @@ class Shader
          * \return the Shader constructed or NULL if error
          * */
         static Shader* loadFromStrings(const std::string& vertexString, const std::string& fragString);
+
+        /** \brief create a specialized shader from a vertex and a fragment string.
+         * \param vertexString the vertex string.
+         * \param fragmentString the fragment string.
+         * \param features the ShaderFeature flags to #define in both sources.
+         *
+         * \return the Shader constructed or NULL if error
+         * */
+        static Shader* loadFromStrings(const std::string& vertexString, const std::string& fragString, uint32_t features);
+
+        /** \brief get the #define lines corresponding to a set of features.
+         * \param features the ShaderFeature flags
+         * \return the preprocessor lines, one per flag */
+        static std::string featureDefines(uint32_t features);
+
+        /** \brief read a whole file.
+         * \param file the file to read, opened in "r" mode
+         * \return the content of the file */
+        static std::string readFile(FILE* file);
     private:
         GLuint m_programID; /*!< The shader   program ID*/
         GLuint m_vertexID;  /*!< The vertex   shader  ID*/
@@ -53,6 +113,9 @@ class Shader
         /* \brief Bind the attributes to known locations (vPosition to 0, vColor to 1 for example)*/
         virtual void bindAttributes();
 
+        /* \brief Bind the uniform blocks found in the linked program to their UniformBlockBinding*/
+        void bindUniformBlocks();
+
         /** \brief Bind the attributes key string by an ID 
          * \param code the attribute name
          * \param type the type of this attribute (vertex, fragment, etc.)*/
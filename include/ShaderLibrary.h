@@ -0,0 +1,61 @@
+#ifndef  SHADERLIBRARY_INC
+#define  SHADERLIBRARY_INC
+
+#include <map>
+#include <string>
+#include "Shader.h"
+
+/** \brief The permutations of one vertex/fragment source pair.
+ * Each variant is compiled with its ShaderFeature flags #defined, on first use, and cached by this feature key.*/
+class ShaderLibrary
+{
+    public:
+        /** \brief Constructor. Nothing is compiled before the first call to get.
+         * \param vertexString the vertex source, containing the #ifdef of every feature.
+         * \param fragString the fragment source, containing the #ifdef of every feature.*/
+        ShaderLibrary(const std::string& vertexString, const std::string& fragString);
+
+        /* \brief Destructor. Destroy every compiled variant */
+        ~ShaderLibrary();
+
+        /** \brief create a library from a vertex and a fragment file.
+         * \param vertexFile the vertex file.
+         * \param fragFile the fragment file.
+         *
+         * \return the library constructed */
+        static ShaderLibrary* loadFromFiles(FILE* vertexFile, FILE* fragFile);
+
+        /** \brief create a library from a vertex and a fragment path. The paths are kept so that the library can be reloaded.
+         * \param vertexPath the vertex file path.
+         * \param fragPath the fragment file path.
+         *
+         * \return the library constructed or NULL if a file cannot be opened */
+        static ShaderLibrary* loadFromPaths(const std::string& vertexPath, const std::string& fragPath);
+
+        /** \brief re-read the source files and recompile every cached variant. The new programs are swapped into the existing Shader objects
+         * only if ALL the variants compile, otherwise the previous programs are kept. Must be called on the GL thread, between two frames.
+         * \return true if the new sources are in use */
+        bool reload();
+
+        /** \brief tell whether a file is one of the sources of this library
+         * \param fileName the file name, without directory
+         * \return true if the vertex or the fragment path ends with fileName */
+        bool usesFile(const std::string& fileName) const;
+
+        /** \brief get the variant compiled for a set of features. Compile it if it is not in the cache yet.
+         * \param features the ShaderFeature flags of the variant
+         * \return the variant or NULL if it does not compile (the failure is cached too) */
+        Shader* get(uint32_t features);
+
+        /** \brief get how many variants were requested so far
+         * \return the number of variants in the cache */
+        size_t getNbVariants() const {return m_variants.size();}
+    private:
+        std::string m_vertexString; /*!< The vertex   source, before specialization*/
+        std::string m_fragString;   /*!< The fragment source, before specialization*/
+        std::string m_vertexPath;   /*!< The vertex   file, empty if the library was not loaded from paths*/
+        std::string m_fragPath;     /*!< The fragment file, empty if the library was not loaded from paths*/
+        std::map<uint32_t, Shader*> m_variants; /*!< The compiled variants, per feature key*/
+};
+
+#endif
@@ -0,0 +1,33 @@
+#ifndef  SHADERWATCHER_INC
+#define  SHADERWATCHER_INC
+
+#include <string>
+#include <vector>
+
+/** \brief Watch a shader directory for modified files (inotify on Linux).
+ * Nothing is done in the background : the owner polls the watcher at the frame boundary and reloads what changed.*/
+class ShaderWatcher
+{
+    public:
+        /** \brief Constructor. Start watching the directory
+         * \param directory the directory containing the shader sources */
+        ShaderWatcher(const std::string& directory);
+
+        /* \brief Destructor. Stop watching */
+        ~ShaderWatcher();
+
+        /** \brief tell whether the directory is really watched (it is not on unsupported platforms or if the directory does not exist)
+         * \return true if poll can report changes */
+        bool isWatching() const {return m_fd >= 0;}
+
+        /** \brief get the files written since the last call. Never blocks.
+         * \param changedFiles filled with the names (without directory) of the files written or moved into the directory. Each name appears once.
+         * \return true if at least one file changed */
+        bool poll(std::vector<std::string>& changedFiles);
+    private:
+        std::string m_directory; /*!< The watched directory*/
+        int m_fd    = -1;        /*!< The inotify instance*/
+        int m_watch = -1;        /*!< The watch descriptor of m_directory*/
+};
+
+#endif
@@ -0,0 +1,63 @@
+#ifndef  SKYBOX_INC
+#define  SKYBOX_INC
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <stdint.h>
+#include "ShaderLibrary.h"
+
+/** \brief The background at infinity : a cube map drawn by a single full screen triangle at the far depth, after the opaque objects.
+ * The depth test only lets it through where nothing was drawn : each pixel of the background is a single texture fetch, without lighting
+ * nor overdraw. The cube map is converted at load time from an equirectangular image, mapped like the texture of a Sphere
+ * (u along the longitude from +z towards +x, v from the north pole +y).*/
+class Skybox
+{
+    public:
+        /** \brief create the cube map from an equirectangular image and load the shader
+         * \param rgba the pixels of the image, 4 bytes per pixel, the first row at the north pole
+         * \param width the width of the image
+         * \param height the height of the image
+         * \param faceSize the resolution of a face of the cube map
+         * \param farDepth the normalized device depth where the depth buffer is cleared (DepthRange::getFarDepth)
+         * \param vertexPath the vertex shader of the sky
+         * \param fragPath the fragment shader of the sky
+         * \return the Skybox or NULL if error */
+        static Skybox* create(const uint8_t* rgba, uint32_t width, uint32_t height, uint32_t faceSize, float farDepth,
+                              const char* vertexPath, const char* fragPath);
+
+        /** \brief resample an equirectangular image into the 6 faces of a cube map, with bilinear filtering
+         * \param rgba the pixels of the image, 4 bytes per pixel, the first row at the north pole
+         * \param width the width of the image
+         * \param height the height of the image
+         * \param faceSize the resolution of a face
+         * \param faces filled with the 6 faces in the order of GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, faceSize * faceSize * 4 bytes each */
+        static void equirectangularToCube(const uint8_t* rgba, uint32_t width, uint32_t height, uint32_t faceSize, uint8_t* faces);
+
+        /* \brief Destructor. Destroy the cube map and the shader */
+        ~Skybox();
+
+        /** \brief set the view of the next draws
+         * \param viewProjection the projection and the view of the camera (the camera at the origin, the standard projection)
+         * \param rotation the orientation of the sky in the world
+         * \param color the color the texture is multiplied by */
+        void setView(const glm::mat4& viewProjection, const glm::mat3& rotation, const glm::vec3& color);
+
+        /** \brief draw the sky behind what was drawn, without depth writes. The program, the vertex array and the texture are unbound */
+        void draw() const;
+
+        /** \brief get the sources of the sky shader, to reload them when they change (see ShaderWatcher)
+         * \return the library of its single variant */
+        ShaderLibrary* getShaders() const {return m_shaders;}
+    private:
+        /** \brief the constructor. Should never be called alone (use create)*/
+        Skybox() {}
+
+        GLuint         m_cubeMap   = 0;
+        GLuint         m_vao       = 0;    /*!< Without any attribute : the full screen triangle comes from gl_VertexID*/
+        ShaderLibrary* m_shaders   = NULL; /*!< Only the variant 0 is used*/
+        float          m_farDepth  = 1.0f; /*!< Normalized device depth where the depth buffer is cleared*/
+        glm::mat4      m_clipToSky = glm::mat4(1.0f); /*!< From the far plane in clip space to a direction in the frame of the cube map*/
+        glm::vec3      m_color     = glm::vec3(1.0f);
+};
+
+#endif
@@ -0,0 +1,194 @@
+#ifndef  STATICGEOMETRY_INC
+#define  STATICGEOMETRY_INC
+
+#include "Geometry.h"
+
+/** \brief Geometries generated by the compiler. Their arrays are constexpr data placed in the read-only segment of the program :
+ * constructing one costs neither computation nor allocation, and the Geometry only points to them (copies point to them too).
+ * The common tessellations should use these classes, the runtime ones (Sphere, Cylinder...) remain for the other resolutions.*/
+namespace staticgeometry
+{
+    constexpr double PI = 3.14159265358979323846;
+
+    /* \brief sin, usable in constant expressions (std::sin is not constexpr). Taylor series after the reduction to [-pi/2, pi/2] */
+    constexpr double sin(double x)
+    {
+        x -= 2.0 * PI * (double)(int64_t)(x / (2.0 * PI));
+        if(x > PI)
+            x -= 2.0 * PI;
+        else if(x < -PI)
+            x += 2.0 * PI;
+        if(x > 0.5 * PI)
+            x = PI - x;
+        else if(x < -0.5 * PI)
+            x = -PI - x;
+
+        double term = x, sum = x;
+        for(int k = 1; k < 15; k++)
+        {
+            term *= -x * x / ((2 * k) * (2 * k + 1));
+            sum  += term;
+        }
+        return sum;
+    }
+
+    constexpr double cos(double x)
+    {
+        return sin(x + 0.5 * PI);
+    }
+
+    /* \brief sqrt, usable in constant expressions. Newton iterations */
+    constexpr double sqrt(double x)
+    {
+        if(x <= 0.0)
+            return 0.0;
+        double r = x > 1.0 ? x : 1.0;
+        for(int i = 0; i < 100; i++)
+        {
+            double next = 0.5 * (r + x / r);
+            if(next >= r)
+                break;
+            r = next;
+        }
+        return r;
+    }
+
+    /* \brief The arrays of a Geometry, same layout */
+    template<uint32_t NbVertices>
+    struct MeshData
+    {
+        float vertices[3 * NbVertices] = {};
+        float normals[3 * NbVertices]  = {};
+        float uvs[2 * NbVertices]      = {};
+        float boundingCenter[3]        = {};
+        float boundingRadius           = 0.0f;
+    };
+
+    /* \brief Same bounding sphere as Geometry::computeBoundingSphere */
+    template<uint32_t NbVertices>
+    constexpr void computeBoundingSphere(MeshData<NbVertices>& data)
+    {
+        float minPos[3] = {data.vertices[0], data.vertices[1], data.vertices[2]};
+        float maxPos[3] = {data.vertices[0], data.vertices[1], data.vertices[2]};
+        for(uint32_t i = 1; i < NbVertices; i++)
+            for(uint32_t j = 0; j < 3; j++)
+            {
+                if(data.vertices[3*i+j] < minPos[j]) minPos[j] = data.vertices[3*i+j];
+                if(data.vertices[3*i+j] > maxPos[j]) maxPos[j] = data.vertices[3*i+j];
+            }
+
+        for(uint32_t j = 0; j < 3; j++)
+            data.boundingCenter[j] = 0.5f*(minPos[j]+maxPos[j]);
+
+        float radius2 = 0.0f;
+        for(uint32_t i = 0; i < NbVertices; i++)
+        {
+            float d2 = 0.0f;
+            for(uint32_t j = 0; j < 3; j++)
+                d2 += (data.vertices[3*i+j]-data.boundingCenter[j])*(data.vertices[3*i+j]-data.boundingCenter[j]);
+            if(d2 > radius2)
+                radius2 = d2;
+        }
+        data.boundingRadius = (float)sqrt(radius2);
+    }
+
+    /* \brief The triangles of Sphere(NbLatitude, NbLongitude), same order and same values (the normals are computed in double) */
+    template<uint32_t NbLatitude, uint32_t NbLongitude>
+    constexpr MeshData<NbLongitude*(NbLatitude-1)*6> makeSphere()
+    {
+        MeshData<NbLongitude*(NbLatitude-1)*6> data;
+        const double radius = 0.5;
+        for(uint32_t i = 0; i < NbLongitude; i++)
+        {
+            for(uint32_t j = 0; j < NbLatitude-1; j++)
+            {
+                /* The grid points of the two triangles of the quad (i, j) */
+                uint32_t next = (i+1) % NbLongitude;
+                uint32_t corners[6][2] = {{i, j}, {next, j+1}, {next, j}, {i, j}, {i, j+1}, {next, j+1}};
+                for(uint32_t k = 0; k < 6; k++)
+                {
+                    uint32_t lon = corners[k][0], lat = corners[k][1];
+                    double theta = 2*PI/(NbLongitude-1) * lon;
+                    double phi   = PI/(NbLatitude-1) * lat;
+                    double pos[] = {sin(phi)*sin(theta), cos(phi), cos(theta)*sin(phi)};
+                    uint32_t v = (NbLatitude-1)*i*6 + j*6 + k;
+                    for(uint32_t c = 0; c < 3; c++)
+                    {
+                        data.vertices[3*v+c] = (float)(radius*(float)pos[c]);
+                        data.normals[3*v+c]  = (float)pos[c];
+                    }
+                    data.uvs[2*v+0] = (float)(lon/(double)NbLongitude);
+                    data.uvs[2*v+1] = (float)(lat/(double)NbLatitude);
+                }
+            }
+        }
+        computeBoundingSphere(data);
+        return data;
+    }
+
+    /* \brief The triangles of a unit cube centered on the origin, two per face */
+    constexpr MeshData<36> makeCube()
+    {
+        MeshData<36> data;
+        /* Per face : the axis and the sign of the normal, the 6 corners and their UVs */
+        const float normals[6][2] = {{2, -1}, {2, 1}, {0, -1}, {0, 1}, {1, 1}, {1, -1}};
+        const float corners[6][6][3] = {
+            {{-0.5f, -0.5f, -0.5f}, { 0.5f, -0.5f, -0.5f}, { 0.5f,  0.5f, -0.5f}, {-0.5f, -0.5f, -0.5f}, { 0.5f,  0.5f, -0.5f}, {-0.5f,  0.5f, -0.5f}}, //Front
+            {{-0.5f, -0.5f,  0.5f}, { 0.5f,  0.5f,  0.5f}, { 0.5f, -0.5f,  0.5f}, {-0.5f, -0.5f,  0.5f}, {-0.5f,  0.5f,  0.5f}, { 0.5f,  0.5f,  0.5f}}, //Back
+            {{-0.5f, -0.5f,  0.5f}, {-0.5f, -0.5f, -0.5f}, {-0.5f,  0.5f, -0.5f}, {-0.5f, -0.5f,  0.5f}, {-0.5f,  0.5f, -0.5f}, {-0.5f,  0.5f,  0.5f}}, //Left
+            {{ 0.5f, -0.5f,  0.5f}, { 0.5f,  0.5f, -0.5f}, { 0.5f, -0.5f, -0.5f}, { 0.5f, -0.5f,  0.5f}, { 0.5f,  0.5f,  0.5f}, { 0.5f,  0.5f, -0.5f}}, //Right
+            {{ 0.5f,  0.5f, -0.5f}, {-0.5f,  0.5f, -0.5f}, {-0.5f,  0.5f,  0.5f}, { 0.5f,  0.5f, -0.5f}, {-0.5f,  0.5f,  0.5f}, { 0.5f,  0.5f,  0.5f}}, //Top
+            {{ 0.5f, -0.5f, -0.5f}, {-0.5f, -0.5f,  0.5f}, {-0.5f, -0.5f, -0.5f}, { 0.5f, -0.5f, -0.5f}, { 0.5f, -0.5f,  0.5f}, {-0.5f, -0.5f,  0.5f}}};//Bottom
+        const float uvs[6][6][2] = {
+            {{0, 0}, {1, 0}, {1, 1}, {0, 0}, {1, 1}, {0, 1}},
+            {{0, 0}, {1, 1}, {1, 0}, {0, 0}, {0, 1}, {1, 1}},
+            {{0, 1}, {0, 0}, {1, 0}, {0, 1}, {1, 0}, {1, 1}},
+            {{0, 1}, {1, 0}, {0, 0}, {0, 1}, {1, 1}, {1, 0}},
+            {{1, 0}, {0, 0}, {0, 1}, {1, 0}, {0, 1}, {1, 1}},
+            {{1, 0}, {0, 1}, {0, 0}, {1, 0}, {1, 1}, {0, 1}}};
+        for(uint32_t f = 0; f < 6; f++)
+            for(uint32_t k = 0; k < 6; k++)
+            {
+                uint32_t v = 6*f + k;
+                for(uint32_t c = 0; c < 3; c++)
+                {
+                    data.vertices[3*v+c] = corners[f][k][c];
+                    data.normals[3*v+c]  = c == (uint32_t)normals[f][0] ? normals[f][1] : 0.0f;
+                }
+                data.uvs[2*v+0] = uvs[f][k][0];
+                data.uvs[2*v+1] = uvs[f][k][1];
+            }
+        computeBoundingSphere(data);
+        return data;
+    }
+}
+
+/** \brief Sphere(NbLatitude, NbLongitude), generated at compile time*/
+template<uint32_t NbLatitude, uint32_t NbLongitude>
+class StaticSphere : public Geometry
+{
+    static_assert(NbLatitude >= 2 && NbLongitude >= 2, "A sphere needs at least 2 latitudes and 2 longitudes");
+    public:
+        static constexpr uint32_t NB_VERTICES = NbLongitude*(NbLatitude-1)*6;
+        static constexpr float    U_SCALE = (NbLongitude-1) / (float)NbLongitude; /*!< The u of the seam : the texture does not wrap around*/
+        static constexpr float    V_SCALE = (NbLatitude-1) / (float)NbLatitude;   /*!< The v of the south pole*/
+
+        /* \brief Constructor. Points to the static arrays */
+        StaticSphere() : Geometry(s_data.vertices, s_data.normals, s_data.uvs, NB_VERTICES, s_data.boundingCenter, s_data.boundingRadius)
+        {}
+    private:
+        static constexpr staticgeometry::MeshData<NB_VERTICES> s_data = staticgeometry::makeSphere<NbLatitude, NbLongitude>();
+};
+
+/** \brief A unit cube centered on the origin, generated at compile time*/
+class StaticCube : public Geometry
+{
+    public:
+        /* \brief Constructor. Points to the static arrays */
+        StaticCube() : Geometry(s_data.vertices, s_data.normals, s_data.uvs, 36, s_data.boundingCenter, s_data.boundingRadius)
+        {}
+    private:
+        static constexpr staticgeometry::MeshData<36> s_data = staticgeometry::makeCube();
+};
+
+#endif
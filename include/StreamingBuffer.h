@@ -0,0 +1,92 @@
+#ifndef  STREAMINGBUFFER_INC
+#define  STREAMINGBUFFER_INC
+
+#include <GL/glew.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+#define STREAMING_FRAMES    3   /*!< Frame regions of the buffer : the CPU writes one while the GPU may still read the others*/
+#define STREAMING_ALIGNMENT 256 /*!< The regions start on this boundary, enough for every allocation alignment*/
+#define STREAMING_DEFAULT_ALIGNMENT 16 /*!< Alignment of the allocations which do not ask for another one (vertex attributes)*/
+
+/** \brief Per-frame data streamed to the GPU (uniform blocks, instance attributes) from one buffer split in STREAMING_FRAMES regions.
+ * With GL_ARB_buffer_storage and GL_ARB_sync, the buffer is mapped once, persistently and coherently : an allocation is a pointer bump
+ * in the region of the frame and the CPU writes where the GPU reads, without copy nor driver synchronization. A fence placed after
+ * the commands of each frame guards its region, which is only rewritten once the GPU is done with it.
+ * Otherwise (OpenGL 3.0) the allocations are written in memory and uploaded by flush into the buffer, orphaned at each frame.*/
+class StreamingBuffer
+{
+    public:
+        /** \brief Constructor. Create and map the buffer
+         * \param frameSize the bytes which can be allocated per frame */
+        StreamingBuffer(GLsizeiptr frameSize);
+
+        /* \brief Destructor. Unmap and destroy the buffer */
+        ~StreamingBuffer();
+
+        /** \brief start a frame : fence the previous one, then move to the next region and wait until the GPU stopped reading it.
+         * With enough regions the fence is already signaled and nothing waits
+         * \param frameSize the bytes needed by this frame. The buffer grows (once the GPU is done with all of it) if they do not fit */
+        void beginFrame(GLsizeiptr frameSize = 0);
+
+        /** \brief allocate memory in the region of the frame
+         * \param size the size in bytes
+         * \param offset filled with the offset of the allocation in getBuffer()
+         * \param alignment the alignment of the offset, a power of two up to STREAMING_ALIGNMENT
+         * \return where to write the data, NULL if the frame region is full */
+        void* allocate(GLsizeiptr size, GLintptr& offset, GLsizeiptr alignment = STREAMING_DEFAULT_ALIGNMENT);
+
+        /** \brief get the room an allocation can take in a region, its alignment padding included.
+         * Allocations of the same alignment always fit in the sum of their rooms : that sum is the frameSize to give to beginFrame
+         * \param size the size in bytes of the allocation
+         * \param alignment its alignment, as given to allocate
+         * \return size rounded up to the alignment */
+        static GLsizeiptr getAllocationSize(GLsizeiptr size, GLsizeiptr alignment = STREAMING_DEFAULT_ALIGNMENT)
+        {
+            return (size + alignment - 1) & ~(alignment - 1);
+        }
+
+        /** \brief make the data written since the previous flush visible to the next draws. Nothing to do with the persistent mapping */
+        void flush();
+
+        /** \brief get the OpenGL buffer, to bind to any target
+         * \return the buffer */
+        GLuint getBuffer() const {return m_buffer;}
+
+        /** \brief get the capacity of a frame region
+         * \return the size in bytes */
+        GLsizeiptr getFrameSize() const {return m_frameSize;}
+
+        /** \brief tell whether the buffer is persistently mapped
+         * \return false if the orphaning fallback is used */
+        bool isPersistent() const {return m_mapping != NULL;}
+
+        /** \brief get the number of frames which had to wait for the GPU to release their region
+         * \return the number of waits */
+        uint32_t getNbWaits() const {return m_nbWaits;}
+
+        /** \brief get the largest number of bytes allocated in a frame
+         * \return the size in bytes */
+        GLsizeiptr getPeakUsage() const {return m_peakUsage;}
+    private:
+        /* \brief Create the buffer (and its mapping) for regions of frameSize bytes */
+        void create(GLsizeiptr frameSize);
+
+        /* \brief Wait until the GPU signaled a fence, then delete it */
+        void waitFence(uint32_t region);
+
+        GLuint     m_buffer    = 0;
+        uint8_t*   m_mapping   = NULL;  /*!< The persistent mapping of the STREAMING_FRAMES regions, NULL with the fallback*/
+        std::vector<uint8_t> m_staging; /*!< Fallback : the allocations of the frame, uploaded by flush*/
+        GLsync     m_fences[STREAMING_FRAMES] = {};
+        GLsizeiptr m_frameSize = 0;     /*!< Capacity of a region, a multiple of STREAMING_ALIGNMENT*/
+        uint32_t   m_region    = 0;     /*!< Region of the current frame*/
+        GLsizeiptr m_head      = 0;     /*!< Bytes allocated in the current region*/
+        GLsizeiptr m_flushed   = 0;     /*!< Fallback : bytes of the current region already uploaded*/
+        bool       m_started   = false; /*!< Whether a frame was started (and has to be fenced by the next one)*/
+        uint32_t   m_nbWaits   = 0;
+        GLsizeiptr m_peakUsage = 0;
+};
+
+#endif
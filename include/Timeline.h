@@ -0,0 +1,114 @@
+#ifndef  TIMELINE_INC
+#define  TIMELINE_INC
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include "GameObject.h"
+#include "Scene.h"
+
+#define TIMELINE_MAX_COMPONENTS 7 /*!< Values of a key of the largest property (material)*/
+
+/** \brief What a track animates on its node*/
+enum TimelineProperty
+{
+    TIMELINE_POSITION = 0, /*!< x, y, z : GameObject::position*/
+    TIMELINE_ROTATION = 1, /*!< axis x, y, z and angle (radians) : GameObject::propagatedMatrix. The angle can span several turns between two keys*/
+    TIMELINE_SCALE    = 2, /*!< x, y, z : GameObject::localMatrix*/
+    TIMELINE_MATERIAL = 3  /*!< r, g, b, ka, kd, ks, alpha : GameObject::sphereMtl (the shader features are kept)*/
+};
+
+/** \brief How the values between two keys are computed*/
+enum TimelineInterpolation
+{
+    TIMELINE_STEP   = 0, /*!< The value of the previous key. Each key of a transform track is a cut : the node jumps there*/
+    TIMELINE_LINEAR = 1,
+    TIMELINE_SPLINE = 2  /*!< Catmull-Rom : goes through the keys with continuous derivatives*/
+};
+
+/* \brief A named instant of the timeline, handled by the application */
+struct TimelineEvent
+{
+    double      time;
+    const char* name; /*!< Valid as long as the Timeline*/
+};
+
+/* \brief The keys of one property of one node. They are stored in the arrays of the Timeline */
+struct TimelineTrack
+{
+    uint32_t              node;          /*!< Index of the node in the Scene (and of its GameObject)*/
+    TimelineProperty      property;
+    TimelineInterpolation interpolation;
+    uint32_t              firstKey;      /*!< In Timeline::m_times*/
+    uint32_t              nbKeys;
+    uint32_t              firstValue;    /*!< In Timeline::m_values, nbKeys * components values*/
+    uint32_t              cursor;        /*!< Key before the last evaluated time, relative to firstKey*/
+};
+
+/** \brief Keyframe animation of the nodes of a Scene, loaded from a text file (see Scenes/asteroid.timeline).
+ * The keys of all the tracks are stored in two contiguous arrays. Each track keeps a cursor on the key of the last evaluation :
+ * playing forward moves it by one key at most per call, so an evaluation is O(number of tracks). seek places the cursors anywhere.
+ * A track does nothing before its first key and holds its last value after its last key.*/
+class Timeline
+{
+    public:
+        /** \brief parse a timeline
+         * \param path the file
+         * \param scene the scene whose nodes are animated (resolved by name)
+         * \return the Timeline loaded or NULL if error */
+        static Timeline* load(const std::string& path, const Scene& scene);
+
+        /** \brief place the cursors at a time, without firing the events before it
+         * \param time the time, in simulation steps */
+        void seek(double time);
+
+        /** \brief apply every track at a time, and queue the events reached since the previous evaluation.
+         * Going back in time is a seek, which cuts every node with a transform track
+         * \param time the time, in simulation steps
+         * \param objects the objects of the scene, in the node order (see Scene::instantiate) */
+        void evaluate(double time, std::vector<GameObject>& objects);
+
+        /** \brief get the next event reached by evaluate, in time order
+         * \param event filled with the event
+         * \return false if there is no more event */
+        bool pollEvent(TimelineEvent& event);
+
+        /** \brief get the nodes cut by the last evaluate : a step track of their position, rotation or scale reached one of its keys.
+         * They and their descendants jumped there instead of moving continuously
+         * \return the indices of the nodes, each one once */
+        const std::vector<uint32_t>& getCuts() const {return m_cuts;}
+
+        uint32_t getNbTracks() const {return m_tracks.size();}
+
+        /** \brief get the time of the last key or event
+         * \return the duration */
+        double getDuration() const {return m_duration;}
+
+        /** \brief get the number of values of a key of a property
+         * \param property the TimelineProperty
+         * \return the number of components */
+        static uint32_t getNbComponents(TimelineProperty property);
+    private:
+        /** \brief the constructor. Should never be called alone (use load)*/
+        Timeline() {}
+
+        /* \brief Compute the value of a track at a time, its cursor being on the right key */
+        void interpolate(const TimelineTrack& track, double time, double* value) const;
+
+        std::vector<TimelineTrack> m_tracks;
+        std::vector<double>        m_times;  /*!< Key times, track after track*/
+        std::vector<double>        m_values; /*!< Key values, track after track*/
+
+        std::vector<double>   m_eventTimes;  /*!< Sorted*/
+        std::vector<uint32_t> m_eventNames;  /*!< Offsets in m_strings*/
+        std::vector<char>     m_strings;
+        uint32_t m_eventCursor = 0;          /*!< First event not reached yet*/
+        uint32_t m_nextEvent   = 0;          /*!< First event reached but not polled*/
+
+        std::vector<uint32_t> m_cuts;        /*!< Nodes cut by the last evaluate*/
+
+        double m_lastTime = -1e300;
+        double m_duration = 0.0;
+};
+
+#endif
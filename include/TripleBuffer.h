@@ -0,0 +1,61 @@
+#ifndef  TRIPLEBUFFER_INC
+#define  TRIPLEBUFFER_INC
+
+#include <stdint.h>
+#include <atomic>
+
+/** \brief Lock-free handoff of the latest state from one producer thread to one consumer thread.
+ * The producer fills the write buffer and publishes it, the consumer acquires the latest published one : the two buffers
+ * they hold are never the same, and the third is exchanged with a single atomic operation. Neither side ever waits for the other.
+ * A state published again before being acquired replaces the previous one (which is dropped).*/
+template<typename T>
+class TripleBuffer
+{
+    public:
+        /* \brief Constructor. Nothing is published */
+        TripleBuffer() : m_middle(1) {}
+
+        /** \brief get the buffer to fill. Producer only. It keeps what was written in it two publications ago
+         * \return the write buffer */
+        T& getWriteBuffer() {return m_buffers[m_write];}
+
+        /** \brief hand the write buffer to the consumer and take the previous middle one as the new write buffer. Producer only
+         * \return false if the previous publication was never acquired (dropped) */
+        bool publish()
+        {
+            /* release : the content of the buffer is visible to the consumer which acquires it */
+            uint32_t previous = m_middle.exchange(m_write | FRESH, std::memory_order_acq_rel);
+            m_write = previous & INDEX;
+            return !(previous & FRESH);
+        }
+
+        /** \brief whether a published buffer was not acquired yet. Either side
+         * \return true if the consumer has something new */
+        bool isPending() const {return m_middle.load(std::memory_order_acquire) & FRESH;}
+
+        /** \brief take the latest published buffer, if any since the previous call. Consumer only
+         * \return false if nothing new was published : the read buffer is unchanged */
+        bool acquire()
+        {
+            if(!(m_middle.load(std::memory_order_relaxed) & FRESH))
+                return false;
+            /* acquire : the content written before publish is visible */
+            uint32_t previous = m_middle.exchange(m_read, std::memory_order_acq_rel);
+            m_read = previous & INDEX;
+            return true;
+        }
+
+        /** \brief get the buffer acquired last. Consumer only
+         * \return the read buffer (default constructed before the first acquire) */
+        const T& getReadBuffer() const {return m_buffers[m_read];}
+    private:
+        static const uint32_t INDEX = 3; /*!< Mask of the buffer index in m_middle*/
+        static const uint32_t FRESH = 4; /*!< Set in m_middle by publish, cleared by acquire*/
+
+        T m_buffers[3];
+        std::atomic<uint32_t> m_middle;    /*!< Index of the buffer exchanged between the threads, and the FRESH flag*/
+        alignas(64) uint32_t  m_write = 0; /*!< Owned by the producer. Not on the cache line of the consumer*/
+        alignas(64) uint32_t  m_read  = 2; /*!< Owned by the consumer*/
+};
+
+#endif
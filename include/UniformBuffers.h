@@ -0,0 +1,99 @@
+#ifndef  UNIFORMBUFFERS_INC
+#define  UNIFORMBUFFERS_INC
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <stdint.h>
+#include <vector>
+#include "GameObject.h"
+#include "Shader.h"
+#include "StreamingBuffer.h"
+
+/* \brief std140 layout of the FrameBlock uniform block */
+struct FrameUniforms
+{
+    glm::mat4 view;
+    glm::mat4 projection;
+    glm::mat4 viewProjection;
+    glm::vec4 cameraPosition; /*!< w unused*/
+    glm::vec4 lightPosition;  /*!< w : radius of the light source (see Eclipses::getLightRadius)*/
+    glm::vec4 lightColor;     /*!< w unused*/
+    glm::vec4 depthParams;    /*!< See DepthRange::getParams*/
+};
+
+/* \brief std140 layout of one element of the MaterialBlock array */
+struct MaterialUniforms
+{
+    glm::vec4 color; /*!< w unused*/
+    glm::vec4 cts;   /*!< ka, kd, ks, alpha*/
+};
+
+/* \brief std140 layout of the ObjectBlock uniform block */
+struct ObjectUniforms
+{
+    glm::mat4 mvp;
+    glm::mat4 model;
+    glm::vec4 invModel3x3[3]; /*!< A std140 mat3 is stored as three vec4 columns*/
+    int32_t   material[4];    /*!< x : index in the MaterialBlock array, y : number of occluders*/
+    glm::vec4 occluders[SHADER_MAX_OCCLUDERS]; /*!< Camera-relative spheres (center, radius) which can hide the light (SHADER_ECLIPSES)*/
+};
+
+/** \brief The uniform buffer objects shared by every program :
+ * a per-material array uploaded when it changes, and the per-frame and per-object blocks sub-allocated in a StreamingBuffer.
+ * When it is persistently mapped, each frame writes its own region, fenced at the start of the next frame : a region is written again
+ * only after the GPU signaled the fence of the frame which used it. Without the mapping, the buffer is orphaned every frame.*/
+class UniformBuffers
+{
+    public:
+        /** \brief Constructor. Create the buffers and bind the material block.
+         * \param nbObjects the object blocks the frame regions are first sized for. They grow when a frame needs more */
+        UniformBuffers(uint32_t nbObjects);
+
+        /* \brief Destructor. Destroy the buffers */
+        ~UniformBuffers();
+
+        /** \brief tell whether the uniform blocks can be used with the current context
+         * \return true if GL_ARB_uniform_buffer_object is supported */
+        static bool isSupported();
+
+        /** \brief start a frame : fence the draws of the previous one, move to the next region of the streaming buffer
+         * (waiting for the GPU if it still reads it, growing it if the frame does not fit), write the per-frame block
+         * and reserve the object blocks. Called once per frame, before its first setObject
+         * \param frame the per-frame data
+         * \param nbObjects the number of object blocks of the frame */
+        void beginFrame(const FrameUniforms& frame, uint32_t nbObjects);
+
+        /** \brief get the index of a material in the MaterialBlock array. The material is added if it is not known yet :
+         * once the array is full, it replaces the material used the longest time ago (animated materials change every frame)
+         * \param mtl the material
+         * \return its index. 0 if every material of the array is used by the current frame */
+        uint32_t getMaterialIndex(const Material& mtl);
+
+        /** \brief write the data of a draw in its object block
+         * \param index the index of the block, below the nbObjects given to beginFrame
+         * \param object the per-object data */
+        void setObject(uint32_t index, const ObjectUniforms& object);
+
+        /** \brief make the blocks of the frame visible to the draws : upload the new materials and flush the object blocks.
+         * Called once, after the last setObject and before the first draw */
+        void flush();
+
+        /** \brief bind an object block to BLOCK_OBJECT
+         * \param index the index of the block, as given to setObject */
+        void bindObject(uint32_t index);
+    private:
+        GLuint           m_materialUBO  = 0;
+        StreamingBuffer* m_stream       = NULL;  /*!< The frame block and the object blocks of the frames in flight*/
+        uint32_t         m_alignment;            /*!< GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT*/
+        GLsizeiptr       m_objectStride;         /*!< Size of an object block, rounded up to m_alignment*/
+        uint8_t*         m_objects      = NULL;  /*!< Where the object blocks of the current frame are written*/
+        GLintptr         m_objectOffset = 0;     /*!< Offset of the first object block of the current frame in the buffer*/
+        uint32_t         m_nbObjects    = 0;     /*!< Object blocks of the current frame*/
+        uint64_t         m_frame        = 0;     /*!< Frames begun*/
+
+        std::vector<Material> m_materials; /*!< The materials, in the MaterialBlock order*/
+        std::vector<uint64_t> m_materialFrames; /*!< The last frame using each material*/
+        bool m_materialsDirty = false;     /*!< Whether m_materials changed since the last upload*/
+};
+
+#endif
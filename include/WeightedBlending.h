@@ -0,0 +1,49 @@
+#ifndef  WEIGHTEDBLENDING_INC
+#define  WEIGHTEDBLENDING_INC
+
+#include <GL/glew.h>
+#include <stdint.h>
+#include "Framebuffer.h"
+#include "ShaderLibrary.h"
+
+/** \brief Weighted blended order-independent transparency (McGuire and Bavoil, 2013) : the translucent surfaces are drawn in any order,
+ * without sorting, into two floating point targets sharing the depth buffer of the scene. A full screen pass then blends their average over the scene.
+ * The accumulation target sums the premultiplied colors weighted by their distance (rgb) and multiplies the transparencies (a, the revealage),
+ * the weight target sums the weighted alphas : the same blend function does both, OpenGL 3.0 is enough.
+ * The shaders of the translucent surfaces are the SHADER_WEIGHTED_BLENDED variants.*/
+class WeightedBlending
+{
+    public:
+        /** \brief create the targets of the resolution of a framebuffer and load the composition shader
+         * \param target the framebuffer of the scene : its depth buffer is shared, the composition is drawn into it
+         * \param vertexPath the vertex shader of the composition
+         * \param fragPath the fragment shader of the composition
+         * \return the WeightedBlending or NULL if error */
+        static WeightedBlending* create(Framebuffer& target, const char* vertexPath, const char* fragPath);
+
+        /* \brief Destructor. Destroy the targets and the shader */
+        ~WeightedBlending();
+
+        /** \brief draw into the cleared targets from now on, blending additively, without depth writes */
+        void begin();
+
+        /** \brief draw into the framebuffer of the scene again and blend the average translucent color over it.
+         * The program, the vertex array and the textures are unbound */
+        void composite();
+
+        /** \brief get the sources of the composition shader, to reload them when they change (see ShaderWatcher)
+         * \return the library of its single variant */
+        ShaderLibrary* getShaders() const {return m_composite;}
+    private:
+        /** \brief the constructor. Should never be called alone (use create)*/
+        WeightedBlending(Framebuffer& target) : m_target(target) {}
+
+        Framebuffer&   m_target;
+        GLuint         m_fbo          = 0;
+        GLuint         m_accumulation = 0;    /*!< RGBA16F : sum of the weighted premultiplied colors, product of the transparencies*/
+        GLuint         m_weights      = 0;    /*!< R16F : sum of the weighted alphas*/
+        GLuint         m_vao          = 0;    /*!< Without any attribute : the full screen triangle comes from gl_VertexID*/
+        ShaderLibrary* m_composite    = NULL; /*!< Only the variant 0 is used*/
+};
+
+#endif
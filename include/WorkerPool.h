@@ -0,0 +1,62 @@
+#ifndef  WORKERPOOL_INC
+#define  WORKERPOOL_INC
+
+#include <stdint.h>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+/** \brief Threads started once and woken for each parallel pass, instead of being created and joined every step.
+ * A pass runs task(t) for every t in [0, nbTasks[ : the workers and the calling thread take the tasks in turn,
+ * and run returns once all of them are done. One pass at a time : the pool is driven by a single thread.*/
+class WorkerPool
+{
+    public:
+        /** \brief Constructor. Start the workers
+         * \param nbThreads the threads of a pass, the calling one included. 0 : one per core */
+        WorkerPool(uint32_t nbThreads = 0);
+
+        /* \brief Destructor. Stop and join the workers */
+        ~WorkerPool();
+
+        /** \brief run task(t) for every t in [0, nbTasks[ on the workers and the calling thread, and wait for them
+         * \param nbTasks the number of tasks
+         * \param task called with the index of each task, from any of the threads */
+        template<typename F> void run(uint32_t nbTasks, const F& task)
+        {
+            dispatch(nbTasks, &call<F>, &task);
+        }
+
+        /** \brief get the number of threads of a pass, the calling one included
+         * \return the number of workers + 1 */
+        uint32_t getNbThreads() const {return m_threads.size() + 1;}
+    private:
+        typedef void (*TaskFunction)(const void* task, uint32_t t);
+
+        template<typename F> static void call(const void* task, uint32_t t) {(*(const F*)task)(t);}
+
+        /* \brief Wake the workers on a pass, take its tasks too and wait for the end */
+        void dispatch(uint32_t nbTasks, TaskFunction function, const void* task);
+
+        /* \brief Take the tasks of the current pass until there is none left */
+        void runTasks();
+
+        /* \brief Loop of a worker : wait for a pass, run its tasks */
+        void work();
+
+        std::vector<std::thread> m_threads;
+        std::mutex               m_mutex;
+        std::condition_variable  m_wakeCond;    /*!< A pass started or the pool is stopping*/
+        std::condition_variable  m_doneCond;    /*!< The last worker left the pass*/
+        TaskFunction             m_function = NULL;
+        const void*              m_task     = NULL;
+        uint32_t                 m_nbTasks  = 0;
+        std::atomic<uint32_t>    m_nextTask;    /*!< The next task to take in the current pass*/
+        uint32_t                 m_nbBusy   = 0; /*!< Workers still in the current pass*/
+        uint64_t                 m_pass     = 0; /*!< Incremented by each pass : the workers wait for a new value*/
+        bool                     m_stop     = false;
+};
+
+#endif
@@ -0,0 +1,34 @@
+#ifndef  WORLDTRANSFORMS_INC
+#define  WORLDTRANSFORMS_INC
+
+#include <glm/glm.hpp>
+#include <stdint.h>
+#include <vector>
+#include "GameObject.h"
+
+/** \brief The world transforms of a scene graph, composed in double precision, and their camera-relative float version.
+ * A float has 24 bits of mantissa : about 10 m at 1 AU. The positions are thus kept in double and the camera is subtracted
+ * before the conversion to float, so the GPU only sees small values around the camera.*/
+class WorldTransforms
+{
+    public:
+        /** \brief compose the transforms of every object reachable from the roots : parent * translate(position) * propagatedMatrix * localMatrix.
+         * Sets GameObject::worldPosition and the rotation and scale of GameObject::modelMatrix
+         * \param roots the root objects */
+        void update(const std::vector<GameObject*>& roots);
+
+        /** \brief set the translation of GameObject::modelMatrix of every object of the last update : its world position minus the camera.
+         * The subtractions and the conversions are done 2 objects at a time (SSE2), then scattered into the matrices
+         * \param cameraPosition the camera, in world space */
+        void rebase(const glm::dvec3& cameraPosition);
+
+        uint32_t getNbObjects() const {return m_objects.size();}
+    private:
+        /* \brief Flatten the hierarchy in depth-first order */
+        void gather(GameObject& go, const glm::dmat4& parentMatrix);
+
+        std::vector<GameObject*> m_objects;     /*!< Depth-first order of the last update*/
+        std::vector<double>      m_x, m_y, m_z; /*!< World positions, in the same order*/
+};
+
+#endif
@@ -5,6 +5,7 @@
 #include <stdio.h>
 #include <stdint.h>
 #include <string.h>
+#include <type_traits>
 
 //Colors for printf
 #define RED   "\x1B[31m"
@@ -24,16 +25,127 @@
 #define __FILENAME__ (strrchr("/" __FILE__, '/') + 1)
 #endif
 
+//Levels, for the compile-time filter : the macros of the levels above LOG_LEVEL are never called (their arguments are still type-checked)
+#define LOG_LEVEL_NONE    0
+#define LOG_LEVEL_ERROR   1
+#define LOG_LEVEL_WARNING 2
+#define LOG_LEVEL_INFO    3
+
+#ifndef LOG_LEVEL
+#define LOG_LEVEL LOG_LEVEL_INFO
+#endif
+
+#define LOG_RING_SIZE       (64 * 1024) /*!< Bytes of the ring of each logging thread, a power of two*/
+#define LOG_MAX_STRING_ARG  512         /*!< %s arguments are copied, truncated to this length*/
+
+/** Asynchronous logging : the macros only copy the format pointer and the binary arguments in a lock-free ring owned by the calling thread.
+ * A background thread formats and writes them. The formats must be string literals (they are read later).*/
+namespace logger
+{
+    enum Level
+    {
+        LEVEL_ERROR   = LOG_LEVEL_ERROR,   /*!< Written on stderr*/
+        LEVEL_WARNING = LOG_LEVEL_WARNING, /*!< Written on stdout*/
+        LEVEL_INFO    = LOG_LEVEL_INFO     /*!< Written on stdout*/
+    };
+
+    /* \brief Type tags of the arguments serialized after a record header */
+    enum ArgType
+    {
+        ARG_INT,     /*!< int64_t*/
+        ARG_UINT,    /*!< uint64_t*/
+        ARG_DOUBLE,  /*!< double*/
+        ARG_STRING,  /*!< uint16_t length then the characters, without the terminating 0*/
+        ARG_POINTER  /*!< void**/
+    };
+
+    /** \brief reserve a record in the ring of the calling thread. Waits if the background thread is late
+     * \param size the size of the arguments in bytes
+     * \param level the level
+     * \param file the source file (static storage)
+     * \param line the source line
+     * \param format the format (string literal)
+     * \return where to write the arguments */
+    uint8_t* beginRecord(uint32_t size, Level level, const char* file, int line, const char* format);
+
+    /** \brief publish the record reserved by beginRecord to the background thread */
+    void endRecord();
+
+    /** \brief wait until every record logged so far is written */
+    void flush();
+
+    //Size of each serialized argument
+    inline uint32_t argSize(const char* s) {size_t n = strlen(s ? s : "(null)"); return 1 + 2 + (uint32_t)(n < LOG_MAX_STRING_ARG ? n : LOG_MAX_STRING_ARG);}
+    inline uint32_t argSize(char* s) {return argSize((const char*)s);}
+    inline uint32_t argSize(const unsigned char* s) {return argSize((const char*)s);} /*glGetString*/
+    template<typename T> inline uint32_t argSize(const T&) {return 1 + 8;}
+
+    //Serialization of each argument, by type
+    inline uint8_t* writeArg(uint8_t* p, const char* s)
+    {
+        if(!s)
+            s = "(null)";
+        size_t n = strlen(s);
+        uint16_t length = (uint16_t)(n < LOG_MAX_STRING_ARG ? n : LOG_MAX_STRING_ARG);
+        *p = ARG_STRING;
+        memcpy(p + 1, &length, 2);
+        memcpy(p + 3, s, length);
+        return p + 3 + length;
+    }
+    inline uint8_t* writeArg(uint8_t* p, char* s) {return writeArg(p, (const char*)s);}
+    inline uint8_t* writeArg(uint8_t* p, const unsigned char* s) {return writeArg(p, (const char*)s);}
+
+    template<typename V> inline uint8_t* writeTagged(uint8_t* p, ArgType type, V value)
+    {
+        static_assert(sizeof(V) == 8, "the arguments are stored on 64 bits");
+        *p = type;
+        memcpy(p + 1, &value, 8);
+        return p + 9;
+    }
+
+    template<typename T> inline typename std::enable_if<std::is_floating_point<T>::value, uint8_t*>::type writeArg(uint8_t* p, const T& v) {return writeTagged(p, ARG_DOUBLE, (double)v);}
+    template<typename T> inline typename std::enable_if<std::is_pointer<T>::value, uint8_t*>::type writeArg(uint8_t* p, const T& v) {return writeTagged(p, ARG_POINTER, (uint64_t)(uintptr_t)v);}
+    template<typename T> inline typename std::enable_if<std::is_integral<T>::value && std::is_signed<T>::value, uint8_t*>::type writeArg(uint8_t* p, const T& v) {return writeTagged(p, ARG_INT, (int64_t)v);}
+    template<typename T> inline typename std::enable_if<(std::is_integral<T>::value && !std::is_signed<T>::value) || std::is_enum<T>::value, uint8_t*>::type writeArg(uint8_t* p, const T& v) {return writeTagged(p, ARG_UINT, (uint64_t)v);}
+
+    inline uint32_t argsSize() {return 0;}
+    template<typename T, typename... Args> inline uint32_t argsSize(const T& first, const Args&... rest) {return argSize(first) + argsSize(rest...);}
+
+    inline void writeArgs(uint8_t*) {}
+    template<typename T, typename... Args> inline void writeArgs(uint8_t* p, const T& first, const Args&... rest) {writeArgs(writeArg(p, first), rest...);}
+
+    /** \brief log a message. Use the ERROR, WARNING and INFO macros */
+    template<typename... Args> inline void log(Level level, const char* file, int line, const char* format, const Args&... args)
+    {
+        uint8_t* p = beginRecord(argsSize(args...), level, file, line, format);
+        writeArgs(p, args...);
+        endRecord();
+    }
+}
+
+//The format is concatenated with "" : a compile error if it is not a literal
 #ifndef ERROR
-#define ERROR(x, ...)     (fprintf(stderr, RED "Error : " GRN "%s:%d " RESET x, __FILENAME__, __LINE__, ## __VA_ARGS__))
+#if LOG_LEVEL >= LOG_LEVEL_ERROR
+#define ERROR(x, ...)     (logger::log(logger::LEVEL_ERROR, __FILENAME__, __LINE__, x "", ## __VA_ARGS__))
+#else
+#define ERROR(x, ...)     (false ? logger::log(logger::LEVEL_ERROR, __FILENAME__, __LINE__, x "", ## __VA_ARGS__) : (void)0)
+#endif
 #endif
 
 #ifndef WARNING
-#define WARNING(x, ...)   (fprintf(stdout, YEL "Warning : " GRN "%s:%d " RESET x, __FILENAME__, __LINE__, ## __VA_ARGS__))
+#if LOG_LEVEL >= LOG_LEVEL_WARNING
+#define WARNING(x, ...)   (logger::log(logger::LEVEL_WARNING, __FILENAME__, __LINE__, x "", ## __VA_ARGS__))
+#else
+#define WARNING(x, ...)   (false ? logger::log(logger::LEVEL_WARNING, __FILENAME__, __LINE__, x "", ## __VA_ARGS__) : (void)0)
+#endif
 #endif
 
 #ifndef INFO
-#define INFO(x, ...)   (fprintf(stdout, BOLD WHT "INFO : " RESET GRN "%s:%d " RESET x , __FILENAME__, __LINE__, ## __VA_ARGS__))
+#if LOG_LEVEL >= LOG_LEVEL_INFO
+#define INFO(x, ...)   (logger::log(logger::LEVEL_INFO, __FILENAME__, __LINE__, x "", ## __VA_ARGS__))
+#else
+#define INFO(x, ...)   (false ? logger::log(logger::LEVEL_INFO, __FILENAME__, __LINE__, x "", ## __VA_ARGS__) : (void)0)
+#endif
 #endif
 
 #endif
@@ -0,0 +1,54 @@
+#include "Annulus.h"
+#include "logger.h"
+
+Annulus::Annulus(uint32_t nbEdges, float innerRadius) : Geometry()
+{
+    if(nbEdges < 3)
+        ERROR("The parameter 'nbEdges' should be three or greater\n");
+    if(innerRadius < 0.0f || innerRadius >= 0.5f)
+        ERROR("The parameter 'innerRadius' should be between 0 and 0.5\n");
+
+    const float outerRadius = 0.5f;
+    m_nbVertices = 6*nbEdges;
+    m_vertices   = (float*)malloc(3*6*(uint64_t)nbEdges*sizeof(float));
+    m_normals    = (float*)malloc(3*6*(uint64_t)nbEdges*sizeof(float));
+    m_uvs        = (float*)malloc(2*6*(uint64_t)nbEdges*sizeof(float));
+
+    for(uint32_t i=0; i < nbEdges; i++)
+    {
+        /* Counterclockwise seen from +y : z = -sin */
+        float cos0 = (float)cos(i*2*M_PI/nbEdges),     sin0 = (float)sin(i*2*M_PI/nbEdges);
+        float cos1 = (float)cos((i+1)*2*M_PI/nbEdges), sin1 = (float)sin((i+1)*2*M_PI/nbEdges);
+        float u0   = i/(float)nbEdges, u1 = (i+1)/(float)nbEdges;
+
+        /* Two triangles per edge : inner0, outer0, outer1 and inner0, outer1, inner1 */
+        float pos[] = {innerRadius*cos0, 0.0f, -innerRadius*sin0,
+                       outerRadius*cos0, 0.0f, -outerRadius*sin0,
+                       outerRadius*cos1, 0.0f, -outerRadius*sin1,
+
+                       innerRadius*cos0, 0.0f, -innerRadius*sin0,
+                       outerRadius*cos1, 0.0f, -outerRadius*sin1,
+                       innerRadius*cos1, 0.0f, -innerRadius*sin1};
+
+        float uvPos[] = {u0, 0.0f,
+                         u0, 1.0f,
+                         u1, 1.0f,
+
+                         u0, 0.0f,
+                         u1, 1.0f,
+                         u1, 0.0f};
+
+        for(uint32_t j=0; j < 18; j++)
+            m_vertices[18*i+j] = pos[j];
+        for(uint32_t j=0; j < 12; j++)
+            m_uvs[12*i+j] = uvPos[j];
+        for(uint32_t j=0; j < 6; j++)
+        {
+            m_normals[18*i+3*j]   = 0.0f;
+            m_normals[18*i+3*j+1] = 1.0f;
+            m_normals[18*i+3*j+2] = 0.0f;
+        }
+    }
+
+    computeBoundingSphere();
+}
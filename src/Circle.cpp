@@ -32,4 +32,6 @@ Circle::Circle(uint32_t nbEdge) : Geometry()
                 m_normals[9*i+3*j+k] = normal[k];
         }
 	}
+
+    computeBoundingSphere();
 }
@@ -0,0 +1,293 @@
+#include "CollisionWorld.h"
+#include "WorkerPool.h"
+#include <algorithm>
+#include <cmath>
+
+#define COLLISION_MIN_PARALLEL 4096 /*!< Below, the passes stay on the calling thread*/
+
+/** \brief run f(first, last) on ranges of [0, count[, one per thread of the pool */
+template<typename F> static void parallelFor(WorkerPool& workers, uint32_t count, const F& f)
+{
+    uint32_t nbThreads = workers.getNbThreads();
+    if(nbThreads <= 1 || count < COLLISION_MIN_PARALLEL)
+    {
+        f(0, count);
+        return;
+    }
+    uint32_t perThread = (count + nbThreads - 1) / nbThreads;
+    workers.run((count + perThread - 1) / perThread, [&](uint32_t t) {
+        f(t * perThread, std::min(count, (t + 1) * perThread));
+    });
+}
+
+static inline uint32_t hashCell(int32_t x, int32_t y, int32_t z)
+{
+    return ((uint32_t)x * 73856093u) ^ ((uint32_t)y * 19349663u) ^ ((uint32_t)z * 83492791u);
+}
+
+CollisionWorld::CollisionWorld(WorkerPool& workers) : m_workers(workers)
+{}
+
+void CollisionWorld::resize(uint32_t nbBodies)
+{
+    std::vector<float>* arrays[] = {&m_x0, &m_y0, &m_z0, &m_x1, &m_y1, &m_z1, &m_radius};
+    for(uint32_t i = 0; i < sizeof(arrays) / sizeof(arrays[0]); i++)
+        arrays[i]->resize(nbBodies, 0.0f);
+    m_group.resize(nbBodies, 0);
+    m_mask.resize(nbBodies, 0);
+}
+
+int32_t CollisionWorld::cell(float v) const
+{
+    float c = std::floor(v / m_cellSize);
+    return (int32_t)std::max(-1e9f, std::min(1e9f, c));
+}
+
+void CollisionWorld::step()
+{
+    m_events.clear();
+    m_nextEvent = 0;
+    m_stats     = CollisionStats();
+    uint32_t n  = getNbBodies();
+    m_stats.nbBodies = n;
+    if(n < 2)
+        return;
+
+    /* Cells of a couple of average swept diameters : the grid adapts to the bodies */
+    double extent = 0.0;
+    for(uint32_t i = 0; i < n; i++)
+    {
+        float dx = m_x1[i] - m_x0[i], dy = m_y1[i] - m_y0[i], dz = m_z1[i] - m_z0[i];
+        extent += m_radius[i] + 0.5f * std::sqrt(dx * dx + dy * dy + dz * dz);
+    }
+    m_cellSize = std::max(1e-6f, (float)(COLLISION_CELL_FACTOR * 2.0 * extent / n));
+
+    /* Cells covered by each swept box. The bodies covering too many go to the large list */
+    const uint32_t LARGE = UINT32_MAX;
+    m_cellCounts.resize(n + 1);
+    parallelFor(m_workers, n, [this, LARGE](uint32_t first, uint32_t last) {
+        for(uint32_t i = first; i < last; i++)
+        {
+            if(m_radius[i] <= 0.0f || m_mask[i] == 0 || m_group[i] == 0)
+            {
+                m_cellCounts[i] = 0;
+                continue;
+            }
+            float r = m_radius[i];
+            uint64_t nx = cell(std::max(m_x0[i], m_x1[i]) + r) - cell(std::min(m_x0[i], m_x1[i]) - r) + 1;
+            uint64_t ny = cell(std::max(m_y0[i], m_y1[i]) + r) - cell(std::min(m_y0[i], m_y1[i]) - r) + 1;
+            uint64_t nz = cell(std::max(m_z0[i], m_z1[i]) + r) - cell(std::min(m_z0[i], m_z1[i]) - r) + 1;
+            uint64_t nbCells = nx * ny * nz;
+            m_cellCounts[i] = nbCells > COLLISION_MAX_CELLS ? LARGE : (uint32_t)nbCells;
+        }
+    });
+
+    m_largeBodies.clear();
+    uint32_t nbEntries = 0;
+    for(uint32_t i = 0; i < n; i++)
+    {
+        uint32_t count = m_cellCounts[i];
+        if(count == LARGE)
+        {
+            m_largeBodies.push_back(i);
+            count = 0;
+        }
+        m_cellCounts[i] = nbEntries;
+        nbEntries += count;
+    }
+    m_cellCounts[n] = nbEntries;
+    m_stats.nbLargeBodies = m_largeBodies.size();
+    m_stats.nbCells       = nbEntries;
+
+    /* Hash the cells in a table twice as big as the entries. Slot hashSize collects the duplicates of a body (two of its cells with the same hash) */
+    uint32_t hashSize = 1;
+    while(hashSize < 2 * std::max(nbEntries, 1u))
+        hashSize <<= 1;
+    m_hashMask = hashSize - 1;
+    const uint32_t DISCARD = hashSize;
+
+    m_entryKeys.resize(nbEntries);
+    m_entryBodies.resize(nbEntries);
+    parallelFor(m_workers, n, [this, DISCARD](uint32_t first, uint32_t last) {
+        for(uint32_t i = first; i < last; i++)
+        {
+            uint32_t entry = m_cellCounts[i];
+            uint32_t end   = m_cellCounts[i + 1];
+            if(entry == end)
+                continue;
+            float r = m_radius[i];
+            int32_t minX = cell(std::min(m_x0[i], m_x1[i]) - r), maxX = cell(std::max(m_x0[i], m_x1[i]) + r);
+            int32_t minY = cell(std::min(m_y0[i], m_y1[i]) - r), maxY = cell(std::max(m_y0[i], m_y1[i]) + r);
+            int32_t minZ = cell(std::min(m_z0[i], m_z1[i]) - r), maxZ = cell(std::max(m_z0[i], m_z1[i]) + r);
+            uint32_t firstEntry = entry;
+            for(int32_t z = minZ; z <= maxZ; z++)
+                for(int32_t y = minY; y <= maxY; y++)
+                    for(int32_t x = minX; x <= maxX; x++)
+                    {
+                        uint32_t key = hashCell(x, y, z) & m_hashMask;
+                        for(uint32_t e = firstEntry; e < entry; e++)
+                            if(m_entryKeys[e] == key)
+                                key = DISCARD;
+                        m_entryKeys[entry]   = key;
+                        m_entryBodies[entry] = i;
+                        entry++;
+                    }
+        }
+    });
+
+    /* Counting sort of the entries by key : linear, the entries of a cell become contiguous */
+    m_bucketStarts.assign(hashSize + 2, 0);
+    for(uint32_t e = 0; e < nbEntries; e++)
+        m_bucketStarts[m_entryKeys[e] + 1]++;
+    for(uint32_t k = 0; k <= hashSize; k++)
+        m_bucketStarts[k + 1] += m_bucketStarts[k];
+    m_sortedBodies.resize(nbEntries);
+    m_sortedKeys.resize(nbEntries);
+    for(uint32_t e = 0; e < nbEntries; e++)
+    {
+        uint32_t slot = m_bucketStarts[m_entryKeys[e]]++;
+        m_sortedBodies[slot] = m_entryBodies[e];
+        m_sortedKeys[slot]   = m_entryKeys[e];
+    }
+
+    /* Pair tests in parallel : one range of whole cells per thread, and a share of the large bodies */
+    uint32_t nbThreads = nbEntries < COLLISION_MIN_PARALLEL ? 1 : m_workers.getNbThreads();
+    std::vector<std::vector<CollisionEvent> > events(nbThreads);
+    std::vector<uint64_t> nbCandidates(nbThreads, 0);
+    auto work = [&](uint32_t t) {
+        uint32_t first = (uint64_t)nbEntries * t / nbThreads;
+        uint32_t last  = (uint64_t)nbEntries * (t + 1) / nbThreads;
+        while(first > 0 && first < nbEntries && m_sortedKeys[first] == m_sortedKeys[first - 1])
+            first++;
+        while(last < nbEntries && last > 0 && m_sortedKeys[last] == m_sortedKeys[last - 1])
+            last++;
+        if(first < last)
+            testCells(first, last, events[t], nbCandidates[t]);
+        for(size_t l = t; l < m_largeBodies.size(); l += nbThreads)
+            testLarge(m_largeBodies[l], events[t], nbCandidates[t]);
+    };
+    m_workers.run(nbThreads, work);
+
+    for(uint32_t t = 0; t < nbThreads; t++)
+    {
+        m_events.insert(m_events.end(), events[t].begin(), events[t].end());
+        m_stats.nbCandidates += nbCandidates[t];
+    }
+    std::sort(m_events.begin(), m_events.end(), [](const CollisionEvent& l, const CollisionEvent& r) {
+        if(l.time != r.time)
+            return l.time < r.time;
+        return l.a != r.a ? l.a < r.a : l.b < r.b;
+    });
+    m_stats.nbEvents = m_events.size();
+}
+
+void CollisionWorld::testCells(uint32_t first, uint32_t last, std::vector<CollisionEvent>& events, uint64_t& nbCandidates) const
+{
+    for(uint32_t begin = first; begin < last; )
+    {
+        uint32_t key = m_sortedKeys[begin];
+        uint32_t end = begin + 1;
+        while(end < last && m_sortedKeys[end] == key)
+            end++;
+        if(key > m_hashMask)
+        {
+            begin = end;
+            continue;
+        }
+
+        for(uint32_t p = begin; p < end; p++)
+        {
+            uint32_t a = m_sortedBodies[p];
+            float ra = m_radius[a];
+            for(uint32_t q = p + 1; q < end; q++)
+            {
+                uint32_t b = m_sortedBodies[q];
+                if(!(m_group[a] & m_mask[b]) || !(m_group[b] & m_mask[a]))
+                    continue;
+
+                /* The pair shares several cells (or hash collisions) : only the cell of the corner of the intersection of the boxes tests it */
+                float rb = m_radius[b];
+                float lowX = std::max(std::min(m_x0[a], m_x1[a]) - ra, std::min(m_x0[b], m_x1[b]) - rb);
+                float lowY = std::max(std::min(m_y0[a], m_y1[a]) - ra, std::min(m_y0[b], m_y1[b]) - rb);
+                float lowZ = std::max(std::min(m_z0[a], m_z1[a]) - ra, std::min(m_z0[b], m_z1[b]) - rb);
+                if(lowX > std::min(std::max(m_x0[a], m_x1[a]) + ra, std::max(m_x0[b], m_x1[b]) + rb) ||
+                   lowY > std::min(std::max(m_y0[a], m_y1[a]) + ra, std::max(m_y0[b], m_y1[b]) + rb) ||
+                   lowZ > std::min(std::max(m_z0[a], m_z1[a]) + ra, std::max(m_z0[b], m_z1[b]) + rb))
+                    continue;
+                if((hashCell(cell(lowX), cell(lowY), cell(lowZ)) & m_hashMask) != key)
+                    continue;
+                testPair(std::min(a, b), std::max(a, b), events, nbCandidates);
+            }
+        }
+        begin = end;
+    }
+}
+
+void CollisionWorld::testLarge(uint32_t large, std::vector<CollisionEvent>& events, uint64_t& nbCandidates) const
+{
+    float r = m_radius[large];
+    float minX = std::min(m_x0[large], m_x1[large]) - r, maxX = std::max(m_x0[large], m_x1[large]) + r;
+    float minY = std::min(m_y0[large], m_y1[large]) - r, maxY = std::max(m_y0[large], m_y1[large]) + r;
+    float minZ = std::min(m_z0[large], m_z1[large]) - r, maxZ = std::max(m_z0[large], m_z1[large]) + r;
+
+    uint32_t n = getNbBodies();
+    for(uint32_t i = 0; i < n; i++)
+    {
+        /* Two large bodies : tested once, by the first one */
+        if(i == large || (i < large && m_cellCounts[i] == m_cellCounts[i + 1] && std::binary_search(m_largeBodies.begin(), m_largeBodies.end(), i)))
+            continue;
+        if(!(m_group[i] & m_mask[large]) || !(m_group[large] & m_mask[i]))
+            continue;
+        float ri = m_radius[i];
+        if(std::min(m_x0[i], m_x1[i]) - ri > maxX || std::max(m_x0[i], m_x1[i]) + ri < minX ||
+           std::min(m_y0[i], m_y1[i]) - ri > maxY || std::max(m_y0[i], m_y1[i]) + ri < minY ||
+           std::min(m_z0[i], m_z1[i]) - ri > maxZ || std::max(m_z0[i], m_z1[i]) + ri < minZ)
+            continue;
+        testPair(std::min(i, large), std::max(i, large), events, nbCandidates);
+    }
+}
+
+void CollisionWorld::testPair(uint32_t a, uint32_t b, std::vector<CollisionEvent>& events, uint64_t& nbCandidates) const
+{
+    nbCandidates++;
+
+    /* Relative motion of b seen from a : |d0 + v t| = ra + rb, smallest root in [0, 1] */
+    glm::vec3 fromA(m_x0[a], m_y0[a], m_z0[a]), toA(m_x1[a], m_y1[a], m_z1[a]);
+    glm::vec3 fromB(m_x0[b], m_y0[b], m_z0[b]), toB(m_x1[b], m_y1[b], m_z1[b]);
+    glm::vec3 d0 = fromB - fromA;
+    glm::vec3 v  = (toB - toA) - d0;
+    float r = m_radius[a] + m_radius[b];
+    float c = glm::dot(d0, d0) - r * r;
+
+    float t = 0.0f;
+    if(c > 0.0f)
+    {
+        float vv = glm::dot(v, v);
+        float dv = glm::dot(d0, v);
+        if(vv == 0.0f || dv >= 0.0f)
+            return; //Not moving closer
+        float disc = dv * dv - vv * c;
+        if(disc < 0.0f)
+            return;
+        t = (-dv - std::sqrt(disc)) / vv;
+        if(t > 1.0f)
+            return;
+    }
+
+    glm::vec3 pa = fromA + t * (toA - fromA);
+    glm::vec3 pb = fromB + t * (toB - fromB);
+    CollisionEvent event;
+    event.a     = a;
+    event.b     = b;
+    event.time  = t;
+    event.point = pa + (pb - pa) * (r > 0.0f ? m_radius[a] / r : 0.5f);
+    events.push_back(event);
+}
+
+bool CollisionWorld::pollEvent(CollisionEvent& event)
+{
+    if(m_nextEvent >= m_events.size())
+        return false;
+    event = m_events[m_nextEvent++];
+    return true;
+}
@@ -52,4 +52,6 @@ Cone::Cone(uint32_t nbLattitude, float topRadius) : Geometry()
             m_normals[18*i+15+j] = normalI[j];
         }
 	}
+
+    computeBoundingSphere();
 }
@@ -44,4 +44,6 @@ Cylinder::Cylinder(uint32_t nbLattitude) : Geometry()
             m_normals[18*i+3*j+2] = 0.0f;
         }
 	}
+
+    computeBoundingSphere();
 }
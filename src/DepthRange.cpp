@@ -0,0 +1,55 @@
+#include "DepthRange.h"
+#include <cmath>
+
+DepthRange::DepthRange(DepthMode mode, float zFar) : m_mode(mode), m_zFar(zFar)
+{}
+
+bool DepthRange::isSupported(DepthMode mode)
+{
+    if(mode == DEPTH_REVERSED)
+        return GLEW_ARB_clip_control;
+    return true;
+}
+
+DepthMode DepthRange::getBestMode(bool floatDepthBuffer)
+{
+    /* Reversed with a fixed point buffer would only move the precision around : the logarithm spreads it */
+    if(floatDepthBuffer && isSupported(DEPTH_REVERSED))
+        return DEPTH_REVERSED;
+    return DEPTH_LOGARITHMIC;
+}
+
+void DepthRange::apply() const
+{
+    if(m_mode == DEPTH_REVERSED)
+    {
+        glClipControl(GL_LOWER_LEFT, GL_ZERO_TO_ONE);
+        glClearDepth(0.0);
+        glDepthFunc(GL_GREATER);
+    }
+    else
+    {
+        if(GLEW_ARB_clip_control)
+            glClipControl(GL_LOWER_LEFT, GL_NEGATIVE_ONE_TO_ONE);
+        glClearDepth(1.0);
+        glDepthFunc(GL_LESS);
+    }
+}
+
+glm::mat4 DepthRange::getProjection(const glm::mat4& perspective) const
+{
+    if(m_mode != DEPTH_REVERSED)
+        return perspective;
+
+    /* z_clip = zNear and w_clip = -z_view : the depth zNear / distance goes from 1 at the near plane to 0 at infinity */
+    float zNear = perspective[3][2] / (perspective[2][2] - 1.0f);
+    glm::mat4 reversed = perspective;
+    reversed[2][2] = 0.0f;
+    reversed[3][2] = zNear;
+    return reversed;
+}
+
+glm::vec4 DepthRange::getParams() const
+{
+    return glm::vec4(2.0f / std::log2(m_zFar + 1.0f), m_mode == DEPTH_REVERSED ? 1.0f : 0.0f, 0.0f, 0.0f);
+}
@@ -0,0 +1,121 @@
+#include "Eclipses.h"
+#include <algorithm>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define ECLIPSES_SSE
+#endif
+
+void Eclipses::update(const glm::vec3& light, const std::vector<GameObject*>& occluders, const glm::dvec3& origin)
+{
+    m_origin      = origin;
+    m_light       = glm::vec3(glm::dvec3(light) - origin);
+    m_lightRadius = 0.0f;
+    m_x.clear();
+    m_y.clear();
+    m_z.clear();
+    m_radius.clear();
+    m_objects.clear();
+
+    for(size_t i = 0; i < occluders.size(); i++)
+    {
+        glm::vec3 center(occluders[i]->worldCenter - origin);
+        float     radius = occluders[i]->worldRadius;
+        glm::vec3 toLight = m_light - center;
+        if(glm::dot(toLight, toLight) < radius * radius)
+        {
+            m_lightRadius = std::max(m_lightRadius, radius);
+            continue;
+        }
+        m_x.push_back(center.x);
+        m_y.push_back(center.y);
+        m_z.push_back(center.z);
+        m_radius.push_back(radius);
+        m_objects.push_back(occluders[i]);
+    }
+
+    /* A sphere at the light is before nothing : the padding fails the test */
+    while(m_objects.size() % 4)
+    {
+        m_x.push_back(m_light.x);
+        m_y.push_back(m_light.y);
+        m_z.push_back(m_light.z);
+        m_radius.push_back(0.0f);
+        m_objects.push_back(NULL);
+    }
+}
+
+uint32_t Eclipses::findOccluders(const GameObject& receiver, glm::vec4* spheres) const
+{
+    glm::vec3 center(receiver.worldCenter - m_origin);
+    float     radius   = receiver.worldRadius;
+    glm::vec3 axis     = center - m_light;
+    float     distance = glm::length(axis);
+    if(distance <= radius)
+        return 0;
+    axis /= distance;
+
+    /* The hull of the light and receiver spheres : along the axis (t from the light), its radius goes from the light radius to the receiver one.
+     * An occluder between them (0 < t < distance + radius : a ring around its planet has the same center) is kept when its sphere reaches the hull : perpendicular distance <= its radius + the hull radius */
+    float    slope = (radius - m_lightRadius) / distance;
+    uint32_t nbFound = 0;
+    float    scores[SHADER_MAX_OCCLUDERS];
+
+    auto keep = [&](uint32_t i)
+    {
+        const GameObject* object = m_objects[i];
+        if(object == &receiver)
+            return;
+        /* The largest seen from the receiver hide the most */
+        glm::vec3 c(m_x[i], m_y[i], m_z[i]);
+        float score = m_radius[i] / std::max(glm::length(c - center), 1e-6f);
+        uint32_t j = nbFound < SHADER_MAX_OCCLUDERS ? nbFound++ : SHADER_MAX_OCCLUDERS;
+        for(; j > 0 && scores[j-1] < score; j--)
+            if(j < SHADER_MAX_OCCLUDERS)
+            {
+                scores[j]  = scores[j-1];
+                spheres[j] = spheres[j-1];
+            }
+        if(j < SHADER_MAX_OCCLUDERS)
+        {
+            scores[j]  = score;
+            spheres[j] = glm::vec4(c, m_radius[i]);
+        }
+    };
+
+    uint32_t i = 0;
+#ifdef ECLIPSES_SSE
+    __m128 lx = _mm_set1_ps(m_light.x), ly = _mm_set1_ps(m_light.y), lz = _mm_set1_ps(m_light.z);
+    __m128 ax = _mm_set1_ps(axis.x),    ay = _mm_set1_ps(axis.y),    az = _mm_set1_ps(axis.z);
+    __m128 maxT   = _mm_set1_ps(distance + radius);
+    __m128 slopes = _mm_set1_ps(slope);
+    __m128 lightR = _mm_set1_ps(m_lightRadius);
+    __m128 zero   = _mm_setzero_ps();
+    for(; i + 4 <= m_objects.size(); i += 4)
+    {
+        __m128 vx = _mm_sub_ps(_mm_loadu_ps(&m_x[i]), lx);
+        __m128 vy = _mm_sub_ps(_mm_loadu_ps(&m_y[i]), ly);
+        __m128 vz = _mm_sub_ps(_mm_loadu_ps(&m_z[i]), lz);
+        __m128 t  = _mm_add_ps(_mm_add_ps(_mm_mul_ps(vx, ax), _mm_mul_ps(vy, ay)), _mm_mul_ps(vz, az));
+        __m128 perp2 = _mm_sub_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(vx, vx), _mm_mul_ps(vy, vy)), _mm_mul_ps(vz, vz)), _mm_mul_ps(t, t));
+        __m128 reach = _mm_add_ps(_mm_add_ps(_mm_loadu_ps(&m_radius[i]), lightR), _mm_mul_ps(slopes, t));
+
+        __m128 inside = _mm_and_ps(_mm_and_ps(_mm_cmpgt_ps(t, zero), _mm_cmplt_ps(t, maxT)),
+                                   _mm_and_ps(_mm_cmpgt_ps(reach, zero), _mm_cmple_ps(perp2, _mm_mul_ps(reach, reach))));
+        int mask = _mm_movemask_ps(inside);
+        for(uint32_t j = 0; mask; j++, mask >>= 1)
+            if(mask & 1)
+                keep(i + j);
+    }
+#endif
+    for(; i < m_objects.size(); i++)
+    {
+        glm::vec3 v     = glm::vec3(m_x[i], m_y[i], m_z[i]) - m_light;
+        float     t     = glm::dot(v, axis);
+        float     perp2 = glm::dot(v, v) - t * t;
+        float     reach = m_radius[i] + m_lightRadius + slope * t;
+        if(t > 0.0f && t < distance + radius && reach > 0.0f && perp2 <= reach * reach)
+            keep(i);
+    }
+    return nbFound;
+}
@@ -0,0 +1,418 @@
+#include "FrameExporter.h"
+#include "logger.h"
+#include <SDL2/SDL.h>
+#include <SDL2/SDL_image.h>
+#include <algorithm>
+#include <cstring>
+#include <cerrno>
+#include <csignal>
+
+#ifdef _WIN32
+#define popen  _popen
+#define pclose _pclose
+
+/* \brief No SIGPIPE on Windows : a write to a closed pipe only fails */
+struct PipeSignalBlocker
+{
+    PipeSignalBlocker() {}
+};
+#else
+#include <pthread.h>
+#include <ctime>
+
+/* \brief Block SIGPIPE on the calling thread while it writes to the output : if ffmpeg (or the reader of a named pipe) quits,
+ * the write fails with EPIPE instead of killing the process. The signal it raised is consumed before the mask is restored.
+ * The handler of the process and the other threads are left alone */
+class PipeSignalBlocker
+{
+    public:
+        PipeSignalBlocker()
+        {
+            sigemptyset(&m_pipe);
+            sigaddset(&m_pipe, SIGPIPE);
+            sigset_t pending;
+            sigpending(&pending);
+            m_wasPending = sigismember(&pending, SIGPIPE) == 1;
+            pthread_sigmask(SIG_BLOCK, &m_pipe, &m_previous);
+        }
+
+        ~PipeSignalBlocker()
+        {
+            /* A SIGPIPE pending from before belongs to someone else */
+            if(!m_wasPending)
+            {
+                struct timespec zero = {0, 0};
+                while(sigtimedwait(&m_pipe, NULL, &zero) == SIGPIPE);
+            }
+            pthread_sigmask(SIG_SETMASK, &m_previous, NULL);
+        }
+    private:
+        sigset_t m_pipe;
+        sigset_t m_previous;
+        bool     m_wasPending;
+};
+#endif
+
+FrameExporter::FrameExporter(ExportFormat format, const std::string& path, uint32_t width, uint32_t height) :
+    m_format(format), m_path(path), m_width(width), m_height(height), m_nbWritten(0), m_failed(false)
+{
+    for(uint32_t i = 0; i < EXPORT_PBO_RING; i++)
+    {
+        m_pbo[i]     = 0;
+        m_fence[i]   = 0;
+        m_pending[i] = false;
+        m_index[i]   = 0;
+    }
+}
+
+FrameExporter::~FrameExporter()
+{
+    finish();
+    if(m_pbo[0])
+        glDeleteBuffers(EXPORT_PBO_RING, m_pbo);
+    for(uint32_t i = 0; i < m_allPixels.size(); i++)
+        free(m_allPixels[i]);
+}
+
+ExportFormat FrameExporter::formatFromPath(const std::string& path)
+{
+    std::string extension = path.substr(path.find_last_of('.') + 1);
+    std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+    if(extension == "png")
+        return EXPORT_PNG;
+    if(extension == "y4m")
+        return EXPORT_Y4M;
+    return EXPORT_FFMPEG;
+}
+
+bool FrameExporter::isFramePattern(const std::string& path)
+{
+    uint32_t nbConversions = 0;
+    for(size_t i = 0; i < path.size(); i++)
+    {
+        if(path[i] != '%')
+            continue;
+        if(++i < path.size() && path[i] == '%')
+            continue;
+
+        /* Flags and width only : the frame number is an unsigned int */
+        while(i < path.size() && strchr("-+ #0123456789", path[i]))
+            i++;
+        if(i == path.size() || !strchr("diu", path[i]))
+            return false;
+        nbConversions++;
+    }
+    return nbConversions == 1;
+}
+
+FrameExporter* FrameExporter::create(ExportFormat format, const std::string& path, uint32_t width, uint32_t height, uint32_t framerate, bool readback)
+{
+    /* The path is the format of snprintf : without a conversion every frame would overwrite the same file */
+    if(format == EXPORT_PNG && !isFramePattern(path))
+    {
+        ERROR("The PNG export path %s needs exactly one frame number conversion, e.g. frames/frame_%%05d.png (%%%% for a %% character)\n", path.c_str());
+        return NULL;
+    }
+
+    FrameExporter* exporter = new FrameExporter(format, path, width, height);
+
+    /* Open the output stream. The video formats need the frames in order, the PNG files are independent */
+    if(format == EXPORT_Y4M)
+    {
+        exporter->m_output = fopen(path.c_str(), "wb");
+        if(exporter->m_output)
+            fprintf(exporter->m_output, "YUV4MPEG2 W%u H%u F%u:1 Ip A1:1 C420jpeg\n", width, height, framerate);
+    }
+    else if(format == EXPORT_FFMPEG)
+    {
+        char command[1024];
+        snprintf(command, sizeof(command), "ffmpeg -loglevel error -y -f rawvideo -pix_fmt rgba -s %ux%u -r %u -i - -pix_fmt yuv420p \"%s\"",
+                 width, height, framerate, path.c_str());
+        /* If ffmpeg quits, the writes fail (see PipeSignalBlocker) */
+        exporter->m_output = popen(command, "w");
+    }
+    if(format != EXPORT_PNG && exporter->m_output == NULL)
+    {
+        ERROR("Could not open %s for the export : %s\n", path.c_str(), strerror(errno));
+        delete exporter;
+        return NULL;
+    }
+
+    /* Pixel pack buffers : glReadPixels returns at once, the copy is done by the GPU */
+    if(readback)
+    {
+        glGenBuffers(EXPORT_PBO_RING, exporter->m_pbo);
+        for(uint32_t i = 0; i < EXPORT_PBO_RING; i++)
+        {
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, exporter->m_pbo[i]);
+            glBufferData(GL_PIXEL_PACK_BUFFER, width * height * 4, NULL, GL_STREAM_READ);
+        }
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    }
+
+    /* Keep a core for the rendering. Each worker may hold two frames so that none of them waits for the GL thread */
+    uint32_t nbWorkers = std::max(1u, std::thread::hardware_concurrency() - 1);
+    for(uint32_t i = 0; i < 2 * nbWorkers + 1; i++)
+    {
+        uint8_t* pixels = (uint8_t*)malloc(width * height * 4);
+        exporter->m_allPixels.push_back(pixels);
+        exporter->m_freePixels.push_back(pixels);
+    }
+    for(uint32_t i = 0; i < nbWorkers; i++)
+        exporter->m_workers.push_back(std::thread(&FrameExporter::workerLoop, exporter));
+
+    INFO("Exporting %ux%u frames to %s with %u encoding threads\n", width, height, path.c_str(), nbWorkers);
+    return exporter;
+}
+
+void FrameExporter::capture(const Framebuffer& framebuffer)
+{
+    if(m_finished)
+        return;
+    if(m_nbCaptured == 0)
+        m_timeStart = std::chrono::steady_clock::now();
+
+    /* Free the slot : its readback was started EXPORT_PBO_RING frames ago and is normally finished */
+    uint32_t slot = m_nbCaptured % EXPORT_PBO_RING;
+    if(m_pending[slot])
+        retire(slot);
+
+    /* Restore the read framebuffer : the default one may not exist (headless context) */
+    GLint readFramebuffer = 0;
+    glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &readFramebuffer);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer.getID());
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, m_pbo[slot]);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, std::min(m_width, framebuffer.getWidth()), std::min(m_height, framebuffer.getHeight()), GL_RGBA, GL_UNSIGNED_BYTE, 0);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, readFramebuffer);
+
+    if(GLEW_ARB_sync)
+        m_fence[slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    m_pending[slot] = true;
+    m_index[slot]   = m_nbCaptured++;
+}
+
+void FrameExporter::retire(uint32_t slot)
+{
+    /* Count the stalls : with a deep enough ring the fence is already signaled */
+    if(m_fence[slot])
+    {
+        if(glClientWaitSync(m_fence[slot], 0, 0) == GL_TIMEOUT_EXPIRED)
+        {
+            m_nbStalls++;
+            glClientWaitSync(m_fence[slot], GL_SYNC_FLUSH_COMMANDS_BIT, (GLuint64)1e9);
+        }
+        glDeleteSync(m_fence[slot]);
+        m_fence[slot] = 0;
+    }
+
+    uint8_t* pixels = acquirePixels();
+
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, m_pbo[slot]);
+    void* data = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, m_width * m_height * 4, GL_MAP_READ_BIT);
+    if(data)
+    {
+        memcpy(pixels, data, m_width * m_height * 4);
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    }
+    else
+        memset(pixels, 0, m_width * m_height * 4);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    m_pending[slot] = false;
+    pushJob(pixels, m_index[slot]);
+}
+
+void FrameExporter::capture(const uint8_t* pixels)
+{
+    if(m_finished)
+        return;
+    if(m_nbCaptured == 0)
+        m_timeStart = std::chrono::steady_clock::now();
+
+    /* The frames are numbered in the capture order : the readbacks started before this frame go first, oldest first */
+    for(uint32_t i = 0; i < EXPORT_PBO_RING; i++)
+    {
+        uint32_t slot = (m_nbCaptured + i) % EXPORT_PBO_RING;
+        if(m_pending[slot])
+            retire(slot);
+    }
+
+    uint8_t* copy = acquirePixels();
+    memcpy(copy, pixels, m_width * m_height * 4);
+    pushJob(copy, m_nbCaptured++);
+}
+
+uint8_t* FrameExporter::acquirePixels()
+{
+    /* Bounded memory : wait for a worker if every copy is still being encoded */
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_freeCond.wait(lock, [this]{return !m_freePixels.empty();});
+    uint8_t* pixels = m_freePixels.back();
+    m_freePixels.pop_back();
+    return pixels;
+}
+
+void FrameExporter::pushJob(uint8_t* pixels, uint32_t index)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        Job job;
+        job.pixels = pixels;
+        job.index  = index;
+        m_jobs.push_back(job);
+    }
+    m_jobCond.notify_one();
+}
+
+void FrameExporter::finish()
+{
+    if(m_finished)
+        return;
+
+    /* Oldest frames first */
+    for(uint32_t i = 0; i < EXPORT_PBO_RING; i++)
+    {
+        uint32_t slot = (m_nbCaptured + i) % EXPORT_PBO_RING;
+        if(m_pending[slot])
+            retire(slot);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_jobCond.notify_all();
+    for(uint32_t i = 0; i < m_workers.size(); i++)
+        m_workers[i].join();
+    m_workers.clear();
+
+    if(m_output)
+    {
+        PipeSignalBlocker blocker; //The buffered data is written on closing
+        if(m_format == EXPORT_FFMPEG)
+        {
+            int status = pclose(m_output);
+            if(status != 0)
+                ERROR("ffmpeg exited with the status %d\n", status);
+        }
+        else
+            fclose(m_output);
+        m_output = NULL;
+    }
+    m_finished = true;
+
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - m_timeStart).count();
+    if(m_failed)
+        ERROR("The export to %s failed after %u frames\n", m_path.c_str(), m_nbWritten.load());
+    else if(m_nbWritten > 0 && elapsed > 0.0)
+        INFO("Exported %u frames to %s in %.2f s (%.1f fps, %u readback stalls)\n", m_nbWritten.load(), m_path.c_str(), elapsed, m_nbWritten / elapsed, m_nbStalls);
+}
+
+void FrameExporter::workerLoop()
+{
+    std::vector<uint8_t> yuv;
+    while(true)
+    {
+        Job job;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_jobCond.wait(lock, [this]{return m_stop || !m_jobs.empty();});
+            if(m_jobs.empty())
+                return;
+            job = m_jobs.front();
+            m_jobs.pop_front();
+        }
+
+        bool written = encode(job.pixels, job.index, yuv);
+
+        if(!written)
+            m_failed = true;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_freePixels.push_back(job.pixels);
+        }
+        m_freeCond.notify_one();
+    }
+}
+
+bool FrameExporter::encode(uint8_t* pixels, uint32_t index, std::vector<uint8_t>& yuv)
+{
+    /* OpenGL reads bottom-up : flip the rows in place */
+    uint32_t pitch = m_width * 4;
+    for(uint32_t y = 0; y < m_height / 2; y++)
+        std::swap_ranges(pixels + y * pitch, pixels + (y + 1) * pitch, pixels + (m_height - 1 - y) * pitch);
+
+    if(m_format == EXPORT_PNG)
+    {
+        char fileName[1024];
+        snprintf(fileName, sizeof(fileName), m_path.c_str(), index);
+        SDL_Surface* surface = SDL_CreateRGBSurfaceWithFormatFrom(pixels, m_width, m_height, 32, pitch, SDL_PIXELFORMAT_RGBA32);
+        bool saved = surface && IMG_SavePNG(surface, fileName) == 0;
+        if(!saved)
+            ERROR("Could not save %s : %s\n", fileName, SDL_GetError());
+        SDL_FreeSurface(surface);
+        if(saved)
+            m_nbWritten++;
+        return saved;
+    }
+
+    if(m_format == EXPORT_FFMPEG)
+        return writeOrdered(index, NULL, pixels, pitch * m_height);
+
+    /* Y4M : full range BT.601 (C420jpeg), chroma averaged over 2x2 blocks */
+    uint32_t chromaWidth  = (m_width + 1) / 2;
+    uint32_t chromaHeight = (m_height + 1) / 2;
+    uint32_t lumaSize     = m_width * m_height;
+    uint32_t chromaSize   = chromaWidth * chromaHeight;
+    yuv.resize(lumaSize + 2 * chromaSize);
+    uint8_t* planeY = &yuv[0];
+    uint8_t* planeU = planeY + lumaSize;
+    uint8_t* planeV = planeU + chromaSize;
+
+    for(uint32_t i = 0; i < lumaSize; i++)
+    {
+        const uint8_t* p = pixels + 4 * i;
+        planeY[i] = (uint8_t)((77 * p[0] + 150 * p[1] + 29 * p[2] + 128) >> 8);
+    }
+    for(uint32_t cy = 0; cy < chromaHeight; cy++)
+    {
+        for(uint32_t cx = 0; cx < chromaWidth; cx++)
+        {
+            int r = 0, g = 0, b = 0, n = 0;
+            for(uint32_t y = 2 * cy; y < std::min(2 * cy + 2, m_height); y++)
+                for(uint32_t x = 2 * cx; x < std::min(2 * cx + 2, m_width); x++, n++)
+                {
+                    const uint8_t* p = pixels + y * pitch + 4 * x;
+                    r += p[0]; g += p[1]; b += p[2];
+                }
+            r /= n; g /= n; b /= n;
+            planeU[cy * chromaWidth + cx] = (uint8_t)std::min(255, std::max(0, (-43 * r - 85 * g + 128 * b + 128) / 256 + 128));
+            planeV[cy * chromaWidth + cx] = (uint8_t)std::min(255, std::max(0, (128 * r - 107 * g - 21 * b + 128) / 256 + 128));
+        }
+    }
+    return writeOrdered(index, "FRAME\n", &yuv[0], yuv.size());
+}
+
+bool FrameExporter::writeOrdered(uint32_t index, const char* header, const uint8_t* data, size_t size)
+{
+    /* The jobs are taken in order, so the frame expected next is always being encoded by some worker */
+    std::unique_lock<std::mutex> lock(m_writeMutex);
+    m_writeCond.wait(lock, [this, index]{return m_nextWrite == index;});
+
+    bool written = !m_failed;
+    PipeSignalBlocker blocker;
+    if(written && header)
+        written = fputs(header, m_output) >= 0;
+    if(written)
+        written = fwrite(data, 1, size, m_output) == size;
+    if(written)
+        m_nbWritten++;
+    else if(!m_failed)
+        ERROR("Could not write the frame %u to %s\n", index, m_path.c_str());
+
+    m_nextWrite++;
+    lock.unlock();
+    m_writeCond.notify_all();
+    return written;
+}
@@ -0,0 +1,72 @@
+#include "Frustum.h"
+#include <cmath>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define FRUSTUM_SSE
+#endif
+
+Frustum::Frustum(const glm::mat4& viewProjection)
+{
+    /* Rows of the matrix (glm is column-major) */
+    glm::vec4 rows[4];
+    for(uint32_t i = 0; i < 4; i++)
+        rows[i] = glm::vec4(viewProjection[0][i], viewProjection[1][i], viewProjection[2][i], viewProjection[3][i]);
+
+    m_planes[0] = rows[3] + rows[0];
+    m_planes[1] = rows[3] - rows[0];
+    m_planes[2] = rows[3] + rows[1];
+    m_planes[3] = rows[3] - rows[1];
+    m_planes[4] = rows[3] + rows[2];
+    m_planes[5] = rows[3] - rows[2];
+
+    for(uint32_t i = 0; i < 6; i++)
+        m_planes[i] /= glm::length(glm::vec3(m_planes[i]));
+}
+
+bool Frustum::intersects(const glm::vec3& center, float radius) const
+{
+    for(uint32_t i = 0; i < 6; i++)
+        if(glm::dot(glm::vec3(m_planes[i]), center) + m_planes[i].w < -radius)
+            return false;
+    return true;
+}
+
+void Frustum::intersects(const float* x, const float* y, const float* z, const float* radius, uint32_t nbSpheres, uint8_t* visible) const
+{
+    uint32_t i = 0;
+#ifdef FRUSTUM_SSE
+    __m128 px[6], py[6], pz[6], pw[6];
+    for(uint32_t p = 0; p < 6; p++)
+    {
+        px[p] = _mm_set1_ps(m_planes[p].x);
+        py[p] = _mm_set1_ps(m_planes[p].y);
+        pz[p] = _mm_set1_ps(m_planes[p].z);
+        pw[p] = _mm_set1_ps(m_planes[p].w);
+    }
+
+    for(; i + 4 <= nbSpheres; i += 4)
+    {
+        __m128 cx = _mm_loadu_ps(x + i);
+        __m128 cy = _mm_loadu_ps(y + i);
+        __m128 cz = _mm_loadu_ps(z + i);
+        __m128 nr = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(radius + i));
+
+        /* inside = AND over the 6 planes of (distance to the plane >= -radius) */
+        __m128 inside;
+        for(uint32_t p = 0; p < 6; p++)
+        {
+            __m128 d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(px[p], cx), _mm_mul_ps(py[p], cy)),
+                                  _mm_add_ps(_mm_mul_ps(pz[p], cz), pw[p]));
+            __m128 in = _mm_cmpge_ps(d, nr);
+            inside = (p == 0) ? in : _mm_and_ps(inside, in);
+        }
+
+        int mask = _mm_movemask_ps(inside);
+        for(uint32_t j = 0; j < 4; j++)
+            visible[i+j] = (mask >> j) & 1;
+    }
+#endif
+    for(; i < nbSpheres; i++)
+        visible[i] = intersects(glm::vec3(x[i], y[i], z[i]), radius[i]);
+}
@@ -1,8 +1,19 @@
 #include "Geometry.h"
 #include <cstring>
+#include <cmath>
 
 Geometry::Geometry(){}
 
+Geometry::Geometry(const float* vertices, const float* normals, const float* uvs, uint32_t nbVertices, const float* boundingCenter, float boundingRadius) :
+    m_nbVertices(nbVertices), m_boundingRadius(boundingRadius), m_ownsData(false)
+{
+    /* Never written : only the constructors of the runtime geometries fill the arrays, which they allocate */
+    m_vertices = const_cast<float*>(vertices);
+    m_normals  = const_cast<float*>(normals);
+    m_uvs      = const_cast<float*>(uvs);
+    memcpy(m_boundingCenter, boundingCenter, sizeof(m_boundingCenter));
+}
+
 Geometry::Geometry(const Geometry& copy)
 {
     *this = copy;
@@ -14,6 +25,9 @@ Geometry::Geometry(Geometry&& mvt) noexcept
     m_vertices   = mvt.m_vertices;
     m_normals    = mvt.m_normals;
     m_uvs        = mvt.m_uvs;
+    memcpy(m_boundingCenter, mvt.m_boundingCenter, sizeof(m_boundingCenter));
+    m_boundingRadius = mvt.m_boundingRadius;
+    m_ownsData       = mvt.m_ownsData;
 
     mvt.m_vertices   = mvt.m_normals = mvt.m_uvs = nullptr;
     mvt.m_nbVertices = 0;
@@ -27,6 +41,17 @@ Geometry& Geometry::operator=(const Geometry& copy)
         if (copy.getNbVertices() == 0) return *this;
 
         m_nbVertices = copy.m_nbVertices;
+        memcpy(m_boundingCenter, copy.m_boundingCenter, sizeof(m_boundingCenter));
+        m_boundingRadius = copy.m_boundingRadius;
+        if(!copy.m_ownsData)
+        {
+            m_vertices = copy.m_vertices;
+            m_normals  = copy.m_normals;
+            m_uvs      = copy.m_uvs;
+            m_ownsData = false;
+            return *this;
+        }
+
         m_vertices = (float*)malloc((uint64_t)getNbVertices()*3*sizeof(float));
         if(m_vertices != nullptr)
             memcpy(m_vertices, copy.m_vertices, (uint64_t)getNbVertices()*3*sizeof(float));
@@ -50,12 +75,48 @@ Geometry::~Geometry()
 
 void Geometry::clear()
 {
-    if(m_vertices)
-        free(m_vertices);
-    if(m_normals)
-        free(m_normals);
-    if(m_uvs)
-        free(m_uvs);
+    if(m_ownsData)
+    {
+        if(m_vertices)
+            free(m_vertices);
+        if(m_normals)
+            free(m_normals);
+        if(m_uvs)
+            free(m_uvs);
+    }
     m_vertices = m_normals = m_uvs = nullptr;
+    m_ownsData = true;
     m_nbVertices = 0;
+    m_boundingCenter[0] = m_boundingCenter[1] = m_boundingCenter[2] = 0.0f;
+    m_boundingRadius = 0.0f;
+}
+
+void Geometry::computeBoundingSphere()
+{
+    if(m_nbVertices == 0 || m_vertices == nullptr)
+        return;
+
+    float minPos[3], maxPos[3];
+    for(uint32_t j = 0; j < 3; j++)
+        minPos[j] = maxPos[j] = m_vertices[j];
+    for(uint32_t i = 1; i < m_nbVertices; i++)
+        for(uint32_t j = 0; j < 3; j++)
+        {
+            if(m_vertices[3*i+j] < minPos[j]) minPos[j] = m_vertices[3*i+j];
+            if(m_vertices[3*i+j] > maxPos[j]) maxPos[j] = m_vertices[3*i+j];
+        }
+
+    for(uint32_t j = 0; j < 3; j++)
+        m_boundingCenter[j] = 0.5f*(minPos[j]+maxPos[j]);
+
+    float radius2 = 0.0f;
+    for(uint32_t i = 0; i < m_nbVertices; i++)
+    {
+        float d2 = 0.0f;
+        for(uint32_t j = 0; j < 3; j++)
+            d2 += (m_vertices[3*i+j]-m_boundingCenter[j])*(m_vertices[3*i+j]-m_boundingCenter[j]);
+        if(d2 > radius2)
+            radius2 = d2;
+    }
+    m_boundingRadius = sqrtf(radius2);
 }
\ No newline at end of file
@@ -0,0 +1,111 @@
+#include "HeadlessContext.h"
+#include "logger.h"
+
+#ifdef USE_EGL
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+#ifndef EGL_PLATFORM_SURFACELESS_MESA
+#define EGL_PLATFORM_SURFACELESS_MESA 0x31DD
+#endif
+#endif
+
+HeadlessContext::HeadlessContext()
+{}
+
+HeadlessContext::~HeadlessContext()
+{
+#ifdef USE_EGL
+    if(m_display)
+    {
+        eglMakeCurrent((EGLDisplay)m_display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+        if(m_context)
+            eglDestroyContext((EGLDisplay)m_display, (EGLContext)m_context);
+        eglTerminate((EGLDisplay)m_display);
+    }
+#endif
+}
+
+HeadlessContext* HeadlessContext::create(int major, int minor)
+{
+#ifdef USE_EGL
+    HeadlessContext* ctx = new HeadlessContext();
+
+    /* The surfaceless platform needs neither X11 nor a DRM device. Fall back on the default display otherwise */
+    EGLDisplay display = EGL_NO_DISPLAY;
+    PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+    if(getPlatformDisplay)
+        display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+    if(display == EGL_NO_DISPLAY)
+        display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+
+    EGLint eglMajor, eglMinor;
+    if(display == EGL_NO_DISPLAY || !eglInitialize(display, &eglMajor, &eglMinor))
+    {
+        ERROR("Could not initialize an EGL display (error 0x%x)\n", eglGetError());
+        delete ctx;
+        return NULL;
+    }
+    ctx->m_display = display;
+
+    const EGLint configAttribs[] = {EGL_SURFACE_TYPE,    EGL_PBUFFER_BIT,
+                                    EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+                                    EGL_RED_SIZE, 8, EGL_GREEN_SIZE, 8, EGL_BLUE_SIZE, 8,
+                                    EGL_NONE};
+    EGLConfig config;
+    EGLint    nbConfigs = 0;
+    if(!eglChooseConfig(display, configAttribs, &config, 1, &nbConfigs) || nbConfigs == 0)
+    {
+        ERROR("No EGL config supports desktop OpenGL (error 0x%x)\n", eglGetError());
+        delete ctx;
+        return NULL;
+    }
+
+    if(!eglBindAPI(EGL_OPENGL_API))
+    {
+        ERROR("Could not bind the OpenGL API (error 0x%x)\n", eglGetError());
+        delete ctx;
+        return NULL;
+    }
+
+    const EGLint contextAttribs[] = {EGL_CONTEXT_MAJOR_VERSION, major,
+                                     EGL_CONTEXT_MINOR_VERSION, minor,
+                                     EGL_NONE};
+    EGLContext context = eglCreateContext(display, config, EGL_NO_CONTEXT, contextAttribs);
+    if(context == EGL_NO_CONTEXT)
+    {
+        ERROR("Could not create an OpenGL %d.%d context (error 0x%x)\n", major, minor, eglGetError());
+        delete ctx;
+        return NULL;
+    }
+    ctx->m_context = context;
+
+    if(!ctx->makeCurrent())
+    {
+        delete ctx;
+        return NULL;
+    }
+    INFO("Headless EGL %d.%d context created (%s)\n", eglMajor, eglMinor, eglQueryString(display, EGL_VENDOR));
+    return ctx;
+#else
+    (void)major;
+    (void)minor;
+    ERROR("Headless rendering needs EGL : compile with USE_EGL\n");
+    return NULL;
+#endif
+}
+
+bool HeadlessContext::makeCurrent()
+{
+#ifdef USE_EGL
+    /* Without any surface, the default framebuffer is incomplete : draw into a Framebuffer */
+    if(!eglMakeCurrent((EGLDisplay)m_display, EGL_NO_SURFACE, EGL_NO_SURFACE, (EGLContext)m_context))
+    {
+        ERROR("Could not make the EGL context current (error 0x%x)\n", eglGetError());
+        return false;
+    }
+    return true;
+#else
+    return false;
+#endif
+}
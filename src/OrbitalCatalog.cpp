@@ -0,0 +1,562 @@
+#include "OrbitalCatalog.h"
+#include "logger.h"
+#include "WorkerPool.h"
+#include <thread>
+#include <chrono>
+#include <cmath>
+#include <cerrno>
+#include <algorithm>
+
+#ifdef _WIN32
+#include <stdio.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define CATALOG_SSE2
+#endif
+
+/* Eight digits are converted at once in a 64 bits register, which must be little endian */
+#if (defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__) || defined(_WIN32)
+#define CATALOG_SWAR
+#endif
+
+#define CATALOG_J2000_JD   2451545.0
+#define CATALOG_DEG_TO_RAD 0.017453292519943295
+#define CATALOG_MIN_PARALLEL_BODIES 65536 /*!< Below, computePositions stays on the calling thread*/
+
+/* \brief The columns read. The first CATALOG_NB_REQUIRED must be present */
+enum CatalogColumn
+{
+    COLUMN_A,
+    COLUMN_E,
+    COLUMN_I,
+    COLUMN_NODE,
+    COLUMN_PERI,
+    COLUMN_M,
+    COLUMN_EPOCH,
+    COLUMN_H,
+    COLUMN_COUNT
+};
+#define CATALOG_NB_REQUIRED 6
+
+/* Accepted header names of each column */
+static const char* const COLUMN_NAMES[COLUMN_COUNT][3] = {
+    {"a",     NULL,       NULL},
+    {"e",     NULL,       NULL},
+    {"i",     "incl",     NULL},
+    {"om",    "node",     "raan"},
+    {"w",     "peri",     "argperi"},
+    {"ma",    "M",        NULL},
+    {"epoch", "epoch_jd", NULL},
+    {"H",     NULL,       NULL}
+};
+
+static const double POW10[23] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+                                 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+/** \brief find the next comma of a field
+ * \param p the start of the search
+ * \param end the end of the line
+ * \return the comma or end */
+static const char* findComma(const char* p, const char* end)
+{
+#ifdef CATALOG_SSE2
+    /* 16 bytes per comparison */
+    const __m128i comma = _mm_set1_epi8(',');
+    while(end - p >= 16)
+    {
+        int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)p), comma));
+        if(mask)
+        {
+            int bit = 0;
+            while(!(mask & (1 << bit)))
+                bit++;
+            return p + bit;
+        }
+        p += 16;
+    }
+#endif
+    while(p < end && *p != ',')
+        p++;
+    return p;
+}
+
+/** \brief skip a field which is not read (text, possibly quoted)
+ * \param p the start of the field
+ * \param end the end of the line
+ * \return the comma after the field or end */
+static const char* skipField(const char* p, const char* end)
+{
+    if(p < end && *p == '"')
+    {
+        const char* quote = (const char*)memchr(p + 1, '"', end - p - 1);
+        p = quote ? quote + 1 : end;
+    }
+    return findComma(p, end);
+}
+
+#ifdef CATALOG_SWAR
+/** \brief tell whether the 8 characters are all digits (fast_float's test)*/
+static inline bool isEightDigits(uint64_t v)
+{
+    return ((v & 0xF0F0F0F0F0F0F0F0ull) | (((v + 0x0606060606060606ull) & 0xF0F0F0F0F0F0F0F0ull) >> 4)) == 0x3333333333333333ull;
+}
+
+/** \brief convert 8 digits with three multiplications instead of eight*/
+static inline uint32_t parseEightDigits(uint64_t v)
+{
+    const uint64_t mask = 0x000000FF000000FFull;
+    const uint64_t mul1 = 100 + (1000000ull << 32);
+    const uint64_t mul2 = 1 + (10000ull << 32);
+    v -= 0x3030303030303030ull;
+    v  = (v * 10) + (v >> 8);
+    v  = (((v & mask) * mul1) + (((v >> 16) & mask) * mul2)) >> 32;
+    return (uint32_t)v;
+}
+#endif
+
+/** \brief read the digits of a number in a 19 digits mantissa
+ * \param p the cursor, moved after the digits
+ * \param end the end of the line
+ * \param mantissa the mantissa
+ * \param nbDigits the significant digits read so far
+ * \param fraction whether the digits are after the dot : each digit kept decreases the exponent. Before the dot, each digit dropped increases it
+ * \param exponent the decimal exponent
+ * \return whether a digit was read */
+static inline bool parseDigits(const char*& p, const char* end, uint64_t& mantissa, int& nbDigits, bool fraction, int& exponent)
+{
+    const char* start = p;
+#ifdef CATALOG_SWAR
+    while(end - p >= 8 && nbDigits + 8 <= 19)
+    {
+        uint64_t v;
+        memcpy(&v, p, 8);
+        if(!isEightDigits(v))
+            break;
+        mantissa  = mantissa * 100000000 + parseEightDigits(v);
+        nbDigits += 8;
+        exponent -= fraction ? 8 : 0;
+        p        += 8;
+    }
+#endif
+    while(p < end && (unsigned)(*p - '0') < 10)
+    {
+        if(nbDigits < 19)
+        {
+            mantissa = mantissa * 10 + (*p - '0');
+            nbDigits++;
+            exponent -= fraction ? 1 : 0;
+        }
+        else if(!fraction)
+            exponent++;
+        p++;
+    }
+    return p != start;
+}
+
+/** \brief parse a decimal number without locale nor allocation. Exact up to 19 significant digits and 10^22, close enough beyond
+ * \param p the start of the field
+ * \param end the end of the line
+ * \param value the result, NaN if the field is empty or not a number
+ * \return the comma after the field or end */
+static const char* parseNumber(const char* p, const char* end, double* value)
+{
+    while(p < end && *p == ' ')
+        p++;
+    bool negative = false;
+    if(p < end && (*p == '-' || *p == '+'))
+        negative = *p++ == '-';
+
+    uint64_t mantissa = 0;
+    int      nbDigits = 0;
+    int      exponent = 0;
+    bool     digits   = parseDigits(p, end, mantissa, nbDigits, false, exponent);
+    if(p < end && *p == '.')
+    {
+        p++;
+        digits |= parseDigits(p, end, mantissa, nbDigits, true, exponent);
+    }
+    if(digits && p < end && (*p == 'e' || *p == 'E'))
+    {
+        p++;
+        bool negativeExponent = false;
+        if(p < end && (*p == '-' || *p == '+'))
+            negativeExponent = *p++ == '-';
+        int e = 0;
+        while(p < end && (unsigned)(*p - '0') < 10)
+        {
+            if(e < 10000)
+                e = e * 10 + (*p - '0');
+            p++;
+        }
+        exponent += negativeExponent ? -e : e;
+    }
+    while(p < end && (*p == ' ' || *p == '\r'))
+        p++;
+
+    if(!digits || (p < end && *p != ','))
+    {
+        *value = NAN;
+        return findComma(p, end);
+    }
+
+    double v = (double)mantissa;
+    if(exponent >= 0 && exponent <= 22)
+        v *= POW10[exponent];
+    else if(exponent < 0 && exponent >= -22)
+        v /= POW10[-exponent];
+    else
+        v *= pow(10.0, exponent);
+    *value = negative ? -v : v;
+    return p;
+}
+
+/* \brief The rows parsed by one thread in the current window, before they are appended in the file order */
+struct CatalogParser
+{
+    std::vector<float> columns[COLUMN_COUNT];
+    uint64_t nbRows     = 0;
+    uint64_t nbRejected = 0;
+
+    /** \brief parse the rows of a chunk, made of whole lines
+     * \param p the start of the chunk
+     * \param end the end of the chunk
+     * \param fieldColumns the CatalogColumn of each field of a row, -1 if not read */
+    void parse(const char* p, const char* end, const std::vector<int8_t>& fieldColumns)
+    {
+        for(uint32_t c = 0; c < COLUMN_COUNT; c++)
+            columns[c].clear();
+        nbRows = nbRejected = 0;
+
+        while(p < end)
+        {
+            const char* eol = (const char*)memchr(p, '\n', end - p);
+            if(!eol)
+                eol = end;
+            if(eol - p <= 1)
+            {
+                p = eol + 1; //Empty line
+                continue;
+            }
+            nbRows++;
+            const char* line = p;
+
+            double row[COLUMN_COUNT]; //Double for the epochs (Julian days)
+            for(uint32_t c = 0; c < COLUMN_COUNT; c++)
+                row[c] = NAN;
+
+            const char* field = p;
+            for(size_t f = 0; f < fieldColumns.size(); f++)
+            {
+                const char* fieldEnd = fieldColumns[f] < 0 ? skipField(field, eol) : parseNumber(field, eol, &row[fieldColumns[f]]);
+                if(fieldEnd >= eol)
+                    break;
+                field = fieldEnd + 1;
+            }
+            p = eol + 1;
+
+            /* Bound orbits only : the hyperbolic comets are left out */
+            bool valid = eol - line < CATALOG_MAX_LINE && row[COLUMN_A] > 0.0 && row[COLUMN_E] >= 0.0 && row[COLUMN_E] < 1.0;
+            for(uint32_t c = 0; c < CATALOG_NB_REQUIRED; c++)
+                valid = valid && std::isfinite(row[c]);
+            if(!valid)
+            {
+                nbRejected++;
+                continue;
+            }
+
+            row[COLUMN_I]     *= CATALOG_DEG_TO_RAD;
+            row[COLUMN_NODE]  *= CATALOG_DEG_TO_RAD;
+            row[COLUMN_PERI]  *= CATALOG_DEG_TO_RAD;
+            row[COLUMN_M]     *= CATALOG_DEG_TO_RAD;
+            row[COLUMN_EPOCH]  = std::isfinite(row[COLUMN_EPOCH]) ? row[COLUMN_EPOCH] - CATALOG_J2000_JD : 0.0;
+            for(uint32_t c = 0; c < COLUMN_COUNT; c++)
+                columns[c].push_back((float)row[c]);
+        }
+    }
+};
+
+/* \brief Access to a file window by window : mapped on POSIX, read in a buffer elsewhere */
+class CatalogFile
+{
+    public:
+        ~CatalogFile()
+        {
+            unmap();
+#ifdef _WIN32
+            if(m_file)
+                fclose(m_file);
+#else
+            if(m_fd >= 0)
+                close(m_fd);
+#endif
+        }
+
+        bool open(const std::string& path)
+        {
+#ifdef _WIN32
+            m_file = fopen(path.c_str(), "rb");
+            if(!m_file)
+                return false;
+            _fseeki64(m_file, 0, SEEK_END);
+            m_size = _ftelli64(m_file);
+            return true;
+#else
+            m_fd = ::open(path.c_str(), O_RDONLY);
+            struct stat status;
+            if(m_fd < 0 || fstat(m_fd, &status) != 0)
+                return false;
+            m_size = status.st_size;
+            return true;
+#endif
+        }
+
+        /** \brief access a part of the file. The previous window is released
+         * \return the bytes or NULL if error */
+        const char* map(uint64_t offset, uint64_t size)
+        {
+            unmap();
+#ifdef _WIN32
+            m_buffer.resize(size);
+            _fseeki64(m_file, offset, SEEK_SET);
+            if(fread(m_buffer.data(), 1, size, m_file) != size)
+                return NULL;
+            return m_buffer.data();
+#else
+            /* The mapping starts on a page : the window is shifted */
+            uint64_t page    = sysconf(_SC_PAGESIZE);
+            uint64_t aligned = offset - offset % page;
+            m_mappingSize    = size + (offset - aligned);
+            void* mapping    = mmap(NULL, m_mappingSize, PROT_READ, MAP_PRIVATE, m_fd, aligned);
+            if(mapping == MAP_FAILED)
+                return NULL;
+            madvise(mapping, m_mappingSize, MADV_SEQUENTIAL);
+            madvise(mapping, m_mappingSize, MADV_WILLNEED);
+            m_mapping = mapping;
+            return (const char*)mapping + (offset - aligned);
+#endif
+        }
+
+        void unmap()
+        {
+#ifndef _WIN32
+            if(m_mapping)
+                munmap(m_mapping, m_mappingSize);
+            m_mapping = NULL;
+#endif
+        }
+
+        uint64_t getSize() const {return m_size;}
+    private:
+        uint64_t m_size = 0;
+#ifdef _WIN32
+        FILE*             m_file = NULL;
+        std::vector<char> m_buffer;
+#else
+        int      m_fd          = -1;
+        void*    m_mapping     = NULL;
+        uint64_t m_mappingSize = 0;
+#endif
+};
+
+OrbitalCatalog* OrbitalCatalog::load(const std::string& path, uint64_t maxBodies)
+{
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    CatalogFile file;
+    if(!file.open(path))
+    {
+        ERROR("Could not open the catalog %s : %s\n", path.c_str(), strerror(errno));
+        return NULL;
+    }
+    uint64_t size = file.getSize();
+
+    /* The header gives the field of each column */
+    const char* header = file.map(0, std::min<uint64_t>(size, CATALOG_MAX_LINE));
+    const char* headerEnd = header ? (const char*)memchr(header, '\n', std::min<uint64_t>(size, CATALOG_MAX_LINE)) : NULL;
+    if(!headerEnd)
+    {
+        ERROR("The catalog %s has no header row\n", path.c_str());
+        return NULL;
+    }
+    std::vector<int8_t> fieldColumns;
+    bool found[COLUMN_COUNT] = {false};
+    for(const char* field = header; field <= headerEnd; )
+    {
+        const char* fieldEnd = skipField(field, headerEnd);
+        std::string name(field, fieldEnd);
+        name.erase(std::remove_if(name.begin(), name.end(), [](char c) {return c == '"' || c == ' ' || c == '\r';}), name.end());
+
+        int8_t column = -1;
+        for(int c = 0; c < COLUMN_COUNT && column < 0; c++)
+            for(int n = 0; n < 3 && COLUMN_NAMES[c][n]; n++)
+                if(!found[c] && name == COLUMN_NAMES[c][n])
+                    column = c;
+        if(column >= 0)
+            found[column] = true;
+        fieldColumns.push_back(column);
+        field = fieldEnd + 1;
+    }
+    for(int c = 0; c < CATALOG_NB_REQUIRED; c++)
+    {
+        if(!found[c])
+        {
+            ERROR("The catalog %s has no column %s\n", path.c_str(), COLUMN_NAMES[c][0]);
+            return NULL;
+        }
+    }
+    /* The fields after the last column read are not even scanned */
+    while(!fieldColumns.empty() && fieldColumns.back() < 0)
+        fieldColumns.pop_back();
+    uint64_t offset = headerEnd - header + 1;
+
+    uint32_t nbThreads = std::max(1u, std::thread::hardware_concurrency());
+    std::vector<CatalogParser> parsers(nbThreads);
+    OrbitalCatalog* catalog = new OrbitalCatalog();
+    std::vector<float>* arrays[COLUMN_COUNT] = {&catalog->m_semiMajorAxis, &catalog->m_eccentricity, &catalog->m_inclination, &catalog->m_ascendingNode,
+                                                &catalog->m_argPeriapsis, &catalog->m_meanAnomaly, &catalog->m_epoch, &catalog->m_absoluteMagnitude};
+    CatalogStats& stats = catalog->m_stats;
+    stats.nbBytes = size;
+
+    uint32_t progress = 0;
+    while(offset < size && (maxBodies == 0 || catalog->getNbBodies() < maxBodies))
+    {
+        uint64_t windowSize = std::min<uint64_t>(CATALOG_WINDOW_SIZE, size - offset);
+        const char* window = file.map(offset, windowSize);
+        if(!window)
+        {
+            ERROR("Could not read the catalog %s at %llu : %s\n", path.c_str(), (unsigned long long)offset, strerror(errno));
+            delete catalog;
+            return NULL;
+        }
+
+        /* Whole lines only : the last partial line is read again with the next window */
+        const char* end = window + windowSize;
+        if(offset + windowSize < size)
+        {
+            while(end > window && end[-1] != '\n')
+                end--;
+            if(end == window)
+            {
+                ERROR("The catalog %s has a line longer than %u bytes\n", path.c_str(), CATALOG_WINDOW_SIZE);
+                delete catalog;
+                return NULL;
+            }
+        }
+
+        /* One chunk of whole lines per thread */
+        std::vector<std::thread> threads;
+        const char* chunk = window;
+        for(uint32_t t = 0; t < nbThreads; t++)
+        {
+            const char* chunkEnd = t + 1 == nbThreads ? end : std::min(end, chunk + (end - window) / nbThreads);
+            const char* eol = chunkEnd < end ? (const char*)memchr(chunkEnd, '\n', end - chunkEnd) : NULL;
+            chunkEnd = eol ? eol + 1 : end;
+            if(t + 1 == nbThreads)
+                parsers[t].parse(chunk, chunkEnd, fieldColumns);
+            else
+                threads.push_back(std::thread(&CatalogParser::parse, &parsers[t], chunk, chunkEnd, std::cref(fieldColumns)));
+            chunk = chunkEnd;
+        }
+        for(size_t t = 0; t < threads.size(); t++)
+            threads[t].join();
+
+        /* Size the arrays once from the rows of the first window, instead of growing them by copies */
+        if(catalog->getNbBodies() == 0 && offset + (end - window) < size)
+        {
+            uint64_t nbRows = 0;
+            for(uint32_t t = 0; t < nbThreads; t++)
+                nbRows += parsers[t].nbRows;
+            uint64_t estimate = nbRows ? (uint64_t)((double)nbRows * (size - offset) / (end - window) * 1.01) : 0;
+            if(maxBodies)
+                estimate = std::min(estimate, maxBodies);
+            for(uint32_t c = 0; c < COLUMN_COUNT; c++)
+                arrays[c]->reserve(estimate);
+        }
+
+        /* Append in the file order */
+        for(uint32_t t = 0; t < nbThreads; t++)
+        {
+            size_t nbValid = parsers[t].columns[0].size();
+            size_t nbKept  = maxBodies ? std::min<size_t>(nbValid, maxBodies - catalog->getNbBodies()) : nbValid;
+            for(uint32_t c = 0; c < COLUMN_COUNT; c++)
+                arrays[c]->insert(arrays[c]->end(), parsers[t].columns[c].begin(), parsers[t].columns[c].begin() + nbKept);
+            stats.nbRows     += parsers[t].nbRows;
+            stats.nbRejected += parsers[t].nbRejected;
+        }
+        offset += end - window;
+
+        uint32_t percent = (uint32_t)(offset * 100 / size);
+        if(percent / 10 > progress / 10 && offset < size)
+        {
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            INFO("Catalog %s : %u%% (%llu bodies, %.0f MB/s)\n", path.c_str(), percent, (unsigned long long)catalog->getNbBodies(), offset / (seconds * 1e6));
+            progress = percent;
+        }
+    }
+    file.unmap();
+
+    stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    if(offset < size)
+        INFO("Catalog %s : limit of %llu bodies reached, the last %.1f MB are skipped\n", path.c_str(), (unsigned long long)maxBodies, (size - offset) * 1e-6);
+    INFO("Catalog %s : %u bodies loaded from %llu rows (%llu rejected) in %.2f s (%.0f MB/s, %u threads)\n", path.c_str(), catalog->getNbBodies(),
+         (unsigned long long)stats.nbRows, (unsigned long long)stats.nbRejected, stats.seconds, offset / (stats.seconds * 1e6), nbThreads);
+    return catalog;
+}
+
+/** \brief solve Kepler's equation and place a range of bodies*/
+static void computeRange(const OrbitalCatalog* catalog, double days, float* x, float* y, float* z, uint32_t first, uint32_t last)
+{
+    const float* a     = catalog->getSemiMajorAxis();
+    const float* e     = catalog->getEccentricity();
+    const float* inc   = catalog->getInclination();
+    const float* node  = catalog->getAscendingNode();
+    const float* peri  = catalog->getArgPeriapsis();
+    const float* m0    = catalog->getMeanAnomaly();
+    const float* epoch = catalog->getEpoch();
+
+    for(uint32_t i = first; i < last; i++)
+    {
+        /* The mean anomaly grows for decades : reduced in double before the float trigonometry */
+        double meanMotion = CATALOG_GAUSS_K / (a[i] * sqrt((double)a[i]));
+        float  m = (float)fmod(m0[i] + meanMotion * (days - epoch[i]), 2.0 * M_PI);
+
+        float eccentricAnomaly = m + e[i] * sinf(m);
+        for(int k = 0; k < 5; k++)
+            eccentricAnomaly -= (eccentricAnomaly - e[i] * sinf(eccentricAnomaly) - m) / (1.0f - e[i] * cosf(eccentricAnomaly));
+
+        /* In the orbital plane, then rotated by the argument of periapsis, the inclination and the ascending node */
+        float px = a[i] * (cosf(eccentricAnomaly) - e[i]);
+        float py = a[i] * sqrtf(1.0f - e[i] * e[i]) * sinf(eccentricAnomaly);
+        float cosO = cosf(node[i]), sinO = sinf(node[i]);
+        float cosW = cosf(peri[i]), sinW = sinf(peri[i]);
+        float cosI = cosf(inc[i]),  sinI = sinf(inc[i]);
+        x[i] = (cosO * cosW - sinO * sinW * cosI) * px + (-cosO * sinW - sinO * cosW * cosI) * py;
+        y[i] = (sinO * cosW + cosO * sinW * cosI) * px + (-sinO * sinW + cosO * cosW * cosI) * py;
+        z[i] = (sinW * sinI) * px + (cosW * sinI) * py;
+    }
+}
+
+void OrbitalCatalog::computePositions(double days, float* x, float* y, float* z, uint32_t first, uint32_t count, WorkerPool& workers) const
+{
+    uint32_t nbThreads = workers.getNbThreads();
+    if(count < CATALOG_MIN_PARALLEL_BODIES || nbThreads == 1)
+    {
+        computeRange(this, days, x, y, z, first, first + count);
+        return;
+    }
+
+    uint32_t perThread = (count + nbThreads - 1) / nbThreads;
+    workers.run(nbThreads, [&](uint32_t t) {
+        uint32_t begin = first + std::min(count, t * perThread);
+        uint32_t end   = first + std::min(count, (t + 1) * perThread);
+        if(begin < end)
+            computeRange(this, days, x, y, z, begin, end);
+    });
+}
@@ -0,0 +1,223 @@
+#include "ParticleSystem.h"
+#include "WorkerPool.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define PARTICLES_SSE
+#endif
+
+#define PARTICLES_MIN_PARALLEL 65536 /*!< Below, the passes stay on the calling thread*/
+
+/** \brief run f(first, last) on ranges of [0, count[ (multiples of 4), one per thread of the pool */
+template<typename F> static void parallelFor(WorkerPool& workers, uint32_t count, const F& f)
+{
+    uint32_t nbThreads = workers.getNbThreads();
+    if(nbThreads <= 1 || count < PARTICLES_MIN_PARALLEL)
+    {
+        f(0, count);
+        return;
+    }
+    uint32_t perThread = ((count + nbThreads - 1) / nbThreads + 3) & ~3u;
+    workers.run((count + perThread - 1) / perThread, [&](uint32_t t) {
+        f(t * perThread, std::min(count, (t + 1) * perThread));
+    });
+}
+
+ParticleSystem::ParticleSystem(uint32_t capacity, WorkerPool& workers) : m_workers(workers)
+{
+    std::vector<float>* arrays[] = {&m_x, &m_y, &m_z, &m_vx, &m_vy, &m_vz, &m_age, &m_invLife};
+    for(uint32_t i = 0; i < sizeof(arrays) / sizeof(arrays[0]); i++)
+        arrays[i]->resize(capacity);
+    m_emitter.resize(capacity);
+}
+
+uint32_t ParticleSystem::addEmitter(const ParticleEmitter& emitter)
+{
+    if(m_emitters.size() >= PARTICLES_MAX_EMITTERS)
+        return PARTICLES_MAX_EMITTERS;
+    m_emitters.push_back(emitter);
+    return m_emitters.size() - 1;
+}
+
+float ParticleSystem::random()
+{
+    m_random ^= m_random << 13;
+    m_random ^= m_random >> 17;
+    m_random ^= m_random << 5;
+    return (m_random >> 8) * (1.0f / 16777216.0f);
+}
+
+void ParticleSystem::spawn(uint32_t emitter, const glm::vec3& center, float radius, const glm::vec3& direction)
+{
+    if(m_nbParticles >= getCapacity())
+    {
+        m_stats.nbDropped++;
+        return;
+    }
+    const ParticleEmitter& e = m_emitters[emitter];
+
+    /* Uniform direction on the sphere, bent toward the mean direction */
+    float z   = 2.0f * random() - 1.0f;
+    float phi = 2.0f * (float)M_PI * random();
+    float r   = std::sqrt(std::max(0.0f, 1.0f - z * z));
+    glm::vec3 d(r * std::cos(phi), r * std::sin(phi), z);
+    if(direction != glm::vec3(0.0f))
+        d = glm::normalize(glm::normalize(direction) + e.spread * d + glm::vec3(1e-6f));
+
+    float speed    = e.speed * (1.0f + e.speedSpread * (2.0f * random() - 1.0f));
+    float lifetime = e.lifetime * (1.0f + e.lifetimeSpread * (2.0f * random() - 1.0f));
+
+    uint32_t i = m_nbParticles++;
+    m_x[i]  = center.x + radius * d.x;
+    m_y[i]  = center.y + radius * d.y;
+    m_z[i]  = center.z + radius * d.z;
+    m_vx[i] = speed * d.x;
+    m_vy[i] = speed * d.y;
+    m_vz[i] = speed * d.z;
+    m_age[i]     = 0.0f;
+    m_invLife[i] = 1.0f / std::max(lifetime, 1e-3f);
+    m_emitter[i] = emitter;
+    m_stats.nbSpawned++;
+}
+
+void ParticleSystem::burst(uint32_t emitter, const glm::vec3& center, float radius, const glm::vec3& direction, uint32_t count)
+{
+    for(uint32_t i = 0; i < count; i++)
+        spawn(emitter, center, radius, direction);
+}
+
+void ParticleSystem::integrate(uint32_t first, uint32_t last, float dt)
+{
+    float damping = std::pow(m_damping, dt);
+    glm::vec3 dv  = m_acceleration * dt;
+    uint32_t i = first;
+#ifdef PARTICLES_SSE
+    /* Aligned on 4 particles : the threads never share a group */
+    __m128 d4 = _mm_set1_ps(dt), k4 = _mm_set1_ps(damping);
+    __m128 ax = _mm_set1_ps(dv.x), ay = _mm_set1_ps(dv.y), az = _mm_set1_ps(dv.z);
+    for(; i + 4 <= last; i += 4)
+    {
+        __m128 vx = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(&m_vx[i]), k4), ax);
+        __m128 vy = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(&m_vy[i]), k4), ay);
+        __m128 vz = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(&m_vz[i]), k4), az);
+        _mm_storeu_ps(&m_vx[i], vx);
+        _mm_storeu_ps(&m_vy[i], vy);
+        _mm_storeu_ps(&m_vz[i], vz);
+        _mm_storeu_ps(&m_x[i], _mm_add_ps(_mm_loadu_ps(&m_x[i]), _mm_mul_ps(vx, d4)));
+        _mm_storeu_ps(&m_y[i], _mm_add_ps(_mm_loadu_ps(&m_y[i]), _mm_mul_ps(vy, d4)));
+        _mm_storeu_ps(&m_z[i], _mm_add_ps(_mm_loadu_ps(&m_z[i]), _mm_mul_ps(vz, d4)));
+        _mm_storeu_ps(&m_age[i], _mm_add_ps(_mm_loadu_ps(&m_age[i]), d4));
+    }
+#endif
+    for(; i < last; i++)
+    {
+        m_vx[i] = m_vx[i] * damping + dv.x;
+        m_vy[i] = m_vy[i] * damping + dv.y;
+        m_vz[i] = m_vz[i] * damping + dv.z;
+        m_x[i] += m_vx[i] * dt;
+        m_y[i] += m_vy[i] * dt;
+        m_z[i] += m_vz[i] * dt;
+        m_age[i] += dt;
+    }
+}
+
+void ParticleSystem::update(float dt)
+{
+    m_stats = ParticleStats();
+
+    /* Continuous emission from the nodes */
+    for(uint32_t e = 0; e < m_emitters.size(); e++)
+    {
+        ParticleEmitter& emitter = m_emitters[e];
+        if(!emitter.node || emitter.rate <= 0.0f)
+        {
+            emitter.accumulator = 0.0f;
+            continue;
+        }
+        emitter.accumulator += emitter.rate * dt;
+        uint32_t count = (uint32_t)emitter.accumulator;
+        emitter.accumulator -= count;
+        burst(e, glm::vec3(emitter.node->worldCenter), emitter.node->worldRadius, emitter.direction, count);
+    }
+
+    /* Motion */
+    parallelFor(m_workers, m_nbParticles, [this, dt](uint32_t first, uint32_t last) {integrate(first, last, dt);});
+
+    /* Death : the last particle takes the place of the dead one */
+    for(uint32_t i = 0; i < m_nbParticles; )
+    {
+        if(m_age[i] * m_invLife[i] < 1.0f)
+        {
+            i++;
+            continue;
+        }
+        uint32_t last = --m_nbParticles;
+        m_x[i]  = m_x[last];  m_y[i]  = m_y[last];  m_z[i]  = m_z[last];
+        m_vx[i] = m_vx[last]; m_vy[i] = m_vy[last]; m_vz[i] = m_vz[last];
+        m_age[i]     = m_age[last];
+        m_invLife[i] = m_invLife[last];
+        m_emitter[i] = m_emitter[last];
+        m_stats.nbKilled++;
+    }
+    m_stats.nbAlive = m_nbParticles;
+}
+
+void ParticleSystem::buildInstances(const glm::vec3& cameraPosition, ParticleInstance* instances)
+{
+    uint32_t count = m_nbParticles;
+    m_keys.resize(count);
+    m_keysTmp.resize(count);
+    m_order.resize(count);
+    m_orderTmp.resize(count);
+
+    /* Key : the 16 highest bits of the squared distance (sign, exponent and 7 bits of mantissa of a positive float sort like integers), inverted to get the farthest first */
+    parallelFor(m_workers, count, [this, &cameraPosition](uint32_t first, uint32_t last) {
+        for(uint32_t i = first; i < last; i++)
+        {
+            float dx = m_x[i] - cameraPosition.x, dy = m_y[i] - cameraPosition.y, dz = m_z[i] - cameraPosition.z;
+            float distance2 = dx * dx + dy * dy + dz * dz;
+            uint32_t bits;
+            memcpy(&bits, &distance2, sizeof(bits));
+            m_keys[i]  = 0xFFFF - (bits >> 16);
+            m_order[i] = i;
+        }
+    });
+
+    /* LSD radix sort, 8 bits per pass, like the render queue */
+    for(uint32_t shift = 0; shift < 16; shift += 8)
+    {
+        uint32_t offsets[256] = {0};
+        for(uint32_t i = 0; i < count; i++)
+            offsets[(m_keys[i] >> shift) & 0xFF]++;
+        if(count > 0 && offsets[(m_keys[0] >> shift) & 0xFF] == count)
+            continue;
+        for(uint32_t b = 0, sum = 0; b < 256; b++)
+        {
+            uint32_t n = offsets[b];
+            offsets[b] = sum;
+            sum += n;
+        }
+        for(uint32_t i = 0; i < count; i++)
+        {
+            uint32_t slot = offsets[(m_keys[i] >> shift) & 0xFF]++;
+            m_keysTmp[slot]  = m_keys[i];
+            m_orderTmp[slot] = m_order[i];
+        }
+        m_keys.swap(m_keysTmp);
+        m_order.swap(m_orderTmp);
+    }
+
+    parallelFor(m_workers, count, [this, instances, &cameraPosition](uint32_t first, uint32_t last) {
+        for(uint32_t i = first; i < last; i++)
+        {
+            uint32_t p = m_order[i];
+            const ParticleEmitter& e = m_emitters[m_emitter[p]];
+            float t = std::min(1.0f, m_age[p] * m_invLife[p]);
+            instances[i].positionSize = glm::vec4(m_x[p] - cameraPosition.x, m_y[p] - cameraPosition.y, m_z[p] - cameraPosition.z, e.startSize + (e.endSize - e.startSize) * t);
+            instances[i].color        = e.startColor + (e.endColor - e.startColor) * t;
+        }
+    });
+}
@@ -0,0 +1,237 @@
+#include "Profiler.h"
+#include "logger.h"
+#include <chrono>
+#include <algorithm>
+#include <vector>
+#include <map>
+
+static uint64_t clockNs()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+Profiler::Profiler(const char* name, bool gpu)
+{
+    /* The profilers of the different threads share the origin : their traces line up */
+    static const uint64_t origin = clockNs();
+    m_frames = (ProfileFrame*)calloc(PROFILER_MAX_FRAMES, sizeof(ProfileFrame));
+    m_origin = origin;
+    m_name   = name;
+
+    m_gpuSupported = gpu && (GLEW_ARB_timer_query || GLEW_VERSION_3_3);
+    if(m_gpuSupported)
+        glGenQueries(PROFILER_GPU_LATENCY * PROFILER_MAX_GPU_SCOPES, &m_queries[0][0]);
+    else if(gpu)
+        WARNING("GL_ARB_timer_query is not supported, only the CPU is profiled\n");
+    for(uint32_t i = 0; i < PROFILER_GPU_LATENCY; i++)
+        m_queryFrame[i] = UINT64_MAX;
+}
+
+Profiler::~Profiler()
+{
+    if(m_gpuSupported)
+        glDeleteQueries(PROFILER_GPU_LATENCY * PROFILER_MAX_GPU_SCOPES, &m_queries[0][0]);
+    free(m_frames);
+}
+
+uint64_t Profiler::now() const
+{
+    return clockNs() - m_origin;
+}
+
+void Profiler::beginFrame()
+{
+    /* Read the queries of the frame which used this set. PROFILER_GPU_LATENCY frames later, they are normally available.
+     * If one is not, the frame stays unresolved rather than waiting for the GPU : the set is reused by this frame */
+    uint32_t set = m_nbFrames % PROFILER_GPU_LATENCY;
+    if(m_gpuSupported && m_queryFrame[set] != UINT64_MAX)
+    {
+        ProfileFrame& old = m_frames[m_queryFrame[set] % PROFILER_MAX_FRAMES];
+        if(old.index == m_queryFrame[set])
+        {
+            GLuint available = GL_TRUE;
+            for(uint32_t i = 0; i < old.nbGpuScopes && available; i++)
+                glGetQueryObjectuiv(m_queries[set][i], GL_QUERY_RESULT_AVAILABLE, &available);
+            if(available)
+            {
+                for(uint32_t i = 0; i < old.nbGpuScopes; i++)
+                {
+                    GLuint64 elapsed = 0;
+                    glGetQueryObjectui64v(m_queries[set][i], GL_QUERY_RESULT, &elapsed);
+                    old.gpuScopes[i].end = old.gpuScopes[i].begin + elapsed;
+                }
+                old.gpuResolved = true;
+            }
+            else
+                m_nbUnresolved++;
+        }
+        m_queryFrame[set] = UINT64_MAX;
+    }
+
+    m_current = &m_frames[m_nbFrames % PROFILER_MAX_FRAMES];
+    m_current->index       = m_nbFrames;
+    m_current->begin       = now();
+    m_current->end         = m_current->begin;
+    m_current->nbScopes    = 0;
+    m_current->nbGpuScopes = 0;
+    m_current->gpuResolved = !m_gpuSupported;
+    m_depth = 0;
+    m_nbFrames++;
+}
+
+void Profiler::endFrame()
+{
+    if(!m_current)
+        return;
+    while(m_depth > 0)
+        endScope();
+    if(m_gpuOpen)
+        endGpu();
+    m_current->end = now();
+    if(m_current->nbGpuScopes > 0)
+        m_queryFrame[m_current->index % PROFILER_GPU_LATENCY] = m_current->index;
+    m_current = NULL;
+}
+
+void Profiler::beginScope(const char* name)
+{
+    if(!m_current || m_current->nbScopes >= PROFILER_MAX_SCOPES || m_depth >= PROFILER_MAX_SCOPES)
+    {
+        /* Keep the nesting balanced : endScope ignores the dropped scopes */
+        if(m_depth < PROFILER_MAX_SCOPES)
+            m_stack[m_depth] = UINT32_MAX;
+        m_depth++;
+        return;
+    }
+    ProfileEvent& event = m_current->scopes[m_current->nbScopes];
+    event.name  = name;
+    event.depth = m_depth;
+    event.begin = now();
+    event.end   = event.begin;
+    m_stack[m_depth++] = m_current->nbScopes++;
+}
+
+void Profiler::endScope()
+{
+    if(m_depth == 0)
+        return;
+    m_depth--;
+    if(m_current && m_depth < PROFILER_MAX_SCOPES && m_stack[m_depth] < m_current->nbScopes)
+        m_current->scopes[m_stack[m_depth]].end = now();
+}
+
+void Profiler::beginGpu(const char* name)
+{
+    if(!m_current || m_gpuOpen || m_current->nbGpuScopes >= PROFILER_MAX_GPU_SCOPES)
+        return;
+    ProfileEvent& event = m_current->gpuScopes[m_current->nbGpuScopes];
+    event.name  = name;
+    event.depth = 0;
+    event.begin = now();
+    event.end   = event.begin;
+    if(m_gpuSupported)
+        glBeginQuery(GL_TIME_ELAPSED, m_queries[m_current->index % PROFILER_GPU_LATENCY][m_current->nbGpuScopes]);
+    m_gpuOpen = true;
+}
+
+void Profiler::endGpu()
+{
+    if(!m_gpuOpen)
+        return;
+    if(m_gpuSupported)
+        glEndQuery(GL_TIME_ELAPSED);
+    m_current->nbGpuScopes++;
+    m_gpuOpen = false;
+}
+
+void Profiler::printSummary() const
+{
+    /* Total duration of each scope name per frame. The GPU passes are prefixed to tell them apart */
+    std::map<std::string, std::vector<uint64_t> > durations;
+    uint64_t nbFrames = std::min<uint64_t>(m_nbFrames, PROFILER_MAX_FRAMES);
+    for(uint64_t f = 0; f < nbFrames; f++)
+    {
+        const ProfileFrame& frame = m_frames[f];
+        if(&frame == m_current)
+            continue;
+
+        std::map<std::string, uint64_t> frameDurations;
+        frameDurations["frame"] = frame.end - frame.begin;
+        for(uint32_t i = 0; i < frame.nbScopes; i++)
+            frameDurations[frame.scopes[i].name] += frame.scopes[i].end - frame.scopes[i].begin;
+        if(frame.gpuResolved)
+            for(uint32_t i = 0; i < frame.nbGpuScopes; i++)
+                frameDurations[std::string("gpu:") + frame.gpuScopes[i].name] += frame.gpuScopes[i].end - frame.gpuScopes[i].begin;
+
+        for(std::map<std::string, uint64_t>::iterator it = frameDurations.begin(); it != frameDurations.end(); ++it)
+            durations[it->first].push_back(it->second);
+    }
+
+    INFO("Profile of the %s thread over %u frames\n", m_name, (uint32_t)nbFrames);
+    if(m_nbUnresolved > 0)
+        INFO("    %u frames without GPU times : their queries were not available in time\n", m_nbUnresolved);
+    INFO("    (ms)                           min      avg      p99\n");
+    for(std::map<std::string, std::vector<uint64_t> >::iterator it = durations.begin(); it != durations.end(); ++it)
+    {
+        std::vector<uint64_t>& values = it->second;
+        std::sort(values.begin(), values.end());
+        uint64_t sum = 0;
+        for(size_t i = 0; i < values.size(); i++)
+            sum += values[i];
+        size_t p99 = std::min(values.size() - 1, (size_t)((values.size() * 99 + 99) / 100) - 1);
+        INFO("    %-24s %8.3f %8.3f %8.3f\n", it->first.c_str(), values[0] * 1e-6, sum * 1e-6 / values.size(), values[p99] * 1e-6);
+    }
+}
+
+bool Profiler::exportChromeTrace(const std::string& path) const
+{
+    const Profiler* profiler = this;
+    return exportChromeTrace(path, &profiler, 1);
+}
+
+bool Profiler::exportChromeTrace(const std::string& path, const Profiler* const* profilers, uint32_t nbProfilers)
+{
+    FILE* file = fopen(path.c_str(), "w");
+    if(!file)
+    {
+        ERROR("Could not write the trace %s\n", path.c_str());
+        return false;
+    }
+
+    /* Complete events ("X") in microseconds. The CPU scopes of the profiler p are on the thread 2p, its GPU passes on the thread 2p+1 */
+    fprintf(file, "{\"traceEvents\":[");
+    uint32_t nbWritten = 0;
+    for(uint32_t p = 0; p < nbProfilers; p++)
+    {
+        const Profiler& profiler = *profilers[p];
+        uint32_t cpu = 2 * p, gpu = 2 * p + 1;
+        fprintf(file, "%s\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":%u,\"args\":{\"name\":\"%s\"}}", p > 0 ? "," : "", cpu, profiler.m_name);
+        if(profiler.m_gpuSupported)
+            fprintf(file, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":%u,\"args\":{\"name\":\"%s GPU\"}}", gpu, profiler.m_name);
+
+        uint64_t first = profiler.m_nbFrames > PROFILER_MAX_FRAMES ? profiler.m_nbFrames - PROFILER_MAX_FRAMES : 0;
+        for(uint64_t f = first; f < profiler.m_nbFrames; f++)
+        {
+            const ProfileFrame& frame = profiler.m_frames[f % PROFILER_MAX_FRAMES];
+            if(&frame == profiler.m_current)
+                continue;
+            fprintf(file, ",\n{\"name\":\"frame\",\"ph\":\"X\",\"pid\":0,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"index\":%llu}}",
+                    cpu, frame.begin * 1e-3, (frame.end - frame.begin) * 1e-3, (unsigned long long)frame.index);
+            for(uint32_t i = 0; i < frame.nbScopes; i++)
+                fprintf(file, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":0,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+                        frame.scopes[i].name, cpu, frame.scopes[i].begin * 1e-3, (frame.scopes[i].end - frame.scopes[i].begin) * 1e-3);
+            if(frame.gpuResolved)
+                for(uint32_t i = 0; i < frame.nbGpuScopes; i++)
+                    fprintf(file, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":0,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+                            frame.gpuScopes[i].name, gpu, frame.gpuScopes[i].begin * 1e-3, (frame.gpuScopes[i].end - frame.gpuScopes[i].begin) * 1e-3);
+        }
+        nbWritten += (uint32_t)(profiler.m_nbFrames - first);
+    }
+    fprintf(file, "\n]}\n");
+
+    bool written = !ferror(file);
+    fclose(file);
+    if(written)
+        INFO("Trace of %u frames of %u threads written to %s\n", nbWritten, nbProfilers, path.c_str());
+    return written;
+}
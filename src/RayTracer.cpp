@@ -0,0 +1,800 @@
+#include "RayTracer.h"
+#include "Shader.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <thread>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define RAYTRACER_SSE
+#endif
+
+#define TWO_PI (2.0f * (float)M_PI)
+
+/* \brief The 4 lanes of a packet, one per ray : an SSE register, or 4 floats without SSE. A comparison sets every bit of the lanes where it holds */
+struct Lanes
+{
+#ifdef RAYTRACER_SSE
+    __m128 v;
+    Lanes() {}
+    Lanes(__m128 x) : v(x) {}
+    explicit Lanes(float x) : v(_mm_set1_ps(x)) {}
+    static Lanes load(const float* p) {return _mm_load_ps(p);}
+    void store(float* p) const {_mm_store_ps(p, v);}
+#else
+    union
+    {
+        float    f[4];
+        uint32_t u[4];
+    };
+    Lanes() {}
+    explicit Lanes(float x) {for(int i = 0; i < 4; i++) f[i] = x;}
+    static Lanes load(const float* p) {Lanes r; for(int i = 0; i < 4; i++) r.f[i] = p[i]; return r;}
+    void store(float* p) const {for(int i = 0; i < 4; i++) p[i] = f[i];}
+#endif
+};
+
+#ifdef RAYTRACER_SSE
+static inline Lanes operator+(Lanes a, Lanes b)  {return _mm_add_ps(a.v, b.v);}
+static inline Lanes operator-(Lanes a, Lanes b)  {return _mm_sub_ps(a.v, b.v);}
+static inline Lanes operator*(Lanes a, Lanes b)  {return _mm_mul_ps(a.v, b.v);}
+static inline Lanes operator/(Lanes a, Lanes b)  {return _mm_div_ps(a.v, b.v);}
+static inline Lanes operator<(Lanes a, Lanes b)  {return _mm_cmplt_ps(a.v, b.v);}
+static inline Lanes operator>(Lanes a, Lanes b)  {return _mm_cmpgt_ps(a.v, b.v);}
+static inline Lanes operator<=(Lanes a, Lanes b) {return _mm_cmple_ps(a.v, b.v);}
+static inline Lanes operator>=(Lanes a, Lanes b) {return _mm_cmpge_ps(a.v, b.v);}
+static inline Lanes operator&(Lanes a, Lanes b)  {return _mm_and_ps(a.v, b.v);}
+static inline Lanes lanesMin(Lanes a, Lanes b)   {return _mm_min_ps(a.v, b.v);}
+static inline Lanes lanesMax(Lanes a, Lanes b)   {return _mm_max_ps(a.v, b.v);}
+static inline Lanes lanesSqrt(Lanes a)           {return _mm_sqrt_ps(a.v);}
+static inline Lanes select(Lanes mask, Lanes a, Lanes b) {return _mm_or_ps(_mm_and_ps(mask.v, b.v), _mm_andnot_ps(mask.v, a.v));}
+static inline int   moveMask(Lanes mask)         {return _mm_movemask_ps(mask.v);}
+#else
+#define LANES_ARITHMETIC(op) static inline Lanes operator op(Lanes a, Lanes b) {Lanes r; for(int i = 0; i < 4; i++) r.f[i] = a.f[i] op b.f[i]; return r;}
+#define LANES_COMPARISON(op) static inline Lanes operator op(Lanes a, Lanes b) {Lanes r; for(int i = 0; i < 4; i++) r.u[i] = a.f[i] op b.f[i] ? 0xffffffffu : 0u; return r;}
+LANES_ARITHMETIC(+)
+LANES_ARITHMETIC(-)
+LANES_ARITHMETIC(*)
+LANES_ARITHMETIC(/)
+LANES_COMPARISON(<)
+LANES_COMPARISON(>)
+LANES_COMPARISON(<=)
+LANES_COMPARISON(>=)
+static inline Lanes operator&(Lanes a, Lanes b)  {Lanes r; for(int i = 0; i < 4; i++) r.u[i] = a.u[i] & b.u[i]; return r;}
+/* Like minps and maxps : the second operand if one is NaN */
+static inline Lanes lanesMin(Lanes a, Lanes b)   {Lanes r; for(int i = 0; i < 4; i++) r.f[i] = a.f[i] < b.f[i] ? a.f[i] : b.f[i]; return r;}
+static inline Lanes lanesMax(Lanes a, Lanes b)   {Lanes r; for(int i = 0; i < 4; i++) r.f[i] = a.f[i] > b.f[i] ? a.f[i] : b.f[i]; return r;}
+static inline Lanes lanesSqrt(Lanes a)           {Lanes r; for(int i = 0; i < 4; i++) r.f[i] = sqrtf(a.f[i]); return r;}
+static inline Lanes select(Lanes mask, Lanes a, Lanes b) {Lanes r; for(int i = 0; i < 4; i++) r.u[i] = (mask.u[i] & b.u[i]) | (~mask.u[i] & a.u[i]); return r;}
+static inline int   moveMask(Lanes mask)         {int m = 0; for(int i = 0; i < 4; i++) m |= (mask.u[i] >> 31) << i; return m;}
+#endif
+
+/* \brief The rays of a packet, one per lane. A hit is between tMin and tMax, both excluded */
+struct alignas(16) RayTracer::Packet
+{
+    float   ox[4], oy[4], oz[4];
+    float   dx[4], dy[4], dz[4]; /*!< Normalized*/
+    float   tMin[4];
+    float   tMax[4];             /*!< Shortened to the nearest hit*/
+    int32_t hit[4];              /*!< Index in m_items of the nearest hit, -1 if none*/
+};
+
+/* \brief The rays traced by one thread */
+struct RayTracer::Counters
+{
+    uint64_t nbRays       = 0;
+    uint64_t nbShadowRays = 0;
+};
+
+/* \brief A point hit by a view ray, between the traversal of its view ray and the one of its shadow ray */
+struct RayTracer::Surface
+{
+    glm::vec3 position;
+    glm::vec3 normal;
+    glm::vec4 texel;
+};
+
+static inline uint32_t countLanes(int mask)
+{
+    return (mask & 1) + ((mask >> 1) & 1) + ((mask >> 2) & 1) + ((mask >> 3) & 1);
+}
+
+static inline uint32_t hashPixel(uint32_t x, uint32_t y, uint32_t salt)
+{
+    uint32_t h = (x * 0x8da6b343u) ^ (y * 0xd8163841u) ^ (salt * 0xcb1ab31fu);
+    h ^= h >> 16;
+    h *= 0x7feb352du;
+    h ^= h >> 15;
+    h *= 0x846ca68bu;
+    h ^= h >> 16;
+    return h;
+}
+
+/* \brief The point s of the R2 low-discrepancy sequence in [0, 1[², shifted by a seed : the pixels do not share the same pattern */
+static inline glm::vec2 samplePoint(uint32_t s, uint32_t seed)
+{
+    float x = 0.5f + s * 0.7548776662f + (seed & 0xffff) / 65536.0f;
+    float y = 0.5f + s * 0.5698402910f + (seed >> 16) / 65536.0f;
+    return glm::vec2(x - floorf(x), y - floorf(y));
+}
+
+RayTracer::RayTracer(uint32_t nbSamples, uint32_t nbThreads) : m_nbSamples(std::max(1u, nbSamples)), m_nbThreads(nbThreads)
+{
+    if(m_nbThreads == 0)
+        m_nbThreads = std::max(1u, std::thread::hardware_concurrency());
+}
+
+void RayTracer::addTexture(uint32_t id, const uint8_t* rgba, uint32_t width, uint32_t height)
+{
+    Texture& texture = m_textures[id];
+    texture.width  = width;
+    texture.height = height;
+    texture.rgba.assign(rgba, rgba + width * height * 4);
+}
+
+void RayTracer::setSky(const uint8_t* rgba, uint32_t width, uint32_t height)
+{
+    m_sky.width  = width;
+    m_sky.height = height;
+    m_sky.rgba.assign(rgba, rgba + width * height * 4);
+}
+
+void RayTracer::clear()
+{
+    m_items.clear();
+    m_occluders.clear();
+    m_particles.clear();
+}
+
+void RayTracer::addPrimitive(const RayPrimitive& primitive)
+{
+    Item item;
+    item.primitive    = primitive;
+    item.invModel     = glm::inverse(primitive.model);
+    item.normalMatrix = glm::transpose(glm::inverse(glm::mat3(primitive.model)));
+    std::unordered_map<uint32_t, Texture>::const_iterator texture = m_textures.find(primitive.texture);
+    item.texture      = texture != m_textures.end() ? &texture->second : NULL;
+    item.unlit        = (primitive.material.shaderFeatures & SHADER_UNLIT) || (primitive.material.kd == 0.0f && primitive.material.ks == 0.0f);
+    m_items.push_back(item);
+}
+
+void RayTracer::addOccluder(const glm::vec4& sphere)
+{
+    m_occluders.push_back(sphere);
+}
+
+void RayTracer::setParticles(const ParticleInstance* particles, uint32_t nbParticles)
+{
+    m_particles.assign(particles, particles + nbParticles);
+}
+
+void RayTracer::setLight(const glm::vec3& position, float radius, const glm::vec3& color)
+{
+    m_lightPosition = position;
+    m_lightRadius   = radius;
+    m_lightColor    = color;
+}
+
+void RayTracer::setSkyView(bool visible, const glm::mat3& rotation, const glm::vec3& color)
+{
+    m_skyVisible  = visible;
+    m_skyRotation = rotation;
+    m_skyColor    = color;
+}
+
+void RayTracer::buildHierarchy(const std::vector<glm::vec4>& spheres, std::vector<Node>& nodes, std::vector<uint32_t>& indices)
+{
+    nodes.clear();
+    indices.resize(spheres.size());
+    for(uint32_t i = 0; i < indices.size(); i++)
+        indices[i] = i;
+    if(!spheres.empty())
+        buildNode(spheres, nodes, indices, 0, spheres.size());
+}
+
+uint32_t RayTracer::buildNode(const std::vector<glm::vec4>& spheres, std::vector<Node>& nodes, std::vector<uint32_t>& indices, uint32_t first, uint32_t count)
+{
+    glm::vec3 boundsMin(INFINITY), boundsMax(-INFINITY), centersMin(INFINITY), centersMax(-INFINITY);
+    for(uint32_t i = first; i < first + count; i++)
+    {
+        const glm::vec4& sphere = spheres[indices[i]];
+        glm::vec3 center(sphere);
+        boundsMin  = glm::min(boundsMin, center - sphere.w);
+        boundsMax  = glm::max(boundsMax, center + sphere.w);
+        centersMin = glm::min(centersMin, center);
+        centersMax = glm::max(centersMax, center);
+    }
+
+    uint32_t index = nodes.size();
+    nodes.push_back(Node());
+    nodes[index].min = boundsMin;
+    nodes[index].max = boundsMax;
+    if(count <= RAYTRACE_LEAF_SIZE)
+    {
+        nodes[index].first = first;
+        nodes[index].count = count;
+        nodes[index].axis  = 0;
+        return index;
+    }
+
+    /* Half of the spheres on each side of the median of their centers */
+    glm::vec3 extent = centersMax - centersMin;
+    uint16_t  axis   = extent.x >= extent.y && extent.x >= extent.z ? 0 : (extent.y >= extent.z ? 1 : 2);
+    uint32_t  middle = first + count / 2;
+    std::nth_element(indices.begin() + first, indices.begin() + middle, indices.begin() + first + count,
+                     [&spheres, axis](uint32_t a, uint32_t b) {return spheres[a][axis] < spheres[b][axis];});
+
+    buildNode(spheres, nodes, indices, first, middle - first);
+    uint32_t second = buildNode(spheres, nodes, indices, middle, first + count - middle);
+    nodes[index].first = second;
+    nodes[index].count = 0;
+    nodes[index].axis  = axis;
+    return index;
+}
+
+glm::vec4 RayTracer::sample(const Texture& texture, float u, float v)
+{
+    float x  = u * texture.width - 0.5f, y = v * texture.height - 0.5f;
+    float fx = floorf(x), fy = floorf(y);
+    float ax = x - fx, ay = y - fy;
+
+    /* GL_REPEAT, the negative coordinates too */
+    int32_t width = texture.width, height = texture.height;
+    int32_t x0 = ((int32_t)fx % width + width) % width, y0 = ((int32_t)fy % height + height) % height;
+    int32_t x1 = (x0 + 1) % width, y1 = (y0 + 1) % height;
+    auto texel = [&texture, width](int32_t i, int32_t j)
+    {
+        const uint8_t* p = &texture.rgba[(j * width + i) * 4];
+        return glm::vec4(p[0], p[1], p[2], p[3]);
+    };
+    return glm::mix(glm::mix(texel(x0, y0), texel(x1, y0), ax), glm::mix(texel(x0, y1), texel(x1, y1), ax), ay) / 255.0f;
+}
+
+glm::vec3 RayTracer::background(const glm::vec3& direction) const
+{
+    if(!m_skyVisible || m_sky.rgba.empty())
+        return glm::vec3(0.0f);
+
+    /* Into the frame of the sky (the inverse of the rotation is its transpose), then the longitude and the colatitude like the Skybox */
+    glm::vec3 d = glm::transpose(m_skyRotation) * direction;
+    float theta = atan2f(d.x, d.z);
+    if(theta < 0.0f)
+        theta += TWO_PI;
+    float phi = acosf(glm::clamp(d.y, -1.0f, 1.0f));
+    return glm::clamp(m_skyColor * glm::vec3(sample(m_sky, theta / TWO_PI, phi / (float)M_PI)), 0.0f, 1.0f);
+}
+
+glm::vec3 RayTracer::viewRay(float x, float y) const
+{
+    /* The camera is at the origin : a point of the far plane is the direction of its pixel */
+    glm::vec4 p = m_invViewProjection * glm::vec4(x / m_width * 2.0f - 1.0f, y / m_height * 2.0f - 1.0f, 1.0f, 1.0f);
+    return glm::normalize(glm::vec3(p) / p.w);
+}
+
+void RayTracer::intersect(Packet& packet, int mask) const
+{
+    if(m_nodes.empty())
+        return;
+
+    Lanes ox = Lanes::load(packet.ox), oy = Lanes::load(packet.oy), oz = Lanes::load(packet.oz);
+    Lanes dx = Lanes::load(packet.dx), dy = Lanes::load(packet.dy), dz = Lanes::load(packet.dz);
+    Lanes ix = Lanes(1.0f) / dx, iy = Lanes(1.0f) / dy, iz = Lanes(1.0f) / dz;
+    Lanes tMin = Lanes::load(packet.tMin);
+    Lanes zero(0.0f);
+
+    /* The nearest hit of the active lanes with the item i, in its local frame */
+    auto intersectItem = [&](uint32_t i, int active)
+    {
+        const Item&      item = m_items[i];
+        const glm::mat4& m    = item.invModel;
+        Lanes lox = Lanes(m[0][0]) * ox + Lanes(m[1][0]) * oy + Lanes(m[2][0]) * oz + Lanes(m[3][0]);
+        Lanes loy = Lanes(m[0][1]) * ox + Lanes(m[1][1]) * oy + Lanes(m[2][1]) * oz + Lanes(m[3][1]);
+        Lanes loz = Lanes(m[0][2]) * ox + Lanes(m[1][2]) * oy + Lanes(m[2][2]) * oz + Lanes(m[3][2]);
+        Lanes ldx = Lanes(m[0][0]) * dx + Lanes(m[1][0]) * dy + Lanes(m[2][0]) * dz;
+        Lanes ldy = Lanes(m[0][1]) * dx + Lanes(m[1][1]) * dy + Lanes(m[2][1]) * dz;
+        Lanes ldz = Lanes(m[0][2]) * dx + Lanes(m[1][2]) * dy + Lanes(m[2][2]) * dz;
+        Lanes tMax = Lanes::load(packet.tMax);
+
+        Lanes t, hit;
+        if(item.primitive.shape == RAY_SPHERE)
+        {
+            /* From the point of the ray nearest to the center : precise for the small spheres far away */
+            Lanes a  = ldx * ldx + ldy * ldy + ldz * ldz;
+            Lanes tc = zero - (lox * ldx + loy * ldy + loz * ldz) / a;
+            Lanes cx = lox + tc * ldx, cy = loy + tc * ldy, cz = loz + tc * ldz;
+            Lanes h  = (Lanes(0.25f) - (cx * cx + cy * cy + cz * cz)) / a;
+            Lanes s  = lanesSqrt(lanesMax(h, zero));
+            Lanes t0 = tc - s;
+            t   = select(t0 > tMin, tc + s, t0); //The far side from inside the sphere (the sky)
+            hit = (h >= zero) & (t > tMin) & (t < tMax);
+        }
+        else
+        {
+            t = zero - loy / ldy;
+            Lanes px = lox + t * ldx, pz = loz + t * ldz;
+            Lanes r2 = px * px + pz * pz;
+            float inner = item.primitive.innerRadius;
+            hit = (r2 <= Lanes(0.25f)) & (r2 >= Lanes(inner * inner)) & (t > tMin) & (t < tMax);
+        }
+
+        int hits = moveMask(hit) & active;
+        if(hits)
+        {
+            alignas(16) float ts[4];
+            t.store(ts);
+            for(int l = 0; l < 4; l++)
+                if(hits & (1 << l))
+                {
+                    packet.tMax[l] = ts[l];
+                    packet.hit[l]  = i;
+                }
+        }
+    };
+
+    uint32_t stack[64];
+    uint32_t nbStacked = 0;
+    stack[nbStacked++] = 0;
+    while(nbStacked > 0)
+    {
+        uint32_t    index = stack[--nbStacked];
+        const Node& node  = m_nodes[index];
+
+        /* Slabs of the box, for the 4 rays at once */
+        Lanes tMax  = Lanes::load(packet.tMax);
+        Lanes ax    = (Lanes(node.min.x) - ox) * ix, bx = (Lanes(node.max.x) - ox) * ix;
+        Lanes ay    = (Lanes(node.min.y) - oy) * iy, by = (Lanes(node.max.y) - oy) * iy;
+        Lanes az    = (Lanes(node.min.z) - oz) * iz, bz = (Lanes(node.max.z) - oz) * iz;
+        Lanes tNear = lanesMax(lanesMax(lanesMin(ax, bx), lanesMin(ay, by)), lanesMax(lanesMin(az, bz), tMin));
+        Lanes tFar  = lanesMin(lanesMin(lanesMax(ax, bx), lanesMax(ay, by)), lanesMin(lanesMax(az, bz), tMax));
+        int   active = moveMask(tNear <= tFar) & mask;
+        if(!active)
+            continue;
+
+        if(node.count > 0)
+        {
+            for(uint32_t i = node.first; i < node.first + node.count; i++)
+                intersectItem(m_indices[i], active);
+            continue;
+        }
+
+        /* The nearest child first along the direction of an active ray : its hits shorten the rays before the other child is tested */
+        int   lane = active & 1 ? 0 : (active & 2 ? 1 : (active & 4 ? 2 : 3));
+        float d    = node.axis == 0 ? packet.dx[lane] : (node.axis == 1 ? packet.dy[lane] : packet.dz[lane]);
+        uint32_t nearChild = index + 1, farChild = node.first;
+        if(d < 0.0f)
+            std::swap(nearChild, farChild);
+        stack[nbStacked++] = farChild;
+        stack[nbStacked++] = nearChild;
+    }
+}
+
+int RayTracer::occluded(const Packet& packet, int mask) const
+{
+    if(m_occluderNodes.empty())
+        return 0;
+
+    Lanes ox = Lanes::load(packet.ox), oy = Lanes::load(packet.oy), oz = Lanes::load(packet.oz);
+    Lanes dx = Lanes::load(packet.dx), dy = Lanes::load(packet.dy), dz = Lanes::load(packet.dz);
+    Lanes ix = Lanes(1.0f) / dx, iy = Lanes(1.0f) / dy, iz = Lanes(1.0f) / dz;
+    Lanes tMax = Lanes::load(packet.tMax);
+    Lanes zero(0.0f);
+
+    int      result = 0;
+    uint32_t stack[64];
+    uint32_t nbStacked = 0;
+    stack[nbStacked++] = 0;
+    while(nbStacked > 0)
+    {
+        uint32_t    index = stack[--nbStacked];
+        const Node& node  = m_occluderNodes[index];
+
+        Lanes ax    = (Lanes(node.min.x) - ox) * ix, bx = (Lanes(node.max.x) - ox) * ix;
+        Lanes ay    = (Lanes(node.min.y) - oy) * iy, by = (Lanes(node.max.y) - oy) * iy;
+        Lanes az    = (Lanes(node.min.z) - oz) * iz, bz = (Lanes(node.max.z) - oz) * iz;
+        Lanes tNear = lanesMax(lanesMax(lanesMin(ax, bx), lanesMin(ay, by)), lanesMax(lanesMin(az, bz), zero));
+        Lanes tFar  = lanesMin(lanesMin(lanesMax(ax, bx), lanesMax(ay, by)), lanesMin(lanesMax(az, bz), tMax));
+        int   active = moveMask(tNear <= tFar) & mask & ~result;
+        if(!active)
+            continue;
+
+        if(node.count > 0)
+        {
+            /* Any hit between the origin and the light stops the ray : no need for the nearest one */
+            for(uint32_t i = node.first; i < node.first + node.count; i++)
+            {
+                const glm::vec4& sphere = m_occluders[m_occluderIndices[i]];
+                Lanes cx = Lanes(sphere.x) - ox, cy = Lanes(sphere.y) - oy, cz = Lanes(sphere.z) - oz;
+                Lanes tc = cx * dx + cy * dy + cz * dz;
+                Lanes px = cx - tc * dx, py = cy - tc * dy, pz = cz - tc * dz;
+                Lanes h  = Lanes(sphere.w * sphere.w) - (px * px + py * py + pz * pz);
+                Lanes s  = lanesSqrt(lanesMax(h, zero));
+                result |= moveMask((h >= zero) & (tc + s > zero) & (tc - s < tMax)) & active;
+            }
+            if((result & mask) == mask)
+                return result;
+            continue;
+        }
+        stack[nbStacked++] = node.first;
+        stack[nbStacked++] = index + 1;
+    }
+    return result;
+}
+
+void RayTracer::trace(Packet& packet, int mask, const glm::vec2* lightSamples, glm::vec3* colors, float* depths, Counters& counters) const
+{
+    glm::vec3 throughput[4];
+    for(int l = 0; l < 4; l++)
+    {
+        colors[l]     = glm::vec3(0.0f);
+        throughput[l] = glm::vec3(1.0f);
+        depths[l]     = INFINITY;
+    }
+
+    /* A translucent surface lets the ray go on from its hit : the same ray, beyond it */
+    for(uint32_t layer = 0; mask && layer < RAYTRACE_MAX_LAYERS; layer++)
+    {
+        for(int l = 0; l < 4; l++)
+        {
+            packet.tMax[l] = INFINITY;
+            packet.hit[l]  = -1;
+        }
+        counters.nbRays += countLanes(mask);
+        intersect(packet, mask);
+
+        /* The surfaces, and a shadow ray towards a point of the light disc from the lit side of each one */
+        Surface surfaces[4];
+        Packet  shadows = {};
+        int     shadowMask = 0;
+        for(int l = 0; l < 4; l++)
+        {
+            if(!(mask & (1 << l)))
+                continue;
+            glm::vec3 direction(packet.dx[l], packet.dy[l], packet.dz[l]);
+            if(packet.hit[l] < 0)
+            {
+                colors[l] += throughput[l] * background(direction);
+                mask &= ~(1 << l);
+                continue;
+            }
+
+            const Item& item    = m_items[packet.hit[l]];
+            Surface&    surface = surfaces[l];
+            surface.position = glm::vec3(packet.ox[l], packet.oy[l], packet.oz[l]) + packet.tMax[l] * direction;
+            glm::vec3 local  = glm::vec3(item.invModel * glm::vec4(surface.position, 1.0f));
+            glm::vec2 uv;
+            if(item.primitive.shape == RAY_SPHERE)
+            {
+                /* Longitude from +z towards +x and colatitude from +y, like the vertices of the sphere */
+                glm::vec3 n = glm::normalize(local);
+                float theta = atan2f(n.x, n.z);
+                if(theta < 0.0f)
+                    theta += TWO_PI;
+                uv = glm::vec2(theta / TWO_PI, acosf(glm::clamp(n.y, -1.0f, 1.0f)) / (float)M_PI) * item.primitive.uvScale;
+                surface.normal = glm::normalize(item.normalMatrix * local);
+            }
+            else
+            {
+                /* Angle counterclockwise seen from +y, radius from the inner edge to the outer one, like the vertices of the annulus */
+                float angle = atan2f(-local.z, local.x);
+                if(angle < 0.0f)
+                    angle += TWO_PI;
+                float inner = item.primitive.innerRadius;
+                uv = glm::vec2(angle / TWO_PI, (sqrtf(local.x * local.x + local.z * local.z) - inner) / (0.5f - inner));
+                surface.normal = glm::normalize(item.normalMatrix * glm::vec3(0.0f, 1.0f, 0.0f));
+            }
+            surface.texel = item.texture ? sample(*item.texture, uv.x, uv.y) : glm::vec4(1.0f);
+
+            glm::vec3 toLight = m_lightPosition - surface.position;
+            float     lightDistance = glm::length(toLight);
+            if(item.unlit || m_occluderNodes.empty() || lightDistance <= 0.0f || glm::dot(surface.normal, toLight) <= 0.0f)
+                continue;
+            glm::vec3 axis      = toLight / lightDistance;
+            glm::vec3 tangent   = glm::normalize(glm::cross(axis, fabsf(axis.y) < 0.99f ? glm::vec3(0.0f, 1.0f, 0.0f) : glm::vec3(1.0f, 0.0f, 0.0f)));
+            glm::vec3 bitangent = glm::cross(axis, tangent);
+            float     radius    = m_lightRadius * sqrtf(lightSamples[l].x);
+            float     angle     = TWO_PI * lightSamples[l].y;
+            glm::vec3 target    = m_lightPosition + radius * (cosf(angle) * tangent + sinf(angle) * bitangent);
+
+            /* Off the surface, relative to the precision of its distance to the camera */
+            glm::vec3 origin   = surface.position + surface.normal * (1e-4f * glm::length(surface.position) + 1e-6f);
+            glm::vec3 toTarget = target - origin;
+            float     distance = glm::length(toTarget);
+            shadows.ox[l]   = origin.x;
+            shadows.oy[l]   = origin.y;
+            shadows.oz[l]   = origin.z;
+            shadows.dx[l]   = toTarget.x / distance;
+            shadows.dy[l]   = toTarget.y / distance;
+            shadows.dz[l]   = toTarget.z / distance;
+            shadows.tMax[l] = distance;
+            shadowMask |= 1 << l;
+        }
+        int inShadow = shadowMask ? occluded(shadows, shadowMask) : 0;
+        counters.nbRays       += countLanes(shadowMask);
+        counters.nbShadowRays += countLanes(shadowMask);
+
+        /* The shading of colorTexture.frag, each surface clamped like a fragment */
+        for(int l = 0; l < 4; l++)
+        {
+            if(!(mask & (1 << l)))
+                continue;
+            const Item&     item    = m_items[packet.hit[l]];
+            const Material& mtl     = item.primitive.material;
+            const Surface&  surface = surfaces[l];
+            glm::vec3 rgb = mtl.ka * mtl.color * m_lightColor;
+            if(!item.unlit)
+            {
+                glm::vec3 lightDir = glm::normalize(m_lightPosition - surface.position);
+                glm::vec3 diffuse  = mtl.kd * std::max(0.0f, glm::dot(surface.normal, lightDir)) * mtl.color * m_lightColor;
+                glm::vec3 specular(0.0f);
+                if(mtl.ks != 0.0f)
+                {
+                    glm::vec3 V = glm::normalize(-surface.position);
+                    glm::vec3 R = glm::reflect(-lightDir, surface.normal);
+                    specular = mtl.ks * powf(std::max(0.0f, glm::dot(R, V)), mtl.alpha) * m_lightColor;
+                }
+                float visibility = (inShadow & (1 << l)) ? 0.0f : 1.0f;
+                rgb += visibility * (diffuse + specular);
+            }
+            rgb = glm::clamp(rgb * glm::vec3(surface.texel), 0.0f, 1.0f);
+
+            if(item.primitive.translucent)
+            {
+                float alpha = glm::clamp(surface.texel.w, 0.0f, 1.0f);
+                colors[l]     += throughput[l] * alpha * rgb;
+                throughput[l] *= 1.0f - alpha;
+                packet.tMin[l] = packet.tMax[l];
+                if(std::max(throughput[l].x, std::max(throughput[l].y, throughput[l].z)) < 1.0f / 512.0f)
+                    mask &= ~(1 << l);
+            }
+            else
+            {
+                colors[l] += throughput[l] * rgb;
+                depths[l]  = packet.tMax[l];
+                mask &= ~(1 << l);
+            }
+        }
+    }
+
+    /* Through too many layers : what is left only sees the background */
+    for(int l = 0; l < 4; l++)
+        if(mask & (1 << l))
+            colors[l] += throughput[l] * background(glm::vec3(packet.dx[l], packet.dy[l], packet.dz[l]));
+}
+
+void RayTracer::renderTile(uint32_t tile, uint8_t* rgba, Counters& counters) const
+{
+    uint32_t x0 = (tile % m_nbTilesX) * RAYTRACE_TILE_SIZE, y0 = (tile / m_nbTilesX) * RAYTRACE_TILE_SIZE;
+    uint32_t x1 = std::min(x0 + RAYTRACE_TILE_SIZE, m_width), y1 = std::min(y0 + RAYTRACE_TILE_SIZE, m_height);
+    glm::vec3 colors[RAYTRACE_TILE_SIZE * RAYTRACE_TILE_SIZE];
+    float     depths[RAYTRACE_TILE_SIZE * RAYTRACE_TILE_SIZE];
+
+    for(uint32_t y = y0; y < y1; y += 2)
+    {
+        for(uint32_t x = x0; x < x1; x += 2)
+        {
+            /* A packet of 2x2 pixels per sample. The lanes past the edges of the image are inactive */
+            int       mask = 0;
+            uint32_t  seeds[4];
+            glm::vec3 sums[4];
+            float     firstDepths[4];
+            for(int l = 0; l < 4; l++)
+            {
+                uint32_t px = x + (l & 1), py = y + (l >> 1);
+                if(px < x1 && py < y1)
+                    mask |= 1 << l;
+                seeds[l] = hashPixel(px, py, 0);
+                sums[l]  = glm::vec3(0.0f);
+            }
+
+            for(uint32_t s = 0; s < m_nbSamples; s++)
+            {
+                Packet    packet = {};
+                glm::vec2 lightSamples[4];
+                for(int l = 0; l < 4; l++)
+                {
+                    /* A single sample : the center of the pixel and of the light */
+                    glm::vec2 jitter(0.5f);
+                    lightSamples[l] = glm::vec2(0.0f);
+                    if(m_nbSamples > 1)
+                    {
+                        jitter          = samplePoint(s, seeds[l]);
+                        lightSamples[l] = samplePoint(s, hashPixel(seeds[l], s, 1));
+                    }
+                    glm::vec3 direction = viewRay(x + (l & 1) + jitter.x, y + (l >> 1) + jitter.y);
+                    packet.dx[l] = direction.x;
+                    packet.dy[l] = direction.y;
+                    packet.dz[l] = direction.z;
+                }
+
+                glm::vec3 sampleColors[4];
+                float     sampleDepths[4];
+                trace(packet, mask, lightSamples, sampleColors, sampleDepths, counters);
+                for(int l = 0; l < 4; l++)
+                {
+                    sums[l] += glm::clamp(sampleColors[l], 0.0f, 1.0f);
+                    if(s == 0)
+                        firstDepths[l] = sampleDepths[l];
+                }
+            }
+
+            for(int l = 0; l < 4; l++)
+            {
+                if(!(mask & (1 << l)))
+                    continue;
+                uint32_t i = (y + (l >> 1) - y0) * RAYTRACE_TILE_SIZE + (x + (l & 1) - x0);
+                colors[i] = sums[l] / (float)m_nbSamples;
+                depths[i] = firstDepths[l];
+            }
+        }
+    }
+
+    /* The billboards from the farthest, blended where they are in front of the first opaque surface. The view rotates only : the rays stay normalized */
+    const std::vector<uint32_t>& particles = m_tileParticles[tile];
+    if(!particles.empty())
+    {
+        glm::mat3 rotation(m_view);
+        for(uint32_t y = y0; y < y1; y++)
+        {
+            for(uint32_t x = x0; x < x1; x++)
+            {
+                uint32_t   i     = (y - y0) * RAYTRACE_TILE_SIZE + (x - x0);
+                glm::vec3  d     = rotation * viewRay(x + 0.5f, y + 0.5f);
+                glm::vec3& color = colors[i];
+                for(size_t p = 0; p < particles.size(); p++)
+                {
+                    const glm::vec4& center = m_particleCenters[particles[p]];
+                    float t = center.z / d.z;
+                    if(d.z >= 0.0f || t >= depths[i])
+                        continue;
+                    glm::vec2 corner = (glm::vec2(d.x, d.y) * t - glm::vec2(center.x, center.y)) / center.w;
+                    if(fabsf(corner.x) > 0.5f || fabsf(corner.y) > 0.5f)
+                        continue;
+                    const glm::vec4& particleColor = m_particles[particles[p]].color;
+                    float alpha = particleColor.w * (1.0f - glm::smoothstep(0.3f, 1.0f, glm::length(corner * 2.0f)));
+                    color = glm::mix(color, glm::vec3(particleColor), glm::clamp(alpha, 0.0f, 1.0f));
+                }
+            }
+        }
+    }
+
+    for(uint32_t y = y0; y < y1; y++)
+    {
+        for(uint32_t x = x0; x < x1; x++)
+        {
+            glm::vec3 color = glm::clamp(colors[(y - y0) * RAYTRACE_TILE_SIZE + (x - x0)], 0.0f, 1.0f);
+            uint8_t*  pixel = &rgba[(y * m_width + x) * 4];
+            pixel[0] = (uint8_t)(color.x * 255.0f + 0.5f);
+            pixel[1] = (uint8_t)(color.y * 255.0f + 0.5f);
+            pixel[2] = (uint8_t)(color.z * 255.0f + 0.5f);
+            pixel[3] = 255;
+        }
+    }
+}
+
+void RayTracer::render(const glm::mat4& view, const glm::mat4& projection, uint32_t width, uint32_t height, uint8_t* rgba)
+{
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    m_view              = view;
+    m_projection        = projection;
+    m_invViewProjection = glm::inverse(projection * view);
+    m_width             = width;
+    m_height            = height;
+    m_nbTilesX          = (width + RAYTRACE_TILE_SIZE - 1) / RAYTRACE_TILE_SIZE;
+    uint32_t nbTilesY   = (height + RAYTRACE_TILE_SIZE - 1) / RAYTRACE_TILE_SIZE;
+    uint32_t nbTiles    = m_nbTilesX * nbTilesY;
+
+    /* The hierarchies of the frame : the primitives by their bounding spheres, the occluders but the source of the light */
+    std::vector<glm::vec4> spheres(m_items.size());
+    for(size_t i = 0; i < m_items.size(); i++)
+    {
+        const glm::mat4& model = m_items[i].primitive.model;
+        float scale = std::max(glm::length(glm::vec3(model[0])), std::max(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))));
+        spheres[i] = glm::vec4(glm::vec3(model[3]), 0.5f * scale);
+    }
+    buildHierarchy(spheres, m_nodes, m_indices);
+    m_occluders.erase(std::remove_if(m_occluders.begin(), m_occluders.end(), [this](const glm::vec4& sphere)
+                      {return glm::length(m_lightPosition - glm::vec3(sphere)) < sphere.w;}), m_occluders.end());
+    buildHierarchy(m_occluders, m_occluderNodes, m_occluderIndices);
+
+    /* Each particle into the tiles its billboard overlaps, in the order of the blending */
+    m_tileParticles.resize(nbTiles);
+    for(uint32_t t = 0; t < nbTiles; t++)
+        m_tileParticles[t].clear();
+    m_particleCenters.resize(m_particles.size());
+    for(uint32_t i = 0; i < m_particles.size(); i++)
+    {
+        const glm::vec4& positionSize = m_particles[i].positionSize;
+        glm::vec3 center = glm::vec3(view * glm::vec4(glm::vec3(positionSize), 1.0f));
+        m_particleCenters[i] = glm::vec4(center, positionSize.w);
+        if(center.z > -1e-4f || positionSize.w <= 0.0f)
+            continue;
+        glm::vec2 pixelsMin(INFINITY), pixelsMax(-INFINITY);
+        for(int c = 0; c < 4; c++)
+        {
+            glm::vec4 clip = projection * glm::vec4(center.x + ((c & 1) ? 0.5f : -0.5f) * positionSize.w, center.y + ((c & 2) ? 0.5f : -0.5f) * positionSize.w, center.z, 1.0f);
+            glm::vec2 pixel = (glm::vec2(clip.x, clip.y) / clip.w * 0.5f + 0.5f) * glm::vec2(width, height);
+            pixelsMin = glm::min(pixelsMin, pixel);
+            pixelsMax = glm::max(pixelsMax, pixel);
+        }
+        if(pixelsMax.x < 0.0f || pixelsMax.y < 0.0f || pixelsMin.x >= width || pixelsMin.y >= height)
+            continue;
+        uint32_t tx0 = (uint32_t)std::max(0.0f, pixelsMin.x - 1.0f) / RAYTRACE_TILE_SIZE, tx1 = std::min((uint32_t)(pixelsMax.x + 1.0f), width - 1) / RAYTRACE_TILE_SIZE;
+        uint32_t ty0 = (uint32_t)std::max(0.0f, pixelsMin.y - 1.0f) / RAYTRACE_TILE_SIZE, ty1 = std::min((uint32_t)(pixelsMax.y + 1.0f), height - 1) / RAYTRACE_TILE_SIZE;
+        for(uint32_t ty = ty0; ty <= ty1; ty++)
+            for(uint32_t tx = tx0; tx <= tx1; tx++)
+                m_tileParticles[ty * m_nbTilesX + tx].push_back(i);
+    }
+
+    /* A contiguous range of tiles per thread, begin in the low 32 bits and end in the high ones : its thread takes the tiles from the front,
+     * a thread without any tile left moves the end of the largest range to its middle and takes the second half */
+    struct alignas(64) TileRange
+    {
+        std::atomic<uint64_t> tiles;
+    };
+    auto pack = [](uint32_t begin, uint32_t end) {return (uint64_t)begin | ((uint64_t)end << 32);};
+    uint32_t nbThreads = std::max(1u, std::min(m_nbThreads, nbTiles));
+    std::vector<TileRange> ranges(nbThreads);
+    for(uint32_t t = 0; t < nbThreads; t++)
+        ranges[t].tiles.store(pack((uint64_t)nbTiles * t / nbThreads, (uint64_t)nbTiles * (t + 1) / nbThreads));
+
+    std::atomic<uint64_t> nbRays(0), nbShadowRays(0);
+    std::atomic<uint32_t> nbSteals(0);
+    auto work = [&](uint32_t t)
+    {
+        Counters counters;
+        uint32_t steals = 0;
+        while(true)
+        {
+            uint64_t tiles = ranges[t].tiles.load();
+            uint32_t begin = (uint32_t)tiles, end = (uint32_t)(tiles >> 32);
+            if(begin < end)
+            {
+                if(ranges[t].tiles.compare_exchange_weak(tiles, pack(begin + 1, end)))
+                    renderTile(begin, rgba, counters);
+                continue;
+            }
+
+            uint32_t victim = t, largest = 0;
+            uint64_t victimTiles = 0;
+            for(uint32_t v = 0; v < nbThreads; v++)
+            {
+                uint64_t other = ranges[v].tiles.load();
+                uint32_t left  = (uint32_t)(other >> 32) - (uint32_t)other;
+                if(v != t && left > largest)
+                {
+                    victim      = v;
+                    largest     = left;
+                    victimTiles = other;
+                }
+            }
+            if(largest == 0)
+                break;
+            uint32_t victimBegin = (uint32_t)victimTiles, victimEnd = (uint32_t)(victimTiles >> 32);
+            uint32_t middle = victimBegin + (victimEnd - victimBegin) / 2;
+            if(ranges[victim].tiles.compare_exchange_strong(victimTiles, pack(victimBegin, middle)))
+            {
+                ranges[t].tiles.store(pack(middle, victimEnd));
+                steals++;
+            }
+        }
+        nbRays       += counters.nbRays;
+        nbShadowRays += counters.nbShadowRays;
+        nbSteals     += steals;
+    };
+
+    std::vector<std::thread> threads;
+    for(uint32_t t = 1; t < nbThreads; t++)
+        threads.push_back(std::thread(work, t));
+    work(0);
+    for(size_t t = 0; t < threads.size(); t++)
+        threads[t].join();
+
+    m_stats.nbRays       = nbRays;
+    m_stats.nbShadowRays = nbShadowRays;
+    m_stats.nbTiles      = nbTiles;
+    m_stats.nbSteals     = nbSteals;
+    m_stats.nbThreads    = nbThreads;
+    m_stats.seconds      = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
@@ -0,0 +1,196 @@
+#include "RenderQueue.h"
+#include <glm/gtc/type_ptr.hpp>
+#include <algorithm>
+#include <cstring>
+
+uint64_t RenderQueue::makeKey(RenderLayer layer, GLuint program, GLuint texture, GLuint mesh, float depth)
+{
+    uint64_t d = (uint64_t)(std::min(1.0f, std::max(0.0f, depth)) * 0xFFFF);
+    uint64_t key = (uint64_t)layer << 62;
+    if(layer >= LAYER_WEIGHTED)
+        key |= ((0xFFFF - d) << 46) | ((uint64_t)(program & 0xFF) << 38);
+    else
+        key |= ((uint64_t)(program & 0xFF) << 54) | (d << 38);
+    key |= ((uint64_t)(texture & 0xFFFF) << 22) | ((uint64_t)(mesh & 0xFFFF) << 6);
+    return key;
+}
+
+void RenderQueue::clear()
+{
+    m_packets.clear();
+}
+
+void RenderQueue::sort()
+{
+    uint32_t nbPackets = m_packets.size();
+    m_keys.resize(nbPackets);
+    m_keysTmp.resize(nbPackets);
+    m_order.resize(nbPackets);
+    m_orderTmp.resize(nbPackets);
+    for(uint32_t i = 0; i < nbPackets; i++)
+    {
+        m_keys[i]  = m_packets[i].key;
+        m_order[i] = i;
+    }
+
+    for(uint32_t shift = 0; shift < 64; shift += 8)
+    {
+        uint32_t histogram[256];
+        memset(histogram, 0, sizeof(histogram));
+        for(uint32_t i = 0; i < nbPackets; i++)
+            histogram[(m_keys[i] >> shift) & 0xFF]++;
+
+        /* Every key has the same byte : this pass would not move anything */
+        if(nbPackets == 0 || histogram[(m_keys[0] >> shift) & 0xFF] == nbPackets)
+            continue;
+
+        uint32_t offset = 0;
+        for(uint32_t b = 0; b < 256; b++)
+        {
+            uint32_t count = histogram[b];
+            histogram[b] = offset;
+            offset += count;
+        }
+
+        for(uint32_t i = 0; i < nbPackets; i++)
+        {
+            uint32_t dst = histogram[(m_keys[i] >> shift) & 0xFF]++;
+            m_keysTmp[dst]  = m_keys[i];
+            m_orderTmp[dst] = m_order[i];
+        }
+        m_keys.swap(m_keysTmp);
+        m_order.swap(m_orderTmp);
+    }
+}
+
+void RenderQueue::submit(UniformBuffers* uniformBuffers, const FrameUniforms& frame, WeightedBlending* weighted, const Skybox* sky)
+{
+    m_stats = RenderStats();
+
+    GLuint   currentProgram = 0, currentVAO = 0, currentTexture = 0;
+    uint32_t currentLayer   = LAYER_OPAQUE;
+    bool     first          = true;
+
+    auto drawSky = [&]()
+    {
+        sky->draw();
+        m_stats.nbDraws++;
+        m_stats.programBinds++;
+        m_stats.textureBinds++;
+        first = true; //Everything was unbound
+    };
+
+    /* Every object block is written before the first draw : one flush for the frame, then each draw binds its range */
+    if(uniformBuffers)
+    {
+        uniformBuffers->beginFrame(frame, m_order.size());
+        for(uint32_t i = 0; i < m_order.size(); i++)
+        {
+            DrawPacket& packet = m_packets[m_order[i]];
+            packet.object.material[0] = uniformBuffers->getMaterialIndex(packet.material);
+            uniformBuffers->setObject(i, packet.object);
+        }
+        uniformBuffers->flush();
+    }
+
+    glActiveTexture(GL_TEXTURE0);
+    for(uint32_t i = 0; i < m_order.size(); i++)
+    {
+        DrawPacket& packet = m_packets[m_order[i]];
+
+        uint32_t layer = packet.key >> 62;
+        if(layer != currentLayer)
+        {
+            /* The background fills what the opaque objects left : the translucent ones are blended over it */
+            if(sky && currentLayer < LAYER_WEIGHTED && layer >= LAYER_WEIGHTED)
+                drawSky();
+            if(currentLayer == LAYER_WEIGHTED && weighted)
+            {
+                weighted->composite();
+                first = true; //Everything was unbound
+            }
+            if(layer == LAYER_WEIGHTED && weighted)
+                weighted->begin();
+            else if(layer >= LAYER_WEIGHTED)
+            {
+                glEnable(GL_BLEND);
+                glBlendFuncSeparate(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, GL_ONE, GL_ONE_MINUS_SRC_ALPHA); //The target stays opaque (exported frames)
+                glDepthMask(GL_FALSE);
+            }
+            currentLayer = layer;
+        }
+
+        GLuint program = packet.shader->getProgramID();
+        if(first || program != currentProgram)
+        {
+            glUseProgram(program);
+            currentProgram = program;
+            m_stats.programBinds++;
+        }
+        if(first || packet.vao != currentVAO)
+        {
+            glBindVertexArray(packet.vao);
+            currentVAO = packet.vao;
+            m_stats.bufferBinds++;
+        }
+        if(first || packet.texture != currentTexture)
+        {
+            glBindTexture(GL_TEXTURE_2D, packet.texture);
+            currentTexture = packet.texture;
+            m_stats.textureBinds++;
+        }
+        first = false;
+
+        if(uniformBuffers)
+        {
+            uniformBuffers->bindObject(i);
+            m_stats.bufferBinds++;
+        }
+        else
+        {
+            /* Programs without uniform blocks : everything is set for each draw */
+            glm::mat3 invModel3x3(glm::vec3(packet.object.invModel3x3[0]), glm::vec3(packet.object.invModel3x3[1]), glm::vec3(packet.object.invModel3x3[2]));
+            glUniformMatrix4fv(glGetUniformLocation(program, "uMVP"),           1, GL_FALSE, glm::value_ptr(packet.object.mvp));
+            glUniformMatrix4fv(glGetUniformLocation(program, "uModel"),         1, GL_FALSE, glm::value_ptr(packet.object.model));
+            glUniformMatrix3fv(glGetUniformLocation(program, "uInvModel3x3"),   1, GL_FALSE, glm::value_ptr(invModel3x3));
+            glUniform3fv(glGetUniformLocation(program, "uMtlColor"),            1, glm::value_ptr(packet.material.color));
+            glUniform4f(glGetUniformLocation(program, "uMtlCts"),               packet.material.ka, packet.material.kd, packet.material.ks, packet.material.alpha);
+            glUniform3fv(glGetUniformLocation(program, "uLightPos"),            1, glm::value_ptr(frame.lightPosition));
+            glUniform3fv(glGetUniformLocation(program, "uLightColor"),          1, glm::value_ptr(frame.lightColor));
+            glUniform3fv(glGetUniformLocation(program, "uCameraPosition"),      1, glm::value_ptr(frame.cameraPosition));
+            glUniform4fv(glGetUniformLocation(program, "uDepthParams"),         1, glm::value_ptr(frame.depthParams));
+            glUniform1i(glGetUniformLocation(program, "uTexture"), 0);
+            if(packet.object.material[1] > 0)
+            {
+                glUniform1f(glGetUniformLocation(program, "uLightRadius"),      frame.lightPosition.w);
+                glUniform1i(glGetUniformLocation(program, "uNbOccluders"),      packet.object.material[1]);
+                glUniform4fv(glGetUniformLocation(program, "uOccluders"),       packet.object.material[1], glm::value_ptr(packet.object.occluders[0]));
+            }
+            if(packet.nbInstances > 0)
+            {
+                glUniformMatrix4fv(glGetUniformLocation(program, "uViewProjection"), 1, GL_FALSE, glm::value_ptr(frame.viewProjection));
+                glUniformMatrix4fv(glGetUniformLocation(program, "uView"),           1, GL_FALSE, glm::value_ptr(frame.view));
+                glUniformMatrix4fv(glGetUniformLocation(program, "uProjection"),     1, GL_FALSE, glm::value_ptr(frame.projection));
+            }
+        }
+
+        if(packet.nbInstances > 0)
+            glDrawArraysInstancedARB(packet.primitive, packet.first, packet.nbVertices, packet.nbInstances);
+        else
+            glDrawArrays(packet.primitive, packet.first, packet.nbVertices);
+        m_stats.nbDraws++;
+    }
+
+    if(sky && currentLayer < LAYER_WEIGHTED)
+        drawSky();
+    else if(currentLayer == LAYER_WEIGHTED && weighted)
+        weighted->composite();
+    else if(currentLayer >= LAYER_WEIGHTED)
+    {
+        glDepthMask(GL_TRUE);
+        glDisable(GL_BLEND);
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glBindVertexArray(0);
+    glUseProgram(0);
+}
@@ -0,0 +1,533 @@
+#include "Scene.h"
+#include "Shader.h"
+#include "logger.h"
+#include <glm/gtc/matrix_transform.hpp>
+#include <unordered_map>
+#include <cmath>
+#include <cerrno>
+
+#ifdef _WIN32
+#include <stdio.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#define SCENE_BYTE_ORDER 0x01020304
+
+/* The binary form is used in place : the sections must stay 8 bytes aligned */
+static_assert(sizeof(SceneMaterial)   % 8 == 0, "SceneMaterial must be 8 bytes aligned");
+static_assert(sizeof(SceneTexture)    % 8 == 0, "SceneTexture must be 8 bytes aligned");
+static_assert(sizeof(SceneNode)       % 8 == 0, "SceneNode must be 8 bytes aligned");
+static_assert(sizeof(SceneFileHeader) % 8 == 0, "SceneFileHeader must be 8 bytes aligned");
+
+Scene::Scene()
+{
+    memset(&m_header, 0, sizeof(m_header));
+}
+
+Scene::~Scene()
+{
+    if(m_mapping)
+    {
+#ifdef _WIN32
+        free(m_mapping);
+#else
+        munmap(m_mapping, m_mappingSize);
+#endif
+    }
+}
+
+Scene* Scene::load(const std::string& path)
+{
+    FILE* file = fopen(path.c_str(), "rb");
+    if(!file)
+    {
+        ERROR("Could not open the scene %s : %s\n", path.c_str(), strerror(errno));
+        return NULL;
+    }
+    char magic[4] = {0};
+    size_t nbRead = fread(magic, 1, 4, file);
+    fclose(file);
+
+    if(nbRead == 4 && memcmp(magic, SCENE_MAGIC, 4) == 0)
+        return loadBinary(path);
+    return loadText(path);
+}
+
+/* \brief Cursor on the tokens of a line of the text form */
+struct SceneLineParser
+{
+    char* cursor;
+
+    /** \brief get the next token, separated by spaces or tabs
+     * \return the token or NULL at the end of the line */
+    char* next()
+    {
+        while(*cursor == ' ' || *cursor == '\t' || *cursor == '\r')
+            cursor++;
+        if(*cursor == 0 || *cursor == '#')
+            return NULL;
+        char* token = cursor;
+        while(*cursor && *cursor != ' ' && *cursor != '\t' && *cursor != '\r')
+            cursor++;
+        if(*cursor)
+            *cursor++ = 0;
+        return token;
+    }
+};
+
+/** \brief parse "x,y,z" (or "x" for the three components)
+ * \param text the text
+ * \param v the result
+ * \return false if the text is not a vector */
+static bool parseVector(const char* text, double* v)
+{
+    char* end;
+    v[0] = v[1] = v[2] = strtod(text, &end);
+    if(end == text)
+        return false;
+    if(*end == 0)
+        return true;
+    for(int i = 1; i < 3; i++)
+    {
+        if(*end != ',')
+            return false;
+        text = end + 1;
+        v[i] = strtod(text, &end);
+        if(end == text)
+            return false;
+    }
+    return *end == 0;
+}
+
+static bool parseVector(const char* text, float* v)
+{
+    double d[3];
+    if(!parseVector(text, d))
+        return false;
+    for(int i = 0; i < 3; i++)
+        v[i] = (float)d[i];
+    return true;
+}
+
+/** \brief parse a float
+ * \param text the text
+ * \param value the result
+ * \return false if the text is not a number */
+static bool parseFloat(const char* text, float* value)
+{
+    if(!text)
+        return false;
+    char* end;
+    *value = strtof(text, &end);
+    return end != text && *end == 0;
+}
+
+Scene* Scene::loadText(const std::string& path)
+{
+    FILE* file = fopen(path.c_str(), "rb");
+    if(!file)
+    {
+        ERROR("Could not open the scene %s : %s\n", path.c_str(), strerror(errno));
+        return NULL;
+    }
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    std::vector<char> text(size + 1);
+    size_t nbRead = fread(&text[0], 1, size, file);
+    fclose(file);
+    text[nbRead] = 0;
+
+    Scene* scene = new Scene();
+    memcpy(scene->m_header.magic, SCENE_MAGIC, 4);
+    scene->m_header.version   = SCENE_VERSION;
+    scene->m_header.byteOrder = SCENE_BYTE_ORDER;
+    scene->m_header.light     = {{0.0f, 0.0f, 0.0f}, {1.0f, 1.0f, 1.0f}};
+
+    std::unordered_map<std::string, uint32_t> materials, textures, nodes;
+    std::vector<char>& strings = scene->m_ownStrings;
+    auto addString = [&strings](const char* s) -> uint32_t {
+        uint32_t offset = strings.size();
+        strings.insert(strings.end(), s, s + strlen(s) + 1);
+        return offset;
+    };
+    addString("");
+
+    uint32_t lineNumber = 0;
+    char*    line       = &text[0];
+    bool     valid      = true;
+    while(valid && line && *line)
+    {
+        lineNumber++;
+        char* endOfLine = strchr(line, '\n');
+        if(endOfLine)
+            *endOfLine = 0;
+
+        SceneLineParser parser = {line};
+        line = endOfLine ? endOfLine + 1 : NULL;
+        char* keyword = parser.next();
+        if(!keyword)
+            continue;
+
+        if(strcmp(keyword, "light") == 0)
+        {
+            //light <position> <color>
+            const char* position = parser.next();
+            const char* color    = parser.next();
+            valid = position && color && parseVector(position, scene->m_header.light.position) && parseVector(color, scene->m_header.light.color);
+        }
+        else if(strcmp(keyword, "material") == 0)
+        {
+            //material <name> <color> <ka> <kd> <ks> <alpha> [unlit] [nospecular]
+            SceneMaterial mtl;
+            memset(&mtl, 0, sizeof(mtl));
+            const char* name  = parser.next();
+            const char* color = parser.next();
+            valid = name && color && parseVector(color, mtl.color) &&
+                    parseFloat(parser.next(), &mtl.ka) && parseFloat(parser.next(), &mtl.kd) &&
+                    parseFloat(parser.next(), &mtl.ks) && parseFloat(parser.next(), &mtl.alpha);
+            for(const char* option = parser.next(); valid && option; option = parser.next())
+            {
+                if(strcmp(option, "unlit") == 0)
+                    mtl.shaderFeatures |= SHADER_UNLIT;
+                else if(strcmp(option, "nospecular") == 0)
+                    mtl.shaderFeatures |= SHADER_NO_SPECULAR;
+                else
+                    valid = false;
+            }
+            if(valid)
+            {
+                mtl.name = addString(name);
+                materials[name] = scene->m_ownMaterials.size();
+                scene->m_ownMaterials.push_back(mtl);
+            }
+        }
+        else if(strcmp(keyword, "texture") == 0)
+        {
+            //texture <name> <path>
+            const char* name      = parser.next();
+            const char* imagePath = parser.next();
+            valid = name && imagePath;
+            if(valid)
+            {
+                SceneTexture texture;
+                texture.name = addString(name);
+                texture.path = addString(imagePath);
+                textures[name] = scene->m_ownTextures.size();
+                scene->m_ownTextures.push_back(texture);
+            }
+        }
+        else if(strcmp(keyword, "node") == 0)
+        {
+            //node <name> <parent|-> [key=value...] [occluder] [translucent]
+            SceneNode node;
+            memset(&node, 0, sizeof(node));
+            node.texture  = SCENE_NONE;
+            node.material = SCENE_NONE;
+            node.mesh     = SCENE_MESH_SPHERE;
+            node.axis[1]  = 1.0f;
+            node.scale[0] = node.scale[1] = node.scale[2] = 1.0f;
+
+            const char* name   = parser.next();
+            const char* parent = parser.next();
+            valid = name && parent;
+            if(valid && strcmp(parent, "-") == 0)
+                node.parent = SCENE_NONE;
+            else if(valid)
+            {
+                std::unordered_map<std::string, uint32_t>::iterator it = nodes.find(parent);
+                if(it == nodes.end())
+                {
+                    ERROR("%s:%u : the parent %s must be declared before its children\n", path.c_str(), lineNumber, parent);
+                    valid = false;
+                }
+                else
+                    node.parent = it->second;
+            }
+
+            for(char* option = parser.next(); valid && option; option = parser.next())
+            {
+                char* value = strchr(option, '=');
+                if(value)
+                    *value++ = 0;
+
+                if(strcmp(option, "occluder") == 0)
+                    node.flags |= SCENE_NODE_OCCLUDER;
+                else if(strcmp(option, "translucent") == 0)
+                    node.flags |= SCENE_NODE_TRANSLUCENT;
+                else if(strcmp(option, "sky") == 0)
+                    node.flags |= SCENE_NODE_SKY;
+                else if(!value)
+                    valid = false;
+                else if(strcmp(option, "position") == 0)
+                    valid = parseVector(value, node.position);
+                else if(strcmp(option, "axis") == 0)
+                    valid = parseVector(value, node.axis);
+                else if(strcmp(option, "scale") == 0)
+                    valid = parseVector(value, node.scale);
+                else if(strcmp(option, "speed") == 0)
+                    valid = parseFloat(value, &node.speed);
+                else if(strcmp(option, "phase") == 0)
+                    valid = parseFloat(value, &node.phase);
+                else if(strcmp(option, "mesh") == 0)
+                {
+                    if(strcmp(value, "sphere") == 0)
+                        node.mesh = SCENE_MESH_SPHERE;
+                    else if(strcmp(value, "annulus") == 0)
+                        node.mesh = SCENE_MESH_ANNULUS;
+                    else
+                        valid = false;
+                }
+                else if(strcmp(option, "texture") == 0 || strcmp(option, "material") == 0)
+                {
+                    bool isTexture = option[0] == 't';
+                    std::unordered_map<std::string, uint32_t>& names = isTexture ? textures : materials;
+                    std::unordered_map<std::string, uint32_t>::iterator it = names.find(value);
+                    if(it == names.end())
+                    {
+                        ERROR("%s:%u : unknown %s %s\n", path.c_str(), lineNumber, option, value);
+                        valid = false;
+                    }
+                    else if(isTexture)
+                        node.texture = it->second;
+                    else
+                        node.material = it->second;
+                }
+                else
+                    valid = false;
+            }
+
+            if(valid)
+            {
+                node.name = addString(name);
+                nodes[name] = scene->m_ownNodes.size();
+                scene->m_ownNodes.push_back(node);
+            }
+        }
+        else
+            valid = false;
+
+        if(!valid)
+            ERROR("%s:%u : invalid %s line\n", path.c_str(), lineNumber, keyword);
+    }
+
+    if(!valid)
+    {
+        delete scene;
+        return NULL;
+    }
+
+    //Keep the string table 8 bytes aligned in the binary form
+    while(strings.size() % 8)
+        strings.push_back(0);
+
+    scene->m_header.nbMaterials = scene->m_ownMaterials.size();
+    scene->m_header.nbTextures  = scene->m_ownTextures.size();
+    scene->m_header.nbNodes     = scene->m_ownNodes.size();
+    scene->m_header.stringsSize = strings.size();
+    scene->m_materials = scene->m_ownMaterials.empty() ? NULL : &scene->m_ownMaterials[0];
+    scene->m_textures  = scene->m_ownTextures.empty()  ? NULL : &scene->m_ownTextures[0];
+    scene->m_nodes     = scene->m_ownNodes.empty()     ? NULL : &scene->m_ownNodes[0];
+    scene->m_strings   = &strings[0];
+    return scene;
+}
+
+Scene* Scene::loadBinary(const std::string& path)
+{
+    Scene* scene = new Scene();
+    uint64_t size = 0;
+    uint8_t* data = NULL;
+
+#ifdef _WIN32
+    FILE* file = fopen(path.c_str(), "rb");
+    if(file)
+    {
+        fseek(file, 0, SEEK_END);
+        size = ftell(file);
+        fseek(file, 0, SEEK_SET);
+        data = (uint8_t*)malloc(size);
+        if(fread(data, 1, size, file) != size)
+        {
+            free(data);
+            data = NULL;
+        }
+        fclose(file);
+    }
+#else
+    int fd = open(path.c_str(), O_RDONLY);
+    struct stat status;
+    if(fd >= 0 && fstat(fd, &status) == 0)
+    {
+        size = status.st_size;
+        /* Read-only private mapping : the pages are loaded on first access and shared with the page cache */
+        void* mapping = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if(mapping != MAP_FAILED)
+            data = (uint8_t*)mapping;
+    }
+    if(fd >= 0)
+        close(fd);
+#endif
+
+    if(!data)
+    {
+        ERROR("Could not map the scene %s : %s\n", path.c_str(), strerror(errno));
+        delete scene;
+        return NULL;
+    }
+    scene->m_mapping     = data;
+    scene->m_mappingSize = size;
+
+    if(size < sizeof(SceneFileHeader))
+    {
+        ERROR("The scene %s is truncated\n", path.c_str());
+        delete scene;
+        return NULL;
+    }
+    memcpy(&scene->m_header, data, sizeof(SceneFileHeader));
+    scene->m_materials = (const SceneMaterial*)(data + scene->m_header.materialsOffset);
+    scene->m_textures  = (const SceneTexture*)(data + scene->m_header.texturesOffset);
+    scene->m_nodes     = (const SceneNode*)(data + scene->m_header.nodesOffset);
+    scene->m_strings   = (const char*)(data + scene->m_header.stringsOffset);
+
+    if(!scene->validate(size))
+    {
+        ERROR("The scene %s is not valid\n", path.c_str());
+        delete scene;
+        return NULL;
+    }
+    return scene;
+}
+
+bool Scene::validate(uint64_t fileSize) const
+{
+    const SceneFileHeader& h = m_header;
+    if(memcmp(h.magic, SCENE_MAGIC, 4) != 0 || h.version != SCENE_VERSION || h.byteOrder != SCENE_BYTE_ORDER)
+    {
+        ERROR("Unsupported scene version %u (expected %u) or byte order\n", h.version, SCENE_VERSION);
+        return false;
+    }
+
+    /* Every section inside the file and aligned */
+    const uint64_t offsets[4] = {h.materialsOffset, h.texturesOffset, h.nodesOffset, h.stringsOffset};
+    const uint64_t sizes[4]   = {(uint64_t)h.nbMaterials * sizeof(SceneMaterial), (uint64_t)h.nbTextures * sizeof(SceneTexture),
+                                 (uint64_t)h.nbNodes * sizeof(SceneNode), h.stringsSize};
+    for(int i = 0; i < 4; i++)
+        if(offsets[i] % 8 != 0 || offsets[i] > fileSize || sizes[i] > fileSize - offsets[i])
+            return false;
+    if(h.stringsSize == 0 || m_strings[h.stringsSize - 1] != 0)
+        return false;
+
+    /* Every reference in range : the arrays can then be used without any check */
+    for(uint32_t i = 0; i < h.nbMaterials; i++)
+        if(m_materials[i].name >= h.stringsSize)
+            return false;
+    for(uint32_t i = 0; i < h.nbTextures; i++)
+        if(m_textures[i].name >= h.stringsSize || m_textures[i].path >= h.stringsSize)
+            return false;
+    for(uint32_t i = 0; i < h.nbNodes; i++)
+    {
+        const SceneNode& node = m_nodes[i];
+        if((node.parent != SCENE_NONE && node.parent >= i) || node.name >= h.stringsSize ||
+           (node.texture != SCENE_NONE && node.texture >= h.nbTextures) ||
+           (node.material != SCENE_NONE && node.material >= h.nbMaterials) || node.mesh >= SCENE_NB_MESHES)
+            return false;
+    }
+    return true;
+}
+
+bool Scene::saveBinary(const std::string& path) const
+{
+    FILE* file = fopen(path.c_str(), "wb");
+    if(!file)
+    {
+        ERROR("Could not write the scene %s : %s\n", path.c_str(), strerror(errno));
+        return false;
+    }
+
+    SceneFileHeader header = m_header;
+    memcpy(header.magic, SCENE_MAGIC, 4);
+    header.version         = SCENE_VERSION;
+    header.byteOrder       = SCENE_BYTE_ORDER;
+    header.padding         = 0;
+    header.materialsOffset = sizeof(SceneFileHeader);
+    header.texturesOffset  = header.materialsOffset + (uint64_t)header.nbMaterials * sizeof(SceneMaterial);
+    header.nodesOffset     = header.texturesOffset  + (uint64_t)header.nbTextures  * sizeof(SceneTexture);
+    header.stringsOffset   = header.nodesOffset     + (uint64_t)header.nbNodes     * sizeof(SceneNode);
+
+    bool written = fwrite(&header, sizeof(header), 1, file) == 1;
+    if(written && header.nbMaterials)
+        written = fwrite(m_materials, sizeof(SceneMaterial), header.nbMaterials, file) == header.nbMaterials;
+    if(written && header.nbTextures)
+        written = fwrite(m_textures, sizeof(SceneTexture), header.nbTextures, file) == header.nbTextures;
+    if(written && header.nbNodes)
+        written = fwrite(m_nodes, sizeof(SceneNode), header.nbNodes, file) == header.nbNodes;
+    if(written)
+        written = fwrite(m_strings, 1, header.stringsSize, file) == header.stringsSize;
+    written = (fclose(file) == 0) && written;
+
+    if(!written)
+        ERROR("Could not write the scene %s\n", path.c_str());
+    return written;
+}
+
+uint32_t Scene::findNode(const std::string& name) const
+{
+    for(uint32_t i = 0; i < m_header.nbNodes; i++)
+        if(name == getString(m_nodes[i].name))
+            return i;
+    return SCENE_NONE;
+}
+
+void Scene::instantiate(std::vector<GameObject>& objects, const std::vector<GLuint>& textures,
+                        Geometry* const* geometries, const GLuint* vbos, const GLuint* vaos) const
+{
+    const SceneLight& light = m_header.light;
+
+    objects.clear();
+    objects.resize(m_header.nbNodes);
+    for(uint32_t i = 0; i < m_header.nbNodes; i++)
+    {
+        const SceneNode& node = m_nodes[i];
+        GameObject&      go   = objects[i];
+        go.geometry    = geometries[node.mesh];
+        go.vboID       = vbos[node.mesh];
+        go.vaoID       = vaos[node.mesh];
+        go.texture     = node.texture == SCENE_NONE ? 0 : textures[node.texture];
+        go.light       = {glm::vec3(light.position[0], light.position[1], light.position[2]), glm::vec3(light.color[0], light.color[1], light.color[2])};
+        go.occluder    = (node.flags & SCENE_NODE_OCCLUDER) != 0;
+        go.translucent = (node.flags & SCENE_NODE_TRANSLUCENT) != 0;
+        go.sky         = (node.flags & SCENE_NODE_SKY) != 0;
+        if(node.material != SCENE_NONE)
+        {
+            const SceneMaterial& mtl = m_materials[node.material];
+            go.sphereMtl = {glm::vec3(mtl.color[0], mtl.color[1], mtl.color[2]), mtl.ka, mtl.kd, mtl.ks, mtl.alpha, mtl.shaderFeatures};
+        }
+
+        //The parents come first : their address is stable, objects is not resized anymore
+        if(node.parent != SCENE_NONE)
+            objects[node.parent].children.push_back(&go);
+    }
+}
+
+void Scene::animate(std::vector<GameObject>& objects, uint64_t step) const
+{
+    for(uint32_t i = 0; i < m_header.nbNodes; i++)
+    {
+        const SceneNode& node = m_nodes[i];
+        GameObject&      go   = objects[i];
+
+        go.position         = glm::dvec3(node.position[0], node.position[1], node.position[2]);
+        go.propagatedMatrix = glm::mat4(1.0f);
+        if(node.speed != 0.0f || node.phase != 0.0f)
+        {
+            /* Reduced to one turn in double : after many steps the float of the angle would lose the small increments */
+            float angle = (float)fmod(node.phase + node.speed * (double)step, 2.0 * M_PI);
+            go.propagatedMatrix = glm::rotate(go.propagatedMatrix, angle, glm::vec3(node.axis[0], node.axis[1], node.axis[2]));
+        }
+        go.localMatrix = glm::scale(glm::mat4(1.0f), glm::vec3(node.scale[0], node.scale[1], node.scale[2]));
+    }
+}
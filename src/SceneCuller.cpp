@@ -0,0 +1,234 @@
+#include "SceneCuller.h"
+#include "Frustum.h"
+#include <algorithm>
+#include <functional>
+#include <cmath>
+#include <limits>
+
+/* \brief Conservative screen rectangle of a view-space sphere, in depth buffer pixels.
+ * The extremes of x/depth and y/depth are reached on the corners of the sphere bounding box.
+ * \return false if the sphere crosses the near plane (no meaningful rectangle) or is out of the screen */
+static bool sphereRect(const glm::vec3& c, float r, const glm::mat4& projection, float zNear, int32_t rect[4])
+{
+    if(c.z + r > -zNear)
+        return false;
+
+    float depths[2] = {-(c.z + r), -(c.z - r)};
+    float minX = std::numeric_limits<float>::max(), maxX = -minX, minY = minX, maxY = -minX;
+    for(uint32_t i = 0; i < 2; i++)
+        for(int32_t s = -1; s <= 1; s += 2)
+        {
+            float x = projection[0][0] * (c.x + s*r) / depths[i];
+            float y = projection[1][1] * (c.y + s*r) / depths[i];
+            minX = std::min(minX, x); maxX = std::max(maxX, x);
+            minY = std::min(minY, y); maxY = std::max(maxY, y);
+        }
+
+    rect[0] = std::max(0,              (int32_t)std::floor((minX*0.5f+0.5f)*HIZ_SIZE));
+    rect[1] = std::max(0,              (int32_t)std::floor((minY*0.5f+0.5f)*HIZ_SIZE));
+    rect[2] = std::min(HIZ_SIZE-1,     (int32_t)std::floor((maxX*0.5f+0.5f)*HIZ_SIZE));
+    rect[3] = std::min(HIZ_SIZE-1,     (int32_t)std::floor((maxY*0.5f+0.5f)*HIZ_SIZE));
+    return rect[0] <= rect[2] && rect[1] <= rect[3];
+}
+
+/* \brief Distance along a normalized ray from the camera to the front of a view-space sphere
+ * \return the distance or a negative value if the ray misses */
+static float raySphere(const glm::vec3& dir, const glm::vec3& c, float r)
+{
+    float b    = glm::dot(dir, c);
+    float disc = b*b - (glm::dot(c, c) - r*r);
+    if(disc < 0.0f)
+        return -1.0f;
+    return b - std::sqrt(disc);
+}
+
+SceneCuller::SceneCuller(uint32_t viewportHeight) : m_viewportHeight(viewportHeight)
+{
+    for(uint32_t l = 0; l < HIZ_LEVELS; l++)
+        m_hiz[l].resize((HIZ_SIZE >> l) * (HIZ_SIZE >> l));
+}
+
+void SceneCuller::gather(GameObject& go, const glm::dvec3& cameraPosition, int32_t parent)
+{
+    const glm::mat4& model = go.modelMatrix;
+
+    glm::vec3 center(model[3]);
+    float radius = 0.0f, innerRadius = 0.0f;
+    if(go.geometry)
+    {
+        const float* c = go.geometry->getBoundingCenter();
+        center = glm::vec3(model * glm::vec4(c[0], c[1], c[2], 1.0f));
+
+        float scales[3] = {glm::length(glm::vec3(model[0])), glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))};
+        radius      = go.geometry->getBoundingRadius() * std::max(scales[0], std::max(scales[1], scales[2]));
+        innerRadius = go.geometry->getBoundingRadius() * std::min(scales[0], std::min(scales[1], scales[2]));
+    }
+    go.worldCenter = glm::dvec3(center) + cameraPosition;
+    go.worldRadius = radius;
+
+    int32_t index = m_nodes.size();
+    m_nodes.push_back(&go);
+    m_parents.push_back(parent);
+    m_x.push_back(center.x);
+    m_y.push_back(center.y);
+    m_z.push_back(center.z);
+    m_radius.push_back(radius);
+    m_innerRadius.push_back(innerRadius);
+
+    for(uint32_t i = 0; i < go.children.size(); i++)
+        gather(*go.children[i], cameraPosition, index);
+}
+
+void SceneCuller::cull(const std::vector<GameObject*>& roots, const glm::mat4& view, const glm::mat4& projection, const glm::dvec3& cameraPosition)
+{
+    m_nodes.clear();
+    m_parents.clear();
+    m_x.clear(); m_y.clear(); m_z.clear(); m_radius.clear(); m_innerRadius.clear();
+    for(uint32_t i = 0; i < roots.size(); i++)
+        gather(*roots[i], cameraPosition, -1);
+
+    uint32_t nbNodes = m_nodes.size();
+    m_visible.resize(nbNodes);
+    m_viewCenters.resize(nbNodes);
+    m_stats = CullingStats();
+
+    /* Frustum, 4 spheres at a time */
+    Frustum frustum(projection * view);
+    frustum.intersects(m_x.data(), m_y.data(), m_z.data(), m_radius.data(), nbNodes, m_visible.data());
+
+    /* Small objects. zNear is recovered from the OpenGL perspective matrix */
+    float zNear = projection[3][2] / (projection[2][2] - 1.0f);
+    float pixelScale = projection[1][1] * 0.5f * m_viewportHeight;
+    for(uint32_t i = 0; i < nbNodes; i++)
+    {
+        if(m_nodes[i]->geometry == nullptr)
+        {
+            m_visible[i] = 0;
+            continue;
+        }
+        m_stats.nbObjects++;
+        if(!m_visible[i])
+        {
+            m_stats.frustumCulled++;
+            continue;
+        }
+
+        m_viewCenters[i] = glm::vec3(view * glm::vec4(m_x[i], m_y[i], m_z[i], 1.0f));
+        float depth = -m_viewCenters[i].z;
+        if(m_minPixelRadius > 0.0f && depth > zNear && m_radius[i] * pixelScale / depth < m_minPixelRadius)
+        {
+            m_visible[i] = 0;
+            m_stats.smallCulled++;
+        }
+    }
+
+    /* Occlusion */
+    if(m_occlusion)
+    {
+        rasterizeOccluders(projection, zNear);
+        if(m_stats.nbOccluders > 0)
+            for(uint32_t i = 0; i < nbNodes; i++)
+                if(m_visible[i] && isOccluded(m_viewCenters[i], m_radius[i], projection, zNear))
+                {
+                    m_visible[i] = 0;
+                    m_stats.occlusionCulled++;
+                }
+    }
+
+    /* Write back. Children come after their parent, hence the reverse order */
+    for(uint32_t i = 0; i < nbNodes; i++)
+        m_nodes[i]->visible = m_nodes[i]->subtreeVisible = m_visible[i];
+    for(int32_t i = nbNodes-1; i >= 0; i--)
+        if(m_parents[i] >= 0 && m_nodes[i]->subtreeVisible)
+            m_nodes[m_parents[i]]->subtreeVisible = true;
+}
+
+void SceneCuller::rasterizeOccluders(const glm::mat4& projection, float zNear)
+{
+    /* Pick the largest visible occluders on screen */
+    std::vector<std::pair<float, uint32_t> > candidates;
+    for(uint32_t i = 0; i < m_nodes.size(); i++)
+    {
+        if(!m_visible[i] || !m_nodes[i]->occluder)
+            continue;
+        const glm::vec3& c = m_viewCenters[i];
+        float r = m_innerRadius[i];
+        /* The camera must be outside of the occluder and in front of it */
+        if(c.z + r > -zNear)
+            continue;
+        candidates.push_back(std::make_pair(r / -c.z, i));
+    }
+    std::sort(candidates.begin(), candidates.end(), std::greater<std::pair<float, uint32_t> >());
+    if(candidates.size() > CULLER_MAX_OCCLUDERS)
+        candidates.resize(CULLER_MAX_OCCLUDERS);
+    m_stats.nbOccluders = candidates.size();
+    if(candidates.empty())
+        return;
+
+    std::fill(m_hiz[0].begin(), m_hiz[0].end(), std::numeric_limits<float>::max());
+
+    /* A pixel is covered only if the rays through its 4 corners hit the sphere. It stores the farthest of the 4 hits :
+     * a conservative distance to the occluder surface inside this pixel */
+    for(uint32_t o = 0; o < candidates.size(); o++)
+    {
+        uint32_t i = candidates[o].second;
+        const glm::vec3& c = m_viewCenters[i];
+        float r = m_innerRadius[i];
+
+        int32_t rect[4];
+        if(!sphereRect(c, r, projection, zNear, rect))
+            continue;
+
+        for(int32_t y = rect[1]; y <= rect[3]; y++)
+            for(int32_t x = rect[0]; x <= rect[2]; x++)
+            {
+                float farthest = 0.0f;
+                bool  covered  = true;
+                for(uint32_t k = 0; k < 4 && covered; k++)
+                {
+                    float ndcX = (x + (k & 1)) * (2.0f / HIZ_SIZE) - 1.0f;
+                    float ndcY = (y + (k >> 1)) * (2.0f / HIZ_SIZE) - 1.0f;
+                    glm::vec3 dir = glm::normalize(glm::vec3(ndcX / projection[0][0], ndcY / projection[1][1], -1.0f));
+                    float t = raySphere(dir, c, r);
+                    covered  = t > 0.0f;
+                    farthest = std::max(farthest, t);
+                }
+                if(covered)
+                {
+                    float& depth = m_hiz[0][y*HIZ_SIZE + x];
+                    depth = std::min(depth, farthest);
+                }
+            }
+    }
+
+    /* Max pyramid */
+    for(uint32_t l = 1; l < HIZ_LEVELS; l++)
+    {
+        uint32_t size = HIZ_SIZE >> l;
+        const std::vector<float>& src = m_hiz[l-1];
+        for(uint32_t y = 0; y < size; y++)
+            for(uint32_t x = 0; x < size; x++)
+                m_hiz[l][y*size + x] = std::max(std::max(src[(2*y)*(2*size) + 2*x],   src[(2*y)*(2*size) + 2*x+1]),
+                                                std::max(src[(2*y+1)*(2*size) + 2*x], src[(2*y+1)*(2*size) + 2*x+1]));
+    }
+}
+
+bool SceneCuller::isOccluded(const glm::vec3& center, float radius, const glm::mat4& projection, float zNear) const
+{
+    float nearest = glm::length(center) - radius;
+    int32_t rect[4];
+    if(nearest <= zNear || !sphereRect(center, radius, projection, zNear, rect))
+        return false;
+
+    /* Coarsest level where the rectangle spans at most 2x2 texels */
+    uint32_t l = 0;
+    while(l < HIZ_LEVELS-1 && ((rect[2] >> l) - (rect[0] >> l) > 1 || (rect[3] >> l) - (rect[1] >> l) > 1))
+        l++;
+
+    uint32_t size = HIZ_SIZE >> l;
+    for(int32_t y = rect[1] >> l; y <= (rect[3] >> l); y++)
+        for(int32_t x = rect[0] >> l; x <= (rect[2] >> l); x++)
+            if(m_hiz[l][y*size + x] >= nearest)
+                return false;
+    return true;
+}
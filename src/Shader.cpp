@@ -1,4 +1,5 @@
 #include "Shader.h"
+#include <utility>
 
 Shader::Shader() : m_programID(0), m_vertexID(0), m_fragID(0)
 {}
@@ -12,36 +13,85 @@ Shader::~Shader()
 
 Shader* Shader::loadFromFiles(FILE* vertexFile, FILE* fragFile)
 {
-    uint32_t vertexFileSize = 0;
-    uint32_t fragFileSize   = 0;
-    char* vertexCodeC;
-    char* fragCodeC;
+    return loadFromStrings(readFile(vertexFile), readFile(fragFile));
+}
+
+std::string Shader::readFile(FILE* file)
+{
+    uint32_t fileSize = 0;
+    char* codeC;
+
+    /* Determine the file size */
+    fseek(file, 0, SEEK_END);
+    fileSize = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    /* Read the file */
+    codeC = (char*)malloc(fileSize+1);
+    fileSize = fread(codeC, 1, fileSize, file);
+    codeC[fileSize] = '\0';
+
+    std::string code(codeC);
+    free(codeC);
 
-    /* Determine the vertex and fragment shader sizes */
-    fseek(vertexFile, 0, SEEK_END);
-    vertexFileSize = ftell(vertexFile);
-    fseek(vertexFile, 0, SEEK_SET);
+    return code;
+}
+
+std::string Shader::featureDefines(uint32_t features)
+{
+    std::string defines;
+    if(features & SHADER_UNLIT)
+        defines += "#define UNLIT\n";
+    if(features & SHADER_NO_SPECULAR)
+        defines += "#define NO_SPECULAR\n";
+    if(features & SHADER_INSTANCED)
+        defines += "#define INSTANCED\n";
+    if(features & SHADER_PARTICLES)
+        defines += "#define PARTICLES\n";
+    if(features & SHADER_LOG_DEPTH)
+        defines += "#define LOG_DEPTH\n";
+    if(features & SHADER_ECLIPSES)
+        defines += "#define ECLIPSES\n";
+    if(features & SHADER_WEIGHTED_BLENDED)
+        defines += "#define WEIGHTED_BLENDED\n";
+    if(features & SHADER_IMPOSTORS)
+        defines += "#define IMPOSTORS\n";
+    if(features & SHADER_UNIFORM_BUFFERS)
+        defines += "#extension GL_ARB_uniform_buffer_object : require\n"
+                   "#define UNIFORM_BUFFERS\n"
+                   "#define MAX_MATERIALS " + std::to_string(SHADER_MAX_MATERIALS) + "\n";
+    if(features & (SHADER_UNIFORM_BUFFERS | SHADER_ECLIPSES))
+        defines += "#define MAX_OCCLUDERS " + std::to_string(SHADER_MAX_OCCLUDERS) + "\n";
+    return defines;
+}
 
-    fseek(fragFile, 0, SEEK_END);
-    fragFileSize = ftell(fragFile);
-    fseek(fragFile, 0, SEEK_SET);
+/* \brief Insert the defines right after the #version directive (which has to stay the first line).
+ * The #line directive keeps the compiler error line numbers matching the original file */
+static std::string specialize(const std::string& code, const std::string& defines)
+{
+    if(defines.empty())
+        return code;
 
-    /* Read the files */
-    vertexCodeC = (char*)malloc(vertexFileSize+1);
-    fragCodeC   = (char*)malloc(fragFileSize+1);
+    size_t version = code.find("#version");
+    if(version == std::string::npos)
+        return defines + "#line 1\n" + code;
 
-    fread(vertexCodeC, 1, vertexFileSize, vertexFile);
-    vertexCodeC[vertexFileSize] = '\0';
-    fread(fragCodeC, 1, fragFileSize, fragFile);
-    fragCodeC[fragFileSize] = '\0';
+    size_t endLine = code.find('\n', version);
+    if(endLine == std::string::npos)
+        return code + "\n" + defines;
 
-    /* Return the shader and free everything*/
-    Shader* s = loadFromStrings(std::string(vertexCodeC), std::string(fragCodeC));
+    uint32_t line = 2;
+    for(size_t i = 0; i < endLine; i++)
+        if(code[i] == '\n')
+            line++;
 
-    free(vertexCodeC);
-    free(fragCodeC);
+    return code.substr(0, endLine+1) + defines + "#line " + std::to_string(line) + "\n" + code.substr(endLine+1);
+}
 
-    return s;
+Shader* Shader::loadFromStrings(const std::string& vertexString, const std::string& fragString, uint32_t features)
+{
+    std::string defines = featureDefines(features);
+    return loadFromStrings(specialize(vertexString, defines), specialize(fragString, defines));
 }
 
 Shader* Shader::loadFromStrings(const std::string& vertexString, const std::string& fragString)
@@ -72,11 +122,14 @@ Shader* Shader::loadFromStrings(const std::string& vertexString, const std::stri
         int length=0;
         glGetProgramInfoLog(shader->m_programID, ERROR_MAX_LENGTH, &length, error);
         ERROR("Could not link shader-> : \n %s", error);
+        free(error);
 
         delete shader;
         return NULL;
     }
 
+    shader->bindUniformBlocks();
+
     return shader;
 }
 
@@ -99,6 +152,7 @@ int Shader::loadShader(const std::string& code, int type)
         glGetShaderInfoLog(shader, ERROR_MAX_LENGTH, &length, error);
 
         ERROR("Could not compile shader %d : \n %s", type, error);
+        free(error);
         glDeleteShader(shader);
         return 0;
     }
@@ -121,6 +175,38 @@ int Shader::getFragID() const
     return m_fragID;
 }
 
+void Shader::swap(Shader& other)
+{
+    std::swap(m_programID, other.m_programID);
+    std::swap(m_vertexID,  other.m_vertexID);
+    std::swap(m_fragID,    other.m_fragID);
+}
+
 void Shader::bindAttributes()
 {
+    glBindAttribLocation(m_programID, ATTRIB_POSITION,       "vPosition");
+    glBindAttribLocation(m_programID, ATTRIB_NORMAL,         "vNormal");
+    glBindAttribLocation(m_programID, ATTRIB_UV,             "vUV");
+    glBindAttribLocation(m_programID, ATTRIB_INSTANCE_MODEL, "vInstanceModel");
+    glBindAttribLocation(m_programID, ATTRIB_INSTANCE_PARTICLE, "vInstancePositionSize");
+    glBindAttribLocation(m_programID, ATTRIB_INSTANCE_COLOR, "vInstanceColor");
+}
+
+void Shader::bindUniformBlocks()
+{
+    if(!GLEW_ARB_uniform_buffer_object)
+        return;
+
+    static const struct {const char* name; GLuint binding;} blocks[] = {
+        {"FrameBlock",    BLOCK_FRAME},
+        {"MaterialBlock", BLOCK_MATERIAL},
+        {"ObjectBlock",   BLOCK_OBJECT}
+    };
+
+    for(uint32_t i = 0; i < sizeof(blocks)/sizeof(blocks[0]); i++)
+    {
+        GLuint index = glGetUniformBlockIndex(m_programID, blocks[i].name);
+        if(index != GL_INVALID_INDEX)
+            glUniformBlockBinding(m_programID, index, blocks[i].binding);
+    }
 }
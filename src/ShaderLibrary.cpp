@@ -0,0 +1,125 @@
+#include "ShaderLibrary.h"
+
+ShaderLibrary::ShaderLibrary(const std::string& vertexString, const std::string& fragString) : m_vertexString(vertexString), m_fragString(fragString)
+{}
+
+ShaderLibrary::~ShaderLibrary()
+{
+    for(std::map<uint32_t, Shader*>::iterator it = m_variants.begin(); it != m_variants.end(); ++it)
+        delete it->second;
+}
+
+ShaderLibrary* ShaderLibrary::loadFromFiles(FILE* vertexFile, FILE* fragFile)
+{
+    return new ShaderLibrary(Shader::readFile(vertexFile), Shader::readFile(fragFile));
+}
+
+ShaderLibrary* ShaderLibrary::loadFromPaths(const std::string& vertexPath, const std::string& fragPath)
+{
+    FILE* vertexFile = fopen(vertexPath.c_str(), "r");
+    FILE* fragFile   = fopen(fragPath.c_str(), "r");
+    ShaderLibrary* library = NULL;
+
+    if(vertexFile && fragFile)
+    {
+        library = loadFromFiles(vertexFile, fragFile);
+        library->m_vertexPath = vertexPath;
+        library->m_fragPath   = fragPath;
+    }
+    else
+        ERROR("Could not open %s or %s\n", vertexPath.c_str(), fragPath.c_str());
+
+    if(vertexFile)
+        fclose(vertexFile);
+    if(fragFile)
+        fclose(fragFile);
+    return library;
+}
+
+bool ShaderLibrary::reload()
+{
+    if(m_vertexPath.empty() || m_fragPath.empty())
+        return false;
+
+    FILE* vertexFile = fopen(m_vertexPath.c_str(), "r");
+    FILE* fragFile   = fopen(m_fragPath.c_str(), "r");
+    if(!vertexFile || !fragFile)
+    {
+        /* Editors may remove the file for a short time while saving it. The next change will reload it */
+        WARNING("Could not open %s or %s, keeping the previous programs\n", m_vertexPath.c_str(), m_fragPath.c_str());
+        if(vertexFile)
+            fclose(vertexFile);
+        if(fragFile)
+            fclose(fragFile);
+        return false;
+    }
+    std::string vertexString = Shader::readFile(vertexFile);
+    std::string fragString   = Shader::readFile(fragFile);
+    fclose(vertexFile);
+    fclose(fragFile);
+
+    /* Compile everything before touching the variants in use */
+    std::map<uint32_t, Shader*> compiled;
+    bool success = true;
+    for(std::map<uint32_t, Shader*>::iterator it = m_variants.begin(); it != m_variants.end() && success; ++it)
+    {
+        Shader* shader = Shader::loadFromStrings(vertexString, fragString, it->first);
+        if(shader == NULL)
+        {
+            ERROR("Could not reload the shader variant 0x%x, keeping the previous programs\n", it->first);
+            success = false;
+        }
+        compiled[it->first] = shader;
+    }
+
+    if(success)
+    {
+        m_vertexString = vertexString;
+        m_fragString   = fragString;
+        for(std::map<uint32_t, Shader*>::iterator it = compiled.begin(); it != compiled.end(); ++it)
+        {
+            Shader*& current = m_variants[it->first];
+            if(current == NULL) /*Previously broken variant : adopt the new one*/
+            {
+                current    = it->second;
+                it->second = NULL;
+            }
+            else
+                current->swap(*it->second); /*it->second now holds the old program, destroyed below*/
+        }
+        INFO("Reloaded %s and %s (%u variants)\n", m_vertexPath.c_str(), m_fragPath.c_str(), (uint32_t)m_variants.size());
+    }
+
+    for(std::map<uint32_t, Shader*>::iterator it = compiled.begin(); it != compiled.end(); ++it)
+        delete it->second;
+    return success;
+}
+
+bool ShaderLibrary::usesFile(const std::string& fileName) const
+{
+    const std::string* paths[] = {&m_vertexPath, &m_fragPath};
+    for(uint32_t i = 0; i < 2; i++)
+    {
+        const std::string& path = *paths[i];
+        if(path.size() >= fileName.size() && path.compare(path.size() - fileName.size(), fileName.size(), fileName) == 0 &&
+           (path.size() == fileName.size() || path[path.size() - fileName.size() - 1] == '/' || path[path.size() - fileName.size() - 1] == '\\'))
+            return true;
+    }
+    return false;
+}
+
+Shader* ShaderLibrary::get(uint32_t features)
+{
+    std::map<uint32_t, Shader*>::iterator it = m_variants.find(features);
+    if(it != m_variants.end())
+        return it->second;
+
+    Shader* shader = Shader::loadFromStrings(m_vertexString, m_fragString, features);
+    if(shader == NULL)
+        ERROR("Could not compile the shader variant 0x%x\n", features);
+    else
+        INFO("Compiled the shader variant 0x%x\n", features);
+
+    m_variants[features] = shader;
+    return shader;
+}
@@ -0,0 +1,80 @@
+#include "ShaderWatcher.h"
+#include "logger.h"
+#include <algorithm>
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <unistd.h>
+#include <errno.h>
+#endif
+
+ShaderWatcher::ShaderWatcher(const std::string& directory) : m_directory(directory)
+{
+#ifdef __linux__
+    m_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if(m_fd < 0)
+    {
+        ERROR("Could not initialize inotify : %s\n", strerror(errno));
+        return;
+    }
+
+    /* Editors either rewrite the file (IN_CLOSE_WRITE) or write a temporary file and rename it (IN_MOVED_TO) */
+    m_watch = inotify_add_watch(m_fd, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+    if(m_watch < 0)
+    {
+        ERROR("Could not watch %s : %s\n", directory.c_str(), strerror(errno));
+        close(m_fd);
+        m_fd = -1;
+        return;
+    }
+    INFO("Watching %s for shader changes\n", directory.c_str());
+#else
+    WARNING("Shader hot reload is only supported on Linux\n");
+#endif
+}
+
+ShaderWatcher::~ShaderWatcher()
+{
+#ifdef __linux__
+    if(m_fd >= 0)
+    {
+        inotify_rm_watch(m_fd, m_watch);
+        close(m_fd);
+    }
+#endif
+}
+
+bool ShaderWatcher::poll(std::vector<std::string>& changedFiles)
+{
+    changedFiles.clear();
+#ifdef __linux__
+    if(m_fd < 0)
+        return false;
+
+    /* Aligned as required by struct inotify_event */
+    char buffer[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    while(true)
+    {
+        ssize_t length = read(m_fd, buffer, sizeof(buffer));
+        if(length <= 0)
+        {
+            if(length < 0 && errno != EAGAIN)
+                ERROR("Could not read the inotify events of %s : %s\n", m_directory.c_str(), strerror(errno));
+            break;
+        }
+
+        for(char* ptr = buffer; ptr < buffer + length; )
+        {
+            const struct inotify_event* event = (const struct inotify_event*)ptr;
+            if(event->len > 0)
+            {
+                std::string name(event->name);
+                if(std::find(changedFiles.begin(), changedFiles.end(), name) == changedFiles.end())
+                    changedFiles.push_back(name);
+            }
+            ptr += sizeof(struct inotify_event) + event->len;
+        }
+    }
+#endif
+    return !changedFiles.empty();
+}
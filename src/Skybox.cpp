@@ -0,0 +1,139 @@
+#include "Skybox.h"
+#include "logger.h"
+#include <glm/gtc/type_ptr.hpp>
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+Skybox* Skybox::create(const uint8_t* rgba, uint32_t width, uint32_t height, uint32_t faceSize, float farDepth,
+                       const char* vertexPath, const char* fragPath)
+{
+    ShaderLibrary* shaders = ShaderLibrary::loadFromPaths(vertexPath, fragPath);
+    if(shaders && !shaders->get(0))
+    {
+        delete shaders;
+        shaders = NULL;
+    }
+    if(!shaders)
+        return NULL;
+
+    std::vector<uint8_t> faces(6 * faceSize * faceSize * 4);
+    equirectangularToCube(rgba, width, height, faceSize, faces.data());
+
+    Skybox* sky = new Skybox();
+    sky->m_shaders  = shaders;
+    sky->m_farDepth = farDepth;
+    glGenVertexArrays(1, &sky->m_vao);
+
+    /* Bilinear without mipmaps, like the texture of the sphere it replaces : the stars are single pixels, the mipmaps would average them away */
+    glGenTextures(1, &sky->m_cubeMap);
+    glBindTexture(GL_TEXTURE_CUBE_MAP, sky->m_cubeMap);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+    for(uint32_t f = 0; f < 6; f++)
+        glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + f, 0, GL_RGBA8, faceSize, faceSize, 0, GL_RGBA, GL_UNSIGNED_BYTE,
+                     &faces[f * faceSize * faceSize * 4]);
+    glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+
+    /* Filter across the edges of the faces (core since OpenGL 3.2). Without it the edges of the faces are slightly visible */
+    if(GLEW_ARB_seamless_cube_map)
+        glEnable(GL_TEXTURE_CUBE_MAP_SEAMLESS);
+    return sky;
+}
+
+void Skybox::equirectangularToCube(const uint8_t* rgba, uint32_t width, uint32_t height, uint32_t faceSize, uint8_t* faces)
+{
+    /* The direction of the center of the texel (s, t) of each face, s and t in [-1, 1] (the OpenGL cube map convention) */
+    auto direction = [](uint32_t face, float s, float t) -> glm::vec3
+    {
+        switch(face)
+        {
+            case 0:  return glm::vec3( 1.0f,   -t,   -s);
+            case 1:  return glm::vec3(-1.0f,   -t,    s);
+            case 2:  return glm::vec3(    s, 1.0f,    t);
+            case 3:  return glm::vec3(    s,-1.0f,   -t);
+            case 4:  return glm::vec3(    s,   -t, 1.0f);
+            default: return glm::vec3(   -s,   -t,-1.0f);
+        }
+    };
+
+    for(uint32_t f = 0; f < 6; f++)
+    {
+        for(uint32_t j = 0; j < faceSize; j++)
+        {
+            for(uint32_t i = 0; i < faceSize; i++)
+            {
+                float     s = (i + 0.5f) / faceSize * 2.0f - 1.0f;
+                float     t = (j + 0.5f) / faceSize * 2.0f - 1.0f;
+                glm::vec3 d = glm::normalize(direction(f, s, t));
+
+                /* Longitude from +z towards +x, colatitude from +y : the u and v of the sphere */
+                float theta = atan2f(d.x, d.z);
+                if(theta < 0.0f)
+                    theta += 2.0f * (float)M_PI;
+                float phi = acosf(std::min(1.0f, std::max(-1.0f, d.y)));
+                float x   = theta / (2.0f * (float)M_PI) * width - 0.5f;
+                float y   = phi / (float)M_PI * height - 0.5f;
+
+                /* Bilinear : the longitude wraps around, the latitude stops at the poles */
+                float    fx = floorf(x), fy = floorf(y);
+                float    ax = x - fx,    ay = y - fy;
+                int32_t  x0 = (int32_t)fx, y0 = (int32_t)fy;
+                uint32_t xs[2] = {(uint32_t)((x0 + (int32_t)width) % (int32_t)width), (uint32_t)((x0 + 1 + (int32_t)width) % (int32_t)width)};
+                uint32_t ys[2] = {(uint32_t)std::max(y0, 0), (uint32_t)std::min(y0 + 1, (int32_t)height - 1)};
+
+                uint8_t* texel = &faces[((f * faceSize + j) * faceSize + i) * 4];
+                for(uint32_t c = 0; c < 4; c++)
+                {
+                    float top    = rgba[(ys[0] * width + xs[0]) * 4 + c] * (1.0f - ax) + rgba[(ys[0] * width + xs[1]) * 4 + c] * ax;
+                    float bottom = rgba[(ys[1] * width + xs[0]) * 4 + c] * (1.0f - ax) + rgba[(ys[1] * width + xs[1]) * 4 + c] * ax;
+                    texel[c] = (uint8_t)(top * (1.0f - ay) + bottom * ay + 0.5f);
+                }
+            }
+        }
+    }
+}
+
+Skybox::~Skybox()
+{
+    glDeleteTextures(1, &m_cubeMap);
+    glDeleteVertexArrays(1, &m_vao);
+    delete m_shaders;
+}
+
+void Skybox::setView(const glm::mat4& viewProjection, const glm::mat3& rotation, const glm::vec3& color)
+{
+    /* The camera is at the origin : a point of the far plane is the direction of its pixel. The inverse of the rotation is its transpose */
+    m_clipToSky = glm::mat4(glm::transpose(rotation)) * glm::inverse(viewProjection);
+    m_color     = color;
+}
+
+void Skybox::draw() const
+{
+    /* Only where the depth is still the cleared one : whatever the depth test of the mode, nothing drawn is at the far depth */
+    GLint depthFunc;
+    glGetIntegerv(GL_DEPTH_FUNC, &depthFunc);
+    glDepthFunc(GL_EQUAL);
+    glDepthMask(GL_FALSE);
+
+    /* Every uniform is set at each draw : a reload of the sources replaces the program */
+    GLuint program = m_shaders->get(0)->getProgramID();
+    glUseProgram(program);
+    glUniform1i(glGetUniformLocation(program, "uSky"), 0);
+    glUniform1f(glGetUniformLocation(program, "uFarDepth"), m_farDepth);
+    glUniformMatrix4fv(glGetUniformLocation(program, "uClipToSky"), 1, GL_FALSE, glm::value_ptr(m_clipToSky));
+    glUniform3fv(glGetUniformLocation(program, "uSkyColor"), 1, glm::value_ptr(m_color));
+    glBindVertexArray(m_vao);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_CUBE_MAP, m_cubeMap);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+
+    glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+    glBindVertexArray(0);
+    glUseProgram(0);
+    glDepthMask(GL_TRUE);
+    glDepthFunc(depthFunc);
+}
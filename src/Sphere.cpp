@@ -57,4 +57,6 @@ Sphere::Sphere(uint32_t nbLatitude, uint32_t nbLongitude)
     free(order);
     free(vertexCoord);
     free(uvCoord);
+
+    computeBoundingSphere();
 }
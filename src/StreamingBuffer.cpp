@@ -0,0 +1,147 @@
+#include "StreamingBuffer.h"
+#include "logger.h"
+#include <cstring>
+
+StreamingBuffer::StreamingBuffer(GLsizeiptr frameSize)
+{
+    create(frameSize);
+}
+
+StreamingBuffer::~StreamingBuffer()
+{
+    for(uint32_t i = 0; i < STREAMING_FRAMES; i++)
+        if(m_fences[i])
+            glDeleteSync(m_fences[i]);
+    if(m_mapping)
+    {
+        glBindBuffer(GL_ARRAY_BUFFER, m_buffer);
+        glUnmapBuffer(GL_ARRAY_BUFFER);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+    glDeleteBuffers(1, &m_buffer);
+}
+
+void StreamingBuffer::create(GLsizeiptr frameSize)
+{
+    m_frameSize = (frameSize + STREAMING_ALIGNMENT - 1) / STREAMING_ALIGNMENT * STREAMING_ALIGNMENT;
+    if(m_frameSize == 0)
+        m_frameSize = STREAMING_ALIGNMENT;
+
+    /* The target only matters for the creation : the buffer can then be bound to any of them */
+    glGenBuffers(1, &m_buffer);
+    glBindBuffer(GL_ARRAY_BUFFER, m_buffer);
+    if(GLEW_ARB_buffer_storage && GLEW_ARB_sync)
+    {
+        GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glBufferStorage(GL_ARRAY_BUFFER, m_frameSize * STREAMING_FRAMES, NULL, flags);
+        m_mapping = (uint8_t*)glMapBufferRange(GL_ARRAY_BUFFER, 0, m_frameSize * STREAMING_FRAMES, flags);
+        if(!m_mapping)
+        {
+            /* The storage is immutable : a new buffer for the fallback */
+            WARNING("Could not map the streaming buffer of %u KB, falling back to orphaning\n", (uint32_t)(m_frameSize * STREAMING_FRAMES / 1024));
+            glDeleteBuffers(1, &m_buffer);
+            glGenBuffers(1, &m_buffer);
+            glBindBuffer(GL_ARRAY_BUFFER, m_buffer);
+        }
+    }
+    if(!m_mapping)
+    {
+        /* One region is enough : the orphaning gives a new storage to each frame */
+        glBufferData(GL_ARRAY_BUFFER, m_frameSize, NULL, GL_STREAM_DRAW);
+        m_staging.resize(m_frameSize);
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    m_region  = 0;
+    m_head    = 0;
+    m_flushed = 0;
+}
+
+void StreamingBuffer::waitFence(uint32_t region)
+{
+    if(!m_fences[region])
+        return;
+    /* Count the waits : with enough regions the fence is already signaled */
+    if(glClientWaitSync(m_fences[region], 0, 0) == GL_TIMEOUT_EXPIRED)
+    {
+        m_nbWaits++;
+        while(glClientWaitSync(m_fences[region], GL_SYNC_FLUSH_COMMANDS_BIT, (GLuint64)1e9) == GL_TIMEOUT_EXPIRED);
+    }
+    glDeleteSync(m_fences[region]);
+    m_fences[region] = 0;
+}
+
+void StreamingBuffer::beginFrame(GLsizeiptr frameSize)
+{
+    if(m_started && m_head > m_peakUsage)
+        m_peakUsage = m_head;
+
+    if(m_mapping)
+    {
+        /* Every command of the previous frame was issued : its region is free once they are executed */
+        if(m_started)
+            m_fences[m_region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+        if(frameSize > m_frameSize)
+        {
+            /* Rare : the GPU must be done with every region before the buffer is replaced */
+            for(uint32_t i = 0; i < STREAMING_FRAMES; i++)
+                waitFence(i);
+            glBindBuffer(GL_ARRAY_BUFFER, m_buffer);
+            glUnmapBuffer(GL_ARRAY_BUFFER);
+            glBindBuffer(GL_ARRAY_BUFFER, 0);
+            glDeleteBuffers(1, &m_buffer);
+            m_mapping = NULL;
+            create(frameSize > 2 * m_frameSize ? frameSize : 2 * m_frameSize);
+        }
+        else
+        {
+            m_region = (m_region + 1) % STREAMING_FRAMES;
+            waitFence(m_region);
+        }
+    }
+    else
+    {
+        if(frameSize > m_frameSize)
+        {
+            glDeleteBuffers(1, &m_buffer);
+            create(frameSize > 2 * m_frameSize ? frameSize : 2 * m_frameSize);
+        }
+        else
+        {
+            /* Orphan : the draws of the previous frames keep the old storage, the driver does not wait for them */
+            glBindBuffer(GL_ARRAY_BUFFER, m_buffer);
+            glBufferData(GL_ARRAY_BUFFER, m_frameSize, NULL, GL_STREAM_DRAW);
+            glBindBuffer(GL_ARRAY_BUFFER, 0);
+        }
+    }
+
+    m_head    = 0;
+    m_flushed = 0;
+    m_started = true;
+}
+
+void* StreamingBuffer::allocate(GLsizeiptr size, GLintptr& offset, GLsizeiptr alignment)
+{
+    GLsizeiptr begin = (m_head + alignment - 1) & ~(alignment - 1);
+    if(begin + size > m_frameSize)
+        return NULL;
+    m_head = begin + size;
+
+    if(m_mapping)
+    {
+        offset = m_region * m_frameSize + begin;
+        return m_mapping + offset;
+    }
+    offset = begin;
+    return &m_staging[begin];
+}
+
+void StreamingBuffer::flush()
+{
+    if(m_mapping || m_flushed == m_head)
+        return;
+    glBindBuffer(GL_ARRAY_BUFFER, m_buffer);
+    glBufferSubData(GL_ARRAY_BUFFER, m_flushed, m_head - m_flushed, &m_staging[m_flushed]);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    m_flushed = m_head;
+}
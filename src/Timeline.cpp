@@ -0,0 +1,350 @@
+#include "Timeline.h"
+#include "logger.h"
+#include <glm/gtc/matrix_transform.hpp>
+#include <algorithm>
+#include <cerrno>
+
+uint32_t Timeline::getNbComponents(TimelineProperty property)
+{
+    switch(property)
+    {
+        case TIMELINE_POSITION: return 3;
+        case TIMELINE_ROTATION: return 4;
+        case TIMELINE_SCALE:    return 3;
+        case TIMELINE_MATERIAL: return 7;
+    }
+    return 0;
+}
+
+/* \brief Cursor on the tokens of a line, separated by spaces or tabs. NULL at the end of the line or at a comment */
+static char* nextToken(char*& cursor)
+{
+    while(*cursor == ' ' || *cursor == '\t' || *cursor == '\r')
+        cursor++;
+    if(*cursor == 0 || *cursor == '#')
+        return NULL;
+    char* token = cursor;
+    while(*cursor && *cursor != ' ' && *cursor != '\t' && *cursor != '\r')
+        cursor++;
+    if(*cursor)
+        *cursor++ = 0;
+    return token;
+}
+
+/** \brief parse "a,b,c..." (or "a" for all the components)
+ * \param text the text, can be NULL
+ * \param v the result
+ * \param n the number of components
+ * \return false if the text is not a vector of n components */
+static bool parseValues(const char* text, double* v, uint32_t n)
+{
+    if(!text)
+        return false;
+    char* end;
+    v[0] = strtod(text, &end);
+    if(end == text)
+        return false;
+    if(*end == 0)
+    {
+        for(uint32_t i = 1; i < n; i++)
+            v[i] = v[0];
+        return true;
+    }
+    for(uint32_t i = 1; i < n; i++)
+    {
+        if(*end != ',')
+            return false;
+        text = end + 1;
+        v[i] = strtod(text, &end);
+        if(end == text)
+            return false;
+    }
+    return *end == 0;
+}
+
+Timeline* Timeline::load(const std::string& path, const Scene& scene)
+{
+    FILE* file = fopen(path.c_str(), "rb");
+    if(!file)
+    {
+        ERROR("Could not open the timeline %s : %s\n", path.c_str(), strerror(errno));
+        return NULL;
+    }
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    std::vector<char> text(size + 1);
+    size_t nbRead = fread(&text[0], 1, size, file);
+    fclose(file);
+    text[nbRead] = 0;
+
+    Timeline* timeline = new Timeline();
+    std::vector<std::pair<double, uint32_t>> events;
+
+    uint32_t lineNumber = 0;
+    char*    line       = &text[0];
+    bool     valid      = true;
+    while(valid && line && *line)
+    {
+        lineNumber++;
+        char* endOfLine = strchr(line, '\n');
+        if(endOfLine)
+            *endOfLine = 0;
+
+        char* cursor = line;
+        line = endOfLine ? endOfLine + 1 : NULL;
+        char* keyword = nextToken(cursor);
+        if(!keyword)
+            continue;
+
+        if(strcmp(keyword, "track") == 0)
+        {
+            //track <node> <position|rotation|scale|material> [step|linear|spline]
+            const char* node          = nextToken(cursor);
+            const char* property      = nextToken(cursor);
+            const char* interpolation = nextToken(cursor);
+            TimelineTrack track;
+            track.node          = node ? scene.findNode(node) : SCENE_NONE;
+            track.interpolation = TIMELINE_LINEAR;
+            track.firstKey      = timeline->m_times.size();
+            track.nbKeys        = 0;
+            track.firstValue    = timeline->m_values.size();
+            track.cursor        = 0;
+            valid = property && !nextToken(cursor);
+            if(valid && track.node == SCENE_NONE)
+            {
+                ERROR("%s:%u : unknown node %s\n", path.c_str(), lineNumber, node ? node : "");
+                valid = false;
+            }
+            if(valid)
+            {
+                if(strcmp(property, "position") == 0)
+                    track.property = TIMELINE_POSITION;
+                else if(strcmp(property, "rotation") == 0)
+                    track.property = TIMELINE_ROTATION;
+                else if(strcmp(property, "scale") == 0)
+                    track.property = TIMELINE_SCALE;
+                else if(strcmp(property, "material") == 0)
+                    track.property = TIMELINE_MATERIAL;
+                else
+                    valid = false;
+            }
+            if(valid && interpolation)
+            {
+                if(strcmp(interpolation, "step") == 0)
+                    track.interpolation = TIMELINE_STEP;
+                else if(strcmp(interpolation, "linear") == 0)
+                    track.interpolation = TIMELINE_LINEAR;
+                else if(strcmp(interpolation, "spline") == 0)
+                    track.interpolation = TIMELINE_SPLINE;
+                else
+                    valid = false;
+            }
+            if(valid)
+                timeline->m_tracks.push_back(track);
+        }
+        else if(strcmp(keyword, "key") == 0)
+        {
+            //key <time> <values> : position x,y,z | rotation x,y,z angle | scale s|x,y,z | material r,g,b ka kd ks alpha
+            valid = !timeline->m_tracks.empty();
+            if(!valid)
+            {
+                ERROR("%s:%u : a key must follow a track\n", path.c_str(), lineNumber);
+                break;
+            }
+            TimelineTrack& track = timeline->m_tracks.back();
+            double time = 0.0;
+            double value[TIMELINE_MAX_COMPONENTS];
+            valid = parseValues(nextToken(cursor), &time, 1);
+            if(valid && track.property == TIMELINE_ROTATION)
+                valid = parseValues(nextToken(cursor), value, 3) && parseValues(nextToken(cursor), value + 3, 1);
+            else if(valid && track.property == TIMELINE_MATERIAL)
+            {
+                valid = parseValues(nextToken(cursor), value, 3);
+                for(uint32_t i = 3; valid && i < 7; i++)
+                    valid = parseValues(nextToken(cursor), value + i, 1);
+            }
+            else if(valid)
+                valid = parseValues(nextToken(cursor), value, 3);
+            valid = valid && !nextToken(cursor);
+
+            if(valid && track.nbKeys > 0 && time <= timeline->m_times.back())
+            {
+                ERROR("%s:%u : the keys of a track must be in increasing time order\n", path.c_str(), lineNumber);
+                valid = false;
+            }
+            if(valid)
+            {
+                timeline->m_times.push_back(time);
+                timeline->m_values.insert(timeline->m_values.end(), value, value + getNbComponents(track.property));
+                track.nbKeys++;
+                timeline->m_duration = std::max(timeline->m_duration, time);
+            }
+        }
+        else if(strcmp(keyword, "event") == 0)
+        {
+            //event <time> <name>
+            double time = 0.0;
+            valid = parseValues(nextToken(cursor), &time, 1);
+            const char* name = nextToken(cursor);
+            valid = valid && name && !nextToken(cursor);
+            if(valid)
+            {
+                events.push_back(std::make_pair(time, (uint32_t)timeline->m_strings.size()));
+                timeline->m_strings.insert(timeline->m_strings.end(), name, name + strlen(name) + 1);
+                timeline->m_duration = std::max(timeline->m_duration, time);
+            }
+        }
+        else
+            valid = false;
+
+        if(!valid)
+            ERROR("%s:%u : invalid %s line\n", path.c_str(), lineNumber, keyword);
+    }
+
+    for(uint32_t i = 0; valid && i < timeline->m_tracks.size(); i++)
+        if(timeline->m_tracks[i].nbKeys == 0)
+        {
+            ERROR("%s : a track of the node %s has no key\n", path.c_str(), scene.getString(scene.getNodes()[timeline->m_tracks[i].node].name));
+            valid = false;
+        }
+
+    if(!valid)
+    {
+        delete timeline;
+        return NULL;
+    }
+
+    //Events at the same time keep the order of the file
+    std::stable_sort(events.begin(), events.end(), [](const std::pair<double, uint32_t>& a, const std::pair<double, uint32_t>& b) {return a.first < b.first;});
+    for(size_t i = 0; i < events.size(); i++)
+    {
+        timeline->m_eventTimes.push_back(events[i].first);
+        timeline->m_eventNames.push_back(events[i].second);
+    }
+    return timeline;
+}
+
+void Timeline::seek(double time)
+{
+    for(uint32_t i = 0; i < m_tracks.size(); i++)
+    {
+        TimelineTrack& track = m_tracks[i];
+        const double*  times = &m_times[track.firstKey];
+        uint32_t after = std::upper_bound(times, times + track.nbKeys, time) - times;
+        track.cursor = after > 0 ? after - 1 : 0;
+    }
+
+    m_eventCursor = std::lower_bound(m_eventTimes.begin(), m_eventTimes.end(), time) - m_eventTimes.begin();
+    m_nextEvent   = m_eventCursor;
+    m_lastTime    = time;
+}
+
+void Timeline::interpolate(const TimelineTrack& track, double time, double* value) const
+{
+    uint32_t       n      = getNbComponents(track.property);
+    const double*  times  = &m_times[track.firstKey];
+    const double*  values = &m_values[track.firstValue];
+    uint32_t       k      = track.cursor;
+
+    if(track.interpolation == TIMELINE_STEP || k + 1 >= track.nbKeys || time <= times[k])
+    {
+        memcpy(value, values + k * n, n * sizeof(double));
+        return;
+    }
+
+    double duration = times[k+1] - times[k];
+    double u        = (time - times[k]) / duration;
+    const double* p0 = values + k * n;
+    const double* p1 = values + (k+1) * n;
+    if(track.interpolation == TIMELINE_LINEAR)
+    {
+        for(uint32_t c = 0; c < n; c++)
+            value[c] = p0[c] + u * (p1[c] - p0[c]);
+        return;
+    }
+
+    /* Cubic Hermite with the Catmull-Rom tangents, for keys unevenly spaced in time. One-sided at both ends */
+    uint32_t before = k > 0 ? k - 1 : k;
+    uint32_t after  = k + 2 < track.nbKeys ? k + 2 : k + 1;
+    const double* pBefore = values + before * n;
+    const double* pAfter  = values + after  * n;
+    double u2 = u * u, u3 = u2 * u;
+    double h00 = 2*u3 - 3*u2 + 1, h10 = u3 - 2*u2 + u, h01 = -2*u3 + 3*u2, h11 = u3 - u2;
+    for(uint32_t c = 0; c < n; c++)
+    {
+        double m0 = (p1[c] - pBefore[c]) / (times[k+1] - times[before]) * duration;
+        double m1 = (pAfter[c] - p0[c])  / (times[after] - times[k])    * duration;
+        value[c] = h00 * p0[c] + h10 * m0 + h01 * p1[c] + h11 * m1;
+    }
+}
+
+void Timeline::evaluate(double time, std::vector<GameObject>& objects)
+{
+    double previous = m_lastTime;
+    bool   backward = time < previous;
+    if(backward)
+        seek(time);
+    m_lastTime = time;
+    m_cuts.clear();
+
+    double value[TIMELINE_MAX_COMPONENTS];
+    for(uint32_t i = 0; i < m_tracks.size(); i++)
+    {
+        TimelineTrack& track = m_tracks[i];
+        const double*  times = &m_times[track.firstKey];
+
+        //Forward only (the backward moves went through seek) : one key per call when playing step by step
+        uint32_t cursor = track.cursor;
+        while(track.cursor + 1 < track.nbKeys && times[track.cursor + 1] <= time)
+            track.cursor++;
+        if(time < times[0])
+            continue;
+
+        /* A step key reached (the first one included) moves the node at once */
+        bool keyReached = track.cursor != cursor || previous < times[0];
+        if(track.property != TIMELINE_MATERIAL && (backward || (track.interpolation == TIMELINE_STEP && keyReached)) &&
+           std::find(m_cuts.begin(), m_cuts.end(), track.node) == m_cuts.end())
+            m_cuts.push_back(track.node);
+
+        interpolate(track, time, value);
+        GameObject& go = objects[track.node];
+        switch(track.property)
+        {
+            case TIMELINE_POSITION:
+                go.position = glm::dvec3(value[0], value[1], value[2]);
+                break;
+            case TIMELINE_ROTATION:
+            {
+                glm::vec3 axis((float)value[0], (float)value[1], (float)value[2]);
+                go.propagatedMatrix = glm::mat4(1.0f);
+                if(glm::dot(axis, axis) > 0.0f)
+                    go.propagatedMatrix = glm::rotate(go.propagatedMatrix, (float)value[3], axis);
+                break;
+            }
+            case TIMELINE_SCALE:
+                go.localMatrix = glm::scale(glm::mat4(1.0f), glm::vec3((float)value[0], (float)value[1], (float)value[2]));
+                break;
+            case TIMELINE_MATERIAL:
+                go.sphereMtl.color = glm::vec3((float)value[0], (float)value[1], (float)value[2]);
+                go.sphereMtl.ka    = (float)value[3];
+                go.sphereMtl.kd    = (float)value[4];
+                go.sphereMtl.ks    = (float)value[5];
+                go.sphereMtl.alpha = (float)value[6];
+                break;
+        }
+    }
+
+    while(m_eventCursor < m_eventTimes.size() && m_eventTimes[m_eventCursor] <= time)
+        m_eventCursor++;
+}
+
+bool Timeline::pollEvent(TimelineEvent& event)
+{
+    if(m_nextEvent >= m_eventCursor)
+        return false;
+    event.time = m_eventTimes[m_nextEvent];
+    event.name = &m_strings[m_eventNames[m_nextEvent]];
+    m_nextEvent++;
+    return true;
+}
@@ -0,0 +1,113 @@
+#include "UniformBuffers.h"
+#include "logger.h"
+#include <cstring>
+
+UniformBuffers::UniformBuffers(uint32_t nbObjects)
+{
+    GLint alignment = 256;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+    m_alignment = alignment;
+
+    glGenBuffers(1, &m_materialUBO);
+    glBindBuffer(GL_UNIFORM_BUFFER, m_materialUBO);
+    glBufferData(GL_UNIFORM_BUFFER, SHADER_MAX_MATERIALS * sizeof(MaterialUniforms), NULL, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    glBindBufferBase(GL_UNIFORM_BUFFER, BLOCK_MATERIAL, m_materialUBO);
+
+    /* The frame block, then the object blocks, each one aligned */
+    m_objectStride = StreamingBuffer::getAllocationSize(sizeof(ObjectUniforms), m_alignment);
+    m_stream = new StreamingBuffer(StreamingBuffer::getAllocationSize(sizeof(FrameUniforms), m_alignment) + m_objectStride * nbObjects);
+}
+
+UniformBuffers::~UniformBuffers()
+{
+    delete m_stream;
+    glDeleteBuffers(1, &m_materialUBO);
+}
+
+bool UniformBuffers::isSupported()
+{
+    return GLEW_ARB_uniform_buffer_object;
+}
+
+void UniformBuffers::beginFrame(const FrameUniforms& frame, uint32_t nbObjects)
+{
+    /* The region is sized for this frame : no draw is ever left without its block */
+    m_stream->beginFrame(StreamingBuffer::getAllocationSize(sizeof(FrameUniforms), m_alignment) + m_objectStride * nbObjects);
+    m_nbObjects = nbObjects;
+    m_frame++;
+
+    GLintptr offset = 0;
+    void* block = m_stream->allocate(sizeof(FrameUniforms), offset, m_alignment);
+    memcpy(block, &frame, sizeof(FrameUniforms));
+    glBindBufferRange(GL_UNIFORM_BUFFER, BLOCK_FRAME, m_stream->getBuffer(), offset, sizeof(FrameUniforms));
+
+    /* One allocation for all the object blocks, each one at a multiple of the stride */
+    m_objects = (uint8_t*)m_stream->allocate(m_objectStride * nbObjects, m_objectOffset, m_alignment);
+}
+
+uint32_t UniformBuffers::getMaterialIndex(const Material& mtl)
+{
+    for(uint32_t i = 0; i < m_materials.size(); i++)
+    {
+        const Material& m = m_materials[i];
+        if(m.color == mtl.color && m.ka == mtl.ka && m.kd == mtl.kd && m.ks == mtl.ks && m.alpha == mtl.alpha)
+        {
+            m_materialFrames[i] = m_frame;
+            return i;
+        }
+    }
+
+    if(m_materials.size() < SHADER_MAX_MATERIALS)
+    {
+        m_materials.push_back(mtl);
+        m_materialFrames.push_back(m_frame);
+        m_materialsDirty = true;
+        return m_materials.size()-1;
+    }
+
+    /* Full : replace the least recently used one. Only a material unused by this frame, its previous draws keep their values */
+    uint32_t oldest = 0;
+    for(uint32_t i = 1; i < m_materials.size(); i++)
+        if(m_materialFrames[i] < m_materialFrames[oldest])
+            oldest = i;
+    if(m_materialFrames[oldest] == m_frame)
+    {
+        ERROR("Too many materials in this frame (maximum %d)\n", SHADER_MAX_MATERIALS);
+        return 0;
+    }
+    m_materials[oldest]      = mtl;
+    m_materialFrames[oldest] = m_frame;
+    m_materialsDirty = true;
+    return oldest;
+}
+
+void UniformBuffers::setObject(uint32_t index, const ObjectUniforms& object)
+{
+    memcpy(m_objects + index * m_objectStride, &object, sizeof(ObjectUniforms));
+}
+
+void UniformBuffers::flush()
+{
+    /* New materials are uploaded once, before the first draw using them */
+    if(m_materialsDirty)
+    {
+        std::vector<MaterialUniforms> materials(m_materials.size());
+        for(uint32_t i = 0; i < m_materials.size(); i++)
+        {
+            materials[i].color = glm::vec4(m_materials[i].color, 1.0f);
+            materials[i].cts   = glm::vec4(m_materials[i].ka, m_materials[i].kd, m_materials[i].ks, m_materials[i].alpha);
+        }
+        glBindBuffer(GL_UNIFORM_BUFFER, m_materialUBO);
+        glBufferSubData(GL_UNIFORM_BUFFER, 0, materials.size() * sizeof(MaterialUniforms), materials.data());
+        m_materialsDirty = false;
+    }
+
+    /* The frame block and every object block at once */
+    m_stream->flush();
+}
+
+void UniformBuffers::bindObject(uint32_t index)
+{
+    glBindBufferRange(GL_UNIFORM_BUFFER, BLOCK_OBJECT, m_stream->getBuffer(), m_objectOffset + index * m_objectStride, sizeof(ObjectUniforms));
+}
@@ -0,0 +1,104 @@
+#include "WeightedBlending.h"
+#include "logger.h"
+
+/* \brief Create a floating point texture of one pixel per pixel of the target */
+static GLuint createTarget(GLint format, GLenum channels, uint32_t width, uint32_t height)
+{
+    GLuint texture;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, channels, GL_FLOAT, NULL);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    return texture;
+}
+
+WeightedBlending* WeightedBlending::create(Framebuffer& target, const char* vertexPath, const char* fragPath)
+{
+    ShaderLibrary* composite = ShaderLibrary::loadFromPaths(vertexPath, fragPath);
+    if(composite && !composite->get(0))
+    {
+        delete composite;
+        composite = NULL;
+    }
+    if(!composite)
+        return NULL;
+
+    WeightedBlending* blending = new WeightedBlending(target);
+    blending->m_composite    = composite;
+    blending->m_accumulation = createTarget(GL_RGBA16F, GL_RGBA, target.getWidth(), target.getHeight());
+    blending->m_weights      = createTarget(GL_R16F, GL_RED, target.getWidth(), target.getHeight());
+    glGenVertexArrays(1, &blending->m_vao);
+
+    glGenFramebuffers(1, &blending->m_fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, blending->m_fbo);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, blending->m_accumulation, 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, blending->m_weights, 0);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, target.getDepthBuffer());
+    GLenum buffers[] = {GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1};
+    glDrawBuffers(2, buffers);
+    GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    target.bind();
+
+    if(status != GL_FRAMEBUFFER_COMPLETE)
+    {
+        ERROR("The floating point targets of the order-independent transparency are incomplete (status 0x%x)\n", status);
+        delete blending;
+        return NULL;
+    }
+    return blending;
+}
+
+WeightedBlending::~WeightedBlending()
+{
+    glDeleteFramebuffers(1, &m_fbo);
+    glDeleteTextures(1, &m_accumulation);
+    glDeleteTextures(1, &m_weights);
+    glDeleteVertexArrays(1, &m_vao);
+    delete m_composite;
+}
+
+void WeightedBlending::begin()
+{
+    glBindFramebuffer(GL_FRAMEBUFFER, m_fbo);
+    const GLfloat revealage[] = {0.0f, 0.0f, 0.0f, 1.0f};
+    const GLfloat weights[]   = {0.0f, 0.0f, 0.0f, 0.0f};
+    glClearBufferfv(GL_COLOR, 0, revealage);
+    glClearBufferfv(GL_COLOR, 1, weights);
+
+    /* rgb : src + dst in both targets. a (accumulation only) : dst * (1 - src), the product of the transparencies */
+    glEnable(GL_BLEND);
+    glBlendFuncSeparate(GL_ONE, GL_ONE, GL_ZERO, GL_ONE_MINUS_SRC_ALPHA);
+    glDepthMask(GL_FALSE);
+}
+
+void WeightedBlending::composite()
+{
+    m_target.bind();
+
+    /* The target stays opaque (exported frames) */
+    glBlendFuncSeparate(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, GL_ZERO, GL_ONE);
+    glDisable(GL_DEPTH_TEST);
+    /* The samplers are set at each draw : a reload of the sources replaces the program */
+    GLuint program = m_composite->get(0)->getProgramID();
+    glUseProgram(program);
+    glUniform1i(glGetUniformLocation(program, "uAccumulation"), 0);
+    glUniform1i(glGetUniformLocation(program, "uWeights"), 1);
+    glBindVertexArray(m_vao);
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D, m_weights);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, m_accumulation);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glBindVertexArray(0);
+    glUseProgram(0);
+    glEnable(GL_DEPTH_TEST);
+    glDepthMask(GL_TRUE);
+    glDisable(GL_BLEND);
+}
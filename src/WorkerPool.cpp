@@ -0,0 +1,76 @@
+#include "WorkerPool.h"
+#include <algorithm>
+
+WorkerPool::WorkerPool(uint32_t nbThreads) : m_nextTask(0)
+{
+    if(nbThreads == 0)
+        nbThreads = std::max(1u, std::thread::hardware_concurrency());
+    for(uint32_t t = 1; t < nbThreads; t++)
+        m_threads.push_back(std::thread(&WorkerPool::work, this));
+}
+
+WorkerPool::~WorkerPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_wakeCond.notify_all();
+    for(size_t t = 0; t < m_threads.size(); t++)
+        m_threads[t].join();
+}
+
+void WorkerPool::dispatch(uint32_t nbTasks, TaskFunction function, const void* task)
+{
+    /* Nothing to share : no wake up */
+    if(m_threads.empty() || nbTasks <= 1)
+    {
+        for(uint32_t t = 0; t < nbTasks; t++)
+            function(task, t);
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_function = function;
+        m_task     = task;
+        m_nbTasks  = nbTasks;
+        m_nextTask.store(0, std::memory_order_relaxed);
+        m_nbBusy   = m_threads.size();
+        m_pass++;
+    }
+    m_wakeCond.notify_all();
+
+    runTasks();
+
+    /* Every worker has to see the pass before the next one starts (and before the task goes out of scope) */
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_doneCond.wait(lock, [this]() {return m_nbBusy == 0;});
+}
+
+void WorkerPool::runTasks()
+{
+    for(uint32_t t = m_nextTask.fetch_add(1, std::memory_order_relaxed); t < m_nbTasks; t = m_nextTask.fetch_add(1, std::memory_order_relaxed))
+        m_function(m_task, t);
+}
+
+void WorkerPool::work()
+{
+    uint64_t pass = 0;
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while(true)
+    {
+        m_wakeCond.wait(lock, [this, pass]() {return m_stop || m_pass != pass;});
+        if(m_stop)
+            return;
+        pass = m_pass;
+
+        /* The pass is read under the lock, then run without it */
+        lock.unlock();
+        runTasks();
+        lock.lock();
+
+        if(--m_nbBusy == 0)
+            m_doneCond.notify_one();
+    }
+}
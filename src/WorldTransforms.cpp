@@ -0,0 +1,57 @@
+#include "WorldTransforms.h"
+#include <glm/gtc/matrix_transform.hpp>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define WORLDTRANSFORMS_SSE2
+#endif
+
+void WorldTransforms::gather(GameObject& go, const glm::dmat4& parentMatrix)
+{
+    glm::dmat4 propagated = glm::translate(parentMatrix, go.position) * glm::dmat4(go.propagatedMatrix);
+    glm::dmat4 world      = propagated * glm::dmat4(go.localMatrix);
+
+    /* The rotation and the scale are relative : float is enough. The translation waits for the camera */
+    for(int c = 0; c < 3; c++)
+        go.modelMatrix[c] = glm::vec4(world[c]);
+    go.worldPosition = glm::dvec3(world[3]);
+
+    m_objects.push_back(&go);
+    m_x.push_back(world[3].x);
+    m_y.push_back(world[3].y);
+    m_z.push_back(world[3].z);
+
+    for(uint32_t i = 0; i < go.children.size(); i++)
+        gather(*go.children[i], propagated);
+}
+
+void WorldTransforms::update(const std::vector<GameObject*>& roots)
+{
+    m_objects.clear();
+    m_x.clear(); m_y.clear(); m_z.clear();
+    for(uint32_t i = 0; i < roots.size(); i++)
+        gather(*roots[i], glm::dmat4(1.0));
+}
+
+void WorldTransforms::rebase(const glm::dvec3& cameraPosition)
+{
+    /* Subtracted in double, then converted : the small difference keeps the precision the large positions had */
+    uint32_t n = m_objects.size();
+    uint32_t i = 0;
+#ifdef WORLDTRANSFORMS_SSE2
+    __m128d cx = _mm_set1_pd(cameraPosition.x), cy = _mm_set1_pd(cameraPosition.y), cz = _mm_set1_pd(cameraPosition.z);
+    for(; i + 2 <= n; i += 2)
+    {
+        /* The two converted floats are in the low half */
+        float rx[4], ry[4], rz[4];
+        _mm_storeu_ps(rx, _mm_cvtpd_ps(_mm_sub_pd(_mm_loadu_pd(&m_x[i]), cx)));
+        _mm_storeu_ps(ry, _mm_cvtpd_ps(_mm_sub_pd(_mm_loadu_pd(&m_y[i]), cy)));
+        _mm_storeu_ps(rz, _mm_cvtpd_ps(_mm_sub_pd(_mm_loadu_pd(&m_z[i]), cz)));
+        m_objects[i]->modelMatrix[3]   = glm::vec4(rx[0], ry[0], rz[0], 1.0f);
+        m_objects[i+1]->modelMatrix[3] = glm::vec4(rx[1], ry[1], rz[1], 1.0f);
+    }
+#endif
+    for(; i < n; i++)
+        m_objects[i]->modelMatrix[3] = glm::vec4((float)(m_x[i] - cameraPosition.x), (float)(m_y[i] - cameraPosition.y),
+                                                 (float)(m_z[i] - cameraPosition.z), 1.0f);
+}
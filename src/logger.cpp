@@ -0,0 +1,425 @@
+#include "logger.h"
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <csignal>
+#include <cerrno>
+
+#ifdef _WIN32
+#include <io.h>
+#define write _write
+#else
+#include <unistd.h>
+#endif
+
+namespace logger
+{
+    /* \brief Header of a record in a ring. The arguments follow */
+    struct RecordHeader
+    {
+        uint32_t    size;     /*!< Bytes of the record, header included, multiple of 8. 0 : skip to the start of the ring*/
+        uint32_t    level;
+        int32_t     line;
+        uint32_t    padding;
+        uint64_t    sequence; /*!< Global order of the records, to merge the rings*/
+        const char* file;
+        const char* format;
+    };
+
+    /* \brief Single producer (the owning thread), single consumer (the background thread) ring of records */
+    struct Ring
+    {
+        Ring*                 next;     /*!< The ring registered before it*/
+        std::atomic<uint64_t> head;     /*!< Written by the producer*/
+        uint64_t              reserved; /*!< Producer : head of the record being written*/
+        std::atomic<uint64_t> pending;  /*!< Producer : at most the sequence of the record being written, UINT64_MAX if none*/
+        uint8_t               padding[40];  /*!< head and tail on separate cache lines*/
+        std::atomic<uint64_t> tail;     /*!< Written by the consumer*/
+        uint8_t               data[LOG_RING_SIZE];
+
+        Ring() : next(NULL), head(0), reserved(0), pending(UINT64_MAX), tail(0) {}
+    };
+
+    class Backend;
+    static std::atomic<Backend*> s_backend(NULL); /*!< For the crash handler, which cannot run the initialization of Backend::instance*/
+
+    /* \brief The rings of every thread which logged, and the thread emptying them */
+    class Backend
+    {
+        public:
+            Backend() : m_rings(NULL), m_running(true)
+            {
+                m_consumer.clear();
+                s_backend = this;
+                installCrashHandlers();
+                m_thread = std::thread(&Backend::run, this);
+            }
+
+            ~Backend()
+            {
+                s_backend = NULL;
+                m_running = false;
+                m_thread.join();
+                drain();
+            }
+
+            Ring* registerThread()
+            {
+                /* Pushed without a lock : the crash handler walks the list. Never freed : another thread may still read it when the owner exits */
+                Ring* ring = new Ring();
+                ring->next = m_rings.load();
+                while(!m_rings.compare_exchange_weak(ring->next, ring))
+                    ;
+                return ring;
+            }
+
+            uint64_t nextSequence() {return m_sequence.fetch_add(1);}
+            uint64_t peekSequence() {return m_sequence.load();}
+
+            /** \brief write the published records in sequence order, up to the first one still being written
+             * \param spins how many times to try to become the consumer
+             * \return true if something was written, false if nothing was or if another thread is the consumer */
+            bool drain(uint32_t spins = UINT32_MAX)
+            {
+                /* Someone else is reading the rings : consuming too would format its records twice */
+                while(m_consumer.test_and_set(std::memory_order_acquire))
+                {
+                    if(--spins == 0)
+                        return false;
+                    std::this_thread::yield();
+                }
+
+                /* A record is numbered when it is reserved but published at its end : another thread may publish a later number first.
+                 * Every number below the bound was taken before it was read and its ring does not announce it as pending : it is published */
+                uint64_t bound = m_sequence.load();
+                for(Ring* ring = m_rings.load(); ring; ring = ring->next)
+                    bound = std::min(bound, ring->pending.load());
+
+                bool written = false;
+                Ring* best = NULL;
+                while(RecordHeader* record = next(bound, best))
+                {
+                    format(*record);
+                    best->tail.store(best->tail.load(std::memory_order_relaxed) + record->size, std::memory_order_release);
+                    written = true;
+                }
+                if(written)
+                {
+                    fflush(stdout);
+                    fflush(stderr);
+                }
+                m_consumer.clear(std::memory_order_release);
+                return written;
+            }
+
+            /** \brief wait until the rings are empty */
+            void flush()
+            {
+                drain();
+            }
+
+            static Backend& instance()
+            {
+                static Backend backend;
+                return backend;
+            }
+        private:
+            void run()
+            {
+                while(m_running)
+                {
+                    if(!drain())
+                        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                }
+            }
+
+            /** \brief k-way merge on the sequence numbers : get the oldest published record of every ring
+             * \param bound only the records numbered below it
+             * \param best set to the ring of the record
+             * \return the record or NULL if there is none */
+            RecordHeader* next(uint64_t bound, Ring*& best)
+            {
+                RecordHeader* bestRecord = NULL;
+                for(Ring* ring = m_rings.load(); ring; ring = ring->next)
+                {
+                    RecordHeader* record = front(ring);
+                    if(record && record->sequence < bound && (!bestRecord || record->sequence < bestRecord->sequence))
+                    {
+                        best       = ring;
+                        bestRecord = record;
+                    }
+                }
+                return bestRecord;
+            }
+
+            /** \brief get the oldest published record of a ring, skipping the wrap markers
+             * \return the record or NULL if the ring is empty */
+            static RecordHeader* front(Ring* ring)
+            {
+                while(true)
+                {
+                    uint64_t tail = ring->tail.load(std::memory_order_relaxed);
+                    uint64_t head = ring->head.load(std::memory_order_acquire);
+                    if(tail == head)
+                        return NULL;
+                    uint32_t offset = tail & (LOG_RING_SIZE - 1);
+                    RecordHeader* record = (RecordHeader*)(ring->data + offset);
+                    if(record->size != 0)
+                        return record;
+                    ring->tail.store(tail + (LOG_RING_SIZE - offset), std::memory_order_release);
+                }
+            }
+
+            /** \brief format a record : the conversion specifications are printed one by one with their serialized argument */
+            static void format(const RecordHeader& record)
+            {
+                FILE* stream = stdout;
+                if(record.level == LEVEL_ERROR)
+                {
+                    stream = stderr;
+                    fprintf(stream, RED "Error : " GRN "%s:%d " RESET, record.file, record.line);
+                }
+                else if(record.level == LEVEL_WARNING)
+                    fprintf(stream, YEL "Warning : " GRN "%s:%d " RESET, record.file, record.line);
+                else
+                    fprintf(stream, BOLD WHT "INFO : " RESET GRN "%s:%d " RESET, record.file, record.line);
+
+                const uint8_t* arg = (const uint8_t*)(&record + 1);
+                const uint8_t* end = (const uint8_t*)&record + record.size;
+                const char*    f   = record.format;
+                while(*f)
+                {
+                    if(*f != '%')
+                    {
+                        const char* text = f;
+                        while(*f && *f != '%')
+                            f++;
+                        fwrite(text, 1, f - text, stream);
+                        continue;
+                    }
+                    if(f[1] == '%')
+                    {
+                        fputc('%', stream);
+                        f += 2;
+                        continue;
+                    }
+
+                    /* Copy the flags, width and precision, drop the length modifiers : the arguments are stored on 64 bits */
+                    char spec[32];
+                    size_t n = 0;
+                    spec[n++] = *f++;
+                    while(*f && strchr("-+ #0123456789.", *f) && n < sizeof(spec) - 4)
+                        spec[n++] = *f++;
+                    while(*f && strchr("hlLqjzt", *f))
+                        f++;
+                    char conversion = *f;
+                    if(conversion)
+                        f++;
+
+                    if(arg >= end || conversion == 'n' || conversion == 0)
+                    {
+                        fputs("(?)", stream);
+                        continue;
+                    }
+                    uint8_t type = *arg;
+                    if(type == ARG_STRING)
+                    {
+                        uint16_t length;
+                        memcpy(&length, arg + 1, 2);
+                        char text[LOG_MAX_STRING_ARG + 1];
+                        memcpy(text, arg + 3, length);
+                        text[length] = 0;
+                        arg += 3 + length;
+                        spec[n++] = 's';
+                        spec[n]   = 0;
+                        fprintf(stream, spec, text);
+                        continue;
+                    }
+
+                    uint64_t bits;
+                    memcpy(&bits, arg + 1, 8);
+                    arg += 9;
+                    if(type == ARG_DOUBLE)
+                    {
+                        double value;
+                        memcpy(&value, &bits, 8);
+                        spec[n++] = strchr("eEfFgGaA", conversion) ? conversion : 'f';
+                        spec[n]   = 0;
+                        fprintf(stream, spec, value);
+                    }
+                    else if(type == ARG_POINTER || conversion == 'p')
+                    {
+                        spec[n++] = 'p';
+                        spec[n]   = 0;
+                        fprintf(stream, spec, (void*)(uintptr_t)bits);
+                    }
+                    else if(conversion == 'c')
+                    {
+                        spec[n++] = 'c';
+                        spec[n]   = 0;
+                        fprintf(stream, spec, (int)bits);
+                    }
+                    else
+                    {
+                        /* Integers : keep the conversion of the format, on long long */
+                        spec[n++] = 'l';
+                        spec[n++] = 'l';
+                        spec[n++] = strchr("diouxX", conversion) ? conversion : (type == ARG_INT ? 'd' : 'u');
+                        spec[n]   = 0;
+                        if(type == ARG_INT && (conversion == 'd' || conversion == 'i'))
+                            fprintf(stream, spec, (long long)bits);
+                        else
+                            fprintf(stream, spec, (unsigned long long)bits);
+                    }
+                }
+            }
+
+            /** \brief write a whole buffer with write(2), async-signal-safe */
+            static void writeRaw(int fd, const char* text, size_t length)
+            {
+                while(length > 0)
+                {
+                    long n = write(fd, text, length);
+                    if(n < 0 && errno == EINTR)
+                        continue;
+                    if(n <= 0)
+                        return;
+                    text   += n;
+                    length -= n;
+                }
+            }
+
+            /** \brief write a record without formatting it (async-signal-safe) : the location and the format, without the arguments */
+            static void writeRaw(const RecordHeader& record)
+            {
+                int fd = record.level == LEVEL_ERROR ? 2 : 1;
+                const char* prefix = record.level == LEVEL_ERROR ? RED "Error : " GRN : (record.level == LEVEL_WARNING ? YEL "Warning : " GRN : BOLD WHT "INFO : " RESET GRN);
+                writeRaw(fd, prefix, strlen(prefix));
+                writeRaw(fd, record.file, strlen(record.file));
+
+                char     digits[16];
+                size_t   n    = sizeof(digits);
+                uint32_t line = record.line > 0 ? record.line : 0;
+                do
+                {
+                    digits[--n] = '0' + line % 10;
+                    line /= 10;
+                } while(line && n > 1);
+                digits[--n] = ':';
+                writeRaw(fd, digits + n, sizeof(digits) - n);
+                writeRaw(fd, " " RESET, strlen(" " RESET));
+
+                size_t length = strlen(record.format);
+                writeRaw(fd, record.format, length);
+                if(length == 0 || record.format[length-1] != '\n')
+                    writeRaw(fd, "\n", 1);
+            }
+
+            /** \brief write the published records from a signal handler : no lock, no allocation, no stdio
+             * The consumer may be the crashed thread or be busy on another one : a bounded wait, then the records are given up */
+            void crashDump()
+            {
+                uint32_t spins = 1u << 24;
+                while(m_consumer.test_and_set(std::memory_order_acquire))
+                {
+                    if(--spins == 0)
+                    {
+                        const char lost[] = RED "Error : " RESET "the log records left are lost in the crash\n";
+                        writeRaw(2, lost, sizeof(lost) - 1);
+                        return;
+                    }
+                }
+
+                Ring* best = NULL;
+                while(RecordHeader* record = next(UINT64_MAX, best))
+                {
+                    writeRaw(*record);
+                    best->tail.store(best->tail.load(std::memory_order_relaxed) + record->size, std::memory_order_release);
+                }
+                m_consumer.clear(std::memory_order_release);
+            }
+
+            static void onCrash(int signal)
+            {
+                /* Write what is left, then let the default handler terminate the program.
+                 * The records the background thread formatted may still be in the buffers of stdio, which cannot be flushed from here */
+                Backend* backend = s_backend.load();
+                if(backend)
+                    backend->crashDump();
+                std::signal(signal, SIG_DFL);
+                std::raise(signal);
+            }
+
+            /** \brief catch the fatal signals only : SIGINT and SIGTERM keep the behaviour of the program */
+            static void installCrashHandlers()
+            {
+                const int signals[] = {SIGSEGV, SIGABRT, SIGFPE, SIGILL
+#ifdef SIGBUS
+                                       , SIGBUS
+#endif
+                                       };
+                for(size_t i = 0; i < sizeof(signals) / sizeof(signals[0]); i++)
+                    std::signal(signals[i], onCrash);
+            }
+
+            std::atomic<Ring*>    m_rings;         /*!< The last registered ring, the others follow*/
+            std::atomic<uint64_t> m_sequence{0};
+            std::atomic<bool>     m_running;
+            std::atomic_flag      m_consumer;      /*!< Held by whoever reads the rings*/
+            std::thread           m_thread;
+    };
+
+    static thread_local Ring* t_ring = NULL;
+
+    uint8_t* beginRecord(uint32_t size, Level level, const char* file, int line, const char* format)
+    {
+        Backend& backend = Backend::instance();
+        if(!t_ring)
+            t_ring = backend.registerThread();
+        Ring* ring = t_ring;
+
+        uint32_t recordSize = (sizeof(RecordHeader) + size + 7) & ~7u;
+        uint64_t head       = ring->head.load(std::memory_order_relaxed);
+        uint32_t offset     = head & (LOG_RING_SIZE - 1);
+        uint32_t contiguous = LOG_RING_SIZE - offset;
+        uint32_t needed     = recordSize + (contiguous < recordSize ? contiguous : 0);
+
+        /* Full : the background thread is late, wait for it rather than losing a message */
+        while(LOG_RING_SIZE - (head - ring->tail.load(std::memory_order_acquire)) < needed)
+            std::this_thread::yield();
+
+        if(contiguous < recordSize)
+        {
+            /* Not enough room before the end of the ring : a wrap marker, the record starts at 0 */
+            ((RecordHeader*)(ring->data + offset))->size = 0;
+            head  += contiguous;
+            offset = 0;
+            ring->head.store(head, std::memory_order_release);
+        }
+
+        RecordHeader* record = (RecordHeader*)(ring->data + offset);
+        record->size     = recordSize;
+        record->level    = level;
+        record->line     = line;
+        record->padding  = 0;
+        /* Announced before it is numbered : a lower bound of its number (see Backend::drain) */
+        ring->pending.store(backend.peekSequence());
+        record->sequence = backend.nextSequence();
+        record->file     = file;
+        record->format   = format;
+        ring->reserved   = head + recordSize;
+        return (uint8_t*)(record + 1);
+    }
+
+    void endRecord()
+    {
+        t_ring->head.store(t_ring->reserved, std::memory_order_release);
+        t_ring->pending.store(UINT64_MAX);
+    }
+
+    void flush()
+    {
+        Backend::instance().flush();
+    }
+}
@@ -27,118 +27,268 @@
 #include <glm/gtc/type_ptr.hpp>
 
 #include "Shader.h"
+#include "ShaderLibrary.h"
+#include "ShaderWatcher.h"
 #include "logger.h"
-#include <stack>
 #include <vector>
 
-#include "Sphere.h"
+#include "StaticGeometry.h"
+#include "Annulus.h"
+#include "GameObject.h"
+#include "UniformBuffers.h"
+#include "SceneCuller.h"
+#include "RenderQueue.h"
+#include "HeadlessContext.h"
+#include "Framebuffer.h"
+#include "FrameExporter.h"
+#include "Profiler.h"
+#include "Scene.h"
+#include "OrbitalCatalog.h"
+#include "CollisionWorld.h"
+#include "ParticleSystem.h"
+#include "DepthRange.h"
+#include "WorldTransforms.h"
+#include "Timeline.h"
+#include "TripleBuffer.h"
+#include "StreamingBuffer.h"
+#include "Eclipses.h"
+#include "WeightedBlending.h"
+#include "Skybox.h"
+#include "RayTracer.h"
+#include "WorkerPool.h"
+#include <cstring>
+#include <cstddef>
+#include <thread>
+#include <atomic>
+#include <chrono>
 
 #define WIDTH     800
 #define HEIGHT    800
 #define FRAMERATE 60
-#define TIME_PER_FRAME_MS  (1.0f/FRAMERATE * 1e3)
 #define INDICE_TO_PTR(x) ((void*)(x))
+#ifndef SHADER_SOURCE_DIR
+#define SHADER_SOURCE_DIR "Shaders" //Set by the build to the sources of the repository, watched instead of their copy next to the executable
+#endif
+#define DAYS_PER_STEP (365.25 * 0.0077 / (2.0 * M_PI)) //The Earth pivot of the scene turns 0.0077 rad per step
+#define COLLISION_BODIES    1 //Solid bodies of the scene (the occluders)
+#define COLLISION_ASTEROIDS 2 //Asteroids of the catalog : they only hit the bodies
+#define RING_INNER_RADIUS 0.2655f //Of the Annulus of the rings (outer radius 0.5) : the ring textures go from 74,500 to 140,220 km
+
+//What the end of the animation still draws, changed by the events of the timeline
+enum DrawPhase { DRAW_ALL, DRAW_SUN, DRAW_STARS, DRAW_NOTHING };
+
+//Pick the cheapest shader variant which renders this material exactly
+uint32_t cheapestFeatures(const Material& mtl) {
+    uint32_t features = mtl.shaderFeatures;
+    if (mtl.kd == 0.0f && mtl.ks == 0.0f)
+        features |= SHADER_UNLIT;
+    else if (mtl.ks == 0.0f)
+        features |= SHADER_NO_SPECULAR;
+    return features;
+}
 
-struct Material {
-    glm::vec3 color;
-    float ka;
-    float kd;
-    float ks;
-    float alpha;
+//A body to draw, as a simulation step left it : visible, with its camera-relative transform and its material of the step
+struct BodyState {
+    glm::mat4 model;
+    glm::vec4 sphere; //Camera-relative bounding sphere (xyz center, w radius)
+    Material material;
+    GLuint texture;
+    GLuint vao;
+    const Geometry* geometry; //Its mesh : the vertices drawn, the shape ray traced
+    bool translucent;
+    uint32_t nbOccluders;                          //The bodies which can hide a part of the light from this one
+    glm::vec4 occluders[SHADER_MAX_OCCLUDERS];     //Camera-relative
 };
 
-struct Light {
-    glm::vec3 position;
-    glm::vec3 color;
+//Impostors of the same shader, texture and material : a single instanced draw. A body in eclipse has its own, with its occluders
+struct ImpostorBatch {
+    Shader* shader;
+    GLuint texture;
+    Material material;
+    float distance;                //Of the nearest one
+    std::vector<glm::mat4> models; //Camera-relative
+    uint32_t nbOccluders;
+    glm::vec4 occluders[SHADER_MAX_OCCLUDERS];
 };
 
-//Objects
-struct GameObject {
-    GLuint vboID = 0;
-    GLuint texture = 0;
-    Geometry* geometry = nullptr;
-    Material sphereMtl;
-    Light light;
-    glm::mat4 propagatedMatrix = glm::mat4(1.0f);
-    glm::mat4 localMatrix = glm::mat4(1.0f);
-    std::vector<GameObject*> children;
+//Everything the render thread needs from a simulation step. Handed over by a TripleBuffer : the vectors keep their capacity from one step to the next
+struct FrameState {
+    uint64_t step = 0;
+    bool ended = false; //The timeline is over : nothing more to draw
+    glm::dvec3 cameraPosition = glm::dvec3(0.0);
+    glm::mat4 view = glm::mat4(1.0f);
+    float lightRadius = 0.0f;                //Of the body containing the light, for the penumbrae
+    bool sky = false;                        //The sky node is drawn by the Skybox
+    glm::mat3 skyRotation = glm::mat3(1.0f); //Of the sky node
+    glm::vec3 skyColor = glm::vec3(1.0f);    //Ambient color of its material
+    std::vector<BodyState> bodies;           //The visible ones, in the order of the scene graph
+    uint32_t nbAsteroids = 0;                //Of the catalog, 0 when it is not drawn
+    std::vector<glm::mat4> asteroidModels;   //Camera-relative
+    std::vector<ParticleInstance> particles; //Billboards sorted back to front
+    std::vector<glm::vec4> occluders;        //Camera-relative spheres casting the shadows of the ray tracer
 };
-//Draw each Object, this function displays the planets taking into account the lightand its shadows
-void drawSphere(GameObject& go, Shader* shader, std::stack<glm::mat4>& matrices) {
 
+//Flag the nodes cut by the last evaluation of a timeline, and their descendants : they jumped to their new place instead of moving there
+void markCuts(const Timeline& timeline, const std::vector<GameObject>& objects, std::vector<bool>& cut) {
+    std::vector<const GameObject*> stack;
+    for (size_t i = 0; i < timeline.getCuts().size(); i++)
+        stack.push_back(&objects[timeline.getCuts()[i]]);
+    while (!stack.empty()) {
+        const GameObject* go = stack.back();
+        stack.pop_back();
+        cut[go - objects.data()] = true;
+        stack.insert(stack.end(), go->children.begin(), go->children.end());
+    }
+}
 
-    glm::mat4 camera(1.0f);
-    glm::vec3 cameraPosition(0.0f, 800.0f, 1000.0f);
-    camera = glm::translate(camera, cameraPosition);
+//Gather the visible objects of a branch of the scene graph. The visibility flags come from SceneCuller::cull, the camera-relative model matrices from WorldTransforms
+//The lit ones get the occluders of their eclipses (none when eclipses is NULL). With a sky map (the skybox or the sky of the ray tracer), the sky node is not a body : only its orientation is kept
+void collectBodies(const GameObject& go, const Eclipses* eclipses, bool skyMap, const glm::dvec3& cameraPosition, FrameState& state) {
 
-    glm::mat4 projection = glm::perspective(45.0f, WIDTH / (float)HEIGHT, 0.01f, 1000.0f);
-    glm::mat4 view = glm::inverse(camera); //See glm::lookAt also if you want to define the camera in other ways
-    glm::mat4 model(1.0f);
-    model = glm::translate(go.propagatedMatrix, glm::vec3(0.0f, 0.0f, 0.0f)); //Warning: We passed from left-handed world coordinate to right-handed world coordinate due to glm::perspective
+    //Nothing visible in this branch of the scene graph
+    if (!go.subtreeVisible)
+        return;
 
-    glm::mat3 invModel3x3 = glm::inverse(glm::mat3(model));
+    std::vector<BodyState>& bodies = state.bodies;
+    if (go.visible && go.sky && skyMap) {
+        state.sky = true;
+        for (int i = 0; i < 3; i++)
+            state.skyRotation[i] = glm::normalize(glm::vec3(go.modelMatrix[i])); //Without the scale
+        state.skyColor = go.sphereMtl.ka * go.sphereMtl.color;
+    }
+    else if (go.visible) {
+        glm::vec4 sphere(glm::vec3(go.worldCenter - cameraPosition), go.worldRadius);
+        bodies.push_back(BodyState{ go.modelMatrix, sphere, go.sphereMtl, go.texture, go.vaoID, go.geometry, go.translucent, 0 });
+        BodyState& body = bodies.back();
+        if (eclipses && !(cheapestFeatures(go.sphereMtl) & SHADER_UNLIT))
+            body.nbOccluders = eclipses->findOccluders(go, body.occluders); //Already camera-relative
+    }
 
-    matrices.push(matrices.top() * go.propagatedMatrix);      //Push matrices with propagated matrix
-    glm::mat4 mvp = matrices.top() * go.localMatrix;           //Set value of uMVP
+    for (size_t i = 0; i < go.children.size(); i++)
+        collectBodies(*(go.children[i]), eclipses, skyMap, cameraPosition, state);
+}
 
-    glUseProgram(shader->getProgramID());
-    {
-        glBindBuffer(GL_ARRAY_BUFFER, go.vboID);
-
-        //VBO:
-        //Position
-        GLint vPosition = glGetAttribLocation(shader->getProgramID(), "vPosition");
-        glVertexAttribPointer(vPosition, 3, GL_FLOAT, GL_FALSE, 0, 0);
-        //Colors start at 0
-        glEnableVertexAttribArray(vPosition);
-
-        GLint vNormal = glGetAttribLocation(shader->getProgramID(), "vNormal");
-        glVertexAttribPointer(vNormal, 3, GL_FLOAT, GL_FALSE, 0, INDICE_TO_PTR(go.geometry->getNbVertices() * 3 * sizeof(float)));
-        glEnableVertexAttribArray(vNormal);
-
-        //UV
-        GLint vUV = glGetAttribLocation(shader->getProgramID(), "vUV");
-        glVertexAttribPointer(vUV, 2, GL_FLOAT, GL_FALSE, 0, INDICE_TO_PTR(go.geometry->getNbVertices() * (3 + 3) * (sizeof(float))));
-        glEnableVertexAttribArray(vUV);
-
-        //Transformation
-        GLint uMVP = glGetUniformLocation(shader->getProgramID(), "uMVP");
-        GLint uModel = glGetUniformLocation(shader->getProgramID(), "uModel");
-        GLint uInvModel3x3 = glGetUniformLocation(shader->getProgramID(), "uInvModel3x3");
-        glUniformMatrix4fv(uMVP, 1, GL_FALSE, glm::value_ptr(mvp));
-        glUniformMatrix4fv(uModel, 1, GL_FALSE, glm::value_ptr(model));
-        glUniformMatrix3fv(uInvModel3x3, 1, GL_FALSE, glm::value_ptr(invModel3x3));
-
-        //Uniform for fragment shader
-        GLint uMtlColor = glGetUniformLocation(shader->getProgramID(), "uMtlColor");
-        GLint uMtlCts = glGetUniformLocation(shader->getProgramID(), "uMtlCts");
-        GLint uLightPos = glGetUniformLocation(shader->getProgramID(), "uLightPos");
-        GLint uLightColor = glGetUniformLocation(shader->getProgramID(), "uLightColor");
-        GLint uCameraPosition = glGetUniformLocation(shader->getProgramID(), "uCameraPosition");
-        glUniform3f(uMtlColor, 1, 1, 1);
-        glUniform4f(uMtlCts, go.sphereMtl.ka, go.sphereMtl.kd, go.sphereMtl.ks, go.sphereMtl.alpha);
-        glUniform3f(uLightPos, 0, 0, 0);
-        glUniform3f(uLightColor, 1, 1, 1);
-        glUniform3f(uCameraPosition, 0, 0, 0);
-
-        glActiveTexture(GL_TEXTURE0); //Active Texture0. This is not mandatory for only one
-        glBindTexture(GL_TEXTURE_2D, go.texture); //The binding is done on GL_Texture0
-        GLint uTexture = glGetUniformLocation(shader->getProgramID(), "uTexture");
-        glUniform1i(uTexture, 0);
-
-        //Draw the triangle with nbVertices
-        glDrawArrays(GL_TRIANGLES, 0, go.geometry->getNbVertices());
-
-        glBindTexture(GL_TEXTURE_2D, 0); //In fact you do not really need this if you pay
+//Queue the draw of a body, this function displays the planets taking into account the light and its shadows
+//The draws are issued later, sorted, by RenderQueue::submit
+//The translucent bodies are drawn in any order with the translucentFeatures (SHADER_WEIGHTED_BLENDED with the order-independent transparency)
+void queueBody(const BodyState& body, ShaderLibrary& shaders, uint32_t baseFeatures, uint32_t translucentFeatures, const FrameUniforms& frame, float zFar, RenderQueue& queue) {
+
+    //The camera is at the origin : the light, the camera and the world positions of the shaders are all relative to it
+    glm::mat4 model = body.model;
+    glm::mat3 invModel3x3 = glm::inverse(glm::mat3(model));
+    glm::mat4 mvp = frame.viewProjection * model; //Set value of uMVP
+
+    uint32_t features = cheapestFeatures(body.material) | baseFeatures;
+    if (body.nbOccluders > 0 && !(features & SHADER_UNLIT))
+        features |= SHADER_ECLIPSES;
+    if (body.translucent)
+        features |= translucentFeatures;
+    Shader* shader = shaders.get(features);
+    if (!shader)
+        return;
+
+    DrawPacket packet;
+    packet.shader = shader;
+    packet.vao = body.vao;
+    packet.texture = body.texture;
+    packet.first = 0;
+    packet.nbVertices = body.geometry->getNbVertices();
+    packet.material = body.material;
+    packet.object.mvp = mvp;
+    packet.object.model = model;
+    for (int i = 0; i < 3; i++)
+        packet.object.invModel3x3[i] = glm::vec4(invModel3x3[i], 0.0f);
+    packet.object.material[0] = packet.object.material[2] = packet.object.material[3] = 0;
+    packet.object.material[1] = (features & SHADER_ECLIPSES) ? body.nbOccluders : 0;
+    for (uint32_t i = 0; i < body.nbOccluders; i++)
+        packet.object.occluders[i] = body.occluders[i];
+
+    //Front to back for early-Z. An object around the camera (the sky) is the background of everything else
+    float distance = glm::length(glm::vec3(body.sphere));
+    RenderLayer layer = body.translucent ? LAYER_WEIGHTED : (distance < body.sphere.w ? LAYER_BACKGROUND : LAYER_OPAQUE);
+    packet.key = RenderQueue::makeKey(layer, shader->getProgramID(), body.texture, body.vao, distance / zFar);
+    queue.push(packet);
+}
+
+//Upload a geometry in a VBO (positions, then normals, then UVs) and describe it in a VAO. Every program binds its attributes at the same VertexAttribute locations
+void createMeshBuffers(const Geometry& geometry, GLuint& vbo, GLuint& vao) {
+    uint32_t nbVertices = geometry.getNbVertices();
+    glGenBuffers(1, &vbo);
+    glBindBuffer(GL_ARRAY_BUFFER, vbo);
+    glBufferData(GL_ARRAY_BUFFER, nbVertices * (3 + 3 + 2) * sizeof(float), nullptr, GL_STATIC_DRAW); //Never modified
+    glBufferSubData(GL_ARRAY_BUFFER, 0, nbVertices * 3 * sizeof(float), geometry.getVertices());
+    glBufferSubData(GL_ARRAY_BUFFER, nbVertices * 3 * sizeof(float), nbVertices * 3 * sizeof(float), geometry.getNormals());
+    glBufferSubData(GL_ARRAY_BUFFER, nbVertices * (3 + 3) * sizeof(float), nbVertices * 2 * sizeof(float), geometry.getUVs());
+
+    glGenVertexArrays(1, &vao);
+    glBindVertexArray(vao);
+    glVertexAttribPointer(ATTRIB_POSITION, 3, GL_FLOAT, GL_FALSE, 0, 0);
+    glEnableVertexAttribArray(ATTRIB_POSITION);
+    glVertexAttribPointer(ATTRIB_NORMAL, 3, GL_FLOAT, GL_FALSE, 0, INDICE_TO_PTR(nbVertices * 3 * sizeof(float)));
+    glEnableVertexAttribArray(ATTRIB_NORMAL);
+    glVertexAttribPointer(ATTRIB_UV, 2, GL_FLOAT, GL_FALSE, 0, INDICE_TO_PTR(nbVertices * (3 + 3) * sizeof(float)));
+    glEnableVertexAttribArray(ATTRIB_UV);
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
 
+//A vertex array for the impostors : no vertex attribute (the corners come from gl_VertexID), only a model matrix per instance
+GLuint createImpostorVAO() {
+    GLuint vao;
+    glGenVertexArrays(1, &vao);
+    glBindVertexArray(vao);
+    for (int c = 0; c < 4; c++) {
+        glEnableVertexAttribArray(ATTRIB_INSTANCE_MODEL + c);
+        glVertexAttribDivisorARB(ATTRIB_INSTANCE_MODEL + c, 1);
     }
-    glUseProgram(0);
+    glBindVertexArray(0);
+    return vao;
+}
+
+//Whether a body is drawn as an impostor : an opaque sphere, uniformly scaled, whose diameter on screen is below maxSize pixels
+//pixelScale turns a ratio radius / distance into pixels
+bool isImpostor(const BodyState& body, GLuint sphereVAO, float pixelScale, float maxSize) {
+    if (body.vao != sphereVAO || body.translucent)
+        return false;
+    float scale = glm::length(glm::vec3(body.model[0]));
+    if (fabsf(glm::length(glm::vec3(body.model[1])) - scale) > 1e-3f * scale || fabsf(glm::length(glm::vec3(body.model[2])) - scale) > 1e-3f * scale)
+        return false;
+    float radius = 0.5f * scale; //Of the sphere mesh
+    float distance = glm::length(glm::vec3(body.model[3]));
+    return distance > 2.0f * radius && 2.0f * radius / distance * pixelScale < maxSize;
+}
 
-    for (int i = 0; i < go.children.size(); i++)
-        drawSphere(*(go.children[i]), shader, matrices);
+//Point the instance attributes of a VAO at the data of the frame in the streaming buffer. The divisors and the enabled arrays are set once with the VAO
+//A catalog or impostor instance is its model matrix : a mat4 attribute uses four locations
+void pointModelInstances(GLuint vao, GLuint buffer, GLintptr offset) {
+    glBindVertexArray(vao);
+    glBindBuffer(GL_ARRAY_BUFFER, buffer);
+    for (int c = 0; c < 4; c++)
+        glVertexAttribPointer(ATTRIB_INSTANCE_MODEL + c, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), INDICE_TO_PTR(offset + c * sizeof(glm::vec4)));
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
 
-    //Remove the last matrix
-    matrices.pop();
+//A particle instance is a ParticleInstance
+void pointParticleInstances(GLuint vao, GLuint buffer, GLintptr offset) {
+    glBindVertexArray(vao);
+    glBindBuffer(GL_ARRAY_BUFFER, buffer);
+    glVertexAttribPointer(ATTRIB_INSTANCE_PARTICLE, 4, GL_FLOAT, GL_FALSE, sizeof(ParticleInstance), INDICE_TO_PTR(offset + offsetof(ParticleInstance, positionSize)));
+    glVertexAttribPointer(ATTRIB_INSTANCE_COLOR, 4, GL_FLOAT, GL_FALSE, sizeof(ParticleInstance), INDICE_TO_PTR(offset + offsetof(ParticleInstance, color)));
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+//Distance from the sun in the scene for a distance in AU. The scene is not to scale : interpolated between the orbits of the planets
+float auToScene(float au) {
+    static const float orbits[][2] = { {0.0f, 0.0f}, {0.387f, 0.55f}, {0.723f, 0.75f}, {1.0f, 0.85f}, {1.524f, 0.95f},
+                                       {5.203f, 1.30f}, {9.537f, 1.90f}, {19.19f, 2.5f}, {30.07f, 2.9f} };
+    const uint32_t nbOrbits = sizeof(orbits) / sizeof(orbits[0]);
+    uint32_t i = 1;
+    while (i < nbOrbits - 1 && au > orbits[i][0])
+        i++;
+    float t = (au - orbits[i - 1][0]) / (orbits[i][0] - orbits[i - 1][0]);
+    return orbits[i - 1][1] + t * (orbits[i][1] - orbits[i - 1][1]);
 }
 
 void createTexture(GLuint texture, SDL_Surface* img) {
@@ -172,337 +322,748 @@ void createTexture(GLuint texture, SDL_Surface* img) {
 
 int main(int argc, char* argv[])
 {
+    //Command line options
+    bool occlusionCulling = false;
+    bool eclipseShadows = true; //Analytic shadows of the bodies on each other
+    bool orderIndependent = true; //Weighted blended order-independent transparency of the translucent bodies (the rings)
+    bool useSkybox = true;        //The sky node as a cube map at infinity, drawn where nothing else is. A big sphere otherwise
+    float impostorSize = 24.0f;   //Diameter in pixels below which a sphere is ray cast on a quad instead of rasterized. 0 : never
+    bool headless = false;         //No window : render offscreen as fast as possible (batch jobs, servers without display)
+    bool raytrace = false;         //Ray trace the frames on the CPU instead of drawing them (offline renders). Headless, without any OpenGL context
+    uint32_t raySamples = 4;       //Samples per pixel of the ray tracer
+    int width = WIDTH;
+    int height = HEIGHT;
+    uint32_t maxFrames = 0;        //0 : until the end of the scene
+    const char* exportPath = NULL; //Write every frame to a PNG sequence (printf pattern), a .y4m file or a video encoded by ffmpeg
+    const char* profilePath = NULL; //Profile the frames, print a summary and write a Chrome trace at the end
+    const char* scenePath = "Scenes/solar_system.scene"; //Text or compiled scene
+    const char* saveScenePath = NULL; //Compile the scene to its binary form and quit
+    const char* timelinePath = "Scenes/asteroid.timeline";     //Script of the animation
+    const char* impactTimelinePath = "Scenes/impact.timeline"; //Played from the impact of the asteroid in the sun
+    const char* catalogPath = NULL;   //CSV of orbital elements : an asteroid for each row
+    uint64_t catalogMax = 0;          //0 : every row of the catalog
+    uint32_t maxParticles = 1 << 20;  //Capacity of the pool of the fire and the ejecta
+    int depthMode = -1;               //DepthMode. -1 : the best one supported
+    float simRate = FRAMERATE;        //Simulation steps per second of the window mode. 0 : as fast as possible
+    float renderRate = FRAMERATE;     //Frames per second of the window mode. 0 : uncapped
+    std::string shaderDirectory = SHADER_SOURCE_DIR; //Shaders loaded, watched and reloaded when they are saved
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--occlusion") == 0)
+            occlusionCulling = true;
+        else if (strcmp(argv[i], "--no-eclipses") == 0)
+            eclipseShadows = false;
+        else if (strcmp(argv[i], "--sorted-blending") == 0)
+            orderIndependent = false;
+        else if (strcmp(argv[i], "--no-skybox") == 0)
+            useSkybox = false;
+        else if (strcmp(argv[i], "--impostor-size") == 0 && i + 1 < argc)
+            impostorSize = std::max(0.0f, (float)atof(argv[++i]));
+        else if (strcmp(argv[i], "--headless") == 0)
+            headless = true;
+        else if (strcmp(argv[i], "--raytrace") == 0)
+            raytrace = headless = true;
+        else if (strcmp(argv[i], "--samples") == 0 && i + 1 < argc)
+            raySamples = std::max(1, atoi(argv[++i]));
+        else if (strcmp(argv[i], "--width") == 0 && i + 1 < argc)
+            width = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--height") == 0 && i + 1 < argc)
+            height = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc)
+            maxFrames = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--export") == 0 && i + 1 < argc)
+            exportPath = argv[++i];
+        else if (strcmp(argv[i], "--profile") == 0 && i + 1 < argc)
+            profilePath = argv[++i];
+        else if (strcmp(argv[i], "--scene") == 0 && i + 1 < argc)
+            scenePath = argv[++i];
+        else if (strcmp(argv[i], "--save-scene") == 0 && i + 1 < argc)
+            saveScenePath = argv[++i];
+        else if (strcmp(argv[i], "--timeline") == 0 && i + 1 < argc)
+            timelinePath = argv[++i];
+        else if (strcmp(argv[i], "--impact-timeline") == 0 && i + 1 < argc)
+            impactTimelinePath = argv[++i];
+        else if (strcmp(argv[i], "--catalog") == 0 && i + 1 < argc)
+            catalogPath = argv[++i];
+        else if (strcmp(argv[i], "--catalog-max") == 0 && i + 1 < argc)
+            catalogMax = strtoull(argv[++i], NULL, 10);
+        else if (strcmp(argv[i], "--particles") == 0 && i + 1 < argc)
+            maxParticles = strtoul(argv[++i], NULL, 10);
+        else if (strcmp(argv[i], "--sim-rate") == 0 && i + 1 < argc)
+            simRate = std::max(0.0f, (float)atof(argv[++i]));
+        else if (strcmp(argv[i], "--render-rate") == 0 && i + 1 < argc)
+            renderRate = std::max(0.0f, (float)atof(argv[++i]));
+        else if (strcmp(argv[i], "--shaders") == 0 && i + 1 < argc)
+            shaderDirectory = argv[++i];
+        else if (strcmp(argv[i], "--depth") == 0 && i + 1 < argc) {
+            const char* mode = argv[++i];
+            depthMode = strcmp(mode, "standard") == 0 ? DEPTH_STANDARD : strcmp(mode, "reversed") == 0 ? DEPTH_REVERSED : strcmp(mode, "log") == 0 ? DEPTH_LOGARITHMIC : -1;
+            if (depthMode < 0)
+                WARNING("Unknown depth mode %s (standard, reversed or log)\n", mode);
+        }
+        else
+            WARNING("Unknown option %s\n", argv[i]);
+    }
+    if (width <= 0 || height <= 0) {
+        ERROR("Invalid resolution %dx%d\n", width, height);
+        return EXIT_FAILURE;
+    }
+
+    //The sources of the repository are gone (moved build) : use the copy next to the executable
+    FILE* shaderProbe = fopen((shaderDirectory + "/colorTexture.vert").c_str(), "r");
+    if (shaderProbe)
+        fclose(shaderProbe);
+    else {
+        WARNING("No shaders in %s, using the ones of the working directory\n", shaderDirectory.c_str());
+        shaderDirectory = "Shaders";
+    }
+
+    //Bodies, orbits, materials and textures of the scene
+    Scene* scene = Scene::load(scenePath);
+    if (scene == NULL)
+        return EXIT_FAILURE;
+    if (saveScenePath) {
+        bool saved = scene->saveBinary(saveScenePath);
+        if (saved)
+            INFO("Scene %s compiled to %s (%u nodes)\n", scenePath, saveScenePath, scene->getNbNodes());
+        delete scene;
+        return saved ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    //Keyframes and events of the animation, on top of the orbits of the scene
+    Timeline* script = Timeline::load(timelinePath, *scene);
+    Timeline* impactScript = Timeline::load(impactTimelinePath, *scene);
+    if (script == NULL || impactScript == NULL)
+        return EXIT_FAILURE;
+
     ////////////////////////////////////////
     //SDL2 / OpenGL Context initialization :
     ////////////////////////////////////////
 
-    //Initialize SDL2
-    if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_JOYSTICK) < 0)
+    SDL_Window* window = NULL;
+    SDL_GLContext context = NULL;
+    HeadlessContext* headlessContext = NULL;
+    Framebuffer* offscreen = NULL;
+
+    if (headless)
     {
-        ERROR("The initialization of the SDL failed : %s\n", SDL_GetError());
-        return 0;
+        //SDL is only used for the timer and to load the images : no video subsystem
+        if (SDL_Init(SDL_INIT_TIMER) < 0)
+        {
+            ERROR("The initialization of the SDL failed : %s\n", SDL_GetError());
+            return 0;
+        }
+
+        //The ray tracer renders on the CPU : no context at all
+        if (!raytrace) {
+            //Context without any display (EGL surfaceless, runs on llvmpipe)
+            headlessContext = HeadlessContext::create(3, 0);
+            if (headlessContext == NULL)
+                return EXIT_FAILURE;
+
+            //glewInit would look for a GLX display : only load the functions of the current context
+            glewExperimental = GL_TRUE;
+            glewContextInit();
+        }
     }
+    else
+    {
+        //Initialize SDL2
+        if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_JOYSTICK) < 0)
+        {
+            ERROR("The initialization of the SDL failed : %s\n", SDL_GetError());
+            return 0;
+        }
 
-    //Create a Window
-    SDL_Window* window = SDL_CreateWindow("VR Camera",
-        SDL_WINDOWPOS_UNDEFINED,               //X Position
-        SDL_WINDOWPOS_UNDEFINED,               //Y Position
-        WIDTH, HEIGHT,                         //Resolution
-        SDL_WINDOW_OPENGL | SDL_WINDOW_SHOWN); //Flags (OpenGL + Show)
+        //Create a Window
+        window = SDL_CreateWindow("VR Camera",
+            SDL_WINDOWPOS_UNDEFINED,               //X Position
+            SDL_WINDOWPOS_UNDEFINED,               //Y Position
+            width, height,                         //Resolution
+            SDL_WINDOW_OPENGL | SDL_WINDOW_SHOWN); //Flags (OpenGL + Show)
 
-//Initialize OpenGL Version (version 3.0)
-    SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 3);
-    SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 0);
+    //Initialize OpenGL Version (version 3.0)
+        SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 3);
+        SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 0);
 
-    //Initialize the OpenGL Context (where OpenGL resources (Graphics card resources) lives)
-    SDL_GLContext context = SDL_GL_CreateContext(window);
+        //Initialize the OpenGL Context (where OpenGL resources (Graphics card resources) lives)
+        context = SDL_GL_CreateContext(window);
 
-    //Tells GLEW to initialize the OpenGL function with this version
-    glewExperimental = GL_TRUE;
-    glewInit();
+        //Tells GLEW to initialize the OpenGL function with this version
+        glewExperimental = GL_TRUE;
+        glewInit();
+    }
 
 
     //Start using OpenGL to draw something on screen
-    glViewport(0, 0, WIDTH, HEIGHT); //Draw on ALL the screen
-
-    //The OpenGL background color (RGBA, each component between 0.0f and 1.0f)
-    glClearColor(0.0, 0.0, 0.0, 1.0); //Full Black
-
-    glEnable(GL_DEPTH_TEST); //Active the depth test
-
-     //Load the file (png)
-    SDL_Surface* imgSun = IMG_Load("./Images/2k_sun.png");
-    SDL_Surface* imgEarth = IMG_Load("./Images/2k_earth_daymap.png");
-    SDL_Surface* imgMoon = IMG_Load("./Images/2k_moon.png");
-    SDL_Surface* imgMercury = IMG_Load("./Images/2k_mercury.png");
-    SDL_Surface* imgVenus = IMG_Load("./Images/2k_venus_surface.png");
-    SDL_Surface* imgMars = IMG_Load("./Images/2k_mars.png");
-    SDL_Surface* imgJupiter = IMG_Load("./Images/2k_jupiter.png");
-    SDL_Surface* imgSaturne = IMG_Load("./Images/2k_saturn.png");
-    //SDL_Surface* imgAnneauSaturne = IMG_Load("./Images/2k_saturn_ring_alpha.png");
-    SDL_Surface* imgAnneauSaturne = IMG_Load("./Images/2k_saturn_ring_alpha_3.png");
-    SDL_Surface* imgUranus = IMG_Load("./Images/2k_uranus.png");
-    SDL_Surface* imgNeptune = IMG_Load("./Images/2k_neptune.png");
-    SDL_Surface* imgEtoiles = IMG_Load("./Images/2k_stars_2.png");
-    SDL_Surface* imgAsteroide = IMG_Load("./Images/2k_moon.png");
-    SDL_Surface* imgFlammes = IMG_Load("./Images/2k_sun.png");
-
-
-
-    //cretaion of texture
-    GLuint textureSun;
-    glGenTextures(1, &textureSun);
-    GLuint textureEarth;
-    glGenTextures(1, &textureEarth);
-    GLuint textureMoon;
-    glGenTextures(1, &textureMoon);
-    GLuint textureMercury;
-    glGenTextures(1, &textureMercury);
-    GLuint textureVenus;
-    glGenTextures(1, &textureVenus);
-    GLuint textureMars;
-    glGenTextures(1, &textureMars);
-    GLuint textureJupiter;
-    glGenTextures(1, &textureJupiter);
-    GLuint textureSaturne;
-    glGenTextures(1, &textureSaturne);
-    GLuint textureAnneauSaturne;
-    glGenTextures(1, &textureAnneauSaturne);
-    GLuint textureUranus;
-    glGenTextures(1, &textureUranus);
-    GLuint textureNeptune;
-    glGenTextures(1, &textureNeptune);
-    GLuint textureEtoiles;
-    glGenTextures(1, &textureEtoiles);
-    GLuint textureAsteroide;
-    glGenTextures(1, &textureAsteroide);
-    GLuint textureFlammes;
-    glGenTextures(1, &textureFlammes);
-
-
-    createTexture(textureSun, imgSun);
-    createTexture(textureEarth, imgEarth);
-    createTexture(textureMoon, imgMoon);
-    createTexture(textureMercury, imgMercury);
-    createTexture(textureVenus, imgVenus);
-    createTexture(textureMars, imgMars);
-    createTexture(textureJupiter, imgJupiter);
-    createTexture(textureSaturne, imgSaturne);
-    createTexture(textureAnneauSaturne, imgAnneauSaturne);
-    createTexture(textureUranus, imgUranus);
-    createTexture(textureNeptune, imgNeptune);
-    createTexture(textureEtoiles, imgEtoiles);
-    createTexture(textureAsteroide, imgAsteroide);
-    createTexture(textureFlammes, imgFlammes);
-
-
-
-    //Initialisation of object
-    Material sphereMtl{ {1.0f, 1.0f, 1.0f}, 0.4f, 0.9f, 0.8f, 100 };
-    Material sphereMtlSun{ {1.0f, 1.0f, 1.0f}, 1.0, 0.5, 0.5f, 10 };
-
-    Light light{ {0.0f, 0.0f, 0.0f}, {2.0f, 2.0f, 2.0f} };
-
-    Sphere sphere(32, 32);
-
-    //Generate and bind the VBO
-    GLuint vboSphereID;
-    glGenBuffers(1, &vboSphereID);
-    glBindBuffer(GL_ARRAY_BUFFER, vboSphereID);
-    //Set datas
-    glBufferData(GL_ARRAY_BUFFER, sphere.getNbVertices() * (3 + 3 + 2) * sizeof(float), nullptr, GL_DYNAMIC_DRAW);   //3 coordinates per normal, 3 per position and 2 per UVs.
-    glBufferSubData(GL_ARRAY_BUFFER, 0, sphere.getNbVertices() * 3 * sizeof(float), sphere.getVertices());
-    glBufferSubData(GL_ARRAY_BUFFER, sphere.getNbVertices() * 3 * sizeof(float), sphere.getNbVertices() * 3 * sizeof(float), sphere.getNormals());
-    glBufferSubData(GL_ARRAY_BUFFER, sphere.getNbVertices() * (3 + 3) * sizeof(float), sphere.getNbVertices() * 2 * sizeof(float), sphere.getUVs());
-    glBindBuffer(GL_ARRAY_BUFFER, 0); //Close buffer
-
-   //Create sun object of each planet, in order to have several operating speeds (invisible)
-    GameObject sunGO;
-    sunGO.vboID = vboSphereID;
-    sunGO.geometry = &sphere;
-    sunGO.texture = textureSun;
-
-    GameObject sunGOEarth;
-    sunGOEarth.vboID = vboSphereID;
-    sunGOEarth.geometry = &sphere;
-    sunGOEarth.texture = textureSun;
-
-    GameObject sunGOMercury;
-    sunGOMercury.vboID = vboSphereID;
-    sunGOMercury.geometry = &sphere;
-
-    GameObject sunGOVenus;
-    sunGOVenus.vboID = vboSphereID;
-    sunGOVenus.geometry = &sphere;
-
-    GameObject sunGOMars;
-    sunGOMars.vboID = vboSphereID;
-    sunGOMars.geometry = &sphere;
-
-    GameObject sunGOJupiter;
-    sunGOJupiter.vboID = vboSphereID;
-    sunGOJupiter.geometry = &sphere;
-
-    GameObject sunGOSaturne;
-    sunGOSaturne.vboID = vboSphereID;
-    sunGOSaturne.geometry = &sphere;
-
-    GameObject sunGOUranus;
-    sunGOUranus.vboID = vboSphereID;
-    sunGOUranus.geometry = &sphere;
-
-    GameObject sunGONeptune;
-    sunGONeptune.vboID = vboSphereID;
-    sunGONeptune.geometry = &sphere;
-
-
-    //Cretation of planet object
-    GameObject earthGO;
-    earthGO.vboID = vboSphereID;
-    earthGO.geometry = &sphere;
-    earthGO.texture = textureEarth;
-
-    GameObject MoonGO;
-    MoonGO.vboID = vboSphereID;
-    MoonGO.geometry = &sphere;
-    MoonGO.texture = textureMoon;
-
-    GameObject Mercury;
-    Mercury.vboID = vboSphereID;
-    Mercury.geometry = &sphere;
-    Mercury.texture = textureMercury;
-
-    GameObject Venus;
-    Venus.vboID = vboSphereID;
-    Venus.geometry = &sphere;
-    Venus.texture = textureVenus;
-
-    GameObject Mars;
-    Mars.vboID = vboSphereID;
-    Mars.geometry = &sphere;
-    Mars.texture = textureMars;
-
-    GameObject Jupiter;
-    Jupiter.vboID = vboSphereID;
-    Jupiter.geometry = &sphere;
-    Jupiter.texture = textureJupiter;
-
-    GameObject Saturne;
-    Saturne.vboID = vboSphereID;
-    Saturne.geometry = &sphere;
-    Saturne.texture = textureSaturne;
-
-    GameObject anneauSaturne;
-    anneauSaturne.vboID = vboSphereID;
-    anneauSaturne.geometry = &sphere;
-    anneauSaturne.texture = textureAnneauSaturne;
-
-    GameObject Uranus;
-    Uranus.vboID = vboSphereID;
-    Uranus.geometry = &sphere;
-    Uranus.texture = textureUranus;
-
-    GameObject Neptune;
-    Neptune.vboID = vboSphereID;
-    Neptune.geometry = &sphere;
-    Neptune.texture = textureNeptune;
-
-    //background object
-    GameObject Etoiles;
-    Etoiles.vboID = vboSphereID;
-    Etoiles.geometry = &sphere;
-    Etoiles.texture = textureEtoiles;
-
-    //about asteroide object
-    GameObject sunGOAsteroide;
-    sunGOAsteroide.vboID = vboSphereID;
-    sunGOAsteroide.geometry = &sphere;
-
-    GameObject Asteroide;
-    Asteroide.vboID = vboSphereID;
-    Asteroide.geometry = &sphere;
-    Asteroide.texture = textureAsteroide;
-
-    GameObject Flammes;
-    Flammes.vboID = vboSphereID;
-    Flammes.geometry = &sphere;
-    Flammes.texture = textureFlammes;
-
-    //initialisation of material parameter
-    sunGO.sphereMtl = sphereMtlSun;
-    earthGO.sphereMtl = sphereMtl;
-    MoonGO.sphereMtl = sphereMtl;
-    Mercury.sphereMtl = sphereMtl;
-    Venus.sphereMtl = sphereMtl;
-    Mars.sphereMtl = sphereMtl;
-    Jupiter.sphereMtl = sphereMtl;
-    Saturne.sphereMtl = sphereMtl;
-    Uranus.sphereMtl = sphereMtl;
-    Neptune.sphereMtl = sphereMtl;
-    sunGOEarth.sphereMtl = sphereMtl;
-    Etoiles.sphereMtl = sphereMtlSun;
-    Asteroide.sphereMtl = sphereMtl;
-    Flammes.sphereMtl = sphereMtl;
-
-
-    //initialisation of light parameter
-    sunGO.light = light;
-    earthGO.light = light;
-    MoonGO.light = light;
-    Mercury.light = light;
-    Venus.light = light;
-    Mars.light = light;
-    Jupiter.light = light;
-    Saturne.light = light;
-    Uranus.light = light;
-    Neptune.light = light;
-    sunGOEarth.light = light;
-    Etoiles.light = light;
-    anneauSaturne.light = light;
-    Asteroide.light = light;
-    Flammes.light = light;
-
-
-
-    //Hierarchy of 3D objects (scene graph)
-    sunGOEarth.children.push_back(&earthGO);
-    earthGO.children.push_back(&MoonGO);
-
-    sunGOMercury.children.push_back(&Mercury);
-    sunGOVenus.children.push_back(&Venus);
-    sunGOMars.children.push_back(&Mars);
-    sunGOJupiter.children.push_back(&Jupiter);
-    sunGOSaturne.children.push_back(&Saturne);
-    sunGOSaturne.children.push_back(&anneauSaturne);
-    sunGOUranus.children.push_back(&Uranus);
-    sunGONeptune.children.push_back(&Neptune);
-    sunGOAsteroide.children.push_back(&Asteroide);
-    sunGOAsteroide.children.push_back(&Flammes);
+    if (!raytrace) {
+        if (headless || exportPath || orderIndependent) {
+            //There is no default framebuffer, the frames are read back or the transparency shares the depth buffer : draw into an offscreen one of the requested resolution
+            offscreen = new Framebuffer(width, height, true);
+            if (!offscreen->isComplete())
+                return EXIT_FAILURE;
+            offscreen->bind(); //Also sets the viewport
+        }
+        else
+            glViewport(0, 0, width, height); //Draw on ALL the screen
+
+        //The OpenGL background color (RGBA, each component between 0.0f and 1.0f)
+        glClearColor(0.0, 0.0, 0.0, 1.0); //Full Black
+
+        glEnable(GL_DEPTH_TEST); //Active the depth test
+    }
+
+    //Depth precision from the planets next to the camera to the far ones : reversed-Z with the float depth buffer of the offscreen target, logarithmic otherwise
+    const float zFar = 1000.0f;
+    if (!raytrace && depthMode >= 0 && !DepthRange::isSupported((DepthMode)depthMode)) {
+        WARNING("GL_ARB_clip_control is not supported, the depth is not reversed\n");
+        depthMode = -1;
+    }
+    DepthRange depthRange(depthMode >= 0 ? (DepthMode)depthMode : DepthRange::getBestMode(offscreen && offscreen->hasFloatDepth()), zFar);
+    if (!raytrace) {
+        depthRange.apply();
+        const char* depthModeNames[] = {"standard", "reversed", "logarithmic"};
+        INFO("Depth : %s\n", depthModeNames[depthRange.getMode()]);
+    }
+
+    //The texture of the sky node becomes the cube map of the skybox (the sky of the ray tracer), drawn behind everything at infinity
+    uint32_t skyTexture = SCENE_NONE;
+    for (uint32_t i = 0; i < scene->getNbNodes(); i++)
+        if (useSkybox && (scene->getNodes()[i].flags & SCENE_NODE_SKY))
+            skyTexture = scene->getNodes()[i].texture;
+    Skybox* skybox = NULL;
+    bool skyMap = false; //The sky node is not drawn as a sphere
+
+    //The ray tracer samples its own copies of the images
+    RayTracer* rayTracer = raytrace ? new RayTracer(raySamples) : NULL;
+
+    //Load the texture of each scene texture. Without OpenGL, the handles only identify the images of the ray tracer
+    std::vector<GLuint> textures(scene->getNbTextures(), 0);
+    if (raytrace) {
+        for (uint32_t i = 0; i < textures.size(); i++)
+            textures[i] = i + 1;
+    }
+    else if (!textures.empty())
+        glGenTextures(textures.size(), &textures[0]);
+    for (uint32_t i = 0; i < scene->getNbTextures(); i++) {
+        const char* imagePath = scene->getString(scene->getTextures()[i].path);
+        SDL_Surface* img = IMG_Load(imagePath);
+        if (img == NULL) {
+            WARNING("Could not load the texture %s : %s\n", imagePath, IMG_GetError());
+            continue;
+        }
+        if (i == skyTexture) {
+            //A face of the cube map covers a quarter of the longitudes : twice the resolution of the image, the stars of a single pixel survive the resampling
+            SDL_Surface* rgbImg = SDL_ConvertSurfaceFormat(img, SDL_PIXELFORMAT_RGBA32, 0);
+            if (rgbImg && rgbImg->pitch == rgbImg->w * 4) {
+                if (rayTracer) {
+                    rayTracer->setSky((const uint8_t*)rgbImg->pixels, rgbImg->w, rgbImg->h);
+                    skyMap = true;
+                }
+                else {
+                    skybox = Skybox::create((const uint8_t*)rgbImg->pixels, rgbImg->w, rgbImg->h, std::max(1, rgbImg->w / 2), depthRange.getFarDepth(),
+                                            (shaderDirectory + "/skybox.vert").c_str(), (shaderDirectory + "/skybox.frag").c_str());
+                    skyMap = skybox != NULL;
+                }
+            }
+            SDL_FreeSurface(rgbImg);
+            if (skyMap) {
+                SDL_FreeSurface(img);
+                continue;
+            }
+            WARNING("The skybox could not be created from %s, the sky is a sphere\n", imagePath);
+        }
+        if (rayTracer) {
+            SDL_Surface* rgbImg = SDL_ConvertSurfaceFormat(img, SDL_PIXELFORMAT_RGBA32, 0);
+            if (rgbImg && rgbImg->pitch == rgbImg->w * 4)
+                rayTracer->addTexture(textures[i], (const uint8_t*)rgbImg->pixels, rgbImg->w, rgbImg->h);
+            SDL_FreeSurface(rgbImg);
+            SDL_FreeSurface(img);
+        }
+        else
+            createTexture(textures[i], img);
+    }
+
+    StaticSphere<32, 32> sphere; //Generated at compile time
+    Annulus ring(128, RING_INNER_RADIUS); //A flat disc : a fraction of the vertices of the sphere
+
+    //One VBO (3 coordinates per position, 3 per normal and 2 per UVs) and one VAO per mesh
+    GLuint vboSphereID = 0, vaoSphereID = 0, vboRingID = 0, vaoRingID = 0;
+    if (!raytrace) {
+        createMeshBuffers(sphere, vboSphereID, vaoSphereID);
+        createMeshBuffers(ring, vboRingID, vaoRingID);
+    }
+
+    //Create the objects of the scene graph (indexed by SceneMesh)
+    Geometry* meshGeometries[SCENE_NB_MESHES] = { &sphere, &ring };
+    GLuint meshVBOs[SCENE_NB_MESHES] = { vboSphereID, vboRingID };
+    GLuint meshVAOs[SCENE_NB_MESHES] = { vaoSphereID, vaoRingID };
+    std::vector<GameObject> objects;
+    scene->instantiate(objects, textures, meshGeometries, meshVBOs, meshVAOs);
+
+    const SceneLight& sceneLight = scene->getLight();
+    Light light{ {sceneLight.position[0], sceneLight.position[1], sceneLight.position[2]}, {sceneLight.color[0], sceneLight.color[1], sceneLight.color[2]} };
+
+    //Roots of the scene graph, in the order of the scene
+    std::vector<GameObject*> sceneRoots;
+    for (uint32_t i = 0; i < scene->getNbNodes(); i++)
+        if (scene->getNodes()[i].parent == SCENE_NONE)
+            sceneRoots.push_back(&objects[i]);
+
+    //Objects moved by the script of the animation. NULL if the scene does not have them
+    auto findObject = [&](const char* name) -> GameObject* {
+        uint32_t index = scene->findNode(name);
+        return index == SCENE_NONE ? NULL : &objects[index];
+    };
+    GameObject* sunGO = findObject("Sun");
+    GameObject* Etoiles = findObject("Stars");
+    GameObject* Asteroide = findObject("Asteroid");
+
+    //Instance attributes of each frame (catalog models, particle billboards), written straight into a persistently mapped buffer. Grows with the frames
+    StreamingBuffer* instanceStream = raytrace ? NULL : new StreamingBuffer(1 << 20);
+
+    //Population of small bodies, all drawn by a single instanced draw call
+    OrbitalCatalog* catalog = NULL;
+    StaticSphere<6, 6> asteroidSphere;
+    GLuint vboAsteroidID = 0, vaoAsteroidID = 0;
+    std::vector<float> asteroidX, asteroidY, asteroidZ, asteroidScale;
+    std::vector<glm::vec3> asteroidPositions; //In the scene
+    if (catalogPath && !raytrace && !(GLEW_ARB_instanced_arrays && GLEW_ARB_draw_instanced))
+        WARNING("GL_ARB_instanced_arrays is not supported, the catalog %s is not drawn\n", catalogPath);
+    else if (catalogPath) {
+        catalog = OrbitalCatalog::load(catalogPath, catalogMax);
+        if (catalog == NULL)
+            return EXIT_FAILURE;
+
+        uint32_t nbAsteroids = catalog->getNbBodies();
+        asteroidX.resize(nbAsteroids);
+        asteroidY.resize(nbAsteroids);
+        asteroidZ.resize(nbAsteroids);
+        asteroidPositions.resize(nbAsteroids);
+        //The diameter of a body goes with 10^(-H/5)
+        asteroidScale.resize(nbAsteroids);
+        for (uint32_t i = 0; i < nbAsteroids; i++) {
+            float h = catalog->getAbsoluteMagnitude()[i];
+            asteroidScale[i] = std::isfinite(h) ? glm::clamp(0.02f * powf(10.0f, (10.0f - h) / 5.0f), 0.004f, 0.03f) : 0.008f;
+        }
+
+        if (!raytrace) {
+            createMeshBuffers(asteroidSphere, vboAsteroidID, vaoAsteroidID);
+            glBindVertexArray(vaoAsteroidID);
+            //One model matrix per instance, in the streaming buffer
+            for (int c = 0; c < 4; c++) {
+                glEnableVertexAttribArray(ATTRIB_INSTANCE_MODEL + c);
+                glVertexAttribDivisorARB(ATTRIB_INSTANCE_MODEL + c, 1);
+            }
+            glBindVertexArray(0);
+            pointModelInstances(vaoAsteroidID, instanceStream->getBuffer(), 0);
+        }
+    }
 
+    //The catalog asteroids look like the one of the animation
+    Material asteroidMtl = Asteroide ? Asteroide->sphereMtl : Material{ {1.0f, 1.0f, 1.0f}, 0.4f, 0.9f, 0.8f, 100, 0 };
+    GLuint asteroidTexture = Asteroide ? Asteroide->texture : 0;
+
+    //Threads of the parallel passes of the simulation, started once
+    WorkerPool workers;
+
+    //Fire trail of the asteroid, ejecta of its impact and debris of the catalog collisions
+    ParticleSystem particles(maxParticles, workers);
+    particles.setDamping(0.99f);
+    ParticleEmitter fire;
+    fire.node = Asteroide;
+    fire.speed = 0.003f;
+    fire.lifetime = 40.0f;
+    fire.startSize = 0.05f;
+    fire.endSize = 0.15f;
+    fire.startColor = glm::vec4(1.0f, 0.9f, 0.4f, 0.9f);
+    fire.endColor = glm::vec4(0.8f, 0.1f, 0.0f, 0.0f);
+    uint32_t fireEmitter = particles.addEmitter(fire);
+    ParticleEmitter ejecta;
+    ejecta.speed = 0.02f;
+    ejecta.spread = 0.8f;
+    ejecta.lifetime = 150.0f;
+    ejecta.startSize = 0.03f;
+    ejecta.endSize = 0.06f;
+    ejecta.startColor = glm::vec4(1.0f, 0.7f, 0.2f, 1.0f);
+    ejecta.endColor = glm::vec4(0.3f, 0.3f, 0.3f, 0.0f);
+    uint32_t ejectaEmitter = particles.addEmitter(ejecta);
+    ParticleEmitter debris = ejecta;
+    debris.speed = 0.002f;
+    debris.lifetime = 60.0f;
+    debris.startSize = 0.01f;
+    debris.endSize = 0.02f;
+    debris.startColor = glm::vec4(0.8f, 0.7f, 0.6f, 1.0f);
+    uint32_t debrisEmitter = particles.addEmitter(debris);
+
+    //A quad per particle, drawn by a single instanced draw call
+    GLuint vboParticleID = 0, vaoParticleID = 0;
+    if (!raytrace && GLEW_ARB_instanced_arrays && GLEW_ARB_draw_instanced) {
+        const float quad[] = {-0.5f, -0.5f, 0.0f,  0.5f, -0.5f, 0.0f,  0.5f, 0.5f, 0.0f,
+                              -0.5f, -0.5f, 0.0f,  0.5f,  0.5f, 0.0f, -0.5f, 0.5f, 0.0f};
+        glGenBuffers(1, &vboParticleID);
+        glBindBuffer(GL_ARRAY_BUFFER, vboParticleID);
+        glBufferData(GL_ARRAY_BUFFER, sizeof(quad), quad, GL_STATIC_DRAW);
+
+        glGenVertexArrays(1, &vaoParticleID);
+        glBindVertexArray(vaoParticleID);
+        glVertexAttribPointer(ATTRIB_POSITION, 3, GL_FLOAT, GL_FALSE, 0, 0);
+        glEnableVertexAttribArray(ATTRIB_POSITION);
+        //Position, size and color per instance, in the streaming buffer
+        glEnableVertexAttribArray(ATTRIB_INSTANCE_PARTICLE);
+        glVertexAttribDivisorARB(ATTRIB_INSTANCE_PARTICLE, 1);
+        glEnableVertexAttribArray(ATTRIB_INSTANCE_COLOR);
+        glVertexAttribDivisorARB(ATTRIB_INSTANCE_COLOR, 1);
+        glBindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        pointParticleInstances(vaoParticleID, instanceStream->getBuffer(), 0);
+    }
+    else if (!raytrace)
+        WARNING("GL_ARB_instanced_arrays is not supported, the particles are not drawn\n");
+
+    //The small spheres are ray cast on camera-facing quads, batched by texture and material : a vertex array per batch of the frame, created when needed
+    bool impostors = !raytrace && impostorSize > 0.0f && GLEW_ARB_instanced_arrays && GLEW_ARB_draw_instanced;
+    if (!raytrace && impostorSize > 0.0f && !impostors)
+        WARNING("GL_ARB_instanced_arrays is not supported, the small bodies are not drawn as impostors\n");
+    std::vector<ImpostorBatch> impostorBatches;
+    std::vector<GLuint> impostorVAOs;
+    GLuint vaoAsteroidImpostorID = catalog && impostors ? createImpostorVAO() : 0; //The asteroids of the catalog are a few pixels at most : always impostors
+    uint32_t lastNbImpostors = 0, lastNbImpostorBatches = 0;
 
     //Set variables for time (and operating speed)
-    float tSun = 0;
-    float tEarth = 0;
-    float tMercury = 0;
-    float tVenus = 0;
-    float tMars = 0;
-    float tJupiter = 0;
-    float tSaturne = 0;
-    float tUranus = 0;
-    float tNeptune = 0;
-    float tAsteroide = 0;
-    float tEtoile = 0;
+    uint64_t step = 0;
+    bool impacted = false;
+    uint64_t impactStep = 0;
+    bool burning = false; //The fire of the asteroid
+    DrawPhase drawPhase = DRAW_ALL;
+    bool ended = false;
+
+    //Continuous collisions between the solid bodies of the scene and the asteroids of the catalog
+    CollisionWorld collisions(workers);
+    std::vector<GameObject*> collisionObjects;
+    for (size_t i = 0; i < objects.size(); i++)
+        if (objects[i].occluder)
+            collisionObjects.push_back(&objects[i]);
+    collisions.resize(collisionObjects.size() + asteroidX.size());
+    std::vector<glm::vec3> collisionPositions(collisions.getNbBodies()); //Centers at the end of the previous step
+    std::vector<bool> cutObjects(objects.size(), false);                 //Moved by a cut of the timelines this step
+    bool collisionStarted = false;
+    uint32_t lastNbCollisions = 0;
 
 
     //path of vertex and frangemnt shaders
-    const char* vertexPath = "Shaders/colorTexture.vert";
-    const char* fragPath = "Shaders/colorTexture.frag";
+    std::string vertexPath = shaderDirectory + "/colorTexture.vert";
+    std::string fragPath = shaderDirectory + "/colorTexture.frag";
+
+    //Frames read back asynchronously and encoded by worker threads
+    FrameExporter* exporter = NULL;
+    if (exportPath) {
+        exporter = FrameExporter::create(FrameExporter::formatFromPath(exportPath), exportPath, width, height, FRAMERATE, !raytrace);
+        if (exporter == NULL)
+            return EXIT_FAILURE;
+    }
 
-    //File shaders
-    FILE* vertexFile = fopen(vertexPath, "r"); //"r" to read
-    FILE* fragFile = fopen(fragPath, "r");
+    //Load the files and Create shader. The variants are specialized from these sources on demand
+    ShaderLibrary* shaders = raytrace ? NULL : ShaderLibrary::loadFromPaths(vertexPath, fragPath);
 
-    //Load the files and Create shader
-    Shader* shader = Shader::loadFromFiles(vertexFile, fragFile);
-    fclose(vertexFile);
-    fclose(fragFile);
+    //Per-frame, per-material and per-object data in shared uniform blocks when the context supports them
+    UniformBuffers* uniformBuffers = NULL;
+    if (!raytrace && UniformBuffers::isSupported())
+        uniformBuffers = new UniformBuffers(256);
+    else if (!raytrace)
+        WARNING("GL_ARB_uniform_buffer_object is not supported, falling back to classic uniforms\n");
 
-    if (!shader) {
+    if (!raytrace && (!shaders || !shaders->get(uniformBuffers ? SHADER_UNIFORM_BUFFERS : 0))) {
         std::cerr << "The shader is broken... from loading vertxFile and fragFile" << std::endl;
         return EXIT_FAILURE;
     }
 
-    bool isOpened = true;
+    //The translucent bodies are accumulated in any order into floating point targets, then composited. Sorted and blended otherwise
+    WeightedBlending* weightedBlending = NULL;
+    if (orderIndependent && !raytrace) {
+        weightedBlending = WeightedBlending::create(*offscreen, (shaderDirectory + "/weightedComposite.vert").c_str(),
+                                                   (shaderDirectory + "/weightedComposite.frag").c_str());
+        if (!weightedBlending)
+            WARNING("The order-independent transparency is not available, falling back to sorted blending\n");
+    }
+
+    //Recompile the shaders when their sources are saved, without restarting the simulation
+    ShaderWatcher* shaderWatcher = shaders ? new ShaderWatcher(shaderDirectory) : NULL;
+    std::vector<std::string> changedShaders;
+
+    //Visibility of the scene graph, computed each frame before drawing
+    SceneCuller culler(height);
+    culler.setOcclusionEnabled(occlusionCulling);
+    CullingStats lastCullingStats;
+    std::vector<GameObject*> roots;
+    WorldTransforms transforms;
+
+    //Occluders of the lit bodies, for the shadows computed by the fragment shader
+    Eclipses eclipses;
+
+    //Draws of a frame, sorted to minimize the state changes
+    RenderQueue renderQueue;
+    RenderStats lastRenderStats;
+    uint32_t baseFeatures = (uniformBuffers ? SHADER_UNIFORM_BUFFERS : 0) | (depthRange.getMode() == DEPTH_LOGARITHMIC ? SHADER_LOG_DEPTH : 0);
+    uint32_t translucentFeatures = weightedBlending ? SHADER_WEIGHTED_BLENDED : 0;
+
+    //CPU scopes and GPU passes timings, one profiler per thread. The scopes do nothing when profiler is NULL
+    Profiler* profiler = profilePath ? new Profiler("render", !raytrace) : NULL;
+    Profiler* simProfiler = profilePath ? new Profiler("simulation", false) : NULL;
+
+    //The camera does not move : culling and drawing use the same projection
+    glm::mat4 projection = glm::perspective(45.0f, width / (float)height, 0.1f, zFar); //Culling
+    glm::mat4 depthProjection = depthRange.getProjection(projection);                //Drawing
+
+    //One simulation step : everything but OpenGL, written into the state handed to the render thread
+    auto simulateStep = [&](FrameState& state) {
+        //Camera-relative rendering : the view only rotates, the objects are moved by -cameraPosition in double precision (WorldTransforms)
+        glm::dvec3 cameraPosition(0.0, 2.0, 4.0);
+        state.cameraPosition = cameraPosition;
+        state.view = glm::lookAt(glm::vec3(0.0f), glm::vec3(-cameraPosition), glm::vec3(0.0, 1.0, 0.0));
+        state.step = step;
+
+        if (simProfiler)
+            simProfiler->beginScope("update");
+
+        //Orbits and spins of the scene, then the script of the animation on top of them
+        scene->animate(objects, step);
+        script->evaluate((double)step, objects);
+        std::fill(cutObjects.begin(), cutObjects.end(), false);
+        markCuts(*script, objects, cutObjects);
+        if (impacted) {
+            impactScript->evaluate((double)(step - impactStep), objects);
+            markCuts(*impactScript, objects, cutObjects);
+        }
+        TimelineEvent scriptEvent;
+        while (script->pollEvent(scriptEvent) || impactScript->pollEvent(scriptEvent)) {
+            if (strcmp(scriptEvent.name, "fire_on") == 0)
+                burning = true;
+            else if (strcmp(scriptEvent.name, "fire_off") == 0)
+                burning = false;
+            else if (strcmp(scriptEvent.name, "draw_sun") == 0)
+                drawPhase = DRAW_SUN;
+            else if (strcmp(scriptEvent.name, "draw_stars") == 0)
+                drawPhase = DRAW_STARS;
+            else if (strcmp(scriptEvent.name, "draw_nothing") == 0)
+                drawPhase = DRAW_NOTHING;
+            else if (strcmp(scriptEvent.name, "end") == 0)
+                ended = true;
+            else
+                WARNING("Unknown event %s of the timeline at step %u\n", scriptEvent.name, (uint32_t)scriptEvent.time);
+        }
+
+        //The asteroids of the catalog on their Keplerian orbits
+        if (catalog) {
+            ProfileScope catalogScope(simProfiler, "catalog");
+            uint32_t nbAsteroids = catalog->getNbBodies();
+            state.asteroidModels.resize(nbAsteroids);
+            catalog->computePositions(step * DAYS_PER_STEP, asteroidX.data(), asteroidY.data(), asteroidZ.data(), 0, nbAsteroids, workers);
+            for (uint32_t i = 0; i < nbAsteroids; i++) {
+                //Ecliptic (z to the north) to the scene (y up), at the distance of the scene
+                glm::vec3 position(asteroidX[i], asteroidZ[i], -asteroidY[i]);
+                float distance = glm::length(position);
+                if (distance > 0.0f)
+                    position *= auToScene(distance) / distance;
+                asteroidPositions[i] = position;
+                glm::mat4& model = state.asteroidModels[i];
+                model = glm::mat4(asteroidScale[i]);
+                model[3] = glm::vec4(glm::vec3(glm::dvec3(position) - cameraPosition), 1.0f);
+            }
+        }
+
+        //Change time at each loop
+        step++;
+
+        if (simProfiler)
+            simProfiler->endScope();
 
-    //Main application loop
-    while (isOpened) //affichage
+
+        //Planets to draw, with light
+        roots.clear();
+        bool drawCatalog = false;
+        state.ended = ended;
+        if (ended)
+            return;
+        if (drawPhase == DRAW_ALL) {
+            roots = sceneRoots;
+            drawCatalog = catalog != NULL;
+        }
+        else {
+            if (Etoiles && drawPhase != DRAW_NOTHING)
+                roots.push_back(Etoiles);
+            if (sunGO && drawPhase == DRAW_SUN)
+                roots.push_back(sunGO);
+        }
+        state.nbAsteroids = drawCatalog ? catalog->getNbBodies() : 0;
+
+        {
+            ProfileScope scope(simProfiler, "cull");
+            transforms.update(roots);
+            transforms.rebase(cameraPosition);
+            culler.cull(roots, state.view, projection, cameraPosition);
+        }
+        {
+            ProfileScope scope(simProfiler, "eclipses");
+            if (eclipseShadows)
+                eclipses.update(light.position, collisionObjects, cameraPosition);
+            state.lightRadius = eclipses.getLightRadius();
+            state.bodies.clear();
+            state.sky = false;
+            for (size_t i = 0; i < roots.size(); i++)
+                collectBodies(*roots[i], eclipseShadows ? &eclipses : NULL, skyMap, cameraPosition, state);
+
+            //The ray tracer finds the occluders of each point itself
+            state.occluders.clear();
+            for (size_t i = 0; rayTracer && eclipseShadows && i < collisionObjects.size(); i++)
+                state.occluders.push_back(glm::vec4(glm::vec3(collisionObjects[i]->worldCenter - cameraPosition), collisionObjects[i]->worldRadius));
+        }
+        const CullingStats& cullingStats = culler.getStats();
+        if (cullingStats.frustumCulled != lastCullingStats.frustumCulled || cullingStats.smallCulled != lastCullingStats.smallCulled ||
+            cullingStats.occlusionCulled != lastCullingStats.occlusionCulled || cullingStats.nbObjects != lastCullingStats.nbObjects) {
+            INFO("Culling: %u/%u visible (%u outside of the frustum, %u too small, %u occluded by %u)\n", cullingStats.getNbVisible(), cullingStats.nbObjects,
+                 cullingStats.frustumCulled, cullingStats.smallCulled, cullingStats.occlusionCulled, cullingStats.nbOccluders);
+            lastCullingStats = cullingStats;
+        }
+
+        //Each body sweeps from its previous center to the one the culling just computed
+        {
+            ProfileScope scope(simProfiler, "collide");
+            for (uint32_t i = 0; i < collisions.getNbBodies(); i++) {
+                bool isObject = i < collisionObjects.size();
+                glm::vec3 to = isObject ? glm::vec3(collisionObjects[i]->worldCenter) : asteroidPositions[i - collisionObjects.size()];
+                float radius = isObject ? collisionObjects[i]->worldRadius : asteroidScale[i - collisionObjects.size()] * asteroidSphere.getBoundingRadius();
+                glm::vec3 from = collisionPositions[i];
+                if (!collisionStarted || (isObject && cutObjects[collisionObjects[i] - objects.data()]))
+                    from = to; //Cut by the script : no sweep
+                collisions.setBody(i, from, to, radius, isObject ? COLLISION_BODIES : COLLISION_ASTEROIDS, isObject ? COLLISION_ALL : COLLISION_BODIES);
+                collisionPositions[i] = to;
+            }
+            collisionStarted = true;
+            collisions.step();
+        }
+        CollisionEvent collision;
+        uint32_t nbCollisions = 0;
+        while (collisions.pollEvent(collision)) {
+            GameObject* a = collision.a < collisionObjects.size() ? collisionObjects[collision.a] : NULL;
+            GameObject* b = collision.b < collisionObjects.size() ? collisionObjects[collision.b] : NULL;
+            if (!impacted && a && b && ((a == Asteroide && b == sunGO) || (a == sunGO && b == Asteroide))) {
+                impacted = true;
+                impactStep = step;
+                burning = false;
+                INFO("The asteroid hits the sun at (%.2f, %.2f, %.2f), step %u\n", collision.point.x, collision.point.y, collision.point.z, (uint32_t)step);
+                particles.burst(ejectaEmitter, collision.point, 0.0f, collision.point - glm::vec3(sunGO->worldCenter), 50000);
+            }
+            else {
+                nbCollisions++;
+                if (collision.time > 0.0f) //A new contact, not an overlap going on
+                    particles.burst(debrisEmitter, collision.point, 0.0f, glm::vec3(0.0f), 50);
+            }
+        }
+        if (nbCollisions != lastNbCollisions) {
+            const CollisionStats& collisionStats = collisions.getStats();
+            INFO("Collisions: %u (%u candidate pairs among %u bodies, %u too large for the grid)\n", nbCollisions,
+                 (uint32_t)collisionStats.nbCandidates, collisionStats.nbBodies, collisionStats.nbLargeBodies);
+            lastNbCollisions = nbCollisions;
+        }
+
+        //The asteroid burns on its way to the sun
+        {
+            ProfileScope scope(simProfiler, "particles");
+            particles.getEmitter(fireEmitter).rate = burning ? 300.0f : 0.0f;
+            particles.update();
+        }
+
+        //Fire and ejecta, sorted for the blending from the farthest to the nearest
+        state.particles.resize(vaoParticleID || rayTracer ? particles.getNbParticles() : 0);
+        if (!state.particles.empty()) {
+            ProfileScope scope(simProfiler, "billboards");
+            particles.buildInstances(glm::vec3(cameraPosition), state.particles.data());
+        }
+    };
+
+    //The simulation runs on its own thread and hands its steps over through a triple buffer : neither thread waits for the other.
+    //Exporting or headless, every step is a frame : lockstep, the simulation of a step overlaps the drawing of the previous one
+    bool lockstep = headless || exportPath;
+    TripleBuffer<FrameState> states;
+    std::atomic<bool> simulating(true);
+    uint32_t nbSteps = 0;         //Written by the simulation thread, read after its end
+    uint32_t nbDroppedStates = 0; //Replaced by a newer step before being drawn
+    uint64_t simTimeStart = SDL_GetPerformanceCounter();
+    double simElapsed = 0.0;
+    std::thread simulation([&]() {
+        std::chrono::steady_clock::duration period = std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(simRate > 0.0f ? 1.0 / simRate : 0.0));
+        std::chrono::steady_clock::time_point next = std::chrono::steady_clock::now();
+        while (simulating.load(std::memory_order_relaxed)) {
+            if (simProfiler) {
+                simProfiler->endFrame();
+                simProfiler->beginFrame();
+            }
+            FrameState& state = states.getWriteBuffer();
+            simulateStep(state);
+            bool last = state.ended;
+            nbSteps++;
+
+            //Lockstep : the previous step must have been taken by the render thread
+            if (lockstep) {
+                ProfileScope scope(simProfiler, "wait");
+                while (states.isPending() && simulating.load(std::memory_order_relaxed))
+                    std::this_thread::yield();
+            }
+            if (!states.publish())
+                nbDroppedStates++;
+            if (last)
+                break;
+
+            //Fixed rate. Too late (a slow step, a debugger) : start again from now instead of catching up
+            if (!lockstep && simRate > 0.0f) {
+                next += period;
+                std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+                if (now > next + 4 * period)
+                    next = now;
+                else
+                    std::this_thread::sleep_until(next);
+            }
+        }
+        if (simProfiler)
+            simProfiler->endFrame();
+        simElapsed = (SDL_GetPerformanceCounter() - simTimeStart) / (double)SDL_GetPerformanceFrequency();
+    });
+
+    bool isOpened = true;
+    uint32_t nbFrames = 0;
+    std::vector<uint8_t> rayPixels(rayTracer ? width * height * 4 : 0); //Bottom-up, like the readbacks of the exporter
+    uint64_t nbRays = 0, nbShadowRays = 0;
+    uint32_t nbRaySteals = 0;
+    double rayElapsed = 0.0;
+    uint32_t nbRepeatedStates = 0; //Frames drawn without a new step
+    uint64_t timeStart = SDL_GetPerformanceCounter();
+
+    //Main application loop : the render thread
+    while (isOpened && (maxFrames == 0 || nbFrames < maxFrames)) //affichage
     {
         //Time in ms telling us when this frame started. Useful for keeping a fix framerate
         uint32_t timeBegin = SDL_GetTicks();
+        if (profiler) {
+            profiler->endFrame();
+            profiler->beginFrame();
+        }
+
+        //Frame boundary : swap the modified shaders in (the previous programs are kept if they do not compile)
+        if (shaderWatcher && shaderWatcher->poll(changedShaders)) {
+            ShaderLibrary* libraries[] = { shaders, skybox ? skybox->getShaders() : NULL, weightedBlending ? weightedBlending->getShaders() : NULL };
+            for (size_t l = 0; l < sizeof(libraries) / sizeof(libraries[0]); l++) {
+                for (size_t i = 0; libraries[l] && i < changedShaders.size(); i++) {
+                    if (libraries[l]->usesFile(changedShaders[i])) {
+                        libraries[l]->reload();
+                        break;
+                    }
+                }
+            }
+        }
 
         //Fetch the SDL events
         SDL_Event event;
-        while (SDL_PollEvent(&event))
+        while (!headless && SDL_PollEvent(&event))
         {
             switch (event.type)
             {
@@ -525,279 +1086,336 @@ int main(int argc, char* argv[])
             }
         }
 
+        //The latest step of the simulation. Lockstep (and before the first step) : wait for the next one
+        {
+            ProfileScope scope(profiler, "wait");
+            if (lockstep || nbFrames == 0) {
+                while (!states.acquire())
+                    std::this_thread::yield();
+            }
+            else if (!states.acquire())
+                nbRepeatedStates++;
+        }
+        const FrameState& state = states.getReadBuffer();
+        if (state.ended)
+            break;
+
+        //Offline : the frame is ray traced on the CPU instead of drawn
+        if (rayTracer) {
+            {
+                ProfileScope scope(profiler, "raytrace");
+                rayTracer->clear();
+                for (size_t i = 0; i < state.bodies.size(); i++) {
+                    const BodyState& body = state.bodies[i];
+                    RayShape shape = body.geometry == &ring ? RAY_ANNULUS : RAY_SPHERE;
+                    rayTracer->addPrimitive(RayPrimitive{ shape, body.model, body.material, body.texture, body.translucent, RING_INNER_RADIUS, glm::vec2(sphere.U_SCALE, sphere.V_SCALE) });
+                }
+                for (uint32_t i = 0; i < state.nbAsteroids; i++)
+                    rayTracer->addPrimitive(RayPrimitive{ RAY_SPHERE, state.asteroidModels[i], asteroidMtl, asteroidTexture, false, 0.0f, glm::vec2(asteroidSphere.U_SCALE, asteroidSphere.V_SCALE) });
+                for (size_t i = 0; i < state.occluders.size(); i++)
+                    rayTracer->addOccluder(state.occluders[i]);
+                rayTracer->setParticles(state.particles.data(), state.particles.size());
+                rayTracer->setLight(glm::vec3(glm::dvec3(light.position) - state.cameraPosition), state.lightRadius, light.color);
+                rayTracer->setSkyView(state.sky, state.skyRotation, state.skyColor * light.color);
+                rayTracer->render(state.view, projection, width, height, rayPixels.data());
+            }
+            const RayStats& rayStats = rayTracer->getStats();
+            nbRays += rayStats.nbRays;
+            nbShadowRays += rayStats.nbShadowRays;
+            nbRaySteals += rayStats.nbSteals;
+            rayElapsed += rayStats.seconds;
+
+            nbFrames++;
+            if (exporter) {
+                ProfileScope scope(profiler, "export");
+                exporter->capture(rayPixels.data());
+            }
+            continue;
+        }
+
         //Clear the screen : the depth buffer and the color buffer
         glClear(GL_DEPTH_BUFFER_BIT | GL_COLOR_BUFFER_BIT);
 
+        //Per-frame constants, written once
+        FrameUniforms frame;
+        frame.view = state.view;
+        frame.projection = depthProjection;
+        frame.viewProjection = depthProjection * state.view;
+        frame.cameraPosition = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+        frame.lightPosition = glm::vec4(glm::vec3(glm::dvec3(light.position) - state.cameraPosition), state.lightRadius);
+        frame.lightColor = glm::vec4(light.color, 1.0f);
+        frame.depthParams = depthRange.getParams();
 
-        glm::mat4 view;
-        view = glm::lookAt(glm::vec3(0.0, 2.0, 4.0), glm::vec3(0.0, 0.0, 0.0), glm::vec3(0.0, 1.0, 0.0));
-        glm::mat4 projection = glm::perspective(45.0f, WIDTH / (float)HEIGHT, 0.1f, 1000.0f);
-
-
-
-        if (tAsteroide < 0 && tAsteroide > -14.1) {
-            sunGO.localMatrix = sunGO.propagatedMatrix = glm::mat4(1.0f);
-            sunGO.propagatedMatrix = glm::translate(sunGO.localMatrix, glm::vec3(0.0f, 0.0f, 0.0f));
-            sunGO.localMatrix = glm::scale(sunGO.localMatrix, glm::vec3(0.5f, 0.5f, 0.5f));
-            sunGO.propagatedMatrix = glm::rotate(sunGO.propagatedMatrix, tMercury, glm::vec3(0.0f, 1.0f, 0.0f)); //angle de rotation, en rad
-        }
-        else if (tAsteroide < -14.35 && tAsteroide > -14.40) {
-            sunGO.localMatrix = sunGO.propagatedMatrix = glm::mat4(1.0f);
-            sunGO.propagatedMatrix = glm::translate(sunGO.localMatrix, glm::vec3(0.0f, 0.0f, 0.0f));
-            sunGO.localMatrix = glm::scale(sunGO.localMatrix, glm::vec3(0.55, 0.55, 0.55));
-            sunGO.propagatedMatrix = glm::rotate(sunGO.propagatedMatrix, tMercury, glm::vec3(0.0f, 1.0f, 0.0f)); //angle de rotation, en rad
-            //grow += 0.05f;
-        }
-        else if (tAsteroide < -14.40 && tAsteroide > -14.50) {
-            sunGO.localMatrix = sunGO.propagatedMatrix = glm::mat4(1.0f);
-            sunGO.propagatedMatrix = glm::translate(sunGO.localMatrix, glm::vec3(0.0f, 0.0f, 0.0f));
-            sunGO.localMatrix = glm::scale(sunGO.localMatrix, glm::vec3(0.60, 0.60, 0.60));
-            sunGO.propagatedMatrix = glm::rotate(sunGO.propagatedMatrix, tMercury, glm::vec3(0.0f, 1.0f, 0.0f)); //angle de rotation, en rad
-            //grow += 0.05f;
-        }
-        else if (tAsteroide < -14.50 && tAsteroide > -14.55) {
-            sunGO.localMatrix = sunGO.propagatedMatrix = glm::mat4(1.0f);
-            sunGO.propagatedMatrix = glm::translate(sunGO.localMatrix, glm::vec3(0.0f, 0.0f, 0.0f));
-            sunGO.localMatrix = glm::scale(sunGO.localMatrix, glm::vec3(0.65, 0.65, 0.65));
-            sunGO.propagatedMatrix = glm::rotate(sunGO.propagatedMatrix, tMercury, glm::vec3(0.0f, 1.0f, 0.0f)); //angle de rotation, en rad
-            //grow += 0.05f;
-        }
-        else if (tAsteroide < -14.55 && tAsteroide > -14.60) {
-            sunGO.localMatrix = sunGO.propagatedMatrix = glm::mat4(1.0f);
-            sunGO.propagatedMatrix = glm::translate(sunGO.localMatrix, glm::vec3(0.0f, 0.0f, 0.0f));
-            sunGO.localMatrix = glm::scale(sunGO.localMatrix, glm::vec3(0.70, 0.70, 0.70));
-            sunGO.propagatedMatrix = glm::rotate(sunGO.propagatedMatrix, tMercury, glm::vec3(0.0f, 1.0f, 0.0f)); //angle de rotation, en rad
-            //grow += 0.05f;
-        }
-        else if (tAsteroide < -14.60 && tAsteroide > -14.65) {
-            sunGO.localMatrix = sunGO.propagatedMatrix = glm::mat4(1.0f);
-            sunGO.propagatedMatrix = glm::translate(sunGO.localMatrix, glm::vec3(0.0f, 0.0f, 0.0f));
-            sunGO.localMatrix = glm::scale(sunGO.localMatrix, glm::vec3(0.75, 0.75, 0.75));
-            sunGO.propagatedMatrix = glm::rotate(sunGO.propagatedMatrix, tMercury, glm::vec3(0.0f, 1.0f, 0.0f)); //angle de rotation, en rad
-            sunGO.sphereMtl = { {0.2f, 0.2f, 0.2f}, 0.1, 0, 0.0f, 5 };
-            //grow += 0.05f;
-        }
-
-        //Set Translation, Scaling and Rotation of each Object
-        //Operation on fictional sun, result rotation of planet
-        sunGOEarth.localMatrix = sunGOEarth.propagatedMatrix = glm::mat4(1.0f);
-        sunGOEarth.propagatedMatrix = glm::translate(sunGOEarth.localMatrix, glm::vec3(0.0f, 0.0f, 0.0f));
-        sunGOEarth.localMatrix = glm::scale(sunGOEarth.localMatrix, glm::vec3(0.01f, 0.01f, 0.01f));
-        sunGOEarth.propagatedMatrix = glm::rotate(sunGOEarth.propagatedMatrix, tEarth, glm::vec3(0.0f, 1.0f, 0.0f)); //angle de rotation, en rad
-
-        sunGOMercury.localMatrix = sunGOMercury.propagatedMatrix = glm::mat4(1.0f);
-        sunGOMercury.propagatedMatrix = glm::translate(sunGOMercury.localMatrix, glm::vec3(0.0f, 0.0f, 0.0f));
-        sunGOMercury.localMatrix = glm::scale(sunGOEarth.localMatrix, glm::vec3(0.01f, 0.01f, 0.01f));
-        sunGOMercury.propagatedMatrix = glm::rotate(sunGOMercury.propagatedMatrix, tMercury, glm::vec3(0.0f, 1.0f, 0.0f)); //angle de rotation, en rad
-
-        sunGOVenus.localMatrix = sunGOVenus.propagatedMatrix = glm::mat4(1.0f);
-        sunGOVenus.propagatedMatrix = glm::translate(sunGOVenus.localMatrix, glm::vec3(0.0f, 0.0f, 0.0f));
-        sunGOVenus.localMatrix = glm::scale(sunGOVenus.localMatrix, glm::vec3(0.01f, 0.01f, 0.01f));
-        sunGOVenus.propagatedMatrix = glm::rotate(sunGOVenus.propagatedMatrix, tVenus, glm::vec3(0.0f, 1.0f, 0.0f)); //angle de rotation, en rad
-
-        sunGOMars.localMatrix = sunGOMars.propagatedMatrix = glm::mat4(1.0f);
-        sunGOMars.propagatedMatrix = glm::translate(sunGOMars.localMatrix, glm::vec3(0.0f, 0.0f, 0.0f));
-        sunGOMars.localMatrix = glm::scale(sunGOMars.localMatrix, glm::vec3(0.01f, 0.01f, 0.01f));
-        sunGOMars.propagatedMatrix = glm::rotate(sunGOMars.propagatedMatrix, tMars, glm::vec3(0.0f, 1.0f, 0.0f)); //angle de rotation, en rad
-
-        sunGOJupiter.localMatrix = sunGOJupiter.propagatedMatrix = glm::mat4(1.0f);
-        sunGOJupiter.propagatedMatrix = glm::translate(sunGOJupiter.localMatrix, glm::vec3(0.0f, 0.0f, 0.0f));
-        sunGOJupiter.localMatrix = glm::scale(sunGOJupiter.localMatrix, glm::vec3(0.01f, 0.01f, 0.01f));
-        sunGOJupiter.propagatedMatrix = glm::rotate(sunGOJupiter.propagatedMatrix, tJupiter, glm::vec3(0.0f, 1.0f, 0.0f)); //angle de rotation, en rad
-
-        sunGOSaturne.localMatrix = sunGOSaturne.propagatedMatrix = glm::mat4(1.0f);
-        sunGOSaturne.propagatedMatrix = glm::translate(sunGOSaturne.localMatrix, glm::vec3(0.0f, 0.0f, 0.0f));
-        sunGOSaturne.localMatrix = glm::scale(sunGOSaturne.localMatrix, glm::vec3(0.01f, 0.01f, 0.01f));
-        sunGOSaturne.propagatedMatrix = glm::rotate(sunGOSaturne.propagatedMatrix, tSaturne, glm::vec3(0.0f, 1.0f, 0.0f)); //angle de rotation, en rad
-
-        sunGOUranus.localMatrix = sunGOUranus.propagatedMatrix = glm::mat4(1.0f);
-        sunGOUranus.propagatedMatrix = glm::translate(sunGOUranus.localMatrix, glm::vec3(0.0f, 0.0f, 0.0f));
-        sunGOUranus.localMatrix = glm::scale(sunGOUranus.localMatrix, glm::vec3(0.01f, 0.01f, 0.01f));
-        sunGOUranus.propagatedMatrix = glm::rotate(sunGOUranus.propagatedMatrix, tUranus, glm::vec3(0.0f, 1.0f, 0.0f)); //angle de rotation, en rad
-
-        sunGONeptune.localMatrix = sunGONeptune.propagatedMatrix = glm::mat4(1.0f);
-        sunGONeptune.propagatedMatrix = glm::translate(sunGONeptune.localMatrix, glm::vec3(0.0f, 0.0f, 0.0f));
-        sunGONeptune.localMatrix = glm::scale(sunGONeptune.localMatrix, glm::vec3(0.01f, 0.01f, 0.01f));
-        sunGONeptune.propagatedMatrix = glm::rotate(sunGONeptune.propagatedMatrix, tNeptune, glm::vec3(0.0f, 1.0f, 0.0f)); //angle de rotation, en rad
-
-
-        //Operation on planet
-        Mercury.localMatrix = Mercury.propagatedMatrix = glm::mat4(1.0);
-        Mercury.propagatedMatrix = glm::translate(Mercury.propagatedMatrix, glm::vec3(0.55f, 0.0f, 0.0f));
-        Mercury.localMatrix = glm::scale(Mercury.localMatrix, glm::vec3(0.12f, 0.12f, 0.12f));
-        Mercury.propagatedMatrix = glm::rotate(Mercury.propagatedMatrix, tMercury, glm::vec3(0.0f, 1.0f, 1.0f));
-
-        Venus.localMatrix = Venus.propagatedMatrix = glm::mat4(1.0);
-        Venus.propagatedMatrix = glm::translate(Venus.propagatedMatrix, glm::vec3(0.75f, 0.0f, 0.0f));
-        Venus.localMatrix = glm::scale(Venus.localMatrix, glm::vec3(0.12f, 0.12f, 0.12f));
-        Venus.propagatedMatrix = glm::rotate(Venus.propagatedMatrix, tVenus, glm::vec3(0.0f, 1.0f, 1.0f));
-
-        earthGO.localMatrix = earthGO.propagatedMatrix = glm::mat4(1.0f);
-        earthGO.localMatrix = glm::scale(earthGO.localMatrix, glm::vec3(0.12f, 0.12f, 0.12f));
-        earthGO.propagatedMatrix = glm::translate(earthGO.propagatedMatrix, glm::vec3(0.85f, 0.f, 0.0f));
-        earthGO.propagatedMatrix = glm::rotate(earthGO.propagatedMatrix, tMercury, glm::vec3(1.0f, 0.0f, 0.0f)); //tMercury for faster rotation
-
-        MoonGO.localMatrix = MoonGO.propagatedMatrix = glm::mat4(1.0f);
-        MoonGO.localMatrix = glm::scale(MoonGO.localMatrix, glm::vec3(0.04f, 0.04f, 0.04f));
-        MoonGO.propagatedMatrix = glm::translate(MoonGO.propagatedMatrix, glm::vec3(0.0f, 0.10f, 0.0f));
-        MoonGO.propagatedMatrix = glm::rotate(MoonGO.propagatedMatrix, tSun, glm::vec3(0.0f, 1.0f, 0.0f));
-
-        Mars.localMatrix = Mars.propagatedMatrix = glm::mat4(1.0);
-        Mars.propagatedMatrix = glm::translate(Mars.propagatedMatrix, glm::vec3(0.95f, 0.0f, 0.0f));
-        Mars.localMatrix = glm::scale(Mars.localMatrix, glm::vec3(0.12f, 0.12f, 0.12f));
-        Mars.propagatedMatrix = glm::rotate(Mars.propagatedMatrix, tEarth, glm::vec3(0.0f, 1.0f, 1.0f));
-
-        Jupiter.localMatrix = Jupiter.propagatedMatrix = glm::mat4(1.0);
-        Jupiter.propagatedMatrix = glm::translate(Jupiter.propagatedMatrix, glm::vec3(1.30f, 0.0f, 0.0f));
-        Jupiter.localMatrix = glm::scale(Jupiter.localMatrix, glm::vec3(0.30f, 0.30f, 0.30f));
-        Jupiter.propagatedMatrix = glm::rotate(Jupiter.propagatedMatrix, tEarth, glm::vec3(0.2f, 1.0f, 0.0f));
-
-        Saturne.localMatrix = Saturne.propagatedMatrix = glm::mat4(1.0);
-        Saturne.propagatedMatrix = glm::translate(Saturne.propagatedMatrix, glm::vec3(1.90f, 0.0f, 0.0f));
-        Saturne.localMatrix = glm::scale(Saturne.localMatrix, glm::vec3(0.20f, 0.20f, 0.20f));
-        Saturne.propagatedMatrix = glm::rotate(Saturne.propagatedMatrix, tEarth, glm::vec3(0.0f, 1.0f, 0.2f));
-
-        anneauSaturne.localMatrix = anneauSaturne.propagatedMatrix = glm::mat4(1.0);
-        anneauSaturne.propagatedMatrix = glm::translate(anneauSaturne.propagatedMatrix, glm::vec3(1.90f, 0.0f, 0.0f));
-        anneauSaturne.localMatrix = glm::scale(anneauSaturne.localMatrix, glm::vec3(0.35f, 0.015f, 0.35f));
-        anneauSaturne.propagatedMatrix = glm::rotate(anneauSaturne.propagatedMatrix, tEarth, glm::vec3(0.0f, 1.0f, 0.2f));
-
-        Uranus.localMatrix = Uranus.propagatedMatrix = glm::mat4(1.0);
-        Uranus.propagatedMatrix = glm::translate(Uranus.propagatedMatrix, glm::vec3(2.5f, 0.0f, 0.0f));
-        Uranus.localMatrix = glm::scale(Uranus.localMatrix, glm::vec3(0.12f, 0.12f, 0.12f));
-        Uranus.propagatedMatrix = glm::rotate(Uranus.propagatedMatrix, tEarth, glm::vec3(0.0f, 1.0f, 1.0f));
-
-        Neptune.localMatrix = Neptune.propagatedMatrix = glm::mat4(1.0);
-        Neptune.propagatedMatrix = glm::translate(Neptune.propagatedMatrix, glm::vec3(2.9f, 0.0f, 0.0f));
-        Neptune.localMatrix = glm::scale(Neptune.localMatrix, glm::vec3(0.12f, 0.12f, 0.12f));
-        Neptune.propagatedMatrix = glm::rotate(Neptune.propagatedMatrix, tEarth, glm::vec3(0.0f, 1.0f, 1.0f));
-
-        Etoiles.localMatrix = Etoiles.propagatedMatrix = glm::mat4(1.0);
-        Etoiles.propagatedMatrix = glm::translate(Etoiles.propagatedMatrix, glm::vec3(0.0f, 0.0f, 2.0f));
-        Etoiles.localMatrix = glm::scale(Etoiles.localMatrix, glm::vec3(15.0f, 15.0f, 15.0f));
-        Etoiles.propagatedMatrix = glm::rotate(Etoiles.propagatedMatrix, tEtoile, glm::vec3(1.0f, 1.0f, 1.0f));
-
-
-        //definition of the asteroid's motion
-        if (tAsteroide < 0 && tAsteroide > -12) {
-            sunGOAsteroide.localMatrix = sunGOAsteroide.propagatedMatrix = glm::mat4(1.0f);
-            sunGOAsteroide.propagatedMatrix = glm::translate(sunGOAsteroide.propagatedMatrix, glm::vec3(0.0f, 0.0f, 0.0f));
-            sunGOAsteroide.localMatrix = glm::scale(sunGOAsteroide.localMatrix, glm::vec3(0.1f, 0.1f, 0.1f));
-            sunGOAsteroide.propagatedMatrix = glm::rotate(sunGOAsteroide.propagatedMatrix, tAsteroide, glm::vec3(0.0f, 1.0f, 0.0f)); //angle de rotation, en rad
-            tAsteroide -= 0.01;
-        }
-        else {
-            sunGOAsteroide.localMatrix = sunGOAsteroide.propagatedMatrix = glm::mat4(1.0f);
-            sunGOAsteroide.propagatedMatrix = glm::translate(sunGOAsteroide.propagatedMatrix, glm::vec3(1.42f, -1.45f, 0.0f));
-            sunGOAsteroide.localMatrix = glm::scale(sunGOAsteroide.localMatrix, glm::vec3(0.0001f, 0.0001f, 0.0001f));
-            sunGOAsteroide.propagatedMatrix = glm::rotate(sunGOAsteroide.propagatedMatrix, tAsteroide, glm::vec3(1.0f, 1.0f, 0.0f)); //angle de rotation, en rad
-            tAsteroide -= 0.005;
-        }
-
-        if (tAsteroide < 0 && tAsteroide > -5) {
-            Asteroide.localMatrix = Asteroide.propagatedMatrix = glm::mat4(1.0);
-            Asteroide.propagatedMatrix = glm::translate(Asteroide.propagatedMatrix, glm::vec3(1.5f, 1.5f, 5.0f));
-            Asteroide.localMatrix = glm::scale(Asteroide.localMatrix, glm::vec3(0.3f, 0.3f, 0.3f));
-            Flammes.localMatrix = Flammes.propagatedMatrix = glm::mat4(1.0);
-            Flammes.propagatedMatrix = glm::translate(Flammes.propagatedMatrix, glm::vec3(0.0f, 0.0f, 150.0f));
-            Flammes.localMatrix = glm::scale(Flammes.localMatrix, glm::vec3(0.3f, 0.28f, 0.3f));
-        }
-        else if (tAsteroide < -5 && tAsteroide > -12) {
-            Asteroide.localMatrix = Asteroide.propagatedMatrix = glm::mat4(1.0);
-            Asteroide.propagatedMatrix = glm::translate(Asteroide.propagatedMatrix, glm::vec3(1.0f, 1.0f, 2.7f));
-            Asteroide.localMatrix = glm::scale(Asteroide.localMatrix, glm::vec3(0.3f, 0.3f, 0.3f));
-            Flammes.localMatrix = Flammes.propagatedMatrix = glm::mat4(1.0);
-            Flammes.propagatedMatrix = glm::translate(Flammes.propagatedMatrix, glm::vec3(0.0f, 0.0f, 150.0f));
-            Flammes.localMatrix = glm::scale(Flammes.localMatrix, glm::vec3(0.3f, 0.28f, 0.3f));
-        }
-        else if (tAsteroide < -12 && tAsteroide > -14.1) {
-            Asteroide.localMatrix = Asteroide.propagatedMatrix = glm::mat4(1.0);
-            Asteroide.propagatedMatrix = glm::translate(Asteroide.propagatedMatrix, glm::vec3(0.0f, 0.0f, 2.0f));
-            Asteroide.localMatrix = glm::scale(Asteroide.localMatrix, glm::vec3(0.3f, 0.3f, 0.3f));
-            Flammes.localMatrix = Flammes.propagatedMatrix = glm::mat4(1.0);
-            Flammes.propagatedMatrix = glm::translate(Flammes.propagatedMatrix, glm::vec3(0.16f, 0.0f, 2.0f));
-            Flammes.localMatrix = glm::scale(Flammes.localMatrix, glm::vec3(0.6, 0.3f, 0.3f));
+        {
+            ProfileScope scope(profiler, "queue");
+            renderQueue.clear();
+            uint32_t nbImpostorBatches = 0, nbImpostors = 0;
+            for (size_t i = 0; i < state.bodies.size(); i++) {
+                const BodyState& body = state.bodies[i];
+                uint32_t impostorFeatures = cheapestFeatures(body.material) | baseFeatures | SHADER_INSTANCED | SHADER_IMPOSTORS;
+                if (body.nbOccluders > 0 && !(impostorFeatures & SHADER_UNLIT))
+                    impostorFeatures |= SHADER_ECLIPSES;
+                Shader* impostorShader = impostors && isImpostor(body, vaoSphereID, projection[1][1] * height * 0.5f, impostorSize) ? shaders->get(impostorFeatures) : NULL;
+                if (!impostorShader) {
+                    queueBody(body, *shaders, baseFeatures, translucentFeatures, frame, zFar, renderQueue);
+                    continue;
+                }
 
-        }
-        else {
-            Asteroide.localMatrix = Asteroide.propagatedMatrix = glm::mat4(1.0);
-            Asteroide.propagatedMatrix = glm::translate(Asteroide.propagatedMatrix, glm::vec3(0.0f, 0.0f, 150.0f));
-            Asteroide.localMatrix = glm::scale(Asteroide.localMatrix, glm::vec3(0.3f, 0.3f, 0.3f));
-            Flammes.localMatrix = Flammes.propagatedMatrix = glm::mat4(1.0);
-            Flammes.propagatedMatrix = glm::translate(Flammes.propagatedMatrix, glm::vec3(0.0f, 0.0f, 150.0f));
-            Flammes.localMatrix = glm::scale(Flammes.localMatrix, glm::vec3(0.3f, 0.28f, 0.3f));
-        }
+                //Into the batch of its shader, texture and material
+                const Material& mtl = body.material;
+                uint32_t b = 0;
+                while (b < nbImpostorBatches && !(body.nbOccluders == 0 && impostorBatches[b].nbOccluders == 0 &&
+                       impostorBatches[b].shader == impostorShader && impostorBatches[b].texture == body.texture &&
+                       impostorBatches[b].material.color == mtl.color && impostorBatches[b].material.ka == mtl.ka && impostorBatches[b].material.kd == mtl.kd &&
+                       impostorBatches[b].material.ks == mtl.ks && impostorBatches[b].material.alpha == mtl.alpha))
+                    b++;
+                float distance = glm::length(glm::vec3(body.model[3]));
+                if (b == nbImpostorBatches) {
+                    if (impostorBatches.size() <= b)
+                        impostorBatches.resize(b + 1);
+                    impostorBatches[b].shader = impostorShader;
+                    impostorBatches[b].texture = body.texture;
+                    impostorBatches[b].material = mtl;
+                    impostorBatches[b].distance = distance;
+                    impostorBatches[b].models.clear();
+                    impostorBatches[b].nbOccluders = body.nbOccluders;
+                    for (uint32_t o = 0; o < body.nbOccluders; o++)
+                        impostorBatches[b].occluders[o] = body.occluders[o];
+                    nbImpostorBatches++;
+                }
+                impostorBatches[b].distance = std::min(impostorBatches[b].distance, distance);
+                impostorBatches[b].models.push_back(body.model);
+                nbImpostors++;
+            }
 
+            //A region of the streaming buffer for the instances of this frame : nothing to wait for unless the GPU is STREAMING_FRAMES frames late
+            GLsizeiptr instanceBytes = StreamingBuffer::getAllocationSize(state.nbAsteroids * sizeof(glm::mat4)) +
+                                       StreamingBuffer::getAllocationSize(state.particles.size() * sizeof(ParticleInstance));
+            for (uint32_t b = 0; b < nbImpostorBatches; b++)
+                instanceBytes += StreamingBuffer::getAllocationSize(impostorBatches[b].models.size() * sizeof(glm::mat4));
+            instanceStream->beginFrame(instanceBytes);
+
+            //A quad of 4 vertices per impostor
+            for (uint32_t b = 0; b < nbImpostorBatches; b++) {
+                const ImpostorBatch& batch = impostorBatches[b];
+                GLintptr offset = 0;
+                void* instances = instanceStream->allocate(batch.models.size() * sizeof(glm::mat4), offset);
+                if (!instances)
+                    continue;
+                memcpy(instances, batch.models.data(), batch.models.size() * sizeof(glm::mat4));
+                if (impostorVAOs.size() <= b)
+                    impostorVAOs.push_back(createImpostorVAO());
+                pointModelInstances(impostorVAOs[b], instanceStream->getBuffer(), offset);
+
+                DrawPacket packet;
+                packet.shader = batch.shader;
+                packet.vao = impostorVAOs[b];
+                packet.texture = batch.texture;
+                packet.first = 0;
+                packet.nbVertices = 4;
+                packet.nbInstances = batch.models.size();
+                packet.primitive = GL_TRIANGLE_STRIP;
+                packet.material = batch.material;
+                packet.object.mvp = packet.object.model = glm::mat4(1.0f);
+                for (int i = 0; i < 3; i++)
+                    packet.object.invModel3x3[i] = glm::vec4(0.0f);
+                packet.object.material[0] = packet.object.material[2] = packet.object.material[3] = 0;
+                packet.object.material[1] = batch.nbOccluders;
+                for (uint32_t o = 0; o < batch.nbOccluders; o++)
+                    packet.object.occluders[o] = batch.occluders[o];
+                packet.key = RenderQueue::makeKey(LAYER_OPAQUE, batch.shader->getProgramID(), batch.texture, impostorVAOs[b], batch.distance / zFar);
+                renderQueue.push(packet);
+            }
+            if (nbImpostors != lastNbImpostors || nbImpostorBatches != lastNbImpostorBatches) {
+                INFO("Impostors: %u bodies in %u draws\n", nbImpostors, nbImpostorBatches);
+                lastNbImpostors = nbImpostors;
+                lastNbImpostorBatches = nbImpostorBatches;
+            }
 
-        //Change time at each loop
-        tSun += 0.007f;
-        tMercury += 0.01f;
-        tVenus += 0.009f;
-        tEarth += 0.0077f;
-        tMars += 0.0064f;
-        tJupiter += 0.004f;
-        tSaturne += 0.003f;
-        tUranus += 0.002f;
-        tNeptune += 0.001f;
-        tEtoile += 0.0002f;
-
-        //Set Vision
-        std::stack<glm::mat4> matrices;
-        matrices.push(projection * view);
-
-
-        //Draw planet on screen, with light
-        if (tAsteroide < -16.0) {
-            break;
-        }
-        else if (tAsteroide < -15.4) {
-            tAsteroide -= 0.01;
+            //The asteroids of the catalog on their Keplerian orbits
+            uint32_t asteroidFeatures = cheapestFeatures(asteroidMtl) | baseFeatures | SHADER_INSTANCED | (vaoAsteroidImpostorID ? SHADER_IMPOSTORS : 0);
+            GLuint asteroidVAO = vaoAsteroidImpostorID ? vaoAsteroidImpostorID : vaoAsteroidID;
+            Shader* asteroidShader = state.nbAsteroids > 0 ? shaders->get(asteroidFeatures) : NULL;
+            GLintptr asteroidOffset = 0;
+            void* asteroidInstances = asteroidShader ? instanceStream->allocate(state.nbAsteroids * sizeof(glm::mat4), asteroidOffset) : NULL;
+            if (asteroidInstances) {
+                memcpy(asteroidInstances, state.asteroidModels.data(), state.nbAsteroids * sizeof(glm::mat4));
+                pointModelInstances(asteroidVAO, instanceStream->getBuffer(), asteroidOffset);
+
+                DrawPacket packet;
+                packet.shader = asteroidShader;
+                packet.vao = asteroidVAO;
+                packet.texture = asteroidTexture;
+                packet.first = 0;
+                packet.nbVertices = vaoAsteroidImpostorID ? 4 : asteroidSphere.getNbVertices();
+                packet.nbInstances = state.nbAsteroids;
+                packet.primitive = vaoAsteroidImpostorID ? GL_TRIANGLE_STRIP : GL_TRIANGLES;
+                packet.material = asteroidMtl;
+                packet.object.mvp = packet.object.model = glm::mat4(1.0f);
+                for (int i = 0; i < 3; i++)
+                    packet.object.invModel3x3[i] = glm::vec4(0.0f);
+                packet.object.material[0] = packet.object.material[1] = packet.object.material[2] = packet.object.material[3] = 0;
+                float distance = (float)glm::length(state.cameraPosition);
+                packet.key = RenderQueue::makeKey(LAYER_OPAQUE, asteroidShader->getProgramID(), asteroidTexture, asteroidVAO, distance / zFar);
+                renderQueue.push(packet);
+            }
+
+            //Fire and ejecta, blended from the farthest to the nearest
+            Shader* particleShader = !state.particles.empty() ? shaders->get(SHADER_PARTICLES | baseFeatures) : NULL;
+            uint32_t nbParticles = state.particles.size();
+            GLintptr particleOffset = 0;
+            void* particleInstances = particleShader ? instanceStream->allocate(nbParticles * sizeof(ParticleInstance), particleOffset) : NULL;
+            if (particleInstances) {
+                memcpy(particleInstances, state.particles.data(), nbParticles * sizeof(ParticleInstance));
+                pointParticleInstances(vaoParticleID, instanceStream->getBuffer(), particleOffset);
+
+                DrawPacket packet;
+                packet.shader = particleShader;
+                packet.vao = vaoParticleID;
+                packet.texture = 0;
+                packet.first = 0;
+                packet.nbVertices = 6;
+                packet.nbInstances = nbParticles;
+                packet.material = Material{ {1.0f, 1.0f, 1.0f}, 1.0f, 0.0f, 0.0f, 1, SHADER_UNLIT };
+                packet.object.mvp = packet.object.model = glm::mat4(1.0f);
+                for (int i = 0; i < 3; i++)
+                    packet.object.invModel3x3[i] = glm::vec4(0.0f);
+                packet.object.material[0] = packet.object.material[1] = packet.object.material[2] = packet.object.material[3] = 0;
+                //In front of the other translucent objects : the particles are sorted among themselves only
+                packet.key = RenderQueue::makeKey(LAYER_TRANSLUCENT, particleShader->getProgramID(), 0, vaoParticleID, 0.0f);
+                renderQueue.push(packet);
+            }
+            instanceStream->flush();
+            renderQueue.sort();
         }
-        else if (tAsteroide < -15.0) {
-            drawSphere(Etoiles, shader, matrices);
-            tAsteroide -= 0.01;
+        {
+            ProfileScope scope(profiler, "submit");
+            ProfileGpuScope gpuScope(profiler, "scene");
+            if (skybox && state.sky)
+                skybox->setView(projection * state.view, state.skyRotation, state.skyColor * light.color);
+            renderQueue.submit(uniformBuffers, frame, weightedBlending, state.sky ? skybox : NULL);
         }
-        else if (tAsteroide < -14.60) {
-            drawSphere(Etoiles, shader, matrices);
-            drawSphere(sunGO, shader, matrices);
-            tAsteroide -= 0.01;
+
+        const RenderStats& renderStats = renderQueue.getStats();
+        if (renderStats.nbDraws != lastRenderStats.nbDraws || renderStats.programBinds != lastRenderStats.programBinds ||
+            renderStats.textureBinds != lastRenderStats.textureBinds || renderStats.bufferBinds != lastRenderStats.bufferBinds) {
+            INFO("Render queue: %u draws, %u program binds, %u texture binds, %u buffer binds\n",
+                 renderStats.nbDraws, renderStats.programBinds, renderStats.textureBinds, renderStats.bufferBinds);
+            lastRenderStats = renderStats;
         }
-        else {
-            drawSphere(sunGO, shader, matrices);
-            drawSphere(sunGOEarth, shader, matrices);
-            drawSphere(sunGOMercury, shader, matrices);
-            drawSphere(sunGOVenus, shader, matrices);
-            drawSphere(sunGOMars, shader, matrices);
-            drawSphere(sunGOJupiter, shader, matrices);
-            drawSphere(sunGOSaturne, shader, matrices);
-            drawSphere(sunGOUranus, shader, matrices);
-            drawSphere(sunGONeptune, shader, matrices);
-            drawSphere(Etoiles, shader, matrices);
-            drawSphere(sunGOAsteroide, shader, matrices);
+
+
+
+        nbFrames++;
+        if (exporter) {
+            ProfileScope scope(profiler, "export");
+            exporter->capture(*offscreen);
         }
 
+        //Offscreen : nothing to present and no frame cap, the next frame starts right away
+        if (headless) {
+            ProfileScope scope(profiler, "swap");
+            glFlush();
+            continue;
+        }
 
+        //Show the exported frame in the window too
+        if (offscreen) {
+            glBindFramebuffer(GL_READ_FRAMEBUFFER, offscreen->getID());
+            glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+            glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+            offscreen->bind();
+        }
 
         //Display on screen (swap the buffer on screen and the buffer you are drawing on)
-        SDL_GL_SwapWindow(window);
+        {
+            ProfileScope scope(profiler, "swap");
+            SDL_GL_SwapWindow(window);
+        }
+
+        //Exporting : every simulation step is a frame, as fast as possible
+        if (exporter || renderRate <= 0.0f)
+            continue;
 
         //Time in ms telling us when this frame ended. Useful for keeping a fix framerate
         uint32_t timeEnd = SDL_GetTicks();
 
-        //We want FRAMERATE FPS
-        if (timeEnd - timeBegin < TIME_PER_FRAME_MS)
-            SDL_Delay((uint32_t)(TIME_PER_FRAME_MS)-(timeEnd - timeBegin));
+        //We want renderRate FPS
+        float timePerFrameMs = 1e3f / renderRate;
+        if (timeEnd - timeBegin < timePerFrameMs)
+            SDL_Delay((uint32_t)(timePerFrameMs)-(timeEnd - timeBegin));
     }
 
+    //Stop the simulation (it may be waiting for a frame which will not come)
+    simulating = false;
+    simulation.join();
+
+    //Wait for the GPU, then report the real throughput
+    if (exporter)
+        exporter->finish();
+    if (!raytrace)
+        glFinish();
+    if (profiler) {
+        profiler->endFrame();
+        profiler->printSummary();
+        simProfiler->printSummary();
+        const Profiler* threadProfilers[] = { profiler, simProfiler };
+        Profiler::exportChromeTrace(profilePath, threadProfilers, 2);
+    }
+    double elapsed = (SDL_GetPerformanceCounter() - timeStart) / (double)SDL_GetPerformanceFrequency();
+    if (elapsed > 0.0)
+        INFO("%u frames rendered at %dx%d in %.2f s (%.1f fps), %u without a new step\n", nbFrames, width, height, elapsed, nbFrames / elapsed, nbRepeatedStates);
+    if (rayTracer && rayElapsed > 0.0)
+        INFO("%u frames ray traced in %.2f s : %.2f Mrays/s (%.1f%% shadow rays), %u samples per pixel on %u threads, %u tile ranges stolen\n", nbFrames, rayElapsed,
+             nbRays / rayElapsed * 1e-6, nbRays ? 100.0 * nbShadowRays / nbRays : 0.0, rayTracer->getNbSamples(), rayTracer->getStats().nbThreads, nbRaySteals);
+    if (simElapsed > 0.0)
+        INFO("%u simulation steps in %.2f s (%.1f steps/s), %u replaced before being drawn\n", nbSteps, simElapsed, nbSteps / simElapsed, nbDroppedStates);
+    if (instanceStream)
+        INFO("Instances streamed by %s, %u KB per frame at most, %u waits for the GPU\n", instanceStream->isPersistent() ? "a persistent mapping" : "orphaning",
+             (uint32_t)(instanceStream->getPeakUsage() / 1024), instanceStream->getNbWaits());
+
     //Delete Buffer and Shader
-    glDeleteBuffers(1, &vboSphereID);
-    delete shader;
+    if (!raytrace) {
+        glDeleteVertexArrays(1, &vaoSphereID);
+        glDeleteBuffers(1, &vboSphereID);
+        glDeleteVertexArrays(1, &vaoRingID);
+        glDeleteBuffers(1, &vboRingID);
+        if (!impostorVAOs.empty())
+            glDeleteVertexArrays(impostorVAOs.size(), &impostorVAOs[0]);
+        if (catalog) {
+            glDeleteVertexArrays(1, &vaoAsteroidImpostorID);
+            glDeleteVertexArrays(1, &vaoAsteroidID);
+            glDeleteBuffers(1, &vboAsteroidID);
+        }
+        if (vaoParticleID) {
+            glDeleteVertexArrays(1, &vaoParticleID);
+            glDeleteBuffers(1, &vboParticleID);
+        }
+        if (!textures.empty())
+            glDeleteTextures(textures.size(), &textures[0]);
+    }
+    delete catalog;
+    delete instanceStream;
+    delete script;
+    delete impactScript;
+    delete scene;
+    delete uniformBuffers;
+    delete weightedBlending;
+    delete skybox;
+    delete rayTracer;
+    delete shaderWatcher;
+    delete shaders;
+    delete profiler;
+    delete simProfiler;
+    delete exporter;
+    delete offscreen;
 
     //Free everything
     if (context != NULL)
         SDL_GL_DeleteContext(context);
     if (window != NULL)
         SDL_DestroyWindow(window);
+    delete headlessContext;
 
     //THE_END//
 